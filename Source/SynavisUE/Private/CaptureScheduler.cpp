@@ -0,0 +1,107 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "CaptureScheduler.h"
+
+#include "Components/SceneCaptureComponent2D.h"
+#include "Dom/JsonObject.h"
+
+FCaptureScheduler::FSource& FCaptureScheduler::Register(const FString& Name, USceneCaptureComponent2D* Camera, double Rate, int32 Priority,
+  TSharedPtr<FJsonObject> Request, double Now)
+{
+  FSource* Source = Find(Name);
+  if (!Source)
+  {
+    Source = &Sources.AddDefaulted_GetRef();
+    Source->Name = Name;
+  }
+  Source->Camera = Camera;
+  Source->Request = Request;
+  Source->Interval = 1.0 / FMath::Max(Rate, 1e-6);
+  Source->Priority = Priority;
+  Source->NextDue = Now + Source->Interval;
+  return *Source;
+}
+
+bool FCaptureScheduler::Unregister(const FString& Name)
+{
+  return Sources.RemoveAll([&Name](const FSource& Source) { return Source.Name == Name; }) > 0;
+}
+
+FCaptureScheduler::FSource* FCaptureScheduler::Find(const FString& Name)
+{
+  return Sources.FindByPredicate([&Name](const FSource& Source) { return Source.Name == Name; });
+}
+
+void FCaptureScheduler::Select(double Now, double GpuMilliseconds, TArray<FSource*>& Out)
+{
+  Out.Reset();
+  const double Limit = MaxCaptures > 0 ? MaxCaptures : static_cast<double>(FMath::Max(Sources.Num(), 1));
+  if (GpuBudget > 0.0 && GpuMilliseconds > GpuBudget)
+  {
+    Allowance = FMath::Max(1.0, Allowance * 0.5);
+  }
+  else if (GpuBudget > 0.0 && GpuMilliseconds > 0.0)
+  {
+    Allowance = FMath::Min(Limit, Allowance + 0.1);
+  }
+  else
+  {
+    Allowance = Limit;
+  }
+
+  for (FSource& Source : Sources)
+  {
+    if (!Source.Camera.IsValid())
+    {
+      continue;
+    }
+    if (Source.bParked)
+    {
+      // deadlines do not pass while parked, the source is due right away once it is back
+      Source.NextDue = FMath::Max(Source.NextDue, Now);
+      continue;
+    }
+    if (Now >= Source.NextDue + Source.Interval)
+    {
+      // every deadline that passed without a capture is lost, the next one is still due
+      const double Lost = FMath::FloorToDouble((Now - Source.NextDue) / Source.Interval);
+      Source.Misses += static_cast<int64>(Lost);
+      Source.NextDue += Lost * Source.Interval;
+    }
+    if (Now >= Source.NextDue)
+    {
+      Out.Add(&Source);
+    }
+  }
+  Out.Sort([](const FSource& A, const FSource& B)
+    {
+      return A.Priority != B.Priority ? A.Priority > B.Priority : A.NextDue < B.NextDue;
+    });
+  if (Out.Num() > GetAllowance())
+  {
+    Out.SetNum(GetAllowance(), false);
+  }
+}
+
+void FCaptureScheduler::Complete(FSource& Source)
+{
+  ++Source.Captures;
+  // the source is less than an interval late here, so this stays on the grid and lies in the future
+  Source.NextDue += Source.Interval;
+}
+
+void FCaptureScheduler::Miss(FSource& Source)
+{
+  ++Source.Misses;
+  Source.NextDue += Source.Interval;
+}
+
+int64 FCaptureScheduler::GetMisses() const
+{
+  int64 Misses = 0;
+  for (const FSource& Source : Sources)
+  {
+    Misses += Source.Misses;
+  }
+  return Misses;
+}
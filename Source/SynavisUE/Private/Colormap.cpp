@@ -0,0 +1,190 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "Colormap.h"
+
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+// arrays above this size are split across worker threads
+static constexpr int32 ParallelBlockSize = 1 << 15;
+
+static void RangeOfBlock(const float* Values, int32 Num, float& OutMin, float& OutMax)
+{
+  VectorRegister4Float VMin = VectorSetFloat1(TNumericLimits<float>::Max());
+  VectorRegister4Float VMax = VectorSetFloat1(TNumericLimits<float>::Lowest());
+  int32 i = 0;
+  for (; i + 4 <= Num; i += 4)
+  {
+    const VectorRegister4Float V = VectorLoad(Values + i);
+    VMin = VectorMin(V, VMin);
+    VMax = VectorMax(V, VMax);
+  }
+  alignas(16) float Mins[4], Maxs[4];
+  VectorStoreAligned(VMin, Mins);
+  VectorStoreAligned(VMax, Maxs);
+  OutMin = FMath::Min(FMath::Min(Mins[0], Mins[1]), FMath::Min(Mins[2], Mins[3]));
+  OutMax = FMath::Max(FMath::Max(Maxs[0], Maxs[1]), FMath::Max(Maxs[2], Maxs[3]));
+  for (; i < Num; ++i)
+  {
+    OutMin = FMath::Min(OutMin, Values[i]);
+    OutMax = FMath::Max(OutMax, Values[i]);
+  }
+}
+
+static void MapBlock(const FColor* LUT, const float* Values, int32 Num, float Min, float Scale, FColor* OutColors)
+{
+  const VectorRegister4Float VMin = VectorSetFloat1(Min);
+  const VectorRegister4Float VScale = VectorSetFloat1(Scale);
+  const VectorRegister4Float VHalf = VectorSetFloat1(0.5f);
+  const VectorRegister4Float VZero = VectorZeroFloat();
+  const VectorRegister4Float VTop = VectorSetFloat1(255.f);
+  alignas(16) int32 Indices[4];
+  int32 i = 0;
+  for (; i + 4 <= Num; i += 4)
+  {
+    VectorRegister4Float V = VectorMultiplyAdd(VectorSubtract(VectorLoad(Values + i), VMin), VScale, VHalf);
+    V = VectorMin(VectorMax(V, VZero), VTop);
+    VectorIntStoreAligned(VectorFloatToInt(V), Indices);
+    OutColors[i + 0] = LUT[Indices[0]];
+    OutColors[i + 1] = LUT[Indices[1]];
+    OutColors[i + 2] = LUT[Indices[2]];
+    OutColors[i + 3] = LUT[Indices[3]];
+  }
+  for (; i < Num; ++i)
+  {
+    OutColors[i] = LUT[FMath::Clamp(static_cast<int32>((Values[i] - Min) * Scale + 0.5f), 0, 255)];
+  }
+}
+
+static FColor HexColor(uint32 Hex)
+{
+  return FColor((Hex >> 16) & 0xFF, (Hex >> 8) & 0xFF, Hex & 0xFF, 255);
+}
+
+FColormap FColormap::FromControlPoints(const TArray<FColor>& Points)
+{
+  FColormap Map;
+  const int32 Segments = Points.Num() - 1;
+  for (int32 i = 0; i < 256; ++i)
+  {
+    const float Position = (i / 255.f) * Segments;
+    const int32 Lower = FMath::Min(FMath::FloorToInt32(Position), Segments - 1);
+    const float Alpha = Position - Lower;
+    const FColor& A = Points[Lower];
+    const FColor& B = Points[Lower + 1];
+    Map.LUT[i] = FColor(
+      FMath::RoundToInt32(FMath::Lerp<float>(A.R, B.R, Alpha)),
+      FMath::RoundToInt32(FMath::Lerp<float>(A.G, B.G, Alpha)),
+      FMath::RoundToInt32(FMath::Lerp<float>(A.B, B.B, Alpha)),
+      255);
+  }
+  return Map;
+}
+
+static TMap<FString, FColormap> CreateColormaps()
+{
+  TMap<FString, FColormap> Maps;
+  Maps.Add(TEXT("viridis"), FColormap::FromControlPoints({ HexColor(0x440154), HexColor(0x482878), HexColor(0x3e4989), HexColor(0x31688e),
+    HexColor(0x26828e), HexColor(0x1f9e89), HexColor(0x35b779), HexColor(0x6ece58), HexColor(0xb5de2b), HexColor(0xfde725) }));
+  Maps.Add(TEXT("plasma"), FColormap::FromControlPoints({ HexColor(0x0d0887), HexColor(0x41049d), HexColor(0x6a00a8), HexColor(0x8f0da4),
+    HexColor(0xb12a90), HexColor(0xcc4778), HexColor(0xe16462), HexColor(0xf2844b), HexColor(0xfca636), HexColor(0xfcce25), HexColor(0xf0f921) }));
+  Maps.Add(TEXT("inferno"), FColormap::FromControlPoints({ HexColor(0x000004), HexColor(0x1b0c41), HexColor(0x4a0c6b), HexColor(0x781c6d),
+    HexColor(0xa52c60), HexColor(0xcf4446), HexColor(0xed6925), HexColor(0xfb9b06), HexColor(0xf7d13d), HexColor(0xfcffa4) }));
+  Maps.Add(TEXT("magma"), FColormap::FromControlPoints({ HexColor(0x000004), HexColor(0x180f3d), HexColor(0x440f76), HexColor(0x721f81),
+    HexColor(0x9e2f7f), HexColor(0xcd4071), HexColor(0xf1605d), HexColor(0xfd9668), HexColor(0xfeca8d), HexColor(0xfcfdbf) }));
+  Maps.Add(TEXT("coolwarm"), FColormap::FromControlPoints({ HexColor(0x3b4cc0), HexColor(0xdddcdc), HexColor(0xb40426) }));
+  Maps.Add(TEXT("gray"), FColormap::FromControlPoints({ HexColor(0x000000), HexColor(0xffffff) }));
+
+  FColormap Jet;
+  for (int32 i = 0; i < 256; ++i)
+  {
+    const float t = i / 255.f;
+    Jet.LUT[i] = FLinearColor(
+      FMath::Clamp(1.5f - FMath::Abs(4.f * t - 3.f), 0.f, 1.f),
+      FMath::Clamp(1.5f - FMath::Abs(4.f * t - 2.f), 0.f, 1.f),
+      FMath::Clamp(1.5f - FMath::Abs(4.f * t - 1.f), 0.f, 1.f)).ToFColor(false);
+  }
+  Maps.Add(TEXT("jet"), Jet);
+
+  // the original hard-coded mapping of the spawn command, red at the bottom and blue at the top through HSV
+  FColormap BlueRed;
+  for (int32 i = 0; i < 256; ++i)
+  {
+    BlueRed.LUT[i] = FLinearColor::LerpUsingHSV(FLinearColor(1, 0, 0), FLinearColor(0, 0, 1), i / 255.f).ToFColor(false);
+  }
+  Maps.Add(TEXT("bluered"), BlueRed);
+  return Maps;
+}
+
+static const TMap<FString, FColormap>& GetColormaps()
+{
+  static const TMap<FString, FColormap> Maps = CreateColormaps();
+  return Maps;
+}
+
+const FColormap* FColormap::Find(const FString& Name)
+{
+  return GetColormaps().Find(Name.ToLower());
+}
+
+TArray<FString> FColormap::GetNames()
+{
+  TArray<FString> Names;
+  GetColormaps().GetKeys(Names);
+  return Names;
+}
+
+bool FColormap::ComputeRange(const float* Values, int32 Num, float& OutMin, float& OutMax)
+{
+  if (Num <= 0)
+  {
+    return false;
+  }
+  if (Num <= ParallelBlockSize)
+  {
+    RangeOfBlock(Values, Num, OutMin, OutMax);
+    return true;
+  }
+  const int32 NumBlocks = FMath::DivideAndRoundUp(Num, ParallelBlockSize);
+  TArray<float> Mins, Maxs;
+  Mins.SetNumUninitialized(NumBlocks);
+  Maxs.SetNumUninitialized(NumBlocks);
+  ParallelFor(NumBlocks, [&](int32 Block)
+    {
+      const int32 Start = Block * ParallelBlockSize;
+      RangeOfBlock(Values + Start, FMath::Min(ParallelBlockSize, Num - Start), Mins[Block], Maxs[Block]);
+    });
+  OutMin = FMath::Min(Mins);
+  OutMax = FMath::Max(Maxs);
+  return true;
+}
+
+void FColormap::Map(const float* Values, int32 Num, float Min, float Max, FColor* OutColors) const
+{
+  if (Num <= 0)
+  {
+    return;
+  }
+  if (Min >= Max)
+  {
+    ComputeRange(Values, Num, Min, Max);
+  }
+  // a constant field maps onto the lower end of the table
+  const float Scale = (Max > Min) ? 255.f / (Max - Min) : 0.f;
+  if (Num <= ParallelBlockSize)
+  {
+    MapBlock(LUT, Values, Num, Min, Scale, OutColors);
+    return;
+  }
+  ParallelFor(FMath::DivideAndRoundUp(Num, ParallelBlockSize), [&](int32 Block)
+    {
+      const int32 Start = Block * ParallelBlockSize;
+      MapBlock(LUT, Values + Start, FMath::Min(ParallelBlockSize, Num - Start), Min, Scale, OutColors + Start);
+    });
+}
+
+void FColormap::Map(const TArray<float>& Values, float Min, float Max, TArray<FColor>& OutColors) const
+{
+  OutColors.SetNumUninitialized(Values.Num());
+  Map(Values.GetData(), Values.Num(), Min, Max, OutColors.GetData());
+}
@@ -0,0 +1,300 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "DatasetWriter.h"
+
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+// writes leave in pieces of this size, or larger if a single file is larger
+static constexpr int64 WriteBufferSize = 8 << 20;
+// producers block once this much waits for the disk
+static constexpr int64 MaxQueuedBytes = 256 << 20;
+static constexpr int64 TarBlock = 512;
+
+FDatasetWriter::FDatasetWriter(const FString& InDirectory, const FString& InPrefix, int64 InShardSize, EDatasetSync InSync)
+  : Directory(InDirectory)
+  , Prefix(InPrefix)
+  , ShardSize(FMath::Max<int64>(InShardSize, WriteBufferSize))
+  , Sync(InSync)
+{
+  Buffer.Reserve(WriteBufferSize);
+  WakeUp = FPlatformProcess::GetSynchEventFromPool();
+  Drained = FPlatformProcess::GetSynchEventFromPool();
+  Thread = FRunnableThread::Create(this, TEXT("SynavisDatasetWriter"));
+}
+
+FDatasetWriter::~FDatasetWriter()
+{
+  if (Thread)
+  {
+    // the remaining samples are written before the thread ends
+    Thread->Kill(true);
+    delete Thread;
+  }
+  FPlatformProcess::ReturnSynchEventToPool(WakeUp);
+  FPlatformProcess::ReturnSynchEventToPool(Drained);
+}
+
+bool FDatasetWriter::ParseSync(const FString& Name, EDatasetSync& Out)
+{
+  if (Name == TEXT("none"))
+  {
+    Out = EDatasetSync::None;
+  }
+  else if (Name == TEXT("shard"))
+  {
+    Out = EDatasetSync::Shard;
+  }
+  else if (Name == TEXT("sample"))
+  {
+    Out = EDatasetSync::Sample;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+void FDatasetWriter::Stop()
+{
+  bStopping = true;
+  WakeUp->Trigger();
+  Drained->Trigger();
+}
+
+void FDatasetWriter::Write(TArray<FFile>&& Files)
+{
+  int64 SampleBytes = 0;
+  for (const FFile& Entry : Files)
+  {
+    SampleBytes += Entry.Data.Num();
+  }
+  while (!bStopping && !bFailed)
+  {
+    {
+      FScopeLock ScopeLock(&QueueLock);
+      // a dataset should not lose samples, so the producer waits instead of dropping
+      if (Queue.Num() == 0 || QueuedBytes + SampleBytes <= MaxQueuedBytes)
+      {
+        FSample& Sample = Queue.AddDefaulted_GetRef();
+        Sample.Key = FString::Printf(TEXT("%09lld"), NextKey++);
+        Sample.Files = MoveTemp(Files);
+        QueuedBytes += SampleBytes;
+        break;
+      }
+    }
+    Drained->Wait(10);
+  }
+  WakeUp->Trigger();
+}
+
+uint32 FDatasetWriter::Run()
+{
+  while (true)
+  {
+    FSample Sample;
+    bool bHasSample = false;
+    {
+      FScopeLock ScopeLock(&QueueLock);
+      if (Queue.Num() > 0)
+      {
+        Sample = MoveTemp(Queue[0]);
+        Queue.RemoveAt(0, 1, false);
+        bHasSample = true;
+      }
+    }
+    if (!bHasSample)
+    {
+      if (bStopping)
+      {
+        break;
+      }
+      WakeUp->Wait(100);
+      continue;
+    }
+    int64 SampleBytes = 0;
+    for (const FFile& Entry : Sample.Files)
+    {
+      SampleBytes += Entry.Data.Num();
+    }
+    if (!bFailed)
+    {
+      WriteSample(Sample);
+    }
+    {
+      FScopeLock ScopeLock(&QueueLock);
+      QueuedBytes -= SampleBytes;
+    }
+    Drained->Trigger();
+  }
+  CloseShard();
+  return 0;
+}
+
+void FDatasetWriter::WriteSample(FSample& Sample)
+{
+  int64 SampleBytes = 0;
+  for (const FFile& Entry : Sample.Files)
+  {
+    SampleBytes += TarBlock + Align(Entry.Data.Num(), TarBlock);
+  }
+  if (File && ShardBytes > 0 && ShardBytes + SampleBytes > ShardSize)
+  {
+    CloseShard();
+  }
+  if (!File && !OpenShard())
+  {
+    return;
+  }
+  for (const FFile& Entry : Sample.Files)
+  {
+    WriteEntry(Sample.Key + TEXT(".") + Entry.Name, Entry.Data);
+    if (bFailed)
+    {
+      // a sample with missing entries is not counted
+      return;
+    }
+  }
+  ++BufferedSamples;
+  if (Sync == EDatasetSync::Sample)
+  {
+    FlushBuffer(true);
+  }
+}
+
+void FDatasetWriter::WriteEntry(const FString& Name, const TArray<uint8>& Data)
+{
+  // ustar header, numbers are octal text
+  uint8 Header[TarBlock] = {};
+  const auto SetText = [&Header](int32 Offset, int32 Size, const ANSICHAR* Text)
+    {
+      FCStringAnsi::Strncpy(reinterpret_cast<ANSICHAR*>(Header + Offset), Text, Size);
+    };
+  const auto SetOctal = [&Header](int32 Offset, int32 Size, uint64 Value)
+    {
+      // Size - 1 digits and a terminating zero
+      for (int32 i = Size - 2; i >= 0; --i, Value >>= 3)
+      {
+        Header[Offset + i] = static_cast<uint8>('0' + (Value & 7));
+      }
+    };
+  const FTCHARToUTF8 Utf8Name(*Name);
+  // longer names are cut, the keys are short and the file names are ours
+  FMemory::Memcpy(Header, Utf8Name.Get(), FMath::Min(Utf8Name.Length(), 99));
+  SetOctal(100, 8, 0644);
+  SetOctal(108, 8, 0);
+  SetOctal(116, 8, 0);
+  SetOctal(124, 12, Data.Num());
+  SetOctal(136, 12, static_cast<uint64>(FDateTime::UtcNow().ToUnixTimestamp()));
+  Header[156] = '0';
+  SetText(257, 6, "ustar");
+  Header[263] = '0';
+  Header[264] = '0';
+  // the checksum is taken with its own field filled with spaces
+  FMemory::Memset(Header + 148, ' ', 8);
+  uint32 Checksum = 0;
+  for (int32 i = 0; i < TarBlock; ++i)
+  {
+    Checksum += Header[i];
+  }
+  SetOctal(148, 7, Checksum);
+  Header[154] = '\0';
+  Header[155] = ' ';
+
+  Append(Header, TarBlock);
+  Append(Data.GetData(), Data.Num());
+  const int64 Padding = Align(Data.Num(), TarBlock) - Data.Num();
+  if (Padding > 0)
+  {
+    static const uint8 Zeros[TarBlock] = {};
+    Append(Zeros, Padding);
+  }
+}
+
+void FDatasetWriter::Append(const uint8* Data, int64 Length)
+{
+  if (Buffer.Num() + Length > WriteBufferSize)
+  {
+    FlushBuffer(false);
+  }
+  if (Length >= WriteBufferSize)
+  {
+    // large files go to the disk as they are instead of through the buffer
+    if (File && !File->Write(Data, Length))
+    {
+      UE_LOG(LogTemp, Error, TEXT("Could not write to dataset shard %s"), *ShardFile);
+      bFailed = true;
+    }
+  }
+  else
+  {
+    Buffer.Append(Data, static_cast<int32>(Length));
+  }
+  ShardBytes += Length;
+  Bytes += Length;
+}
+
+void FDatasetWriter::FlushBuffer(bool bSync)
+{
+  if (!File)
+  {
+    Buffer.Reset();
+    BufferedSamples = 0;
+    return;
+  }
+  if (Buffer.Num() > 0 && !File->Write(Buffer.GetData(), Buffer.Num()))
+  {
+    UE_LOG(LogTemp, Error, TEXT("Could not write to dataset shard %s"), *ShardFile);
+    bFailed = true;
+  }
+  else if (!bFailed)
+  {
+    // everything of these samples is in the file now
+    Samples += BufferedSamples;
+  }
+  BufferedSamples = 0;
+  Buffer.Reset();
+  if (bSync)
+  {
+    File->Flush(true);
+  }
+}
+
+bool FDatasetWriter::OpenShard()
+{
+  IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+  PlatformFile.CreateDirectoryTree(*Directory);
+  ShardFile = FPaths::Combine(Directory, FString::Printf(TEXT("%s-%06d.tar"), *Prefix, ShardIndex));
+  File.Reset(PlatformFile.OpenWrite(*(ShardFile + TEXT(".part"))));
+  if (!File)
+  {
+    UE_LOG(LogTemp, Error, TEXT("Could not open dataset shard %s"), *ShardFile);
+    bFailed = true;
+    return false;
+  }
+  ShardBytes = 0;
+  return true;
+}
+
+void FDatasetWriter::CloseShard()
+{
+  if (!File)
+  {
+    return;
+  }
+  // two empty blocks end the archive
+  static const uint8 Zeros[2 * TarBlock] = {};
+  Append(Zeros, 2 * TarBlock);
+  FlushBuffer(Sync != EDatasetSync::None);
+  File.Reset();
+  IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+  PlatformFile.DeleteFile(*ShardFile);
+  if (!PlatformFile.MoveFile(*ShardFile, *(ShardFile + TEXT(".part"))))
+  {
+    UE_LOG(LogTemp, Error, TEXT("Could not finish dataset shard %s"), *ShardFile);
+  }
+  ++ShardIndex;
+  ++Shards;
+}
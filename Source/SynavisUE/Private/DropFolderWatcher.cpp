@@ -0,0 +1,170 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "DropFolderWatcher.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_LINUX
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+FDropFolderWatcher::FDropFolderWatcher(const FString& InDirectory, TFunction<void(const FString&)> InOnFile, bool bInReportExisting, float InPollInterval)
+  : Directory(FPaths::ConvertRelativePathToFull(InDirectory))
+  , OnFile(MoveTemp(InOnFile))
+  , bReportExisting(bInReportExisting)
+  , PollInterval(FMath::Max(InPollInterval, 0.01f))
+{
+  IFileManager::Get().MakeDirectory(*Directory, true);
+  Thread = FRunnableThread::Create(this, TEXT("SynavisDropFolder"));
+}
+
+FDropFolderWatcher::~FDropFolderWatcher()
+{
+  if (Thread)
+  {
+    // Kill stops the runnable and waits for it
+    Thread->Kill(true);
+    delete Thread;
+  }
+}
+
+void FDropFolderWatcher::Stop()
+{
+  bStopping = true;
+}
+
+bool FDropFolderWatcher::IsIgnored(const FString& FileName)
+{
+  const FString Name = FPaths::GetCleanFilename(FileName);
+  return Name.IsEmpty() || Name.StartsWith(TEXT(".")) || Name.EndsWith(TEXT("~"))
+    || Name.EndsWith(TEXT(".tmp")) || Name.EndsWith(TEXT(".part")) || Name.EndsWith(TEXT(".json"));
+}
+
+FString FDropFolderWatcher::FindSidecar(const FString& FileName)
+{
+  IFileManager& FileManager = IFileManager::Get();
+  const FString Full = FileName + TEXT(".json");
+  if (FileManager.FileExists(*Full))
+  {
+    return Full;
+  }
+  const FString Base = FPaths::ChangeExtension(FileName, TEXT("json"));
+  return FileManager.FileExists(*Base) ? Base : FString();
+}
+
+void FDropFolderWatcher::ScanExisting(TSet<FString>& Known, bool bReport)
+{
+  TArray<FString> Files;
+  IFileManager::Get().FindFiles(Files, *(Directory / TEXT("*")), true, false);
+  Files.Sort();
+  for (const FString& Name : Files)
+  {
+    if (!IsIgnored(Name) && !Known.Contains(Name))
+    {
+      Known.Add(Name);
+      if (bReport)
+      {
+        OnFile(Directory / Name);
+      }
+    }
+  }
+}
+
+uint32 FDropFolderWatcher::Run()
+{
+  TSet<FString> Known;
+  if (!RunNotify(Known))
+  {
+    RunPolling(Known);
+  }
+  return 0;
+}
+
+bool FDropFolderWatcher::RunNotify(TSet<FString>& Known)
+{
+#if PLATFORM_LINUX
+  const int Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (Notify < 0)
+  {
+    return false;
+  }
+  // a rename into the folder is the complete file, a closed write covers writers that do not rename
+  const int Watch = inotify_add_watch(Notify, TCHAR_TO_UTF8(*Directory), IN_MOVED_TO | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_DELETE);
+  if (Watch < 0)
+  {
+    close(Notify);
+    return false;
+  }
+  // the watch is in place before the scan, so no file falls between the two
+  ScanExisting(Known, bReportExisting);
+  alignas(inotify_event) char Buffer[16384];
+  while (!bStopping)
+  {
+    pollfd Poll{ Notify, POLLIN, 0 };
+    if (poll(&Poll, 1, static_cast<int>(PollInterval * 1000.f)) <= 0)
+    {
+      continue;
+    }
+    const ssize_t Length = read(Notify, Buffer, sizeof(Buffer));
+    for (ssize_t Offset = 0; Offset < Length;)
+    {
+      const inotify_event* Event = reinterpret_cast<const inotify_event*>(Buffer + Offset);
+      Offset += sizeof(inotify_event) + Event->len;
+      if (Event->mask & IN_Q_OVERFLOW)
+      {
+        ScanExisting(Known, true);
+        continue;
+      }
+      if (Event->len == 0 || (Event->mask & IN_ISDIR))
+      {
+        continue;
+      }
+      const FString Name = UTF8_TO_TCHAR(Event->name);
+      if (Event->mask & (IN_MOVED_FROM | IN_DELETE))
+      {
+        Known.Remove(Name);
+      }
+      else if (!IsIgnored(Name) && !Known.Contains(Name))
+      {
+        Known.Add(Name);
+        OnFile(Directory / Name);
+      }
+    }
+  }
+  inotify_rm_watch(Notify, Watch);
+  close(Notify);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void FDropFolderWatcher::RunPolling(TSet<FString>& Known)
+{
+  if (!bReportExisting)
+  {
+    ScanExisting(Known, false);
+  }
+  while (!bStopping)
+  {
+    TArray<FString> Files;
+    IFileManager::Get().FindFiles(Files, *(Directory / TEXT("*")), true, false);
+    Files.Sort();
+    TSet<FString> Present;
+    for (const FString& Name : Files)
+    {
+      Present.Add(Name);
+      if (!IsIgnored(Name) && !Known.Contains(Name))
+      {
+        OnFile(Directory / Name);
+      }
+    }
+    // files that were removed can be dropped again under the same name
+    Known = MoveTemp(Present);
+    FPlatformProcess::Sleep(PollInterval);
+  }
+}
@@ -0,0 +1,530 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "FrameCodec.h"
+
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "Misc/Compression.h"
+#include "Async/ParallelFor.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#include <emmintrin.h>
+#endif
+
+bool FFrameCodec::Parse(const FString& Name, int32 Quality, FFrameCodec& Out)
+{
+  static const EFrameEncoding Encodings[] = { EFrameEncoding::Raw, EFrameEncoding::LZ4, EFrameEncoding::Zlib,
+    EFrameEncoding::QOI, EFrameEncoding::PNG, EFrameEncoding::JPEG };
+  for (const EFrameEncoding Encoding : Encodings)
+  {
+    if (Name.Equals(GetName(Encoding), ESearchCase::IgnoreCase))
+    {
+      Out.Encoding = Encoding;
+      Out.Quality = Quality;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FFrameCodec::ParseChannel(const FString& Name, EFrameChannel& Out)
+{
+  static const EFrameChannel Channels[] = { EFrameChannel::Color, EFrameChannel::Depth16, EFrameChannel::Depth32,
+    EFrameChannel::Seg8, EFrameChannel::Seg16 };
+  for (const EFrameChannel Channel : Channels)
+  {
+    if (Name.Equals(GetChannelName(Channel), ESearchCase::IgnoreCase))
+    {
+      Out = Channel;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FFrameCodec::ParseSink(const FString& Name, FFrameCodec& Out)
+{
+  const bool bBoth = Name.Equals(TEXT("both"), ESearchCase::IgnoreCase);
+  const bool bNetwork = bBoth || Name.Equals(TEXT("network"), ESearchCase::IgnoreCase);
+  const bool bDataset = bBoth || Name.Equals(TEXT("dataset"), ESearchCase::IgnoreCase);
+  if (!bNetwork && !bDataset)
+  {
+    return false;
+  }
+  Out.bNetwork = bNetwork;
+  Out.bDataset = bDataset;
+  return true;
+}
+
+const TCHAR* FFrameCodec::GetChannelName(EFrameChannel Channel)
+{
+  switch (Channel)
+  {
+  case EFrameChannel::Depth16: return TEXT("depth16");
+  case EFrameChannel::Depth32: return TEXT("depth32");
+  case EFrameChannel::Seg8: return TEXT("seg8");
+  case EFrameChannel::Seg16: return TEXT("seg16");
+  default: return TEXT("color");
+  }
+}
+
+const TCHAR* FFrameCodec::GetName(EFrameEncoding Encoding)
+{
+  switch (Encoding)
+  {
+  case EFrameEncoding::LZ4: return TEXT("lz4");
+  case EFrameEncoding::Zlib: return TEXT("zlib");
+  case EFrameEncoding::QOI: return TEXT("qoi");
+  case EFrameEncoding::PNG: return TEXT("png");
+  case EFrameEncoding::JPEG: return TEXT("jpeg");
+  default: return TEXT("raw");
+  }
+}
+
+bool FFrameCodec::Encode(const FFrameCodec& Codec, const TArray<FColor>& Pixels, int32 Width, int32 Height, IImageWrapperModule* ImageWrappers, TArray<uint8>& Out)
+{
+  const int32 Bytes = Pixels.Num() * sizeof(FColor);
+  Out.Reset();
+  switch (Codec.Encoding)
+  {
+  case EFrameEncoding::Raw:
+    Out.Append(reinterpret_cast<const uint8*>(Pixels.GetData()), Bytes);
+    return true;
+  case EFrameEncoding::LZ4:
+  case EFrameEncoding::Zlib:
+    return Compress(Codec.Encoding, reinterpret_cast<const uint8*>(Pixels.GetData()), Bytes, Out);
+  case EFrameEncoding::QOI:
+    EncodeQOI(Pixels.GetData(), Width, Height, Out);
+    return true;
+  case EFrameEncoding::PNG:
+  case EFrameEncoding::JPEG:
+  {
+    if (!ImageWrappers)
+    {
+      return false;
+    }
+    TSharedPtr<IImageWrapper> Wrapper = ImageWrappers->CreateImageWrapper(Codec.Encoding == EFrameEncoding::PNG ? EImageFormat::PNG : EImageFormat::JPEG);
+    if (!Wrapper.IsValid() || !Wrapper->SetRaw(Pixels.GetData(), Bytes, Width, Height, ERGBFormat::BGRA, 8))
+    {
+      return false;
+    }
+    const int32 Quality = (Codec.Encoding == EFrameEncoding::JPEG && Codec.Quality <= 0) ? 85 : Codec.Quality;
+    const TArray64<uint8> Compressed = Wrapper->GetCompressed(Quality);
+    Out.Append(Compressed.GetData(), Compressed.Num());
+    return Out.Num() > 0;
+  }
+  default:
+    return false;
+  }
+}
+
+bool FFrameCodec::Compress(EFrameEncoding Encoding, const uint8* Data, int32 Bytes, TArray<uint8>& Out)
+{
+  if (Encoding != EFrameEncoding::LZ4 && Encoding != EFrameEncoding::Zlib)
+  {
+    return false;
+  }
+  const FName Format = (Encoding == EFrameEncoding::LZ4) ? NAME_LZ4 : NAME_Zlib;
+  int32 CompressedSize = FCompression::CompressMemoryBound(Format, Bytes);
+  Out.SetNumUninitialized(CompressedSize);
+  if (!FCompression::CompressMemory(Format, Out.GetData(), CompressedSize, Data, Bytes))
+  {
+    return false;
+  }
+  Out.SetNum(CompressedSize, false);
+  return true;
+}
+
+void FFrameCodec::EncodeQOI(const FColor* Pixels, int32 Width, int32 Height, TArray<uint8>& Out)
+{
+  // see https://qoiformat.org/qoi-specification.pdf
+  constexpr uint8 OpIndex = 0x00;
+  constexpr uint8 OpDiff = 0x40;
+  constexpr uint8 OpLuma = 0x80;
+  constexpr uint8 OpRun = 0xc0;
+  constexpr uint8 OpRGB = 0xfe;
+  constexpr uint8 OpRGBA = 0xff;
+
+  const int64 Count = static_cast<int64>(Width) * Height;
+  Out.Reset(static_cast<int32>(14 + Count * 5 + 8));
+  const auto Write32 = [&Out](uint32 Value)
+    {
+      Out.Add(static_cast<uint8>(Value >> 24));
+      Out.Add(static_cast<uint8>(Value >> 16));
+      Out.Add(static_cast<uint8>(Value >> 8));
+      Out.Add(static_cast<uint8>(Value));
+    };
+  Out.Append({ 'q', 'o', 'i', 'f' });
+  Write32(Width);
+  Write32(Height);
+  // four channels, sRGB with linear alpha
+  Out.Add(4);
+  Out.Add(0);
+
+  FColor Index[64];
+  FMemory::Memzero(Index);
+  FColor Previous(0, 0, 0, 255);
+  int32 Run = 0;
+  for (int64 i = 0; i < Count; ++i)
+  {
+    const FColor Pixel = Pixels[i];
+    if (Pixel == Previous)
+    {
+      if (++Run == 62 || i == Count - 1)
+      {
+        Out.Add(static_cast<uint8>(OpRun | (Run - 1)));
+        Run = 0;
+      }
+      continue;
+    }
+    if (Run > 0)
+    {
+      Out.Add(static_cast<uint8>(OpRun | (Run - 1)));
+      Run = 0;
+    }
+    const int32 Hash = (Pixel.R * 3 + Pixel.G * 5 + Pixel.B * 7 + Pixel.A * 11) % 64;
+    if (Index[Hash] == Pixel)
+    {
+      Out.Add(static_cast<uint8>(OpIndex | Hash));
+    }
+    else if (Pixel.A == Previous.A)
+    {
+      Index[Hash] = Pixel;
+      // differences wrap around like the channels do
+      const int32 DR = static_cast<int8>(Pixel.R - Previous.R);
+      const int32 DG = static_cast<int8>(Pixel.G - Previous.G);
+      const int32 DB = static_cast<int8>(Pixel.B - Previous.B);
+      const int32 DRG = DR - DG;
+      const int32 DBG = DB - DG;
+      if (DR > -3 && DR < 2 && DG > -3 && DG < 2 && DB > -3 && DB < 2)
+      {
+        Out.Add(static_cast<uint8>(OpDiff | ((DR + 2) << 4) | ((DG + 2) << 2) | (DB + 2)));
+      }
+      else if (DRG > -9 && DRG < 8 && DG > -33 && DG < 32 && DBG > -9 && DBG < 8)
+      {
+        Out.Add(static_cast<uint8>(OpLuma | (DG + 32)));
+        Out.Add(static_cast<uint8>(((DRG + 8) << 4) | (DBG + 8)));
+      }
+      else
+      {
+        Out.Append({ OpRGB, Pixel.R, Pixel.G, Pixel.B });
+      }
+    }
+    else
+    {
+      Index[Hash] = Pixel;
+      Out.Append({ OpRGBA, Pixel.R, Pixel.G, Pixel.B, Pixel.A });
+    }
+    Previous = Pixel;
+  }
+  Out.Append({ 0, 0, 0, 0, 0, 0, 0, 1 });
+}
+
+void FFrameCodec::PackDepth(const TArray<float>& Depth, EFrameChannel Channel, float DepthUnit, TArray<uint8>& Out, double& Scale)
+{
+  if (Channel == EFrameChannel::Depth32)
+  {
+    Out.SetNumUninitialized(Depth.Num() * sizeof(float));
+    FMemory::Memcpy(Out.GetData(), Depth.GetData(), Out.Num());
+    Scale = 0.01;
+    return;
+  }
+  const float Unit = FMath::Max(DepthUnit, KINDA_SMALL_NUMBER);
+  Out.SetNumUninitialized(Depth.Num() * sizeof(uint16));
+  uint16* Target = reinterpret_cast<uint16*>(Out.GetData());
+  constexpr int32 Block = 1 << 16;
+  ParallelFor(FMath::DivideAndRoundUp(Depth.Num(), Block), [&](int32 b)
+    {
+      const int32 End = FMath::Min(Depth.Num(), (b + 1) * Block);
+      for (int32 i = b * Block; i < End; ++i)
+      {
+        // the far plane and everything beyond the range saturates
+        Target[i] = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Depth[i] / Unit), 0, 65535));
+      }
+    });
+  Scale = Unit * 0.01;
+}
+
+// first index after Start that holds a different value than Start, sixteen bytes per step where SSE2 is there
+template <typename T>
+static int32 FindRunEnd(const T* Values, int32 Start, int32 End)
+{
+  const T Value = Values[Start];
+  int32 i = Start + 1;
+#if PLATFORM_CPU_X86_FAMILY
+  constexpr int32 Lanes = 16 / sizeof(T);
+  const __m128i Broadcast = (sizeof(T) == 1) ? _mm_set1_epi8(static_cast<char>(Value)) : _mm_set1_epi16(static_cast<short>(Value));
+  for (; i + Lanes <= End; i += Lanes)
+  {
+    const __m128i Block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Values + i));
+    const __m128i Equal = (sizeof(T) == 1) ? _mm_cmpeq_epi8(Block, Broadcast) : _mm_cmpeq_epi16(Block, Broadcast);
+    const uint32 Mask = static_cast<uint32>(_mm_movemask_epi8(Equal));
+    if (Mask != 0xffff)
+    {
+      return i + static_cast<int32>(FMath::CountTrailingZeros(~Mask & 0xffff) / sizeof(T));
+    }
+  }
+#endif
+  while (i < End && Values[i] == Value)
+  {
+    ++i;
+  }
+  return i;
+}
+
+template <typename T>
+static void EncodeRuns(const T* Values, int32 Start, int32 End, TArray<uint8>& Out)
+{
+  for (int32 i = Start; i < End;)
+  {
+    const int32 RunEnd = FMath::Min(FindRunEnd(Values, i, End), i + 65535);
+    const T Value = Values[i];
+    const uint16 Count = static_cast<uint16>(RunEnd - i);
+    Out.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+    Out.Append(reinterpret_cast<const uint8*>(&Count), sizeof(uint16));
+    i = RunEnd;
+  }
+}
+
+void FFrameCodec::PackSegmentation(const TArray<FColor>& Pixels, EFrameChannel Channel, TArray<uint8>& Out)
+{
+  // stripes are encoded on the workers and put together in order, a run may be split at a stripe border
+  constexpr int32 Stripe = 1 << 16;
+  const int32 NumStripes = FMath::DivideAndRoundUp(Pixels.Num(), Stripe);
+  TArray<TArray<uint8>> Runs;
+  Runs.SetNum(NumStripes);
+  const bool bWide = (Channel == EFrameChannel::Seg16);
+  ParallelFor(NumStripes, [&](int32 s)
+    {
+      const int32 First = s * Stripe;
+      const int32 Count = FMath::Min(Pixels.Num(), First + Stripe) - First;
+      if (bWide)
+      {
+        TArray<uint16> Plane;
+        Plane.SetNumUninitialized(Count);
+        for (int32 i = 0; i < Count; ++i)
+        {
+          Plane[i] = Pixels[First + i].R | (Pixels[First + i].G << 8);
+        }
+        EncodeRuns(Plane.GetData(), 0, Count, Runs[s]);
+      }
+      else
+      {
+        TArray<uint8> Plane;
+        Plane.SetNumUninitialized(Count);
+        for (int32 i = 0; i < Count; ++i)
+        {
+          Plane[i] = Pixels[First + i].R;
+        }
+        EncodeRuns(Plane.GetData(), 0, Count, Runs[s]);
+      }
+    });
+  Out.Reset();
+  for (const TArray<uint8>& Part : Runs)
+  {
+    Out.Append(Part);
+  }
+}
+
+FIntPoint FFrameCodec::GetScaledSize(int32 Width, int32 Height, float Scale)
+{
+  const float Clamped = FMath::Clamp(Scale, 0.f, 1.f);
+  return FIntPoint(FMath::Max(FMath::RoundToInt(Width * Clamped), 1), FMath::Max(FMath::RoundToInt(Height * Clamped), 1));
+}
+
+// averages Factor x Factor blocks, the columns of a block row are summed in 16 bit lanes, four pixels per step where SSE2 is there
+static void BoxDownsample(const FColor* In, int32 Width, int32 Factor, FColor* Out, int32 OutWidth, int32 OutHeight)
+{
+  const int32 Columns = OutWidth * Factor;
+  const uint32 Area = Factor * Factor;
+  ParallelFor(OutHeight, [&](int32 oy)
+    {
+      TArray<uint16, TInlineAllocator<4096>> Sums;
+      Sums.SetNumZeroed(Columns * 4);
+      for (int32 ky = 0; ky < Factor; ++ky)
+      {
+        const uint8* Row = reinterpret_cast<const uint8*>(In + static_cast<int64>(oy * Factor + ky) * Width);
+        int32 x = 0;
+#if PLATFORM_CPU_X86_FAMILY
+        const __m128i Zero = _mm_setzero_si128();
+        for (; x + 4 <= Columns; x += 4)
+        {
+          const __m128i Pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row + 4 * x));
+          __m128i* Target = reinterpret_cast<__m128i*>(Sums.GetData() + 4 * x);
+          _mm_storeu_si128(Target, _mm_add_epi16(_mm_loadu_si128(Target), _mm_unpacklo_epi8(Pixels, Zero)));
+          _mm_storeu_si128(Target + 1, _mm_add_epi16(_mm_loadu_si128(Target + 1), _mm_unpackhi_epi8(Pixels, Zero)));
+        }
+#endif
+        for (; x < Columns; ++x)
+        {
+          for (int32 c = 0; c < 4; ++c)
+          {
+            Sums[4 * x + c] += Row[4 * x + c];
+          }
+        }
+      }
+      uint8* Target = reinterpret_cast<uint8*>(Out + static_cast<int64>(oy) * OutWidth);
+      for (int32 ox = 0; ox < OutWidth; ++ox)
+      {
+        for (int32 c = 0; c < 4; ++c)
+        {
+          uint32 Sum = 0;
+          for (int32 kx = 0; kx < Factor; ++kx)
+          {
+            Sum += Sums[4 * (ox * Factor + kx) + c];
+          }
+          Target[4 * ox + c] = static_cast<uint8>((Sum + Area / 2) / Area);
+        }
+      }
+    }, OutHeight < 16);
+}
+
+void FFrameCodec::Resize(const TArray<FColor>& In, int32 Width, int32 Height, int32 OutWidth, int32 OutHeight, bool bFilter, TArray<FColor>& Out)
+{
+  Out.SetNumUninitialized(OutWidth * OutHeight);
+  // the column sums hold up to 257 rows of 255 in 16 bits
+  const int32 Factor = Width / OutWidth;
+  if (bFilter && Factor <= 257 && Factor * OutWidth == Width && Factor * OutHeight == Height)
+  {
+    BoxDownsample(In.GetData(), Width, Factor, Out.GetData(), OutWidth, OutHeight);
+    return;
+  }
+  // pixel centres of the output in input coordinates, in 16.16 fixed point
+  const int64 StepX = (static_cast<int64>(Width) << 16) / OutWidth;
+  const int64 StepY = (static_cast<int64>(Height) << 16) / OutHeight;
+  ParallelFor(OutHeight, [&](int32 oy)
+    {
+      FColor* Target = Out.GetData() + static_cast<int64>(oy) * OutWidth;
+      const int64 SourceY = FMath::Max<int64>(oy * StepY + StepY / 2 - 0x8000, 0);
+      const int32 y0 = FMath::Min(static_cast<int32>(SourceY >> 16), Height - 1);
+      if (!bFilter)
+      {
+        const FColor* Row = In.GetData() + static_cast<int64>(FMath::Min(static_cast<int32>((oy * StepY + StepY / 2) >> 16), Height - 1)) * Width;
+        for (int32 ox = 0; ox < OutWidth; ++ox)
+        {
+          Target[ox] = Row[FMath::Min(static_cast<int32>((ox * StepX + StepX / 2) >> 16), Width - 1)];
+        }
+        return;
+      }
+      const int32 y1 = FMath::Min(y0 + 1, Height - 1);
+      const uint32 fy = static_cast<uint32>((SourceY >> 8) & 0xff);
+      const FColor* Row0 = In.GetData() + static_cast<int64>(y0) * Width;
+      const FColor* Row1 = In.GetData() + static_cast<int64>(y1) * Width;
+      for (int32 ox = 0; ox < OutWidth; ++ox)
+      {
+        const int64 SourceX = FMath::Max<int64>(ox * StepX + StepX / 2 - 0x8000, 0);
+        const int32 x0 = FMath::Min(static_cast<int32>(SourceX >> 16), Width - 1);
+        const int32 x1 = FMath::Min(x0 + 1, Width - 1);
+        const uint32 fx = static_cast<uint32>((SourceX >> 8) & 0xff);
+        const uint8* A = reinterpret_cast<const uint8*>(Row0 + x0);
+        const uint8* B = reinterpret_cast<const uint8*>(Row0 + x1);
+        const uint8* C = reinterpret_cast<const uint8*>(Row1 + x0);
+        const uint8* D = reinterpret_cast<const uint8*>(Row1 + x1);
+        uint8* Result = reinterpret_cast<uint8*>(Target + ox);
+        for (int32 c = 0; c < 4; ++c)
+        {
+          const uint32 Top = A[c] * (256 - fx) + B[c] * fx;
+          const uint32 Bottom = C[c] * (256 - fx) + D[c] * fx;
+          Result[c] = static_cast<uint8>((Top * (256 - fy) + Bottom * fy + 32768) >> 16);
+        }
+      }
+    }, OutHeight < 16);
+}
+
+void FFrameCodec::Resize(const TArray<float>& In, int32 Width, int32 Height, int32 OutWidth, int32 OutHeight, TArray<float>& Out)
+{
+  Out.SetNumUninitialized(OutWidth * OutHeight);
+  const int64 StepX = (static_cast<int64>(Width) << 16) / OutWidth;
+  const int64 StepY = (static_cast<int64>(Height) << 16) / OutHeight;
+  ParallelFor(OutHeight, [&](int32 oy)
+    {
+      const float* Row = In.GetData() + static_cast<int64>(FMath::Min(static_cast<int32>((oy * StepY + StepY / 2) >> 16), Height - 1)) * Width;
+      float* Target = Out.GetData() + static_cast<int64>(oy) * OutWidth;
+      for (int32 ox = 0; ox < OutWidth; ++ox)
+      {
+        Target[ox] = Row[FMath::Min(static_cast<int32>((ox * StepX + StepX / 2) >> 16), Width - 1)];
+      }
+    }, OutHeight < 16);
+}
+
+// pixel rows compare four pixels per step where SSE2 is there
+static bool RowsEqual(const FColor* A, const FColor* B, int32 Count)
+{
+  int32 i = 0;
+#if PLATFORM_CPU_X86_FAMILY
+  for (; i + 4 <= Count; i += 4)
+  {
+    const __m128i Equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(A + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(B + i)));
+    if (_mm_movemask_epi8(Equal) != 0xffff)
+    {
+      return false;
+    }
+  }
+#endif
+  return FMemory::Memcmp(A + i, B + i, (Count - i) * sizeof(FColor)) == 0;
+}
+
+bool FFrameCodec::EncodeTiles(const TArray<FColor>& Current, const TArray<FColor>& Reference, int32 Width, int32 Height, int32 TileSize, TArray<uint8>& Out)
+{
+  check(Current.Num() == Reference.Num() && Current.Num() == Width * Height);
+  const int32 Size = FMath::Clamp(TileSize, 8, 256);
+  const int32 Columns = FMath::DivideAndRoundUp(Width, Size);
+  const int32 Rows = FMath::DivideAndRoundUp(Height, Size);
+  // one flag per tile, each worker takes a row of tiles
+  TArray<bool> Changed;
+  Changed.SetNumZeroed(Columns * Rows);
+  ParallelFor(Rows, [&](int32 ty)
+    {
+      const int32 Top = ty * Size;
+      const int32 Bottom = FMath::Min(Height, Top + Size);
+      for (int32 tx = 0; tx < Columns; ++tx)
+      {
+        const int32 Left = tx * Size;
+        const int32 TileWidth = FMath::Min(Width, Left + Size) - Left;
+        for (int32 y = Top; y < Bottom; ++y)
+        {
+          if (!RowsEqual(Current.GetData() + y * Width + Left, Reference.GetData() + y * Width + Left, TileWidth))
+          {
+            Changed[ty * Columns + tx] = true;
+            break;
+          }
+        }
+      }
+    });
+
+  int32 Count = 0;
+  for (const bool bChanged : Changed)
+  {
+    Count += bChanged;
+  }
+  // beyond three quarters of the frame the tile headers and lost compression context do not pay off
+  if (static_cast<int64>(Count) * Size * Size * 4 > static_cast<int64>(Width) * Height * 3)
+  {
+    return false;
+  }
+
+  Out.Reset(6 + Count * (4 + Size * Size * sizeof(FColor)));
+  const uint16 Size16 = static_cast<uint16>(Size);
+  const uint32 Count32 = static_cast<uint32>(Count);
+  Out.Append(reinterpret_cast<const uint8*>(&Size16), sizeof(uint16));
+  Out.Append(reinterpret_cast<const uint8*>(&Count32), sizeof(uint32));
+  for (int32 ty = 0; ty < Rows; ++ty)
+  {
+    for (int32 tx = 0; tx < Columns; ++tx)
+    {
+      if (!Changed[ty * Columns + tx])
+      {
+        continue;
+      }
+      const uint16 Position[2] = { static_cast<uint16>(tx), static_cast<uint16>(ty) };
+      Out.Append(reinterpret_cast<const uint8*>(Position), sizeof(Position));
+      const int32 Left = tx * Size;
+      const int32 TileWidth = FMath::Min(Width, Left + Size) - Left;
+      for (int32 y = ty * Size; y < FMath::Min(Height, (ty + 1) * Size); ++y)
+      {
+        Out.Append(reinterpret_cast<const uint8*>(Current.GetData() + y * Width + Left), TileWidth * sizeof(FColor));
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,455 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "FrameEncoder.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/RunnableThread.h"
+#include "IImageWrapperModule.h"
+#include "Modules/ModuleManager.h"
+
+FFrameEncoder::FFrameEncoder(TFunction<void(FUtf8Builder&)> InSend, TSharedPtr<FSendPacer, ESPMode::ThreadSafe> InPacer, int32 InQueueDepth,
+  TSharedPtr<FDatasetWriter, ESPMode::ThreadSafe> InDataset)
+  : Send(MoveTemp(InSend))
+  , Pacer(MoveTemp(InPacer))
+  , Dataset(MoveTemp(InDataset))
+  , QueueDepth(FMath::Max(InQueueDepth, 1))
+{
+  // modules can only be loaded on the game thread
+  ImageWrappers = &FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+  WakeUp = FPlatformProcess::GetSynchEventFromPool();
+  Thread = FRunnableThread::Create(this, TEXT("SynavisFrameEncoder"));
+}
+
+FFrameEncoder::~FFrameEncoder()
+{
+  if (Thread)
+  {
+    Thread->Kill(true);
+    delete Thread;
+  }
+  FPlatformProcess::ReturnSynchEventToPool(WakeUp);
+}
+
+void FFrameEncoder::Stop()
+{
+  bStopping = true;
+  WakeUp->Trigger();
+}
+
+int32 FFrameEncoder::GetQueued() const
+{
+  FScopeLock ScopeLock(&QueueLock);
+  return Queue.Num();
+}
+
+void FFrameEncoder::Submit(FReadbackFrame&& Frame, int32 MaxMessageSize)
+{
+  FJob Job;
+  Job.Frames.Add(MoveTemp(Frame));
+  Job.MaxMessageSize = MaxMessageSize;
+  Enqueue(MoveTemp(Job));
+}
+
+void FFrameEncoder::SubmitPair(FReadbackFrame&& First, FReadbackFrame&& Second, int32 MaxMessageSize)
+{
+  FJob Job;
+  Job.Frames.Add(MoveTemp(First));
+  Job.Frames.Add(MoveTemp(Second));
+  Job.MaxMessageSize = MaxMessageSize;
+  Enqueue(MoveTemp(Job));
+}
+
+void FFrameEncoder::Enqueue(FJob&& Job)
+{
+  {
+    FScopeLock ScopeLock(&QueueLock);
+    // latest frame wins, a frame that waited for the whole queue is outdated anyway
+    // dataset frames are never dropped, only frames that go to the network alone make room
+    while (Queue.Num() >= QueueDepth)
+    {
+      const int32 Oldest = Queue.IndexOfByPredicate([](const FJob& Queued) { return !HasDatasetFrames(Queued); });
+      if (Oldest == INDEX_NONE)
+      {
+        break;
+      }
+      Queue.RemoveAt(Oldest, 1, false);
+      ++Dropped;
+    }
+    if (Queue.Num() >= QueueDepth && !HasDatasetFrames(Job))
+    {
+      ++Dropped;
+      return;
+    }
+    Queue.Add(MoveTemp(Job));
+  }
+  WakeUp->Trigger();
+}
+
+bool FFrameEncoder::HasDatasetFrames(const FJob& Job)
+{
+  return Job.Frames.ContainsByPredicate([](const FReadbackFrame& Frame) { return Frame.Codec.bDataset; });
+}
+
+void FFrameEncoder::Rescale(FReadbackFrame& Frame)
+{
+  const int32 Width = Frame.Pose.Width;
+  const int32 Height = Frame.Pose.Height;
+  const FIntPoint Size = FFrameCodec::GetScaledSize(Width, Height, Frame.Codec.Scale);
+  if (Frame.Codec.Scale <= 0.f || (Size.X == Width && Size.Y == Height))
+  {
+    return;
+  }
+  if (Frame.Depth.Num() == Width * Height && Width * Height > 0)
+  {
+    TArray<float> Scaled;
+    FFrameCodec::Resize(Frame.Depth, Width, Height, Size.X, Size.Y, Scaled);
+    Frame.Depth = MoveTemp(Scaled);
+  }
+  if (Frame.Pixels.Num() == Width * Height && Width * Height > 0)
+  {
+    // segmentation ids must not be blended
+    TArray<FColor> Scaled;
+    FFrameCodec::Resize(Frame.Pixels, Width, Height, Size.X, Size.Y, Frame.Codec.Channel == EFrameChannel::Color, Scaled);
+    Frame.Pixels = MoveTemp(Scaled);
+  }
+  Frame.Pose.Width = Size.X;
+  Frame.Pose.Height = Size.Y;
+}
+
+bool FFrameEncoder::PackDelta(const FReadbackFrame& Frame, const FFrameCodec& Codec, FPackedFrame& Out)
+{
+  // chunks go to every peer, so all of them hold the same reference, one per camera and crop
+  const FIntRect& Roi = Codec.Roi;
+  FDeltaReference& Reference = References.FindOrAdd(FString::Printf(TEXT("%s/%d,%d,%d,%d"), *Frame.Camera, Roi.Min.X, Roi.Min.Y, Roi.Max.X, Roi.Max.Y));
+  const bool bComparable = Reference.Width == Frame.Pose.Width && Reference.Height == Frame.Pose.Height
+    && Reference.Pixels.Num() == Frame.Pixels.Num();
+  bool bTiles = false;
+  if (bComparable && !Codec.bKeyframe && ++Reference.SinceKeyframe < FMath::Max(Codec.KeyframeInterval, 1))
+  {
+    bTiles = FFrameCodec::EncodeTiles(Frame.Pixels, Reference.Pixels, Frame.Pose.Width, Frame.Pose.Height, Codec.TileSize, Out.Storage);
+  }
+  if (!bTiles)
+  {
+    Reference.SinceKeyframe = 0;
+  }
+  // unchanged tiles are bit identical, so the new frame is exactly what the client holds afterwards
+  Reference.Pixels = Frame.Pixels;
+  Reference.Width = Frame.Pose.Width;
+  Reference.Height = Frame.Pose.Height;
+  if (bTiles)
+  {
+    Out.Fields.Append("\"df\":\"tiles\",\"ts\":").AppendInt(FMath::Clamp(Codec.TileSize, 8, 256)).Append(',');
+  }
+  else
+  {
+    Out.Fields.Append("\"df\":\"key\",");
+  }
+  return bTiles;
+}
+
+void FFrameEncoder::Pack(const FReadbackFrame& Frame, const FFrameCodec& Codec, FPackedFrame& Out)
+{
+  EFrameEncoding Encoding = Codec.Encoding;
+  TArray<uint8>& Storage = Out.Storage;
+  Out.Fields.Reset();
+  Out.Scale = 0.0;
+  if (Codec.Channel == EFrameChannel::Color && Codec.bDelta && PackDelta(Frame, Codec, Out))
+  {
+    // tiles are no image either
+    TArray<uint8> Compressed;
+    if (Encoding != EFrameEncoding::Raw && FFrameCodec::Compress(Encoding, Storage.GetData(), Storage.Num(), Compressed))
+    {
+      Storage = MoveTemp(Compressed);
+    }
+    else
+    {
+      Encoding = EFrameEncoding::Raw;
+    }
+    Out.Data = Storage.GetData();
+    Out.Bytes = Storage.Num();
+  }
+  else if (Codec.Channel == EFrameChannel::Color)
+  {
+    Out.Data = reinterpret_cast<const uint8*>(Frame.Pixels.GetData());
+    Out.Bytes = Frame.Pixels.Num() * static_cast<int64>(sizeof(FColor));
+    if (Encoding != EFrameEncoding::Raw)
+    {
+      if (FFrameCodec::Encode(Codec, Frame.Pixels, Frame.Pose.Width, Frame.Pose.Height, ImageWrappers, Storage))
+      {
+        Out.Data = Storage.GetData();
+        Out.Bytes = Storage.Num();
+      }
+      else
+      {
+        UE_LOG(LogTemp, Warning, TEXT("Could not encode frame %d as %s, sending it raw"), Frame.Pose.ID, FFrameCodec::GetName(Encoding));
+        Encoding = EFrameEncoding::Raw;
+      }
+    }
+  }
+  else
+  {
+    TArray<uint8> Plane;
+    if (FFrameCodec::IsDepth(Codec.Channel))
+    {
+      FFrameCodec::PackDepth(Frame.Depth, Codec.Channel, Codec.DepthUnit, Plane, Out.Scale);
+      Out.Fields.Append("\"s\":").AppendDouble(Out.Scale).Append(',');
+    }
+    else
+    {
+      FFrameCodec::PackSegmentation(Frame.Pixels, Codec.Channel, Plane);
+    }
+    Out.Fields.Append("\"ch\":").AppendJsonString(FFrameCodec::GetChannelName(Codec.Channel)).Append(',');
+    // planes are no images, only the general purpose codecs apply
+    if (Encoding != EFrameEncoding::Raw && !FFrameCodec::Compress(Encoding, Plane.GetData(), Plane.Num(), Storage))
+    {
+      Encoding = EFrameEncoding::Raw;
+    }
+    if (Encoding == EFrameEncoding::Raw)
+    {
+      Storage = MoveTemp(Plane);
+    }
+    Out.Data = Storage.GetData();
+    Out.Bytes = Storage.Num();
+  }
+  if (Codec.Roi.Width() > 0)
+  {
+    // where the crop lies in the render target, the pose holds the size it was scaled to
+    Out.Fields.Append("\"roi\":[").AppendInt(Codec.Roi.Min.X).Append(',').AppendInt(Codec.Roi.Min.Y).Append(',')
+      .AppendInt(Codec.Roi.Width()).Append(',').AppendInt(Codec.Roi.Height()).Append("],");
+  }
+  if (Codec.bPaired)
+  {
+    Out.Fields.Append("\"cam\":").AppendJsonString(Frame.Camera).Append(',');
+  }
+  // raw colour frames keep the header older clients know
+  if (Encoding != EFrameEncoding::Raw)
+  {
+    Out.Fields.Append("\"e\":").AppendJsonString(FFrameCodec::GetName(Encoding)).Append(',');
+  }
+  Out.Encoding = Encoding;
+}
+
+TArray<FUtf8Builder> FFrameEncoder::EncodeChunks(const FFramePose& Pose, const uint8* Data, int64 Bytes, const FUtf8Builder& Fields, int32 MaxMessageSize)
+{
+  static_assert(sizeof(FFramePose) == 40, "the frame header layout is part of the protocol");
+  FUtf8Builder Base(128);
+  Base.Append("{\"t\":\"f\",\"m\":\"").AppendBase64(reinterpret_cast<const uint8*>(&Pose), sizeof(FFramePose)).Append("\",");
+  Base.Append(Fields).Append("\"c\":\"");
+  const int32 EndLength = 2;
+  const int64 Groups = FMath::DivideAndRoundUp<int64>(Bytes, 3);
+  // the header, "/" and "\",\"d\":\"" between the chunk numbers and the data, and the end of the message
+  const int32 NumChunks = GetChunkCount(Groups, 4, Base.Len() + 8 + EndLength, MaxMessageSize);
+  TArray<FUtf8Builder> Chunks;
+  if (NumChunks == 0)
+  {
+    UE_LOG(LogTemp, Error, TEXT("Frame %d does not fit into messages of %d bytes"), Pose.ID, MaxMessageSize);
+    return Chunks;
+  }
+
+  // chunks cover whole groups of three bytes, so they encode independently and still concatenate to the base64 of the frame
+  // each chunk is written straight into its own buffer, the header is copied once and the data encoded in place
+  Chunks.SetNum(NumChunks);
+  ParallelFor(NumChunks, [&](int32 i)
+    {
+      const int64 First = FMath::Min(Bytes, Groups * i / NumChunks * 3);
+      const int64 Last = FMath::Min(Bytes, Groups * (i + 1) / NumChunks * 3);
+      FUtf8Builder& Chunk = Chunks[i];
+      Chunk.Reserve(Base.Len() + 32 + static_cast<int32>((Last - First + 2) / 3 * 4));
+      Chunk.Append(Base).AppendInt(i).Append('/').AppendInt(NumChunks).Append("\",\"d\":\"");
+      Chunk.AppendBase64(Data + First, Last - First).Append("\"}", EndLength);
+    }, NumChunks < 4);
+  return Chunks;
+}
+
+int32 FFrameEncoder::GetChunkCount(int64 Units, int32 UnitLength, int32 Overhead, int32 MaxMessageSize)
+{
+  if (MaxMessageSize <= 0 || Units <= 0)
+  {
+    return 1;
+  }
+  // the chunk numbers take at most as many digits as the count each, so try the counts digit by digit
+  int64 Limit = 10;
+  for (int32 Digits = 1; Digits <= 10; ++Digits, Limit *= 10)
+  {
+    const int64 Fits = (static_cast<int64>(MaxMessageSize) - Overhead - 2 * Digits) / FMath::Max(UnitLength, 1);
+    if (Fits <= 0)
+    {
+      return 0;
+    }
+    const int64 Count = FMath::DivideAndRoundUp(Units, Fits);
+    if (Count < Limit)
+    {
+      return Count <= MAX_int32 ? static_cast<int32>(Count) : 0;
+    }
+  }
+  return 0;
+}
+
+bool FFrameEncoder::SendFrame(const FReadbackFrame& Frame, int32 MaxMessageSize, int32 Half)
+{
+  FPackedFrame Packed;
+  Pack(Frame, Frame.Codec, Packed);
+  if (Frame.Codec.bPaired)
+  {
+    // the client acknowledges the chunks of a pair with the half they belong to
+    Packed.Fields.Append("\"half\":").AppendInt(Half).Append(',');
+  }
+  TArray<FUtf8Builder> Chunks = EncodeChunks(Frame.Pose, Packed.Data, Packed.Bytes, Packed.Fields, MaxMessageSize);
+  if (Chunks.Num() == 0)
+  {
+    // the frame is dropped, the next one goes out as usual
+    ++Dropped;
+    return true;
+  }
+  // the frames of a pair share their id, the chunks of the second one are counted on from the first
+  const int32 KeyOffset = Half << 16;
+  for (int32 i = 0; i < Chunks.Num(); ++i)
+  {
+    if (Pacer.IsValid() && !Pacer->Acquire(Chunks[i].Len(), FSendPacer::FrameKey(Frame.Pose.ID, KeyOffset + i), &bStopping))
+    {
+      return false;
+    }
+    Send(Chunks[i]);
+  }
+  return true;
+}
+
+void FFrameEncoder::StoreJob(const FJob& Job)
+{
+  const FFramePose& Pose = Job.Frames[0].Pose;
+  TArray<FDatasetWriter::FFile> Files;
+  FUtf8Builder Meta(512);
+  FJsonResponseWriter Writer(Meta);
+  Writer.BeginObject().Field("id", Pose.ID).Field("fov", Pose.FOV);
+  Writer.Key("position").BeginArray().Value(Pose.Position[0]).Value(Pose.Position[1]).Value(Pose.Position[2]).EndArray();
+  Writer.Key("rotation").BeginArray().Value(Pose.Rotation[0]).Value(Pose.Rotation[1]).Value(Pose.Rotation[2]).EndArray();
+  Writer.Key("frames").BeginObject();
+  for (const FReadbackFrame& Frame : Job.Frames)
+  {
+    if (!Frame.Codec.bDataset)
+    {
+      continue;
+    }
+    // the dataset always holds full frames, tiles only make sense against what a client already has
+    FFrameCodec Codec = Frame.Codec;
+    Codec.bDelta = false;
+    FPackedFrame Packed;
+    Pack(Frame, Codec, Packed);
+    if (Packed.Bytes > MAX_int32)
+    {
+      // entries are held in arrays with an int32 size
+      UE_LOG(LogTemp, Error, TEXT("Frame %d of %s is too large for the dataset"), Frame.Pose.ID, *Frame.Camera);
+      continue;
+    }
+    FString Name = Frame.Camera;
+    if (Codec.Channel != EFrameChannel::Color)
+    {
+      Name += FString(TEXT(".")) + FFrameCodec::GetChannelName(Codec.Channel);
+    }
+    Name += FString(TEXT(".")) + FString(FFrameCodec::GetName(Packed.Encoding)).ToLower();
+
+    Writer.Key(Frame.Camera).BeginObject().Field("file", Name)
+      .Field("width", Frame.Pose.Width).Field("height", Frame.Pose.Height)
+      .Field("channel", FFrameCodec::GetChannelName(Codec.Channel)).Field("encoding", FFrameCodec::GetName(Packed.Encoding));
+    if (Packed.Scale > 0.0)
+    {
+      Writer.Field("scale", Packed.Scale);
+    }
+    if (Codec.Roi.Width() > 0)
+    {
+      Writer.Key("roi").BeginArray().Value(Codec.Roi.Min.X).Value(Codec.Roi.Min.Y).Value(Codec.Roi.Width()).Value(Codec.Roi.Height()).EndArray();
+    }
+    Writer.EndObject();
+
+    FDatasetWriter::FFile& Entry = Files.AddDefaulted_GetRef();
+    Entry.Name = MoveTemp(Name);
+    if (Packed.Data == Packed.Storage.GetData())
+    {
+      Entry.Data = MoveTemp(Packed.Storage);
+    }
+    else
+    {
+      Entry.Data.Append(Packed.Data, static_cast<int32>(Packed.Bytes));
+    }
+  }
+  Writer.EndObject();
+  if (!Job.Frames[0].Meta.IsEmpty())
+  {
+    Writer.Key("tracking").RawValue(Job.Frames[0].Meta);
+  }
+  Writer.EndObject();
+  FDatasetWriter::FFile& MetaEntry = Files.AddDefaulted_GetRef();
+  MetaEntry.Name = TEXT("json");
+  MetaEntry.Data.Append(reinterpret_cast<const uint8*>(Meta.GetData()), Meta.Len());
+  Dataset->Write(MoveTemp(Files));
+}
+
+uint32 FFrameEncoder::Run()
+{
+  while (!bStopping)
+  {
+    FJob Job;
+    bool bHasJob = false;
+    {
+      FScopeLock ScopeLock(&QueueLock);
+      if (Queue.Num() > 0)
+      {
+        Job = MoveTemp(Queue[0]);
+        Queue.RemoveAt(0, 1, false);
+        bHasJob = true;
+      }
+    }
+    if (!bHasJob)
+    {
+      WakeUp->Wait(100);
+      continue;
+    }
+    // scaling first, everything after works on fewer pixels
+    for (FReadbackFrame& Frame : Job.Frames)
+    {
+      Rescale(Frame);
+    }
+    if (Dataset.IsValid() && HasDatasetFrames(Job))
+    {
+      StoreJob(Job);
+    }
+    bool bSent = true;
+    for (int32 i = 0; i < Job.Frames.Num(); ++i)
+    {
+      const FReadbackFrame& Frame = Job.Frames[i];
+      if (Frame.Codec.bNetwork && !SendFrame(Frame, Job.MaxMessageSize, i))
+      {
+        bSent = false;
+        break;
+      }
+    }
+    if (!bSent)
+    {
+      break;
+    }
+    const double Latency = FPlatformTime::Seconds() - Job.Frames[0].RequestTime;
+    LastLatency = Latency;
+    MeanLatency = (Sent == 0) ? Latency : MeanLatency * 0.9 + Latency * 0.1;
+    ++Sent;
+  }
+
+  // the network frames that still wait are outdated, the dataset ones are written before the encoder goes
+  TArray<FJob> Remaining;
+  {
+    FScopeLock ScopeLock(&QueueLock);
+    Remaining = MoveTemp(Queue);
+    Queue.Reset();
+  }
+  for (FJob& Job : Remaining)
+  {
+    if (Dataset.IsValid() && HasDatasetFrames(Job))
+    {
+      for (FReadbackFrame& Frame : Job.Frames)
+      {
+        Rescale(Frame);
+      }
+      StoreJob(Job);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,322 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "FrameReadback.h"
+
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+#include "RHIGPUReadback.h"
+#include "Misc/App.h"
+
+static bool IsFloatFormat(EPixelFormat Format)
+{
+  return Format == PF_FloatRGBA || Format == PF_A32B32G32R32F;
+}
+
+// widens the range of a float row by its channels, like the min max compression of ReadPixels
+static void FindRowRange(EPixelFormat Format, const uint8* Source, int32 Width, float& Min, float& Max)
+{
+  for (int32 x = 0; x < Width; ++x)
+  {
+    const FLinearColor Color = (Format == PF_FloatRGBA) ? FLinearColor(reinterpret_cast<const FFloat16Color*>(Source)[x])
+      : reinterpret_cast<const FLinearColor*>(Source)[x];
+    Min = FMath::Min(Min, FMath::Min(FMath::Min(Color.R, Color.G), FMath::Min(Color.B, Color.A)));
+    Max = FMath::Max(Max, FMath::Max(FMath::Max(Color.R, Color.G), FMath::Max(Color.B, Color.A)));
+  }
+}
+
+// converts one row of the copy into gamma corrected 8 bit colours, the same values ReadPixels produced with RCM_MinMax
+// float rows are mapped from [Min, Min + 1 / Scale] to [0, 1] first, the range covers at least [0, 1]
+// with bGamma unset float channels are only quantised, so that ids keep the value an 8 bit target would hold
+static bool ConvertRow(EPixelFormat Format, const uint8* Source, FColor* Target, int32 Width, float Min, float Scale, bool bGamma)
+{
+  const auto Compress = [Min, Scale, bGamma](const FLinearColor& Color)
+    {
+      return FLinearColor((Color.R - Min) * Scale, (Color.G - Min) * Scale, (Color.B - Min) * Scale, (Color.A - Min) * Scale).ToFColor(bGamma);
+    };
+  switch (Format)
+  {
+  case PF_B8G8R8A8:
+    FMemory::Memcpy(Target, Source, Width * sizeof(FColor));
+    return true;
+  case PF_R8G8B8A8:
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = FColor(Source[4 * x], Source[4 * x + 1], Source[4 * x + 2], Source[4 * x + 3]);
+    }
+    return true;
+  case PF_FloatRGBA:
+  {
+    const FFloat16Color* Colors = reinterpret_cast<const FFloat16Color*>(Source);
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = Compress(FLinearColor(Colors[x]));
+    }
+    return true;
+  }
+  case PF_A32B32G32R32F:
+  {
+    const FLinearColor* Colors = reinterpret_cast<const FLinearColor*>(Source);
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = Compress(Colors[x]);
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// copies the first channel of a float row, a depth capture writes its centimetres there
+static bool ConvertDepthRow(EPixelFormat Format, const uint8* Source, float* Target, int32 Width)
+{
+  switch (Format)
+  {
+  case PF_R32_FLOAT:
+    FMemory::Memcpy(Target, Source, Width * sizeof(float));
+    return true;
+  case PF_R16F:
+  {
+    const FFloat16* Values = reinterpret_cast<const FFloat16*>(Source);
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = Values[x];
+    }
+    return true;
+  }
+  case PF_FloatRGBA:
+  {
+    const FFloat16* Values = reinterpret_cast<const FFloat16*>(Source);
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = Values[4 * x];
+    }
+    return true;
+  }
+  case PF_A32B32G32R32F:
+  {
+    const float* Values = reinterpret_cast<const float*>(Source);
+    for (int32 x = 0; x < Width; ++x)
+    {
+      Target[x] = Values[4 * x];
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+FFrameReadbackRing::FFrameReadbackRing(int32 Depth)
+{
+  for (int32 i = 0; i < FMath::Max(Depth, 1); ++i)
+  {
+    TUniquePtr<FSlot>& Slot = Slots.Add_GetRef(MakeUnique<FSlot>());
+    if (!IsSynthetic())
+    {
+      Slot->Readback = MakeUnique<FRHIGPUTextureReadback>(*FString::Printf(TEXT("SynavisReadback%d"), i));
+    }
+  }
+}
+
+FFrameReadbackRing::~FFrameReadbackRing()
+{
+  // render commands still refer to the slots
+  if (GetInFlight() > 0)
+  {
+    FlushRenderingCommands();
+  }
+}
+
+bool FFrameReadbackRing::IsSynthetic()
+{
+  return !FApp::CanEverRender() || GUsingNullRHI;
+}
+
+bool FFrameReadbackRing::CanRequest(int32 Count)
+{
+  if (IsSynthetic() || Slots.Num() - GetInFlight() >= Count)
+  {
+    return true;
+  }
+  ++Dropped;
+  return false;
+}
+
+int32 FFrameReadbackRing::GetInFlight() const
+{
+  int32 InFlight = 0;
+  for (const auto& Slot : Slots)
+  {
+    InFlight += Slot->State.load() != ESlotState::Free;
+  }
+  return InFlight;
+}
+
+bool FFrameReadbackRing::Request(UTextureRenderTarget2D* Target, const FFramePose& Pose, EFramePurpose Purpose, const FString& Camera, const FFrameCodec& Codec,
+  const FString& Meta)
+{
+  FReadbackFrame Frame;
+  Frame.Pose = Pose;
+  Frame.Purpose = Purpose;
+  Frame.Camera = Camera;
+  Frame.Codec = Codec;
+  Frame.Meta = Meta;
+  Frame.RequestTime = FPlatformTime::Seconds();
+  // only the crop is read back, the frame has its size from here on
+  FIntRect Roi(0, 0, FMath::Max(Pose.Width, 1), FMath::Max(Pose.Height, 1));
+  if (Codec.Roi.Width() > 0 && Codec.Roi.Height() > 0)
+  {
+    FIntRect Clipped = Codec.Roi;
+    Clipped.Clip(Roi);
+    if (Clipped.Width() > 0 && Clipped.Height() > 0)
+    {
+      Roi = Clipped;
+    }
+  }
+  // an empty crop in the codec tells the encoder that the frame is whole
+  Frame.Codec.Roi = (Roi.Width() < Pose.Width || Roi.Height() < Pose.Height) ? Roi : FIntRect();
+  Frame.Pose.Width = Roi.Width();
+  Frame.Pose.Height = Roi.Height();
+
+  if (IsSynthetic())
+  {
+    // gradients with the frame id in blue, enough to tell frames and their orientation apart
+    const int32 Width = FMath::Max(Pose.Width, 1);
+    const int32 Height = FMath::Max(Pose.Height, 1);
+    if (FFrameCodec::IsDepth(Codec.Channel))
+    {
+      // a ramp from one to a hundred metres
+      Frame.Depth.SetNumUninitialized(Roi.Area());
+      for (int32 y = 0; y < Roi.Height(); ++y)
+      {
+        const float Value = 100.f + 9900.f * (Roi.Min.Y + y) / Height;
+        for (int32 x = 0; x < Roi.Width(); ++x)
+        {
+          Frame.Depth[y * Roi.Width() + x] = Value;
+        }
+      }
+      Completed.Enqueue(MoveTemp(Frame));
+      return true;
+    }
+    Frame.Pixels.SetNumUninitialized(Roi.Area());
+    for (int32 y = Roi.Min.Y; y < Roi.Max.Y; ++y)
+    {
+      for (int32 x = Roi.Min.X; x < Roi.Max.X; ++x)
+      {
+        Frame.Pixels[(y - Roi.Min.Y) * Roi.Width() + x - Roi.Min.X] = FColor(x * 255 / Width, y * 255 / Height, Pose.ID & 0xff, 255);
+      }
+    }
+    Completed.Enqueue(MoveTemp(Frame));
+    return true;
+  }
+
+  FTextureRenderTargetResource* Resource = Target ? Target->GameThread_GetRenderTargetResource() : nullptr;
+  TUniquePtr<FSlot>* Free = Slots.FindByPredicate([](const TUniquePtr<FSlot>& Slot) { return Slot->State.load() == ESlotState::Free; });
+  if (!Resource || !Free)
+  {
+    ++Dropped;
+    return false;
+  }
+  FSlot* Slot = Free->Get();
+  Slot->Frame = MoveTemp(Frame);
+  Slot->Format = Target->GetFormat();
+  Slot->Sequence = NextSequence++;
+  Slot->State = ESlotState::Requested;
+  ENQUEUE_RENDER_COMMAND(SynavisEnqueueReadback)([Slot, Resource](FRHICommandListImmediate& RHICmdList)
+    {
+      Slot->Readback->EnqueueCopy(RHICmdList, Resource->GetRenderTargetTexture());
+      // the fence of the readback is only meaningful once the copy is enqueued
+      Slot->State = ESlotState::Copying;
+    });
+  return true;
+}
+
+void FFrameReadbackRing::Poll(TFunctionRef<void(FReadbackFrame&&)> OnFrame)
+{
+  // oldest first, a copy that is not done holds back the later ones so that frames stay in order
+  TArray<FSlot*> Pending;
+  for (const auto& Slot : Slots)
+  {
+    const ESlotState State = Slot->State.load();
+    if (State == ESlotState::Requested || State == ESlotState::Copying)
+    {
+      Pending.Add(Slot.Get());
+    }
+  }
+  Pending.Sort([](const FSlot& A, const FSlot& B) { return A.Sequence < B.Sequence; });
+  for (FSlot* Slot : Pending)
+  {
+    if (Slot->State.load() != ESlotState::Copying || !Slot->Readback->IsReady())
+    {
+      break;
+    }
+    Slot->State = ESlotState::Reading;
+    ENQUEUE_RENDER_COMMAND(SynavisReadReadback)([this, Slot](FRHICommandListImmediate& RHICmdList)
+      {
+        FReadbackFrame& Frame = Slot->Frame;
+        const int32 Width = Frame.Pose.Width;
+        const int32 Height = Frame.Pose.Height;
+        const FIntPoint Offset = Frame.Codec.Roi.Min;
+        int32 RowPitch = 0;
+        int32 BufferHeight = 0;
+        const uint8* Data = static_cast<const uint8*>(Slot->Readback->Lock(RowPitch, &BufferHeight));
+        const int32 Rows = FMath::Min(Height, BufferHeight > 0 ? BufferHeight - Offset.Y : Height);
+        // rows of the crop, the copy holds the whole target
+        const auto GetRow = [&](int32 y, int32 BytesPerPixel)
+          {
+            return Data + (static_cast<int64>(Offset.Y + y) * RowPitch + Offset.X) * BytesPerPixel;
+          };
+        if (Data && FFrameCodec::IsDepth(Frame.Codec.Channel))
+        {
+          const int32 BytesPerPixel = GPixelFormats[Slot->Format].BlockBytes;
+          Frame.Depth.SetNumUninitialized(Width * Height);
+          for (int32 y = 0; y < Rows; ++y)
+          {
+            if (!ConvertDepthRow(Slot->Format, GetRow(y, BytesPerPixel), Frame.Depth.GetData() + y * Width, Width))
+            {
+              UE_LOG(LogTemp, Warning, TEXT("Depth needs a float target, %s has none"), GPixelFormats[Slot->Format].Name);
+              Frame.Depth.Reset();
+              break;
+            }
+          }
+          Slot->Readback->Unlock();
+        }
+        else if (Data)
+        {
+          const int32 BytesPerPixel = GPixelFormats[Slot->Format].BlockBytes;
+          // the range of float targets is taken from the whole crop before any row is converted
+          // segmentation ids are neither compressed nor gamma corrected, both would change them
+          const bool bColor = Frame.Codec.Channel == EFrameChannel::Color;
+          float Min = 0.f, Max = 1.f;
+          if (bColor && IsFloatFormat(Slot->Format))
+          {
+            for (int32 y = 0; y < Rows; ++y)
+            {
+              FindRowRange(Slot->Format, GetRow(y, BytesPerPixel), Width, Min, Max);
+            }
+          }
+          const float Scale = 1.f / (Max - Min + SMALL_NUMBER);
+          Frame.Pixels.SetNumUninitialized(Width * Height);
+          for (int32 y = 0; y < Rows; ++y)
+          {
+            if (!ConvertRow(Slot->Format, GetRow(y, BytesPerPixel), Frame.Pixels.GetData() + y * Width, Width, Min, Scale, bColor))
+            {
+              UE_LOG(LogTemp, Warning, TEXT("Render target format %s can not be read back"), GPixelFormats[Slot->Format].Name);
+              Frame.Pixels.Reset();
+              break;
+            }
+          }
+          Slot->Readback->Unlock();
+        }
+        Completed.Enqueue(MoveTemp(Frame));
+        Slot->State = ESlotState::Free;
+      });
+  }
+
+  FReadbackFrame Frame;
+  while (Completed.Dequeue(Frame))
+  {
+    OnFrame(MoveTemp(Frame));
+  }
+}
@@ -0,0 +1,281 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "GeometryCache.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Async/TaskGraphInterfaces.h"
+
+// binary layout of a cache entry, all arrays follow the header in this order
+// positions, normals and tangents are stored as single precision, which is what the render data uses anyway
+// version 2 stores tangents as x, y, z and the sign of the binormal, version 1 entries without the sign are still read
+struct FGeometryCacheHeader
+{
+  uint32 Magic = 0x31434753; // "SGC1"
+  uint32 Version = 2;
+  uint64 NumPoints = 0;
+  uint64 NumNormals = 0;
+  uint64 NumTriangles = 0;
+  uint64 NumUVs = 0;
+  uint64 NumScalars = 0;
+  uint64 NumTangents = 0;
+};
+
+static const TCHAR* CacheExtension = TEXT(".sgc");
+
+template <typename T>
+static void HashArray(FSHA1& Hasher, const TArray<T>& Array)
+{
+  if (Array.Num() > 0)
+  {
+    Hasher.Update(reinterpret_cast<const uint8*>(Array.GetData()), Array.Num() * sizeof(T));
+  }
+}
+
+FGeometryCache::FGeometryCache(const FString& InDirectory)
+  : Directory(InDirectory)
+{
+  auto& FileManager = IFileManager::Get();
+  FileManager.MakeDirectory(*Directory, true);
+  TArray<FString> Files;
+  FileManager.FindFiles(Files, *(Directory / FString(TEXT("*")) + CacheExtension), true, false);
+  for (const auto& File : Files)
+  {
+    Index.Add(FPaths::GetBaseFilename(File));
+  }
+  UE_LOG(LogTemp, Log, TEXT("Geometry cache at %s holds %d entries"), *Directory, Index.Num());
+}
+
+FString FGeometryCache::ComputeHash(const FGeometryPayload& Payload)
+{
+  FSHA1 Hasher;
+  HashArray(Hasher, Payload.Points);
+  HashArray(Hasher, Payload.Normals);
+  HashArray(Hasher, Payload.Triangles);
+  HashArray(Hasher, Payload.UVs);
+  HashArray(Hasher, Payload.Scalars);
+  Hasher.Final();
+  FSHAHash Hash;
+  Hasher.GetHash(Hash.Hash);
+  return Hash.ToString().ToLower();
+}
+
+bool FGeometryCache::IsValidHash(const FString& Hash)
+{
+  if (Hash.Len() != 40)
+  {
+    return false;
+  }
+  for (const TCHAR c : Hash)
+  {
+    if (!FChar::IsHexDigit(c))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FGeometryCache::Contains(const FString& Hash) const
+{
+  FScopeLock Lock(&IndexMutex);
+  return Index.Contains(Hash.ToLower());
+}
+
+int32 FGeometryCache::Num() const
+{
+  FScopeLock Lock(&IndexMutex);
+  return Index.Num();
+}
+
+void FGeometryCache::StoreAsync(const FGeometryPayload& Payload, const FString& Hash)
+{
+  if (!IsValidHash(Hash))
+  {
+    return;
+  }
+  const FString Key = Hash.ToLower();
+  TSharedPtr<const FGeometryPayload, ESPMode::ThreadSafe> Copy;
+  {
+    FScopeLock Lock(&IndexMutex);
+    if (Index.Contains(Key))
+    {
+      return;
+    }
+    Copy = MakeShared<const FGeometryPayload, ESPMode::ThreadSafe>(Payload);
+    Index.Add(Key);
+    Pending.Add(Key, Copy);
+  }
+  FFunctionGraphTask::CreateAndDispatchWhenReady(
+    [WeakCache = TWeakPtr<FGeometryCache, ESPMode::ThreadSafe>(AsShared()), Copy, Key, FileName = GetFileName(Key)]()
+    {
+      const bool bWritten = WriteFile(*Copy, FileName);
+      if (auto Cache = WeakCache.Pin())
+      {
+        FScopeLock Lock(&Cache->IndexMutex);
+        Cache->Pending.Remove(Key);
+        if (!bWritten)
+        {
+          Cache->Index.Remove(Key);
+        }
+      }
+      if (!bWritten)
+      {
+        UE_LOG(LogTemp, Warning, TEXT("Could not write geometry cache entry %s"), *FileName);
+      }
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+bool FGeometryCache::Load(const FString& Hash, FGeometryPayload& OutPayload) const
+{
+  if (!IsValidHash(Hash))
+  {
+    return false;
+  }
+  const FString Key = Hash.ToLower();
+  {
+    FScopeLock Lock(&IndexMutex);
+    if (!Index.Contains(Key))
+    {
+      return false;
+    }
+    if (const auto* Entry = Pending.Find(Key))
+    {
+      OutPayload = **Entry;
+      return true;
+    }
+  }
+  return ReadFile(GetFileName(Key), OutPayload);
+}
+
+FString FGeometryCache::GetFileName(const FString& Hash) const
+{
+  return Directory / Hash + CacheExtension;
+}
+
+bool FGeometryCache::WriteFile(const FGeometryPayload& Payload, const FString& FileName)
+{
+  FGeometryCacheHeader Header;
+  Header.NumPoints = Payload.Points.Num();
+  Header.NumNormals = Payload.Normals.Num();
+  Header.NumTriangles = Payload.Triangles.Num();
+  Header.NumUVs = Payload.UVs.Num();
+  Header.NumScalars = Payload.Scalars.Num();
+  Header.NumTangents = Payload.Tangents.Num();
+
+  TArray<uint8> Data;
+  Data.Reserve(sizeof(Header) + (Header.NumPoints + Header.NumNormals) * sizeof(FVector3f) + Header.NumTangents * sizeof(FVector4f)
+    + Header.NumTriangles * sizeof(int32) + Header.NumUVs * sizeof(FVector2f) + Header.NumScalars * sizeof(float));
+  Data.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+  const auto AppendVectors = [&Data](const TArray<FVector>& Vectors)
+    {
+      const int64 Offset = Data.Num();
+      Data.AddUninitialized(Vectors.Num() * sizeof(FVector3f));
+      FVector3f* Out = reinterpret_cast<FVector3f*>(Data.GetData() + Offset);
+      for (int32 i = 0; i < Vectors.Num(); ++i)
+      {
+        Out[i] = FVector3f(Vectors[i]);
+      }
+    };
+  AppendVectors(Payload.Points);
+  AppendVectors(Payload.Normals);
+  Data.Append(reinterpret_cast<const uint8*>(Payload.Triangles.GetData()), Payload.Triangles.Num() * sizeof(int32));
+  {
+    const int64 Offset = Data.Num();
+    Data.AddUninitialized(Payload.UVs.Num() * sizeof(FVector2f));
+    FVector2f* Out = reinterpret_cast<FVector2f*>(Data.GetData() + Offset);
+    for (int32 i = 0; i < Payload.UVs.Num(); ++i)
+    {
+      Out[i] = FVector2f(Payload.UVs[i]);
+    }
+  }
+  Data.Append(reinterpret_cast<const uint8*>(Payload.Scalars.GetData()), Payload.Scalars.Num() * sizeof(float));
+  {
+    const int64 Offset = Data.Num();
+    Data.AddUninitialized(Payload.Tangents.Num() * sizeof(FVector4f));
+    FVector4f* Out = reinterpret_cast<FVector4f*>(Data.GetData() + Offset);
+    for (int32 i = 0; i < Payload.Tangents.Num(); ++i)
+    {
+      const FProcMeshTangent& Tangent = Payload.Tangents[i];
+      Out[i] = FVector4f(FVector3f(Tangent.TangentX), Tangent.bFlipTangentY ? -1.f : 1.f);
+    }
+  }
+
+  // write next to the target and rename, so that readers never see a partial entry
+  const FString TempName = FileName + TEXT(".tmp");
+  if (!FFileHelper::SaveArrayToFile(Data, *TempName))
+  {
+    return false;
+  }
+  return IFileManager::Get().Move(*FileName, *TempName, true, true);
+}
+
+bool FGeometryCache::ReadFile(const FString& FileName, FGeometryPayload& OutPayload)
+{
+  TArray<uint8> Data;
+  if (!FFileHelper::LoadFileToArray(Data, *FileName))
+  {
+    return false;
+  }
+  if (Data.Num() < sizeof(FGeometryCacheHeader))
+  {
+    return false;
+  }
+  FGeometryCacheHeader Header;
+  FMemory::Memcpy(&Header, Data.GetData(), sizeof(Header));
+  if (Header.Magic != FGeometryCacheHeader().Magic || Header.Version < 1 || Header.Version > FGeometryCacheHeader().Version)
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Geometry cache entry %s has an unknown layout"), *FileName);
+    return false;
+  }
+  const uint64 TangentSize = (Header.Version >= 2) ? sizeof(FVector4f) : sizeof(FVector3f);
+  const uint64 Expected = sizeof(Header) + (Header.NumPoints + Header.NumNormals) * sizeof(FVector3f) + Header.NumTangents * TangentSize
+    + Header.NumTriangles * sizeof(int32) + Header.NumUVs * sizeof(FVector2f) + Header.NumScalars * sizeof(float);
+  if (Expected != static_cast<uint64>(Data.Num()))
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Geometry cache entry %s is truncated"), *FileName);
+    return false;
+  }
+
+  const uint8* Ptr = Data.GetData() + sizeof(Header);
+  const auto ReadVectors = [&Ptr](TArray<FVector>& Vectors, uint64 Num)
+    {
+      Vectors.SetNumUninitialized(Num);
+      const FVector3f* In = reinterpret_cast<const FVector3f*>(Ptr);
+      for (uint64 i = 0; i < Num; ++i)
+      {
+        Vectors[i] = FVector(In[i]);
+      }
+      Ptr += Num * sizeof(FVector3f);
+    };
+  OutPayload.Reset();
+  ReadVectors(OutPayload.Points, Header.NumPoints);
+  ReadVectors(OutPayload.Normals, Header.NumNormals);
+  OutPayload.Triangles.SetNumUninitialized(Header.NumTriangles);
+  FMemory::Memcpy(OutPayload.Triangles.GetData(), Ptr, Header.NumTriangles * sizeof(int32));
+  Ptr += Header.NumTriangles * sizeof(int32);
+  OutPayload.UVs.SetNumUninitialized(Header.NumUVs);
+  {
+    const FVector2f* In = reinterpret_cast<const FVector2f*>(Ptr);
+    for (uint64 i = 0; i < Header.NumUVs; ++i)
+    {
+      OutPayload.UVs[i] = FVector2D(In[i]);
+    }
+    Ptr += Header.NumUVs * sizeof(FVector2f);
+  }
+  OutPayload.Scalars.SetNumUninitialized(Header.NumScalars);
+  FMemory::Memcpy(OutPayload.Scalars.GetData(), Ptr, Header.NumScalars * sizeof(float));
+  Ptr += Header.NumScalars * sizeof(float);
+  OutPayload.Tangents.SetNumUninitialized(Header.NumTangents);
+  {
+    for (uint64 i = 0; i < Header.NumTangents; ++i, Ptr += TangentSize)
+    {
+      FVector4f Tangent(0.f, 0.f, 0.f, 1.f);
+      FMemory::Memcpy(&Tangent, Ptr, TangentSize);
+      OutPayload.Tangents[i] = FProcMeshTangent(FVector(Tangent.X, Tangent.Y, Tangent.Z), Tangent.W < 0.f);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,1088 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "GeometryImporter.h"
+
+#include "VTPMeshFactory.h"
+#include "Async/MappedFileHandle.h"
+#include "Async/ParallelFor.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#include <atomic>
+
+// files are parsed in chunks of at least this many bytes per worker
+static constexpr int64 ImportChunkSize = 1 << 20;
+
+FMappedFile::FMappedFile()
+{
+}
+
+FMappedFile::~FMappedFile()
+{
+  // the region has to go before the handle it was mapped from
+  Region.Reset();
+  Handle.Reset();
+}
+
+bool FMappedFile::Open(const FString& FileName)
+{
+  Region.Reset();
+  Handle.Reset();
+  Fallback.Reset();
+  Handle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FileName));
+  if (Handle.IsValid() && Handle->GetFileSize() > 0)
+  {
+    Region.Reset(Handle->MapRegion(0, Handle->GetFileSize()));
+    if (Region.IsValid())
+    {
+      Data = Region->GetMappedPtr();
+      Size = Region->GetMappedSize();
+      return true;
+    }
+  }
+  Region.Reset();
+  Handle.Reset();
+  if (!FFileHelper::LoadFileToArray(Fallback, *FileName))
+  {
+    Data = nullptr;
+    Size = 0;
+    return false;
+  }
+  Data = Fallback.GetData();
+  Size = Fallback.Num();
+  return true;
+}
+
+// number parsing that never reads past End, mapped files are not null terminated
+static void SkipBlanks(const char*& Cursor, const char* End)
+{
+  while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\r'))
+    ++Cursor;
+}
+
+static void SkipLine(const char*& Cursor, const char* End)
+{
+  while (Cursor < End && *Cursor != '\n')
+    ++Cursor;
+  if (Cursor < End)
+    ++Cursor;
+}
+
+static bool ParseInt(const char*& Cursor, const char* End, int64& Out)
+{
+  const char* p = Cursor;
+  SkipBlanks(p, End);
+  const bool bNegative = p < End && *p == '-';
+  if (p < End && (*p == '-' || *p == '+'))
+    ++p;
+  if (p >= End || *p < '0' || *p > '9')
+    return false;
+  int64 Value = 0;
+  while (p < End && *p >= '0' && *p <= '9')
+    Value = Value * 10 + (*p++ - '0');
+  Out = bNegative ? -Value : Value;
+  Cursor = p;
+  return true;
+}
+
+static bool ParseDouble(const char*& Cursor, const char* End, double& Out)
+{
+  const char* p = Cursor;
+  SkipBlanks(p, End);
+  const bool bNegative = p < End && *p == '-';
+  if (p < End && (*p == '-' || *p == '+'))
+    ++p;
+  uint64 Mantissa = 0;
+  int32 Exponent = 0;
+  bool bDigits = false;
+  while (p < End && *p >= '0' && *p <= '9')
+  {
+    // digits beyond what the mantissa holds only shift the magnitude
+    if (Mantissa < 100000000000000000ull)
+      Mantissa = Mantissa * 10 + (*p - '0');
+    else
+      ++Exponent;
+    ++p;
+    bDigits = true;
+  }
+  if (p < End && *p == '.')
+  {
+    ++p;
+    while (p < End && *p >= '0' && *p <= '9')
+    {
+      if (Mantissa < 100000000000000000ull)
+      {
+        Mantissa = Mantissa * 10 + (*p - '0');
+        --Exponent;
+      }
+      ++p;
+      bDigits = true;
+    }
+  }
+  if (!bDigits)
+    return false;
+  if (p < End && (*p == 'e' || *p == 'E'))
+  {
+    const char* ExponentStart = ++p;
+    int64 ExplicitExponent = 0;
+    if (ParseInt(p, End, ExplicitExponent))
+      Exponent += static_cast<int32>(FMath::Clamp<int64>(ExplicitExponent, -400, 400));
+    else
+      p = ExponentStart - 1;
+  }
+  const double Value = static_cast<double>(Mantissa) * FMath::Pow(10.0, static_cast<double>(Exponent));
+  Out = bNegative ? -Value : Value;
+  Cursor = p;
+  return true;
+}
+
+// splits the buffer into line aligned chunks, one per worker
+static TArray<TPair<const char*, const char*>> SplitLines(const char* Begin, const char* End)
+{
+  TArray<TPair<const char*, const char*>> Chunks;
+  const int64 Size = End - Begin;
+  const int32 NumChunks = static_cast<int32>(FMath::Clamp<int64>(Size / ImportChunkSize, 1, FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() * 4)));
+  const char* ChunkBegin = Begin;
+  for (int32 c = 1; c <= NumChunks && ChunkBegin < End; ++c)
+  {
+    const char* ChunkEnd = (c == NumChunks) ? End : Begin + Size * c / NumChunks;
+    if (ChunkEnd < ChunkBegin)
+      ChunkEnd = ChunkBegin;
+    while (ChunkEnd < End && *ChunkEnd != '\n')
+      ++ChunkEnd;
+    if (ChunkEnd < End)
+      ++ChunkEnd;
+    Chunks.Emplace(ChunkBegin, ChunkEnd);
+    ChunkBegin = ChunkEnd;
+  }
+  return Chunks;
+}
+
+// the layout written for the filegeometry command: counted blocks of points, indices, normals and uvs
+class FRawGeometryImporter : public IGeometryImporter
+{
+public:
+  virtual FString GetName() const override { return TEXT("raw"); }
+  virtual TArray<FString> GetExtensions() const override { return { TEXT("bin"), TEXT("raw") }; }
+
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const override
+  {
+    int64 Offset = 0;
+    auto ReadBlock = [Data, Size, &Offset](auto& Target) -> bool
+    {
+      using ElementType = typename TRemoveReference<decltype(Target)>::Type::ElementType;
+      if (Offset + static_cast<int64>(sizeof(uint64)) > Size)
+        return false;
+      const uint64 Count = *reinterpret_cast<const uint64*>(Data + Offset);
+      Offset += sizeof(uint64);
+      if (Count > static_cast<uint64>(Size - Offset) / sizeof(ElementType))
+        return false;
+      Target.SetNumUninitialized(static_cast<int32>(Count));
+      FMemory::Memcpy(Target.GetData(), Data + Offset, Count * sizeof(ElementType));
+      Offset += Count * sizeof(ElementType);
+      return true;
+    };
+    Out.Reset();
+    if (!(ReadBlock(Out.Points) && ReadBlock(Out.Triangles) && ReadBlock(Out.Normals) && ReadBlock(Out.UVs)))
+    {
+      Error = TEXT("file is not in the raw geometry layout");
+      return false;
+    }
+    return true;
+  }
+};
+
+class FVTKGeometryImporter : public IGeometryImporter
+{
+public:
+  virtual FString GetName() const override { return TEXT("vtk"); }
+  virtual TArray<FString> GetExtensions() const override { return { TEXT("vtp"), TEXT("vtu") }; }
+
+  virtual bool MatchesContent(const uint8* Data, int64 Size) const override
+  {
+    const FUTF8ToTCHAR Head(reinterpret_cast<const ANSICHAR*>(Data), static_cast<int32>(FMath::Min<int64>(Size, 512)));
+    return FStringView(Head.Get(), Head.Length()).Contains(TEXT("<VTKFile"));
+  }
+
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const override
+  {
+    VTPMeshFactory Factory;
+    Factory.ScalarArray = Options.ScalarArray;
+    return Factory.LoadFromMemory(Data, Size, Out, Error);
+  }
+};
+
+class FSTLGeometryImporter : public IGeometryImporter
+{
+public:
+  virtual FString GetName() const override { return TEXT("stl"); }
+  virtual TArray<FString> GetExtensions() const override { return { TEXT("stl") }; }
+
+  // binary files have no signature, but their size follows from the triangle count
+  virtual bool MatchesContent(const uint8* Data, int64 Size) const override
+  {
+    return Size >= 84 && 84 + 50 * static_cast<int64>(*reinterpret_cast<const uint32*>(Data + 80)) == Size;
+  }
+
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const override
+  {
+    Out.Reset();
+    if (MatchesContent(Data, Size))
+    {
+      // fixed 50 byte records, every triangle gets its own three vertices with the facet normal
+      const int32 NumTriangles = static_cast<int32>(*reinterpret_cast<const uint32*>(Data + 80));
+      Out.Points.SetNumUninitialized(NumTriangles * 3);
+      Out.Normals.SetNumUninitialized(NumTriangles * 3);
+      Out.Triangles.SetNumUninitialized(NumTriangles * 3);
+      ParallelFor(NumTriangles, [&](int32 t)
+        {
+          float Record[12];
+          FMemory::Memcpy(Record, Data + 84 + 50 * static_cast<int64>(t), sizeof(Record));
+          FVector Normal(Record[0], Record[1], Record[2]);
+          for (int32 k = 0; k < 3; ++k)
+          {
+            Out.Points[3 * t + k] = FVector(Record[3 + 3 * k], Record[4 + 3 * k], Record[5 + 3 * k]);
+            Out.Triangles[3 * t + k] = 3 * t + k;
+          }
+          if (Normal.IsNearlyZero())
+          {
+            Normal = FVector::CrossProduct(Out.Points[3 * t + 1] - Out.Points[3 * t], Out.Points[3 * t + 2] - Out.Points[3 * t]).GetSafeNormal();
+          }
+          Out.Normals[3 * t] = Out.Normals[3 * t + 1] = Out.Normals[3 * t + 2] = Normal;
+        }, NumTriangles < 4096);
+      return true;
+    }
+
+    const char* Cursor = reinterpret_cast<const char*>(Data);
+    const char* End = Cursor + Size;
+    FVector Normal = FVector::ZeroVector;
+    while (Cursor < End)
+    {
+      SkipBlanks(Cursor, End);
+      while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\n' || *Cursor == '\r'))
+        ++Cursor;
+      const int64 Remaining = End - Cursor;
+      double x, y, z;
+      if (Remaining > 12 && FMemory::Memcmp(Cursor, "facet normal", 12) == 0)
+      {
+        Cursor += 12;
+        if (ParseDouble(Cursor, End, x) && ParseDouble(Cursor, End, y) && ParseDouble(Cursor, End, z))
+          Normal = FVector(x, y, z);
+      }
+      else if (Remaining > 6 && FMemory::Memcmp(Cursor, "vertex", 6) == 0)
+      {
+        Cursor += 6;
+        if (!(ParseDouble(Cursor, End, x) && ParseDouble(Cursor, End, y) && ParseDouble(Cursor, End, z)))
+        {
+          Error = TEXT("malformed vertex in ascii STL");
+          return false;
+        }
+        Out.Triangles.Add(Out.Points.Add(FVector(x, y, z)));
+        Out.Normals.Add(Normal);
+      }
+      SkipLine(Cursor, End);
+    }
+    if (Out.Points.Num() % 3 != 0)
+    {
+      Error = TEXT("ascii STL ends in the middle of a facet");
+      return false;
+    }
+    return true;
+  }
+};
+
+enum class EPlyType : uint8
+{
+  Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid
+};
+
+static EPlyType ParsePlyType(const FString& Name)
+{
+  if (Name == TEXT("char") || Name == TEXT("int8")) return EPlyType::Int8;
+  if (Name == TEXT("uchar") || Name == TEXT("uint8")) return EPlyType::UInt8;
+  if (Name == TEXT("short") || Name == TEXT("int16")) return EPlyType::Int16;
+  if (Name == TEXT("ushort") || Name == TEXT("uint16")) return EPlyType::UInt16;
+  if (Name == TEXT("int") || Name == TEXT("int32")) return EPlyType::Int32;
+  if (Name == TEXT("uint") || Name == TEXT("uint32")) return EPlyType::UInt32;
+  if (Name == TEXT("float") || Name == TEXT("float32")) return EPlyType::Float32;
+  if (Name == TEXT("double") || Name == TEXT("float64")) return EPlyType::Float64;
+  return EPlyType::Invalid;
+}
+
+static int32 GetPlyTypeSize(EPlyType Type)
+{
+  switch (Type)
+  {
+  case EPlyType::Int8: case EPlyType::UInt8: return 1;
+  case EPlyType::Int16: case EPlyType::UInt16: return 2;
+  case EPlyType::Int32: case EPlyType::UInt32: case EPlyType::Float32: return 4;
+  case EPlyType::Float64: return 8;
+  default: return 0;
+  }
+}
+
+static double ReadPlyValue(EPlyType Type, const uint8* Data)
+{
+  switch (Type)
+  {
+  case EPlyType::Int8: return *reinterpret_cast<const int8*>(Data);
+  case EPlyType::UInt8: return *Data;
+  case EPlyType::Int16: { int16 v; FMemory::Memcpy(&v, Data, 2); return v; }
+  case EPlyType::UInt16: { uint16 v; FMemory::Memcpy(&v, Data, 2); return v; }
+  case EPlyType::Int32: { int32 v; FMemory::Memcpy(&v, Data, 4); return v; }
+  case EPlyType::UInt32: { uint32 v; FMemory::Memcpy(&v, Data, 4); return v; }
+  case EPlyType::Float32: { float v; FMemory::Memcpy(&v, Data, 4); return v; }
+  case EPlyType::Float64: { double v; FMemory::Memcpy(&v, Data, 8); return v; }
+  default: return 0.0;
+  }
+}
+
+class FPLYGeometryImporter : public IGeometryImporter
+{
+  struct FProperty
+  {
+    FString Name;
+    EPlyType Type = EPlyType::Invalid;
+    bool bList = false;
+    EPlyType CountType = EPlyType::Invalid;
+    int32 Offset = 0;
+  };
+
+  struct FElement
+  {
+    FString Name;
+    int64 Count = 0;
+    TArray<FProperty> Properties;
+    // byte size of one record, INDEX_NONE if the element contains lists
+    int32 Stride = 0;
+
+    int32 Find(const TCHAR* PropertyName) const
+    {
+      return Properties.IndexOfByPredicate([PropertyName](const FProperty& Property) { return Property.Name == PropertyName; });
+    }
+  };
+
+public:
+  virtual FString GetName() const override { return TEXT("ply"); }
+  virtual TArray<FString> GetExtensions() const override { return { TEXT("ply") }; }
+
+  virtual bool MatchesContent(const uint8* Data, int64 Size) const override
+  {
+    return Size >= 4 && FMemory::Memcmp(Data, "ply", 3) == 0 && (Data[3] == '\n' || Data[3] == '\r');
+  }
+
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const override
+  {
+    Out.Reset();
+    const char* Cursor = reinterpret_cast<const char*>(Data);
+    const char* End = Cursor + Size;
+    TArray<FElement> Elements;
+    bool bBinary = false;
+    bool bHeaderDone = false;
+    while (Cursor < End && !bHeaderDone)
+    {
+      const char* LineEnd = Cursor;
+      while (LineEnd < End && *LineEnd != '\n')
+        ++LineEnd;
+      TArray<FString> Words;
+      FString(static_cast<int32>(LineEnd - Cursor), Cursor).TrimStartAndEnd().ParseIntoArrayWS(Words);
+      Cursor = LineEnd < End ? LineEnd + 1 : End;
+      if (Words.Num() == 0)
+        continue;
+      if (Words[0] == TEXT("format") && Words.Num() > 1)
+      {
+        if (Words[1] == TEXT("binary_big_endian"))
+        {
+          Error = TEXT("big endian PLY files are not supported");
+          return false;
+        }
+        bBinary = Words[1] == TEXT("binary_little_endian");
+      }
+      else if (Words[0] == TEXT("element") && Words.Num() > 2)
+      {
+        FElement& Element = Elements.AddDefaulted_GetRef();
+        Element.Name = Words[1];
+        Element.Count = FCString::Atoi64(*Words[2]);
+        if (Element.Count < 0 || Element.Count > MAX_int32)
+        {
+          Error = FString::Printf(TEXT("PLY element %s has an invalid count"), *Element.Name);
+          return false;
+        }
+      }
+      else if (Words[0] == TEXT("property") && Elements.Num() > 0)
+      {
+        FElement& Element = Elements.Last();
+        FProperty& Property = Element.Properties.AddDefaulted_GetRef();
+        if (Words.Num() > 4 && Words[1] == TEXT("list"))
+        {
+          Property.bList = true;
+          Property.CountType = ParsePlyType(Words[2]);
+          Property.Type = ParsePlyType(Words[3]);
+          Property.Name = Words[4];
+          Element.Stride = INDEX_NONE;
+        }
+        else if (Words.Num() > 2)
+        {
+          Property.Type = ParsePlyType(Words[1]);
+          Property.Name = Words[2];
+          if (Element.Stride != INDEX_NONE)
+          {
+            Property.Offset = Element.Stride;
+            Element.Stride += GetPlyTypeSize(Property.Type);
+          }
+        }
+        if (Property.Type == EPlyType::Invalid || (Property.bList && Property.CountType == EPlyType::Invalid))
+        {
+          Error = FString::Printf(TEXT("unsupported PLY property %s"), *Property.Name);
+          return false;
+        }
+      }
+      else if (Words[0] == TEXT("end_header"))
+      {
+        bHeaderDone = true;
+      }
+    }
+    if (!bHeaderDone)
+    {
+      Error = TEXT("PLY header has no end");
+      return false;
+    }
+
+    const uint8* Body = reinterpret_cast<const uint8*>(Cursor);
+    for (const FElement& Element : Elements)
+    {
+      bool bOk;
+      if (Element.Name == TEXT("vertex"))
+        bOk = bBinary ? ReadBinaryVertices(Element, Body, Data + Size, Options, Out) : ReadAsciiVertices(Element, Cursor, End, Options, Out);
+      else if (Element.Name == TEXT("face"))
+        bOk = bBinary ? ReadBinaryFaces(Element, Body, Data + Size, Out) : ReadAsciiFaces(Element, Cursor, End, Out);
+      else
+        bOk = bBinary ? SkipBinary(Element, Body, Data + Size) : SkipAscii(Element, Cursor, End);
+      if (!bOk)
+      {
+        Error = FString::Printf(TEXT("PLY element %s is truncated or malformed"), *Element.Name);
+        return false;
+      }
+    }
+    for (const int32 Index : Out.Triangles)
+    {
+      if (Index < 0 || Index >= Out.Points.Num())
+      {
+        Error = TEXT("PLY face references a missing vertex");
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct FVertexLayout
+  {
+    int32 Position[3], Normal[3], UV[2], Scalar;
+  };
+
+  static FVertexLayout GetLayout(const FElement& Element, const FGeometryImportOptions& Options)
+  {
+    FVertexLayout Layout;
+    Layout.Position[0] = Element.Find(TEXT("x"));
+    Layout.Position[1] = Element.Find(TEXT("y"));
+    Layout.Position[2] = Element.Find(TEXT("z"));
+    Layout.Normal[0] = Element.Find(TEXT("nx"));
+    Layout.Normal[1] = Element.Find(TEXT("ny"));
+    Layout.Normal[2] = Element.Find(TEXT("nz"));
+    const TCHAR* UNames[] = { TEXT("u"), TEXT("s"), TEXT("texture_u") };
+    const TCHAR* VNames[] = { TEXT("v"), TEXT("t"), TEXT("texture_v") };
+    Layout.UV[0] = Layout.UV[1] = INDEX_NONE;
+    for (int32 i = 0; i < 3 && Layout.UV[0] == INDEX_NONE; ++i)
+    {
+      Layout.UV[0] = Element.Find(UNames[i]);
+      Layout.UV[1] = Element.Find(VNames[i]);
+    }
+    Layout.Scalar = INDEX_NONE;
+    if (!Options.ScalarArray.IsEmpty())
+    {
+      Layout.Scalar = Element.Find(*Options.ScalarArray);
+    }
+    for (const TCHAR* Name : { TEXT("scalar"), TEXT("value"), TEXT("quality"), TEXT("intensity") })
+    {
+      if (Layout.Scalar == INDEX_NONE)
+        Layout.Scalar = Element.Find(Name);
+    }
+    return Layout;
+  }
+
+  static void PrepareVertices(const FElement& Element, const FVertexLayout& Layout, FGeometryPayload& Out)
+  {
+    const int32 Count = static_cast<int32>(Element.Count);
+    Out.Points.SetNumUninitialized(Count);
+    if (Layout.Normal[0] != INDEX_NONE && Layout.Normal[1] != INDEX_NONE && Layout.Normal[2] != INDEX_NONE)
+      Out.Normals.SetNumUninitialized(Count);
+    if (Layout.UV[0] != INDEX_NONE && Layout.UV[1] != INDEX_NONE)
+      Out.UVs.SetNumUninitialized(Count);
+    if (Layout.Scalar != INDEX_NONE)
+      Out.Scalars.SetNumUninitialized(Count);
+  }
+
+  static void StoreVertex(int32 v, const double* Values, const FVertexLayout& Layout, FGeometryPayload& Out)
+  {
+    Out.Points[v] = FVector(Values[Layout.Position[0]], Values[Layout.Position[1]], Values[Layout.Position[2]]);
+    if (Out.Normals.Num() > 0)
+      Out.Normals[v] = FVector(Values[Layout.Normal[0]], Values[Layout.Normal[1]], Values[Layout.Normal[2]]);
+    if (Out.UVs.Num() > 0)
+      Out.UVs[v] = FVector2D(Values[Layout.UV[0]], Values[Layout.UV[1]]);
+    if (Out.Scalars.Num() > 0)
+      Out.Scalars[v] = static_cast<float>(Values[Layout.Scalar]);
+  }
+
+  static bool ReadBinaryVertices(const FElement& Element, const uint8*& Body, const uint8* End, const FGeometryImportOptions& Options, FGeometryPayload& Out)
+  {
+    const FVertexLayout Layout = GetLayout(Element, Options);
+    const int32 NumProperties = Element.Properties.Num();
+    if (Layout.Position[0] == INDEX_NONE || Layout.Position[1] == INDEX_NONE || Layout.Position[2] == INDEX_NONE || Element.Stride == INDEX_NONE || NumProperties > 32)
+      return false;
+    if (Element.Count * Element.Stride > End - Body)
+      return false;
+    PrepareVertices(Element, Layout, Out);
+    // fixed size records are converted in place from the mapped file
+    const uint8* Records = Body;
+    ParallelFor(static_cast<int32>(Element.Count), [&](int32 v)
+      {
+        double Values[32];
+        const uint8* Record = Records + static_cast<int64>(v) * Element.Stride;
+        for (int32 p = 0; p < NumProperties; ++p)
+          Values[p] = ReadPlyValue(Element.Properties[p].Type, Record + Element.Properties[p].Offset);
+        StoreVertex(v, Values, Layout, Out);
+      }, Element.Count < 4096);
+    Body += Element.Count * Element.Stride;
+    return true;
+  }
+
+  static bool ReadAsciiVertices(const FElement& Element, const char*& Cursor, const char* End, const FGeometryImportOptions& Options, FGeometryPayload& Out)
+  {
+    const FVertexLayout Layout = GetLayout(Element, Options);
+    if (Layout.Position[0] == INDEX_NONE || Layout.Position[1] == INDEX_NONE || Layout.Position[2] == INDEX_NONE || Element.Properties.Num() > 32)
+      return false;
+    PrepareVertices(Element, Layout, Out);
+    double Values[32];
+    for (int32 v = 0; v < Element.Count; ++v)
+    {
+      for (int32 p = 0; p < Element.Properties.Num(); ++p)
+      {
+        while (Cursor < End && FCharAnsi::IsWhitespace(*Cursor))
+          ++Cursor;
+        if (Element.Properties[p].bList)
+        {
+          int64 Count;
+          double Ignored;
+          if (!ParseInt(Cursor, End, Count))
+            return false;
+          for (int64 i = 0; i < Count; ++i)
+            ParseDouble(Cursor, End, Ignored);
+          Values[p] = 0.0;
+        }
+        else if (!ParseDouble(Cursor, End, Values[p]))
+        {
+          return false;
+        }
+      }
+      StoreVertex(v, Values, Layout, Out);
+    }
+    return true;
+  }
+
+  static int32 FindFaceList(const FElement& Element)
+  {
+    const int32 Index = Element.Find(TEXT("vertex_indices"));
+    return Index != INDEX_NONE ? Index : Element.Find(TEXT("vertex_index"));
+  }
+
+  static bool ReadBinaryFaces(const FElement& Element, const uint8*& Body, const uint8* End, FGeometryPayload& Out)
+  {
+    const int32 List = FindFaceList(Element);
+    if (List == INDEX_NONE || !Element.Properties[List].bList)
+      return false;
+    const FProperty& Indices = Element.Properties[List];
+    const int32 CountSize = GetPlyTypeSize(Indices.CountType);
+    const int32 IndexSize = GetPlyTypeSize(Indices.Type);
+
+    // the common layout of only triangles in a single list can be read in parallel without a walk
+    if (Element.Properties.Num() == 1 && Indices.CountType == EPlyType::UInt8 && IndexSize == 4)
+    {
+      const int64 Stride = 1 + 3 * 4;
+      if (Element.Count * Stride <= End - Body)
+      {
+        std::atomic<bool> bAllTriangles{ true };
+        const uint8* Records = Body;
+        ParallelFor(static_cast<int32>(FMath::DivideAndRoundUp<int64>(Element.Count, 1 << 16)), [&](int32 Block)
+          {
+            const int64 Last = FMath::Min<int64>(Element.Count, (Block + 1) * (1 << 16));
+            for (int64 f = Block * (1 << 16); f < Last && bAllTriangles; ++f)
+            {
+              if (Records[f * Stride] != 3)
+                bAllTriangles = false;
+            }
+          });
+        if (bAllTriangles)
+        {
+          const int32 Base = Out.Triangles.Num();
+          Out.Triangles.AddUninitialized(static_cast<int32>(Element.Count * 3));
+          ParallelFor(static_cast<int32>(Element.Count), [&](int32 f)
+            {
+              FMemory::Memcpy(&Out.Triangles[Base + 3 * f], Records + f * Stride + 1, 3 * sizeof(int32));
+            }, Element.Count < 4096);
+          Body += Element.Count * Stride;
+          return true;
+        }
+      }
+    }
+
+    for (int64 f = 0; f < Element.Count; ++f)
+    {
+      for (int32 p = 0; p < Element.Properties.Num(); ++p)
+      {
+        const FProperty& Property = Element.Properties[p];
+        if (!Property.bList)
+        {
+          Body += GetPlyTypeSize(Property.Type);
+          continue;
+        }
+        int64 Count;
+        if (!ReadListCount(Property, Body, End, Count))
+          return false;
+        const int32 ItemSize = GetPlyTypeSize(Property.Type);
+        if (p == List && Count >= 3)
+        {
+          const int32 First = static_cast<int32>(ReadPlyValue(Property.Type, Body));
+          for (int64 i = 1; i + 1 < Count; ++i)
+          {
+            Out.Triangles.Add(First);
+            Out.Triangles.Add(static_cast<int32>(ReadPlyValue(Property.Type, Body + i * ItemSize)));
+            Out.Triangles.Add(static_cast<int32>(ReadPlyValue(Property.Type, Body + (i + 1) * ItemSize)));
+          }
+        }
+        Body += Count * ItemSize;
+      }
+    }
+    return Body <= End;
+  }
+
+  static bool ReadAsciiFaces(const FElement& Element, const char*& Cursor, const char* End, FGeometryPayload& Out)
+  {
+    const int32 List = FindFaceList(Element);
+    if (List == INDEX_NONE)
+      return false;
+    TArray<int32> Polygon;
+    for (int64 f = 0; f < Element.Count; ++f)
+    {
+      for (int32 p = 0; p < Element.Properties.Num(); ++p)
+      {
+        while (Cursor < End && FCharAnsi::IsWhitespace(*Cursor))
+          ++Cursor;
+        int64 Count = 1;
+        if (Element.Properties[p].bList && !ParseInt(Cursor, End, Count))
+          return false;
+        Polygon.Reset();
+        for (int64 i = 0; i < Count; ++i)
+        {
+          double Value;
+          while (Cursor < End && FCharAnsi::IsWhitespace(*Cursor))
+            ++Cursor;
+          if (!ParseDouble(Cursor, End, Value))
+            return false;
+          Polygon.Add(static_cast<int32>(Value));
+        }
+        if (p == List)
+        {
+          for (int32 i = 1; i + 1 < Polygon.Num(); ++i)
+          {
+            Out.Triangles.Add(Polygon[0]);
+            Out.Triangles.Add(Polygon[i]);
+            Out.Triangles.Add(Polygon[i + 1]);
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  // reads the count of a list and checks that its items lie before End, Body is left at the first item
+  static bool ReadListCount(const FProperty& Property, const uint8*& Body, const uint8* End, int64& Count)
+  {
+    const int32 CountSize = GetPlyTypeSize(Property.CountType);
+    if (CountSize > End - Body)
+      return false;
+    const double Value = ReadPlyValue(Property.CountType, Body);
+    Body += CountSize;
+    if (Value < 0.0 || Value > static_cast<double>(End - Body) / GetPlyTypeSize(Property.Type))
+      return false;
+    Count = static_cast<int64>(Value);
+    return true;
+  }
+
+  static bool SkipBinary(const FElement& Element, const uint8*& Body, const uint8* End)
+  {
+    if (Element.Stride != INDEX_NONE)
+    {
+      if (Element.Count * Element.Stride > End - Body)
+        return false;
+      Body += Element.Count * Element.Stride;
+      return true;
+    }
+    for (int64 e = 0; e < Element.Count; ++e)
+    {
+      for (const FProperty& Property : Element.Properties)
+      {
+        if (Property.bList)
+        {
+          int64 Count;
+          if (!ReadListCount(Property, Body, End, Count))
+            return false;
+          Body += Count * GetPlyTypeSize(Property.Type);
+        }
+        else
+        {
+          if (GetPlyTypeSize(Property.Type) > End - Body)
+            return false;
+          Body += GetPlyTypeSize(Property.Type);
+        }
+      }
+    }
+    return true;
+  }
+
+  static bool SkipAscii(const FElement& Element, const char*& Cursor, const char* End)
+  {
+    for (int64 e = 0; e < Element.Count && Cursor < End; ++e)
+    {
+      SkipLine(Cursor, End);
+    }
+    return true;
+  }
+};
+
+/**
+ * Wavefront OBJ, the file is split at line boundaries and every chunk is tokenized on its own worker.
+ * Relative indices are resolved once the number of elements in all earlier chunks is known.
+ */
+class FOBJGeometryImporter : public IGeometryImporter
+{
+  struct FCorner
+  {
+    int32 Index[3];
+    // bit k is set if Index[k] is relative to the elements of the chunk
+    uint8 Relative;
+  };
+
+  struct FChunk
+  {
+    TArray<FVector> Positions, Normals;
+    TArray<FVector2D> UVs;
+    TArray<FCorner> Corners;
+    TArray<int32> FaceSizes;
+    bool bValid = true;
+  };
+
+public:
+  virtual FString GetName() const override { return TEXT("obj"); }
+  virtual TArray<FString> GetExtensions() const override { return { TEXT("obj") }; }
+
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const override
+  {
+    Out.Reset();
+    const char* Begin = reinterpret_cast<const char*>(Data);
+    const auto Ranges = SplitLines(Begin, Begin + Size);
+    TArray<FChunk> Chunks;
+    Chunks.SetNum(Ranges.Num());
+    ParallelFor(Ranges.Num(), [&](int32 c)
+      {
+        ParseChunk(Ranges[c].Key, Ranges[c].Value, Chunks[c]);
+      });
+
+    int32 NumPositions = 0, NumUVs = 0, NumNormals = 0, NumCorners = 0;
+    bool bHasUVs = false, bHasNormals = false, bAllUVs = true, bAllNormals = true;
+    TArray<FIntVector> ChunkOffsets;
+    for (const FChunk& Chunk : Chunks)
+    {
+      if (!Chunk.bValid)
+      {
+        Error = TEXT("malformed OBJ face");
+        return false;
+      }
+      ChunkOffsets.Add(FIntVector(NumPositions, NumUVs, NumNormals));
+      NumPositions += Chunk.Positions.Num();
+      NumUVs += Chunk.UVs.Num();
+      NumNormals += Chunk.Normals.Num();
+      NumCorners += Chunk.Corners.Num();
+      for (const FCorner& Corner : Chunk.Corners)
+      {
+        bHasUVs |= Corner.Index[1] != INDEX_NONE || (Corner.Relative & 2);
+        bAllUVs &= Corner.Index[1] != INDEX_NONE || (Corner.Relative & 2);
+        bHasNormals |= Corner.Index[2] != INDEX_NONE || (Corner.Relative & 4);
+        bAllNormals &= Corner.Index[2] != INDEX_NONE || (Corner.Relative & 4);
+      }
+    }
+    TArray<FVector> Positions, Normals;
+    TArray<FVector2D> UVs;
+    Positions.Reserve(NumPositions);
+    Normals.Reserve(NumNormals);
+    UVs.Reserve(NumUVs);
+    for (const FChunk& Chunk : Chunks)
+    {
+      Positions.Append(Chunk.Positions);
+      Normals.Append(Chunk.Normals);
+      UVs.Append(Chunk.UVs);
+    }
+
+    // resolve every corner to global zero based indices
+    const int32 Limits[3] = { NumPositions, NumUVs, NumNormals };
+    TArray<FIntVector> Resolved;
+    Resolved.SetNumUninitialized(NumCorners);
+    TArray<int32> CornerOffsets;
+    int32 CornerOffset = 0;
+    for (const FChunk& Chunk : Chunks)
+    {
+      CornerOffsets.Add(CornerOffset);
+      CornerOffset += Chunk.Corners.Num();
+    }
+    std::atomic<bool> bInRange{ true };
+    ParallelFor(Chunks.Num(), [&](int32 c)
+      {
+        for (int32 i = 0; i < Chunks[c].Corners.Num(); ++i)
+        {
+          const FCorner& Corner = Chunks[c].Corners[i];
+          FIntVector& Target = Resolved[CornerOffsets[c] + i];
+          for (int32 k = 0; k < 3; ++k)
+          {
+            // a relative index can resolve to -1 as well, so absence is only taken from the parsed corner
+            int32 Index = Corner.Index[k];
+            const bool bRelative = (Corner.Relative & (1 << k)) != 0;
+            if (bRelative)
+              Index += ChunkOffsets[c][k];
+            if ((bRelative || Index != INDEX_NONE) && (Index < 0 || Index >= Limits[k]))
+              bInRange = false;
+            Target[k] = Index;
+          }
+        }
+      });
+    if (!bInRange)
+    {
+      Error = TEXT("OBJ face references a missing element");
+      return false;
+    }
+
+    // positions are shared unless corners combine them with different texture coordinates or normals
+    const bool bUseUVs = bHasUVs && bAllUVs;
+    const bool bUseNormals = bHasNormals && bAllNormals;
+    TArray<int32> CornerVertices;
+    CornerVertices.SetNumUninitialized(NumCorners);
+    if (!bUseUVs && !bUseNormals)
+    {
+      Out.Points = MoveTemp(Positions);
+      for (int32 i = 0; i < NumCorners; ++i)
+        CornerVertices[i] = Resolved[i].X;
+    }
+    else
+    {
+      TMap<FIntVector, int32> Unique;
+      Unique.Reserve(NumPositions);
+      for (int32 i = 0; i < NumCorners; ++i)
+      {
+        const FIntVector Key(Resolved[i].X, bUseUVs ? Resolved[i].Y : 0, bUseNormals ? Resolved[i].Z : 0);
+        if (const int32* Existing = Unique.Find(Key))
+        {
+          CornerVertices[i] = *Existing;
+          continue;
+        }
+        CornerVertices[i] = Out.Points.Add(Positions[Key.X]);
+        if (bUseUVs)
+          Out.UVs.Add(UVs[Key.Y]);
+        if (bUseNormals)
+          Out.Normals.Add(Normals[Key.Z]);
+        Unique.Add(Key, CornerVertices[i]);
+      }
+    }
+
+    int32 Corner = 0;
+    for (const FChunk& Chunk : Chunks)
+    {
+      for (const int32 FaceSize : Chunk.FaceSizes)
+      {
+        for (int32 i = 1; i + 1 < FaceSize; ++i)
+        {
+          Out.Triangles.Add(CornerVertices[Corner]);
+          Out.Triangles.Add(CornerVertices[Corner + i]);
+          Out.Triangles.Add(CornerVertices[Corner + i + 1]);
+        }
+        Corner += FaceSize;
+      }
+    }
+    for (const int32 Index : Out.Triangles)
+    {
+      if (Index < 0 || Index >= Out.Points.Num())
+      {
+        Error = TEXT("OBJ face references a missing vertex");
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  static void ParseChunk(const char* Cursor, const char* End, FChunk& Chunk)
+  {
+    while (Cursor < End)
+    {
+      SkipBlanks(Cursor, End);
+      if (End - Cursor < 2)
+        break;
+      double x = 0, y = 0, z = 0;
+      if (Cursor[0] == 'v' && Cursor[1] == ' ')
+      {
+        Cursor += 2;
+        ParseDouble(Cursor, End, x) && ParseDouble(Cursor, End, y) && ParseDouble(Cursor, End, z);
+        Chunk.Positions.Add(FVector(x, y, z));
+      }
+      else if (Cursor[0] == 'v' && Cursor[1] == 'n')
+      {
+        Cursor += 2;
+        ParseDouble(Cursor, End, x) && ParseDouble(Cursor, End, y) && ParseDouble(Cursor, End, z);
+        Chunk.Normals.Add(FVector(x, y, z));
+      }
+      else if (Cursor[0] == 'v' && Cursor[1] == 't')
+      {
+        Cursor += 2;
+        ParseDouble(Cursor, End, x) && ParseDouble(Cursor, End, y);
+        Chunk.UVs.Add(FVector2D(x, y));
+      }
+      else if (Cursor[0] == 'f' && Cursor[1] == ' ')
+      {
+        Cursor += 2;
+        int32 FaceSize = 0;
+        while (true)
+        {
+          SkipBlanks(Cursor, End);
+          if (Cursor >= End || *Cursor == '\n' || *Cursor == '#')
+            break;
+          FCorner Corner{ { INDEX_NONE, INDEX_NONE, INDEX_NONE }, 0 };
+          const int32 Counts[3] = { Chunk.Positions.Num(), Chunk.UVs.Num(), Chunk.Normals.Num() };
+          for (int32 k = 0; k < 3; ++k)
+          {
+            if (k > 0)
+            {
+              if (Cursor >= End || *Cursor != '/')
+                break;
+              ++Cursor;
+            }
+            int64 Value;
+            if (Cursor < End && *Cursor != '/' && ParseInt(Cursor, End, Value))
+            {
+              // indices count from 1, zero and values beyond int32 are not valid in any position
+              if (Value == 0 || Value < -MAX_int32 || Value > MAX_int32)
+              {
+                Chunk.bValid = false;
+                return;
+              }
+              if (Value < 0)
+              {
+                Corner.Index[k] = Counts[k] + static_cast<int32>(Value);
+                Corner.Relative |= 1 << k;
+              }
+              else
+              {
+                Corner.Index[k] = static_cast<int32>(Value - 1);
+              }
+            }
+          }
+          if (Corner.Index[0] == INDEX_NONE && !(Corner.Relative & 1))
+          {
+            Chunk.bValid = false;
+            return;
+          }
+          // skip anything that is not part of the index triple
+          while (Cursor < End && *Cursor != ' ' && *Cursor != '\t' && *Cursor != '\n' && *Cursor != '\r')
+            ++Cursor;
+          Chunk.Corners.Add(Corner);
+          ++FaceSize;
+        }
+        Chunk.FaceSizes.Add(FaceSize);
+      }
+      SkipLine(Cursor, End);
+    }
+  }
+};
+
+FGeometryImporterRegistry& FGeometryImporterRegistry::Get()
+{
+  static FGeometryImporterRegistry Registry;
+  return Registry;
+}
+
+FGeometryImporterRegistry::FGeometryImporterRegistry()
+  : RawImporter(MakeShared<FRawGeometryImporter, ESPMode::ThreadSafe>())
+{
+  Importers.Add(MakeShared<FVTKGeometryImporter, ESPMode::ThreadSafe>());
+  Importers.Add(MakeShared<FPLYGeometryImporter, ESPMode::ThreadSafe>());
+  Importers.Add(MakeShared<FSTLGeometryImporter, ESPMode::ThreadSafe>());
+  Importers.Add(MakeShared<FOBJGeometryImporter, ESPMode::ThreadSafe>());
+  Importers.Add(RawImporter);
+}
+
+void FGeometryImporterRegistry::Register(TSharedRef<IGeometryImporter, ESPMode::ThreadSafe> Importer)
+{
+  FScopeLock ScopeLock(&Lock);
+  // later registrations take precedence, so that projects can replace the built-in importers
+  Importers.Insert(Importer, 0);
+}
+
+TSharedPtr<IGeometryImporter, ESPMode::ThreadSafe> FGeometryImporterRegistry::FindImporter(const FString& FileName, const uint8* Data, int64 Size) const
+{
+  FScopeLock ScopeLock(&Lock);
+  for (const auto& Importer : Importers)
+  {
+    if (Data && Importer->MatchesContent(Data, Size))
+    {
+      return Importer;
+    }
+  }
+  const FString Extension = FPaths::GetExtension(FileName).ToLower();
+  for (const auto& Importer : Importers)
+  {
+    if (Importer->GetExtensions().Contains(Extension))
+    {
+      return Importer;
+    }
+  }
+  return RawImporter;
+}
+
+bool FGeometryImporterRegistry::ImportFile(const FString& FileName, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const
+{
+  FMappedFile File;
+  if (!File.Open(FileName) || File.Num() == 0)
+  {
+    Error = FString::Printf(TEXT("could not read %s"), *FileName);
+    return false;
+  }
+  const auto Importer = FindImporter(FileName, File.GetData(), File.Num());
+  if (!Importer->Import(File.GetData(), File.Num(), Options, Out, Error))
+  {
+    Error = FString::Printf(TEXT("%s importer: %s"), *Importer->GetName(), *Error);
+    return false;
+  }
+  return true;
+}
+
+TArray<FString> FGeometryImporterRegistry::GetSupportedExtensions() const
+{
+  FScopeLock ScopeLock(&Lock);
+  TArray<FString> Extensions;
+  for (const auto& Importer : Importers)
+  {
+    for (const FString& Extension : Importer->GetExtensions())
+    {
+      Extensions.AddUnique(Extension);
+    }
+  }
+  return Extensions;
+}
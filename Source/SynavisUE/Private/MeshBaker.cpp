@@ -0,0 +1,150 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "MeshBaker.h"
+
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "MeshDescription.h"
+#include "StaticMeshAttributes.h"
+#include "Materials/MaterialInterface.h"
+#include "Misc/SecureHash.h"
+
+static FName GetSectionSlotName(int32 Section)
+{
+  return FName(*FString::Printf(TEXT("Section%d"), Section));
+}
+
+TSharedPtr<FMeshDescription, ESPMode::ThreadSafe> FMeshBaker::BuildMeshDescription(const TArray<FProcMeshSection>& Sections)
+{
+  auto Description = MakeShared<FMeshDescription, ESPMode::ThreadSafe>();
+  FStaticMeshAttributes Attributes(*Description);
+  Attributes.Register();
+
+  int32 NumVertices = 0, NumTriangles = 0;
+  for (const auto& Section : Sections)
+  {
+    NumVertices += Section.ProcVertexBuffer.Num();
+    NumTriangles += Section.ProcIndexBuffer.Num() / 3;
+  }
+  Description->ReserveNewVertices(NumVertices);
+  Description->ReserveNewVertexInstances(NumVertices);
+  Description->ReserveNewTriangles(NumTriangles);
+  Description->ReserveNewPolygons(NumTriangles);
+  Description->ReserveNewEdges(NumTriangles * 3);
+
+  auto Positions = Attributes.GetVertexPositions();
+  auto InstanceNormals = Attributes.GetVertexInstanceNormals();
+  auto InstanceTangents = Attributes.GetVertexInstanceTangents();
+  auto InstanceBinormalSigns = Attributes.GetVertexInstanceBinormalSigns();
+  auto InstanceColors = Attributes.GetVertexInstanceColors();
+  auto InstanceUVs = Attributes.GetVertexInstanceUVs();
+  auto SlotNames = Attributes.GetPolygonGroupMaterialSlotNames();
+  InstanceUVs.SetNumChannels(1);
+
+  TArray<FVertexInstanceID> Instances;
+  for (int32 s = 0; s < Sections.Num(); ++s)
+  {
+    const FProcMeshSection& Section = Sections[s];
+    const FPolygonGroupID PolygonGroup = Description->CreatePolygonGroup();
+    SlotNames[PolygonGroup] = GetSectionSlotName(s);
+
+    // procedural mesh vertices already carry all attributes, so every vertex gets exactly one instance
+    Instances.SetNumUninitialized(Section.ProcVertexBuffer.Num(), false);
+    for (int32 i = 0; i < Section.ProcVertexBuffer.Num(); ++i)
+    {
+      const FProcMeshVertex& Vertex = Section.ProcVertexBuffer[i];
+      const FVertexID VertexID = Description->CreateVertex();
+      Positions[VertexID] = FVector3f(Vertex.Position);
+      const FVertexInstanceID InstanceID = Description->CreateVertexInstance(VertexID);
+      InstanceNormals[InstanceID] = FVector3f(Vertex.Normal);
+      InstanceTangents[InstanceID] = FVector3f(Vertex.Tangent.TangentX);
+      InstanceBinormalSigns[InstanceID] = Vertex.Tangent.bFlipTangentY ? -1.f : 1.f;
+      InstanceColors[InstanceID] = FVector4f(FLinearColor(Vertex.Color));
+      InstanceUVs.Set(InstanceID, 0, FVector2f(Vertex.UV0));
+      Instances[i] = InstanceID;
+    }
+
+    const int32 SectionTriangles = Section.ProcIndexBuffer.Num() / 3;
+    for (int32 t = 0; t < SectionTriangles; ++t)
+    {
+      const uint32 a = Section.ProcIndexBuffer[3 * t + 0];
+      const uint32 b = Section.ProcIndexBuffer[3 * t + 1];
+      const uint32 c = Section.ProcIndexBuffer[3 * t + 2];
+      // degenerate triangles are rejected by the static mesh build anyway
+      if (a == b || b == c || a == c)
+      {
+        continue;
+      }
+      Description->CreateTriangle(PolygonGroup, { Instances[a], Instances[b], Instances[c] });
+    }
+  }
+  return Description;
+}
+
+FString FMeshBaker::ComputeSectionKey(const TArray<FProcMeshSection>& Sections)
+{
+  FSHA1 Hasher;
+  for (const auto& Section : Sections)
+  {
+    // the vertex struct contains padding, so only hash the members
+    for (const auto& Vertex : Section.ProcVertexBuffer)
+    {
+      Hasher.Update(reinterpret_cast<const uint8*>(&Vertex.Position), sizeof(FVector));
+      Hasher.Update(reinterpret_cast<const uint8*>(&Vertex.Normal), sizeof(FVector));
+      Hasher.Update(reinterpret_cast<const uint8*>(&Vertex.Tangent.TangentX), sizeof(FVector));
+      const uint8 Flip = Vertex.Tangent.bFlipTangentY ? 1 : 0;
+      Hasher.Update(&Flip, 1);
+      Hasher.Update(reinterpret_cast<const uint8*>(&Vertex.UV0), sizeof(FVector2D));
+      Hasher.Update(reinterpret_cast<const uint8*>(&Vertex.Color), sizeof(FColor));
+    }
+    Hasher.Update(reinterpret_cast<const uint8*>(Section.ProcIndexBuffer.GetData()), Section.ProcIndexBuffer.Num() * sizeof(uint32));
+  }
+  Hasher.Final();
+  FSHAHash Hash;
+  Hasher.GetHash(Hash.Hash);
+  return Hash.ToString().ToLower();
+}
+
+UStaticMesh* FMeshBaker::CreateStaticMesh(UObject* Outer, const TArray<const FMeshDescription*>& LODs,
+  const TArray<UMaterialInterface*>& Materials, bool bNanite, const TArray<float>& ScreenSizes)
+{
+  check(IsInGameThread());
+  if (LODs.Num() == 0)
+  {
+    return nullptr;
+  }
+  UStaticMesh* StaticMesh = NewObject<UStaticMesh>(Outer, NAME_None, RF_Transient);
+  for (int32 s = 0; s < Materials.Num(); ++s)
+  {
+    StaticMesh->GetStaticMaterials().Add(FStaticMaterial(Materials[s], GetSectionSlotName(s)));
+  }
+#if WITH_EDITOR
+  // Nanite data can only be built where the builder is available
+  StaticMesh->NaniteSettings.bEnabled = bNanite;
+#else
+  if (bNanite)
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Nanite was requested for a baked mesh, but cannot be built outside of the editor."));
+  }
+#endif
+  UStaticMesh::FBuildMeshDescriptionsParams Params;
+  Params.bBuildSimpleCollision = false;
+  Params.bMarkPackageDirty = false;
+  Params.bUseHashAsGuid = true;
+  Params.bFastBuild = !bNanite;
+  Params.bAllowCpuAccess = false;
+  if (!StaticMesh->BuildFromMeshDescriptions(LODs, Params))
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Could not build static mesh from mesh description"));
+    return nullptr;
+  }
+  // the runtime build does not compute LOD distances, the render data carries them directly
+  if (FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData())
+  {
+    for (int32 LOD = 0; LOD < FMath::Min(ScreenSizes.Num(), LODs.Num()); ++LOD)
+    {
+      RenderData->ScreenSize[LOD].Default = ScreenSizes[LOD];
+    }
+  }
+  return StaticMesh;
+}
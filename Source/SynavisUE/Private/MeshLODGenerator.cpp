@@ -0,0 +1,93 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "MeshLODGenerator.h"
+
+#include "DynamicMesh/DynamicMesh3.h"
+#include "DynamicMesh/MeshNormals.h"
+#include "MeshSimplification.h"
+
+using namespace UE::Geometry;
+
+static void SectionToDynamicMesh(const FProcMeshSection& Section, FDynamicMesh3& Mesh)
+{
+  Mesh = FDynamicMesh3(true, true, true, false);
+  for (const FProcMeshVertex& Vertex : Section.ProcVertexBuffer)
+  {
+    const FLinearColor Color(Vertex.Color);
+    Mesh.AppendVertex(FVertexInfo(Vertex.Position, FVector3f(Vertex.Normal),
+      FVector3f(Color.R, Color.G, Color.B), FVector2f(Vertex.UV0)));
+  }
+  for (int32 i = 0; i + 2 < Section.ProcIndexBuffer.Num(); i += 3)
+  {
+    // non-manifold triangles are refused by the dynamic mesh, the LODs simply go without them
+    Mesh.AppendTriangle(Section.ProcIndexBuffer[i], Section.ProcIndexBuffer[i + 1], Section.ProcIndexBuffer[i + 2]);
+  }
+}
+
+static void DynamicMeshToSection(FDynamicMesh3& Mesh, FProcMeshSection& Section)
+{
+  Mesh.CompactInPlace();
+  Section.Reset();
+  Section.ProcVertexBuffer.SetNum(Mesh.VertexCount());
+  for (int32 vid = 0; vid < Mesh.MaxVertexID(); ++vid)
+  {
+    FVertexInfo Info;
+    Mesh.GetVertex(vid, Info, true, true, true);
+    FProcMeshVertex& Vertex = Section.ProcVertexBuffer[vid];
+    Vertex.Position = Info.Position;
+    Vertex.Normal = FVector(Info.Normal);
+    FVector TangentX = FVector::CrossProduct(Vertex.Normal, FVector(0, 0, 1));
+    TangentX.Normalize();
+    Vertex.Tangent = FProcMeshTangent(TangentX, false);
+    // the dynamic mesh holds linear colours, the section stores them in sRGB like the source did
+    Vertex.Color = FLinearColor(Info.Color.X, Info.Color.Y, Info.Color.Z).ToFColor(true);
+    Vertex.UV0 = FVector2D(Info.UV);
+    Section.SectionLocalBox += Vertex.Position;
+  }
+  Section.ProcIndexBuffer.Reserve(Mesh.TriangleCount() * 3);
+  for (const int32 tid : Mesh.TriangleIndicesItr())
+  {
+    const FIndex3i Triangle = Mesh.GetTriangle(tid);
+    Section.ProcIndexBuffer.Add(Triangle.A);
+    Section.ProcIndexBuffer.Add(Triangle.B);
+    Section.ProcIndexBuffer.Add(Triangle.C);
+  }
+  Section.bEnableCollision = false;
+  Section.bSectionVisible = true;
+}
+
+TArray<FProcMeshSection> FMeshLODGenerator::BuildLODChain(const FProcMeshSection& Source, int32 NumLODs, float Reduction)
+{
+  TArray<FProcMeshSection> LODs;
+  LODs.Add(Source);
+  Reduction = FMath::Clamp(Reduction, 0.05f, 0.95f);
+  // tiny meshes do not benefit from reduction
+  constexpr int32 MinimumTriangles = 64;
+
+  FDynamicMesh3 Mesh;
+  SectionToDynamicMesh(Source, Mesh);
+  for (int32 LOD = 1; LOD < NumLODs; ++LOD)
+  {
+    const int32 Target = FMath::FloorToInt32(Mesh.TriangleCount() * Reduction);
+    if (Target < MinimumTriangles)
+    {
+      break;
+    }
+    // every LOD is simplified from its predecessor, which keeps the total cost close to that of the first reduction
+    FQEMSimplification Simplifier(&Mesh);
+    Simplifier.CollapseMode = FQEMSimplification::ESimplificationCollapseModes::MinimalQuadricPositionError;
+    Simplifier.SimplifyToTriangleCount(Target);
+    FMeshNormals::QuickComputeVertexNormals(Mesh);
+    FDynamicMesh3 Copy(Mesh);
+    DynamicMeshToSection(Copy, LODs.AddDefaulted_GetRef());
+  }
+  return LODs;
+}
+
+float FMeshLODGenerator::ComputeScreenSize(const FBoxSphereBounds& Bounds, const FVector& ViewOrigin, float FOVDegrees)
+{
+  const double Distance = FMath::Max(FVector::Dist(Bounds.Origin, ViewOrigin), 1.0);
+  // same as ComputeBoundsScreenSize of the engine, so the baked screen sizes switch at the same distances
+  const float ScreenMultiple = 0.5f / FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(FOVDegrees, 1.f, 170.f) * 0.5f));
+  return static_cast<float>(2.0 * ScreenMultiple * Bounds.SphereRadius / Distance);
+}
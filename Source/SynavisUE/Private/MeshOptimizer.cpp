@@ -0,0 +1,400 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "MeshOptimizer.h"
+
+#include "Async/ParallelFor.h"
+
+// triangles per independently optimised batch of a large index buffer
+static constexpr int32 CacheBatchTriangles = 1 << 16;
+
+// applies the permutation to every attribute that is present per vertex, Remap[old] = new or INDEX_NONE
+template<typename T>
+static void RemapAttribute(TArray<T>& Values, const TArray<int32>& Remap, int32 NumNew, int32 NumOld)
+{
+  if (Values.Num() != NumOld)
+  {
+    Values.Reset();
+    return;
+  }
+  TArray<T> Result;
+  Result.SetNumUninitialized(NumNew);
+  for (int32 v = 0; v < NumOld; ++v)
+  {
+    if (Remap[v] != INDEX_NONE)
+    {
+      Result[Remap[v]] = Values[v];
+    }
+  }
+  Values = MoveTemp(Result);
+}
+
+static void RemapGeometry(FGeometryPayload& Geometry, const TArray<int32>& Remap, int32 NumNew)
+{
+  const int32 NumOld = Geometry.Points.Num();
+  RemapAttribute(Geometry.Normals, Remap, NumNew, NumOld);
+  RemapAttribute(Geometry.UVs, Remap, NumNew, NumOld);
+  RemapAttribute(Geometry.Scalars, Remap, NumNew, NumOld);
+  RemapAttribute(Geometry.Tangents, Remap, NumNew, NumOld);
+  RemapAttribute(Geometry.Points, Remap, NumNew, NumOld);
+  for (int32& Index : Geometry.Triangles)
+  {
+    Index = Remap[Index];
+  }
+}
+
+int32 FMeshOptimizer::WeldVertices(FGeometryPayload& Geometry, float Epsilon)
+{
+  const int32 NumVertices = Geometry.Points.Num();
+  const bool bNormals = Geometry.Normals.Num() == NumVertices;
+  const bool bUVs = Geometry.UVs.Num() == NumVertices;
+  const bool bScalars = Geometry.Scalars.Num() == NumVertices;
+  const bool bTangents = Geometry.Tangents.Num() == NumVertices;
+
+  // all attributes but the position have to match exactly, they are hashed apart from it
+  // adding zero turns -0.0 into 0.0, which compare equal and so have to hash the same
+  TArray<uint32> AttributeHashes;
+  AttributeHashes.SetNumUninitialized(NumVertices);
+  // positions fall into cells of the weld grid, neighbours within Epsilon lie in the same or an adjacent cell
+  TArray<FIntVector> Cells;
+  if (Epsilon > 0.f)
+  {
+    Cells.SetNumUninitialized(NumVertices);
+  }
+  ParallelFor(NumVertices, [&](int32 v)
+    {
+      uint32 Hash = 0;
+      if (Epsilon > 0.f)
+      {
+        const FVector& P = Geometry.Points[v];
+        Cells[v] = FIntVector(FMath::FloorToInt32(P.X / Epsilon), FMath::FloorToInt32(P.Y / Epsilon), FMath::FloorToInt32(P.Z / Epsilon));
+      }
+      else
+      {
+        const FVector P = Geometry.Points[v] + FVector::ZeroVector;
+        Hash = FCrc::MemCrc32(&P, sizeof(FVector));
+      }
+      if (bNormals)
+      {
+        const FVector N = Geometry.Normals[v] + FVector::ZeroVector;
+        Hash = FCrc::MemCrc32(&N, sizeof(FVector), Hash);
+      }
+      if (bUVs)
+      {
+        const FVector2D UV = Geometry.UVs[v] + FVector2D::ZeroVector;
+        Hash = FCrc::MemCrc32(&UV, sizeof(FVector2D), Hash);
+      }
+      if (bScalars)
+      {
+        const float Scalar = Geometry.Scalars[v] + 0.f;
+        Hash = FCrc::MemCrc32(&Scalar, sizeof(float), Hash);
+      }
+      if (bTangents)
+      {
+        const FVector T = Geometry.Tangents[v].TangentX + FVector::ZeroVector;
+        Hash = FCrc::MemCrc32(&T, sizeof(FVector), Hash);
+      }
+      AttributeHashes[v] = Hash;
+    }, NumVertices < 65536);
+
+  auto Equal = [&](int32 a, int32 b)
+  {
+    if (Epsilon > 0.f ? !Geometry.Points[a].Equals(Geometry.Points[b], Epsilon) : Geometry.Points[a] != Geometry.Points[b])
+      return false;
+    if (bNormals && Geometry.Normals[a] != Geometry.Normals[b])
+      return false;
+    if (bUVs && Geometry.UVs[a] != Geometry.UVs[b])
+      return false;
+    if (bScalars && Geometry.Scalars[a] != Geometry.Scalars[b])
+      return false;
+    if (bTangents && (Geometry.Tangents[a].TangentX != Geometry.Tangents[b].TangentX || Geometry.Tangents[a].bFlipTangentY != Geometry.Tangents[b].bFlipTangentY))
+      return false;
+    return true;
+  };
+  auto SlotHash = [&](int32 v, const FIntVector& Cell)
+  {
+    return Epsilon > 0.f ? HashCombine(GetTypeHash(Cell), AttributeHashes[v]) : AttributeHashes[v];
+  };
+
+  // open addressing over the surviving vertices, the first vertex of each class survives
+  int32 TableSize = FMath::RoundUpToPowerOfTwo(FMath::Max(NumVertices * 2, 16));
+  TArray<int32> Table;
+  Table.Init(INDEX_NONE, TableSize);
+  TArray<uint32> TableHashes;
+  TableHashes.SetNumUninitialized(TableSize);
+  auto Find = [&](int32 v, const FIntVector& Cell) -> int32
+  {
+    const uint32 Hash = SlotHash(v, Cell);
+    for (uint32 Slot = Hash & (TableSize - 1); Table[Slot] != INDEX_NONE; Slot = (Slot + 1) & (TableSize - 1))
+    {
+      const int32 Other = Table[Slot];
+      if (TableHashes[Slot] == Hash && (Epsilon <= 0.f || Cells[Other] == Cell) && Equal(Other, v))
+      {
+        return Other;
+      }
+    }
+    return INDEX_NONE;
+  };
+  TArray<int32> Remap;
+  Remap.SetNumUninitialized(NumVertices);
+  int32 NumUnique = 0;
+  for (int32 v = 0; v < NumVertices; ++v)
+  {
+    const FIntVector Cell = Epsilon > 0.f ? Cells[v] : FIntVector::ZeroValue;
+    int32 Match = INDEX_NONE;
+    if (Epsilon > 0.f)
+    {
+      // a vertex within Epsilon may lie across a cell boundary, so the adjacent cells are searched as well
+      for (int32 i = 0; i < 27 && Match == INDEX_NONE; ++i)
+      {
+        Match = Find(v, Cell + FIntVector(i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1));
+      }
+    }
+    else
+    {
+      Match = Find(v, Cell);
+    }
+    if (Match != INDEX_NONE)
+    {
+      Remap[v] = Remap[Match];
+      continue;
+    }
+    const uint32 Hash = SlotHash(v, Cell);
+    uint32 Slot = Hash & (TableSize - 1);
+    while (Table[Slot] != INDEX_NONE)
+    {
+      Slot = (Slot + 1) & (TableSize - 1);
+    }
+    Table[Slot] = v;
+    TableHashes[Slot] = Hash;
+    Remap[v] = NumUnique++;
+  }
+  if (NumUnique == NumVertices)
+  {
+    return NumVertices;
+  }
+  RemapGeometry(Geometry, Remap, NumUnique);
+
+  // welding with a tolerance can collapse small triangles
+  TArray<int32>& Triangles = Geometry.Triangles;
+  int32 Write = 0;
+  for (int32 t = 0; t + 2 < Triangles.Num(); t += 3)
+  {
+    const int32 a = Triangles[t], b = Triangles[t + 1], c = Triangles[t + 2];
+    if (a != b && b != c && a != c)
+    {
+      Triangles[Write++] = a;
+      Triangles[Write++] = b;
+      Triangles[Write++] = c;
+    }
+  }
+  Triangles.SetNum(Write, false);
+  return NumUnique;
+}
+
+// Tipsify on an index buffer with vertex indices in [0, NumVertices)
+static void Tipsify(int32* Indices, int32 NumTriangles, int32 NumVertices, int32 CacheSize)
+{
+  // vertex to triangle adjacency in compressed rows
+  TArray<int32> Offsets, Adjacency, Live;
+  Offsets.SetNumZeroed(NumVertices + 1);
+  for (int32 i = 0; i < NumTriangles * 3; ++i)
+  {
+    ++Offsets[Indices[i] + 1];
+  }
+  for (int32 v = 0; v < NumVertices; ++v)
+  {
+    Offsets[v + 1] += Offsets[v];
+  }
+  Live.SetNumUninitialized(NumVertices);
+  for (int32 v = 0; v < NumVertices; ++v)
+  {
+    Live[v] = Offsets[v + 1] - Offsets[v];
+  }
+  Adjacency.SetNumUninitialized(NumTriangles * 3);
+  {
+    TArray<int32> Fill(Offsets.GetData(), NumVertices);
+    for (int32 i = 0; i < NumTriangles * 3; ++i)
+    {
+      Adjacency[Fill[Indices[i]]++] = i / 3;
+    }
+  }
+
+  TArray<int32> CacheTime, DeadEnd, Candidates, Output;
+  CacheTime.SetNumZeroed(NumVertices);
+  TBitArray<> Emitted(false, NumTriangles);
+  Output.Reserve(NumTriangles * 3);
+  int32 Time = CacheSize + 1;
+  int32 Cursor = 0;
+  int32 Fanning = 0;
+  while (Fanning >= 0)
+  {
+    Candidates.Reset();
+    for (int32 a = Offsets[Fanning]; a < Offsets[Fanning + 1]; ++a)
+    {
+      const int32 t = Adjacency[a];
+      if (Emitted[t])
+      {
+        continue;
+      }
+      for (int32 k = 0; k < 3; ++k)
+      {
+        const int32 v = Indices[3 * t + k];
+        Output.Add(v);
+        DeadEnd.Add(v);
+        Candidates.Add(v);
+        --Live[v];
+        if (Time - CacheTime[v] > CacheSize)
+        {
+          CacheTime[v] = Time++;
+        }
+      }
+      Emitted[t] = true;
+    }
+    // prefer the vertex that stays longest in the cache while its remaining triangles are emitted
+    int32 Next = INDEX_NONE, Best = -1;
+    for (const int32 v : Candidates)
+    {
+      if (Live[v] > 0)
+      {
+        int32 Priority = 0;
+        if (Time - CacheTime[v] + 2 * Live[v] <= CacheSize)
+        {
+          Priority = Time - CacheTime[v];
+        }
+        if (Priority > Best)
+        {
+          Best = Priority;
+          Next = v;
+        }
+      }
+    }
+    if (Next == INDEX_NONE)
+    {
+      while (DeadEnd.Num() > 0)
+      {
+        const int32 v = DeadEnd.Pop(false);
+        if (Live[v] > 0)
+        {
+          Next = v;
+          break;
+        }
+      }
+      while (Next == INDEX_NONE && Cursor < NumVertices)
+      {
+        if (Live[Cursor] > 0)
+        {
+          Next = Cursor;
+        }
+        ++Cursor;
+      }
+    }
+    Fanning = Next;
+  }
+  FMemory::Memcpy(Indices, Output.GetData(), Output.Num() * sizeof(int32));
+}
+
+void FMeshOptimizer::OptimizeVertexCache(TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize)
+{
+  const int32 NumTriangles = Triangles.Num() / 3;
+  if (NumTriangles == 0)
+  {
+    return;
+  }
+  if (NumTriangles <= CacheBatchTriangles)
+  {
+    Tipsify(Triangles.GetData(), NumTriangles, NumVertices, CacheSize);
+    return;
+  }
+  // batches follow the incoming order, so each one only sees its local vertices
+  ParallelFor(FMath::DivideAndRoundUp(NumTriangles, CacheBatchTriangles), [&](int32 Batch)
+    {
+      const int32 First = Batch * CacheBatchTriangles;
+      const int32 Count = FMath::Min(CacheBatchTriangles, NumTriangles - First);
+      int32* Indices = Triangles.GetData() + First * 3;
+      TMap<int32, int32> Local;
+      TArray<int32> Global;
+      TArray<int32> LocalIndices;
+      LocalIndices.SetNumUninitialized(Count * 3);
+      for (int32 i = 0; i < Count * 3; ++i)
+      {
+        int32* Found = Local.Find(Indices[i]);
+        LocalIndices[i] = Found ? *Found : Local.Add(Indices[i], Global.Add(Indices[i]));
+      }
+      Tipsify(LocalIndices.GetData(), Count, Global.Num(), CacheSize);
+      for (int32 i = 0; i < Count * 3; ++i)
+      {
+        Indices[i] = Global[LocalIndices[i]];
+      }
+    });
+}
+
+void FMeshOptimizer::OptimizeVertexFetch(FGeometryPayload& Geometry)
+{
+  const int32 NumVertices = Geometry.Points.Num();
+  TArray<int32> Remap;
+  Remap.Init(INDEX_NONE, NumVertices);
+  int32 Next = 0;
+  for (const int32 Index : Geometry.Triangles)
+  {
+    if (Remap[Index] == INDEX_NONE)
+    {
+      Remap[Index] = Next++;
+    }
+  }
+  RemapGeometry(Geometry, Remap, Next);
+}
+
+float FMeshOptimizer::ComputeACMR(const TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize)
+{
+  const int32 NumTriangles = Triangles.Num() / 3;
+  if (NumTriangles == 0)
+  {
+    return 0.f;
+  }
+  // a vertex is in the FIFO cache if fewer than CacheSize misses happened since it was loaded
+  TArray<int32> LoadedAt;
+  LoadedAt.Init(TNumericLimits<int32>::Min() / 2, NumVertices);
+  int32 Misses = 0;
+  for (int32 i = 0; i < NumTriangles * 3; ++i)
+  {
+    const int32 v = Triangles[i];
+    if (Misses - LoadedAt[v] >= CacheSize)
+    {
+      LoadedAt[v] = Misses++;
+    }
+  }
+  return static_cast<float>(Misses) / NumTriangles;
+}
+
+bool FMeshOptimizer::HasValidIndices(const TArray<int32>& Triangles, int32 NumVertices)
+{
+  for (const int32 Index : Triangles)
+  {
+    if (Index < 0 || Index >= NumVertices)
+    {
+      UE_LOG(LogTemp, Warning, TEXT("Index %d is out of range of %d vertices"), Index, NumVertices);
+      return false;
+    }
+  }
+  return true;
+}
+
+FMeshOptimizationStats FMeshOptimizer::Optimize(FGeometryPayload& Geometry, float WeldEpsilon, int32 CacheSize)
+{
+  FMeshOptimizationStats Stats;
+  Stats.VerticesBefore = Geometry.Points.Num();
+  // indices outside of the vertex range would break every pass below
+  if (!HasValidIndices(Geometry.Triangles, Geometry.Points.Num()))
+  {
+    Stats.VerticesAfter = Stats.VerticesBefore;
+    return Stats;
+  }
+  Geometry.Triangles.SetNum(Geometry.Triangles.Num() / 3 * 3, false);
+  Stats.ACMRBefore = ComputeACMR(Geometry.Triangles, Geometry.Points.Num(), CacheSize);
+  WeldVertices(Geometry, WeldEpsilon);
+  OptimizeVertexCache(Geometry.Triangles, Geometry.Points.Num(), CacheSize);
+  OptimizeVertexFetch(Geometry);
+  Stats.VerticesAfter = Geometry.Points.Num();
+  Stats.ACMRAfter = ComputeACMR(Geometry.Triangles, Geometry.Points.Num(), CacheSize);
+  return Stats;
+}
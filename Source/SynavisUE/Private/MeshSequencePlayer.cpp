@@ -0,0 +1,251 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "MeshSequencePlayer.h"
+
+#include "ProceduralMeshComponent.h"
+#include "GeometryCache.h"
+#include "Colormap.h"
+#include "MeshSplitter.h"
+#include "GeometryImporter.h"
+
+// frames are cache hashes or files of any format the importer registry reads
+static bool LoadFrame(const FString& Source, FGeometryCache* Cache, FGeometryPayload& Out)
+{
+  if (Cache && FGeometryCache::IsValidHash(Source) && Cache->Load(Source.ToLower(), Out))
+  {
+    return true;
+  }
+  FString Error;
+  if (!FGeometryImporterRegistry::Get().ImportFile(Source, FGeometryImportOptions(), Out, Error))
+  {
+    UE_LOG(LogTemp, Warning, TEXT("%s"), *Error);
+    return false;
+  }
+  return true;
+}
+
+AMeshSequencePlayer::AMeshSequencePlayer()
+{
+  PrimaryActorTick.bCanEverTick = true;
+}
+
+void AMeshSequencePlayer::SetFrames(const TArray<FString>& InFrames, TSharedPtr<FGeometryCache, ESPMode::ThreadSafe> InCache)
+{
+  ++Generation;
+  Frames = InFrames;
+  Cache = InCache;
+  ProcMesh->ClearAllMeshSections();
+  ActiveRingSize = FMath::Clamp(RingSize, 1, FMath::Max(1, Frames.Num()));
+  SlotFrames.Init(INDEX_NONE, ActiveRingSize);
+  SlotReady.Init(false, ActiveRingSize);
+  DisplayedFrame = INDEX_NONE;
+  RequestedFrame = Frames.Num() > 0 ? 0 : INDEX_NONE;
+  Accumulator = 0.f;
+  Stalls = 0;
+  bStalled = false;
+  FillRing();
+}
+
+bool AMeshSequencePlayer::Step()
+{
+  if (Frames.Num() == 0)
+  {
+    return false;
+  }
+  if (RequestedFrame != DisplayedFrame)
+  {
+    NoteStall();
+    return false;
+  }
+  int32 Next = DisplayedFrame + 1;
+  if (Next >= Frames.Num())
+  {
+    if (!Loop)
+    {
+      return false;
+    }
+    Next = 0;
+  }
+  RequestedFrame = Next;
+  TryShowRequested();
+  FillRing();
+  return RequestedFrame == DisplayedFrame;
+}
+
+bool AMeshSequencePlayer::Seek(int32 Frame)
+{
+  if (!Frames.IsValidIndex(Frame))
+  {
+    return false;
+  }
+  RequestedFrame = Frame;
+  TryShowRequested();
+  FillRing();
+  return RequestedFrame == DisplayedFrame;
+}
+
+bool AMeshSequencePlayer::IsInWindow(int32 Frame) const
+{
+  if (RequestedFrame == INDEX_NONE)
+  {
+    return false;
+  }
+  int32 Distance = Frame - RequestedFrame;
+  if (Distance < 0 && Loop)
+  {
+    Distance += Frames.Num();
+  }
+  return Distance >= 0 && Distance < ActiveRingSize;
+}
+
+int32 AMeshSequencePlayer::FindFreeSlot() const
+{
+  int32 Free = INDEX_NONE;
+  for (int32 Slot = 0; Slot < SlotFrames.Num(); ++Slot)
+  {
+    const int32 Frame = SlotFrames[Slot];
+    if (Frame == INDEX_NONE)
+    {
+      return Slot;
+    }
+    if (Free == INDEX_NONE && Frame != DisplayedFrame && !IsInWindow(Frame))
+    {
+      Free = Slot;
+    }
+  }
+  return Free;
+}
+
+void AMeshSequencePlayer::NoteStall()
+{
+  if (!bStalled)
+  {
+    bStalled = true;
+    ++Stalls;
+  }
+}
+
+void AMeshSequencePlayer::FillRing()
+{
+  if (RequestedFrame == INDEX_NONE)
+  {
+    return;
+  }
+  for (int32 Ahead = 0; Ahead < ActiveRingSize; ++Ahead)
+  {
+    int32 Frame = RequestedFrame + Ahead;
+    if (Frame >= Frames.Num())
+    {
+      if (!Loop)
+      {
+        break;
+      }
+      Frame -= Frames.Num();
+    }
+    if (GetSlot(Frame) != INDEX_NONE)
+    {
+      continue;
+    }
+    // the visible section is only replaced once another frame is shown, the rest of the window waits until then
+    const int32 Slot = FindFreeSlot();
+    if (Slot == INDEX_NONE)
+    {
+      break;
+    }
+    SlotFrames[Slot] = Frame;
+    SlotReady[Slot] = false;
+    TWeakObjectPtr<AMeshSequencePlayer> WeakThis(this);
+    const FColormap* Map = FColormap::Find(Colormap);
+    FFunctionGraphTask::CreateAndDispatchWhenReady(
+      [WeakThis, Source = Frames[Frame], Cache = Cache, Frame, Slot, FrameGeneration = Generation, Map, Range = ScalarRange]()
+      {
+        FGeometryPayload Payload;
+        FProcMeshSection Section;
+        if (LoadFrame(Source, Cache.Get(), Payload))
+        {
+          TArray<FColor> Colors;
+          if (Map && Payload.Scalars.Num() == Payload.Points.Num())
+          {
+            Map->Map(Payload.Scalars, Range.X, Range.Y, Colors);
+          }
+          // without a vertex limit the splitter only assembles the single section
+          auto Sections = FMeshSplitter::Split(Payload.Points, Payload.Triangles, Payload.Normals, Payload.UVs, Colors, Payload.Tangents, 0, false);
+          if (Sections.Num() > 0)
+          {
+            Section = MoveTemp(Sections[0]);
+          }
+        }
+        else
+        {
+          UE_LOG(LogTemp, Warning, TEXT("Could not load sequence frame %s"), *Source);
+        }
+        FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Frame, Slot, FrameGeneration, Section = MoveTemp(Section)]()
+          {
+            if (WeakThis.IsValid())
+            {
+              WeakThis->OnFrameDecoded(Frame, Slot, FrameGeneration, Section);
+            }
+          }, TStatId(), nullptr, ENamedThreads::GameThread);
+      }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+  }
+}
+
+void AMeshSequencePlayer::OnFrameDecoded(int32 Frame, int32 Slot, int32 FrameGeneration, const FProcMeshSection& Section)
+{
+  // a seek can hand the slot to another frame while this one was still decoding
+  if (FrameGeneration != Generation || SlotFrames[Slot] != Frame)
+  {
+    return;
+  }
+  ProcMesh->SetProcMeshSection(Slot, Section);
+  ProcMesh->SetMeshSectionVisible(Slot, false);
+  ProcMesh->SetMaterial(Slot, Material);
+  SlotReady[Slot] = true;
+  TryShowRequested();
+}
+
+void AMeshSequencePlayer::TryShowRequested()
+{
+  if (RequestedFrame == DisplayedFrame || RequestedFrame == INDEX_NONE)
+  {
+    return;
+  }
+  const int32 Slot = GetSlot(RequestedFrame);
+  if (Slot == INDEX_NONE || !SlotReady[Slot])
+  {
+    return;
+  }
+  if (DisplayedFrame != INDEX_NONE)
+  {
+    ProcMesh->SetMeshSectionVisible(GetSlot(DisplayedFrame), false);
+  }
+  ProcMesh->SetMeshSectionVisible(Slot, true);
+  DisplayedFrame = RequestedFrame;
+  bStalled = false;
+  // the slot of the previous frame is free now
+  FillRing();
+}
+
+void AMeshSequencePlayer::Tick(float DeltaTime)
+{
+  Super::Tick(DeltaTime);
+  if (FrameRate <= 0.f || Frames.Num() == 0)
+  {
+    return;
+  }
+  const float Period = 1.f / FrameRate;
+  Accumulator += DeltaTime;
+  if (Accumulator < Period)
+  {
+    return;
+  }
+  // a stalled frame is shown late instead of being skipped
+  if (RequestedFrame != DisplayedFrame)
+  {
+    NoteStall();
+    return;
+  }
+  // a long hitch does not let the backlog pile up
+  Accumulator = FMath::Min(Accumulator - Period, Period);
+  Step();
+}
@@ -0,0 +1,138 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "MeshSplitter.h"
+#include "MeshOptimizer.h"
+
+#include "Async/ParallelFor.h"
+
+#include <algorithm>
+
+// contiguous range of the triangle order that forms one node of the hierarchy
+struct FSplitRange
+{
+  int32 Begin;
+  int32 End;
+};
+
+static FProcMeshVertex MakeVertex(int32 Index, const TArray<FVector>& Points, const TArray<FVector>& Normals,
+  const TArray<FVector2D>& UVs, const TArray<FColor>& Colors, const TArray<FProcMeshTangent>& Tangents)
+{
+  FProcMeshVertex Vertex;
+  Vertex.Position = Points[Index];
+  Vertex.Normal = Normals.IsValidIndex(Index) ? Normals[Index] : FVector(0, 0, 1);
+  Vertex.UV0 = UVs.IsValidIndex(Index) ? UVs[Index] : FVector2D::ZeroVector;
+  Vertex.Color = Colors.IsValidIndex(Index) ? Colors[Index] : FColor::White;
+  Vertex.Tangent = Tangents.IsValidIndex(Index) ? Tangents[Index] : FProcMeshTangent(FVector(1, 0, 0), false);
+  return Vertex;
+}
+
+TArray<FProcMeshSection> FMeshSplitter::Split(const TArray<FVector>& Points, const TArray<int32>& Triangles,
+  const TArray<FVector>& Normals, const TArray<FVector2D>& UVs, const TArray<FColor>& Colors,
+  const TArray<FProcMeshTangent>& Tangents, int32 MaxVertices, bool bEnableCollision)
+{
+  TArray<FProcMeshSection> Sections;
+  const int32 NumTriangles = Triangles.Num() / 3;
+  if (!FMeshOptimizer::HasValidIndices(Triangles, Points.Num()))
+  {
+    return Sections;
+  }
+
+  if (MaxVertices <= 0 || Points.Num() <= MaxVertices || NumTriangles < 2)
+  {
+    FProcMeshSection& Section = Sections.AddDefaulted_GetRef();
+    Section.ProcVertexBuffer.SetNumUninitialized(Points.Num());
+    for (int32 i = 0; i < Points.Num(); ++i)
+    {
+      Section.ProcVertexBuffer[i] = MakeVertex(i, Points, Normals, UVs, Colors, Tangents);
+      Section.SectionLocalBox += Points[i];
+    }
+    Section.ProcIndexBuffer.SetNumUninitialized(NumTriangles * 3);
+    FMemory::Memcpy(Section.ProcIndexBuffer.GetData(), Triangles.GetData(), NumTriangles * 3 * sizeof(int32));
+    Section.bEnableCollision = bEnableCollision;
+    return Sections;
+  }
+
+  TArray<FVector3f> Centroids;
+  Centroids.SetNumUninitialized(NumTriangles);
+  ParallelFor(NumTriangles, [&](int32 t)
+    {
+      Centroids[t] = FVector3f(Points[Triangles[3 * t]] + Points[Triangles[3 * t + 1]] + Points[Triangles[3 * t + 2]]) / 3.f;
+    }, NumTriangles < 65536);
+  TArray<int32> Order;
+  Order.SetNumUninitialized(NumTriangles);
+  for (int32 t = 0; t < NumTriangles; ++t)
+  {
+    Order[t] = t;
+  }
+
+  // median splits along the longest axis of the centroid bounds until every range references few enough vertices
+  // counting distinct vertices with a visit stamp keeps this linear in the size of each range
+  TArray<int32> Stamp;
+  Stamp.Init(-1, Points.Num());
+  int32 Visit = 0;
+  TArray<FSplitRange> Leaves;
+  TArray<FSplitRange> Stack;
+  Stack.Add({ 0, NumTriangles });
+  while (Stack.Num() > 0)
+  {
+    const FSplitRange Range = Stack.Pop(false);
+    ++Visit;
+    int32 UniqueVertices = 0;
+    FBox3f CentroidBounds(ForceInit);
+    for (int32 i = Range.Begin; i < Range.End; ++i)
+    {
+      const int32 t = Order[i];
+      CentroidBounds += Centroids[t];
+      for (int32 k = 0; k < 3; ++k)
+      {
+        const int32 v = Triangles[3 * t + k];
+        if (Stamp[v] != Visit)
+        {
+          Stamp[v] = Visit;
+          ++UniqueVertices;
+        }
+      }
+    }
+    const FVector3f Extent = CentroidBounds.GetSize();
+    const int32 Axis = (Extent.X >= Extent.Y && Extent.X >= Extent.Z) ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+    // coincident centroids cannot be separated spatially, such ranges stay oversized
+    if (UniqueVertices <= MaxVertices || Range.End - Range.Begin < 2 || Extent[Axis] <= 0.f)
+    {
+      Leaves.Add(Range);
+      continue;
+    }
+    const int32 Middle = Range.Begin + (Range.End - Range.Begin) / 2;
+    std::nth_element(Order.GetData() + Range.Begin, Order.GetData() + Middle, Order.GetData() + Range.End,
+      [&Centroids, Axis](int32 a, int32 b) { return Centroids[a][Axis] < Centroids[b][Axis]; });
+    Stack.Add({ Range.Begin, Middle });
+    Stack.Add({ Middle, Range.End });
+  }
+
+  Sections.SetNum(Leaves.Num());
+  ParallelFor(Leaves.Num(), [&](int32 Leaf)
+    {
+      const FSplitRange& Range = Leaves[Leaf];
+      FProcMeshSection& Section = Sections[Leaf];
+      TMap<int32, uint32> Remap;
+      Remap.Reserve(FMath::Min(MaxVertices, (Range.End - Range.Begin) * 3));
+      Section.ProcIndexBuffer.Reserve((Range.End - Range.Begin) * 3);
+      for (int32 i = Range.Begin; i < Range.End; ++i)
+      {
+        const int32 t = Order[i];
+        for (int32 k = 0; k < 3; ++k)
+        {
+          const int32 v = Triangles[3 * t + k];
+          uint32* Local = Remap.Find(v);
+          if (!Local)
+          {
+            Local = &Remap.Add(v, Section.ProcVertexBuffer.Num());
+            Section.ProcVertexBuffer.Add(MakeVertex(v, Points, Normals, UVs, Colors, Tangents));
+            Section.SectionLocalBox += Points[v];
+          }
+          Section.ProcIndexBuffer.Add(*Local);
+        }
+      }
+      Section.bEnableCollision = bEnableCollision;
+    });
+  return Sections;
+}
@@ -0,0 +1,617 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "PointCloud.h"
+
+#include "Colormap.h"
+#include "Async/ParallelFor.h"
+#include "Algo/Sort.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// depth of the point codes, 21 bits per axis fill a 64 bit code
+static constexpr int32 MaxDepth = 21;
+static constexpr int64 ReadBlockSize = 1 << 20;
+// deepest level at which buckets are built independently, 8^5 buckets keep the per block histograms small
+static constexpr int32 MaxBucketDepth = 5;
+static constexpr uint32 IndexMagic = 0x4c435053; // "SPCL"
+static constexpr uint32 IndexVersion = 1;
+
+struct FPointCloudIndexHeader
+{
+  uint32 Magic;
+  uint32 Version;
+  int64 NumPoints;
+  int32 NumNodes;
+  int32 NodeSize;
+};
+
+bool FPointCloudLayout::FromFormat(const FString& Format, bool bDouble, FPointCloudLayout& Out)
+{
+  const FString Name = Format.ToLower();
+  const int32 PositionBytes = bDouble ? 24 : 12;
+  Out = FPointCloudLayout();
+  Out.bDoublePositions = bDouble;
+  if (Name == TEXT("xyz"))
+  {
+    Out.Stride = PositionBytes;
+  }
+  else if (Name == TEXT("xyzrgb"))
+  {
+    Out.ColorOffset = PositionBytes;
+    Out.Stride = PositionBytes + 3;
+  }
+  else if (Name == TEXT("xyzi"))
+  {
+    Out.IntensityOffset = PositionBytes;
+    Out.Stride = PositionBytes + 4;
+  }
+  else if (Name == TEXT("xyzirgb"))
+  {
+    Out.IntensityOffset = PositionBytes;
+    Out.ColorOffset = PositionBytes + 4;
+    Out.Stride = PositionBytes + 7;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+static uint64 SpreadBits(uint32 Value)
+{
+  uint64 x = Value & 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+
+static uint32 CompactBits(uint64 x)
+{
+  x &= 0x1249249249249249ull;
+  x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3ull;
+  x = (x ^ (x >> 4)) & 0x100f00f00f00f00full;
+  x = (x ^ (x >> 8)) & 0x1f0000ff0000ffull;
+  x = (x ^ (x >> 16)) & 0x1f00000000ffffull;
+  x = (x ^ (x >> 32)) & 0x1fffffull;
+  return static_cast<uint32>(x);
+}
+
+namespace
+{
+  struct FKeyedPoint
+  {
+    uint64 Code;
+    FCloudPoint Point;
+  };
+
+  // reads records straight from the mapped input and places them in the cube of the octree
+  struct FRecordReader
+  {
+    const uint8* Records;
+    FPointCloudLayout Layout;
+    const FColormap* Map;
+    float IntensityMin, IntensityScale;
+    FVector3f CubeMin;
+    float CodeScale;
+
+    FVector3f Position(int64 i) const
+    {
+      const uint8* Record = Records + i * Layout.Stride;
+      if (Layout.bDoublePositions)
+      {
+        double p[3];
+        FMemory::Memcpy(p, Record, sizeof(p));
+        return FVector3f(p[0], p[1], p[2]);
+      }
+      FVector3f p;
+      FMemory::Memcpy(&p, Record, sizeof(float) * 3);
+      return p;
+    }
+
+    float Intensity(int64 i) const
+    {
+      float Value;
+      FMemory::Memcpy(&Value, Records + i * Layout.Stride + Layout.IntensityOffset, sizeof(float));
+      return Value;
+    }
+
+    FKeyedPoint Read(int64 i) const
+    {
+      FKeyedPoint Out;
+      Out.Point.Position = Position(i);
+      if (Layout.ColorOffset != INDEX_NONE)
+      {
+        const uint8* Color = Records + i * Layout.Stride + Layout.ColorOffset;
+        Out.Point.Color = FColor(Color[0], Color[1], Color[2]);
+      }
+      else if (Layout.IntensityOffset != INDEX_NONE && Map)
+      {
+        Out.Point.Color = Map->Sample((Intensity(i) - IntensityMin) * IntensityScale);
+      }
+      else
+      {
+        Out.Point.Color = FColor::White;
+      }
+      Out.Code = Code(Out.Point.Position);
+      return Out;
+    }
+
+    uint64 Code(const FVector3f& p) const
+    {
+      const FVector3f Cell = (p - CubeMin) * CodeScale;
+      const uint32 x = static_cast<uint32>(FMath::Clamp(Cell.X, 0.f, float((1 << MaxDepth) - 1)));
+      const uint32 y = static_cast<uint32>(FMath::Clamp(Cell.Y, 0.f, float((1 << MaxDepth) - 1)));
+      const uint32 z = static_cast<uint32>(FMath::Clamp(Cell.Z, 0.f, float((1 << MaxDepth) - 1)));
+      return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+    }
+  };
+
+  struct FLocalNode
+  {
+    int32 Level;
+    uint64 Key;
+    int64 First = 0;
+    int32 Count = 0;
+    int32 Children[8] = { INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE };
+  };
+
+  // subtree of one bucket with its points in node order, plus the shares it hands to the nodes above the buckets
+  struct FBucketResult
+  {
+    TArray<FCloudPoint> Ordered;
+    TArray<FLocalNode> Nodes;
+    TArray<TArray<FCloudPoint>> Upper;
+  };
+}
+
+// moves an even subsample of Count points of the Morton ordered range to Sink, the rest is compacted in order
+static int64 TakeSample(FKeyedPoint* Points, int64 Num, int64 Count, TArray<FCloudPoint>& Sink)
+{
+  Count = FMath::Min(Count, Num);
+  int64 Write = 0;
+  int64 Taken = 0;
+  int64 NextSample = Count > 0 ? Num / (2 * Count) : Num;
+  for (int64 i = 0; i < Num; ++i)
+  {
+    if (Taken < Count && i == NextSample)
+    {
+      Sink.Add(Points[i].Point);
+      ++Taken;
+      NextSample = (2 * Taken + 1) * Num / (2 * Count);
+    }
+    else
+    {
+      Points[Write++] = Points[i];
+    }
+  }
+  return Write;
+}
+
+static int32 BuildLocal(FKeyedPoint* Points, int64 Num, int32 Level, uint64 Key, FBucketResult& Out)
+{
+  const int32 Index = Out.Nodes.AddDefaulted();
+  Out.Nodes[Index].Level = Level;
+  Out.Nodes[Index].Key = Key;
+  Out.Nodes[Index].First = Out.Ordered.Num();
+  if (Num <= FPointCloud::LeafCapacity || Level >= MaxDepth)
+  {
+    for (int64 i = 0; i < Num; ++i)
+    {
+      Out.Ordered.Add(Points[i].Point);
+    }
+    Out.Nodes[Index].Count = static_cast<int32>(Num);
+    return Index;
+  }
+  const int64 Remaining = TakeSample(Points, Num, FPointCloud::NodeCapacity, Out.Ordered);
+  Out.Nodes[Index].Count = static_cast<int32>(Num - Remaining);
+  // the points are sorted by code, so the points of every child are contiguous
+  const int32 Shift = 3 * (MaxDepth - 1 - Level);
+  int64 Start = 0;
+  while (Start < Remaining)
+  {
+    const uint32 Digit = (Points[Start].Code >> Shift) & 7;
+    int64 End = Start + 1;
+    while (End < Remaining && ((Points[End].Code >> Shift) & 7) == Digit)
+    {
+      ++End;
+    }
+    const int32 Child = BuildLocal(Points + Start, End - Start, Level + 1, (Key << 3) | Digit, Out);
+    Out.Nodes[Index].Children[Digit] = Child;
+    Start = End;
+  }
+  return Index;
+}
+
+static FBox GetCellBounds(const FVector& CubeMin, double CubeSize, int32 Level, uint64 Key)
+{
+  const double Cell = CubeSize / static_cast<double>(1ull << Level);
+  const FVector Min = CubeMin + FVector(CompactBits(Key), CompactBits(Key >> 1), CompactBits(Key >> 2)) * Cell;
+  return FBox(Min, Min + FVector(Cell));
+}
+
+static bool WritePoints(IFileHandle* Writer, const TArray<FCloudPoint>& Points)
+{
+  return Points.Num() == 0 || Writer->Write(reinterpret_cast<const uint8*>(Points.GetData()), Points.Num() * sizeof(FCloudPoint));
+}
+
+TSharedPtr<FPointCloud, ESPMode::ThreadSafe> FPointCloud::Build(const FString& FileName, const FPointCloudLayout& Layout, const FString& CacheDirectory,
+  const FString& Colormap, FVector2D IntensityRange, FString& Error, int64 GroupPoints)
+{
+  FMappedFile Input;
+  if (!Input.Open(FileName))
+  {
+    Error = FString::Printf(TEXT("could not read %s"), *FileName);
+    return nullptr;
+  }
+  if (Layout.HeaderBytes < 0 || Layout.HeaderBytes > Input.Num())
+  {
+    Error = FString::Printf(TEXT("%s is shorter than its header of %d bytes"), *FileName, Layout.HeaderBytes);
+    return nullptr;
+  }
+  // a bucket is held in one array, so a pass never holds more than int32 points
+  GroupPoints = FMath::Clamp<int64>(GroupPoints, 1, MAX_int32);
+  const int64 NumRecords = Layout.Stride > 0 ? (Input.Num() - Layout.HeaderBytes) / Layout.Stride : 0;
+  if (NumRecords <= 0)
+  {
+    Error = FString::Printf(TEXT("%s holds no points"), *FileName);
+    return nullptr;
+  }
+
+  // a build is reused as long as the input and the way it is read stay the same
+  IFileManager& FileManager = IFileManager::Get();
+  const FString Key = FString::Printf(TEXT("%s|%s|%lld|%d|%d|%d|%d|%d|%s|%f|%f"), *FPaths::ConvertRelativePathToFull(FileName),
+    *FileManager.GetTimeStamp(*FileName).ToString(), Input.Num(), Layout.Stride, Layout.HeaderBytes, Layout.bDoublePositions ? 1 : 0,
+    Layout.ColorOffset, Layout.IntensityOffset, *Colormap, IntensityRange.X, IntensityRange.Y);
+  const FString Base = CacheDirectory / FString::Printf(TEXT("%s_%08x"), *FPaths::GetBaseFilename(FileName), FCrc::StrCrc32(*Key));
+  const FString IndexFile = Base + TEXT(".spci");
+  const FString PointFile = Base + TEXT(".spcp");
+  if (FileManager.FileExists(*IndexFile) && FileManager.FileExists(*PointFile))
+  {
+    FString OpenError;
+    if (auto Existing = Open(IndexFile, PointFile, OpenError))
+    {
+      return Existing;
+    }
+    UE_LOG(LogTemp, Warning, TEXT("Rebuilding point cloud %s: %s"), *FileName, *OpenError);
+  }
+  FileManager.MakeDirectory(*CacheDirectory, true);
+
+  FRecordReader Reader;
+  Reader.Records = Input.GetData() + Layout.HeaderBytes;
+  Reader.Layout = Layout;
+  Reader.Map = FColormap::Find(Colormap);
+  const int32 NumBlocks = static_cast<int32>(FMath::DivideAndRoundUp(NumRecords, ReadBlockSize));
+  auto BlockRange = [NumRecords](int32 Block) { return TPair<int64, int64>(Block * ReadBlockSize, FMath::Min(NumRecords, (Block + 1) * ReadBlockSize)); };
+
+  // first pass: bounds and intensity range
+  TArray<FBox3f> BlockBounds;
+  TArray<FVector2f> BlockIntensity;
+  BlockBounds.Init(FBox3f(ForceInit), NumBlocks);
+  BlockIntensity.Init(FVector2f(TNumericLimits<float>::Max(), TNumericLimits<float>::Lowest()), NumBlocks);
+  ParallelFor(NumBlocks, [&](int32 Block)
+    {
+      const auto Range = BlockRange(Block);
+      for (int64 i = Range.Key; i < Range.Value; ++i)
+      {
+        BlockBounds[Block] += Reader.Position(i);
+        if (Layout.IntensityOffset != INDEX_NONE)
+        {
+          const float Value = Reader.Intensity(i);
+          BlockIntensity[Block].X = FMath::Min(BlockIntensity[Block].X, Value);
+          BlockIntensity[Block].Y = FMath::Max(BlockIntensity[Block].Y, Value);
+        }
+      }
+    });
+  FBox3f Bounds(ForceInit);
+  FVector2f Intensity(TNumericLimits<float>::Max(), TNumericLimits<float>::Lowest());
+  for (int32 Block = 0; Block < NumBlocks; ++Block)
+  {
+    Bounds += BlockBounds[Block];
+    Intensity.X = FMath::Min(Intensity.X, BlockIntensity[Block].X);
+    Intensity.Y = FMath::Max(Intensity.Y, BlockIntensity[Block].Y);
+  }
+  if (IntensityRange.X < IntensityRange.Y)
+  {
+    Intensity = FVector2f(IntensityRange);
+  }
+  Reader.IntensityMin = Intensity.X;
+  Reader.IntensityScale = (Intensity.Y > Intensity.X) ? 1.f / (Intensity.Y - Intensity.X) : 0.f;
+  const float CubeSize = FMath::Max(Bounds.GetExtent().GetMax() * 2.f * 1.0001f, 1e-3f);
+  Reader.CubeMin = Bounds.GetCenter() - FVector3f(CubeSize * 0.5f);
+  Reader.CodeScale = static_cast<float>(1 << MaxDepth) / CubeSize;
+
+  // second pass: points per bucket, buckets are the cells at a fixed depth that are built independently
+  // the depth grows while a bucket does not fit into the points of one pass
+  int32 BucketDepth = (NumRecords <= LeafCapacity) ? 0
+    : FMath::Min(4, 1 + FMath::FloorToInt(FMath::LogX(8.0, static_cast<double>(NumRecords) / LeafCapacity)));
+  int32 NumBuckets = 0;
+  int32 BucketShift = 0;
+  TArray<TArray<int32>> BlockHistograms;
+  TArray<int64> BucketCounts;
+  while (true)
+  {
+    NumBuckets = 1 << (3 * BucketDepth);
+    BucketShift = 3 * (MaxDepth - BucketDepth);
+    BlockHistograms.Reset();
+    BlockHistograms.SetNum(NumBlocks);
+    ParallelFor(NumBlocks, [&](int32 Block)
+      {
+        TArray<int32>& Histogram = BlockHistograms[Block];
+        Histogram.SetNumZeroed(NumBuckets);
+        const auto Range = BlockRange(Block);
+        for (int64 i = Range.Key; i < Range.Value; ++i)
+        {
+          ++Histogram[Reader.Code(Reader.Position(i)) >> BucketShift];
+        }
+      });
+    BucketCounts.Reset();
+    BucketCounts.SetNumZeroed(NumBuckets);
+    int64 Largest = 0;
+    for (int32 b = 0; b < NumBuckets; ++b)
+    {
+      for (const TArray<int32>& Histogram : BlockHistograms)
+      {
+        BucketCounts[b] += Histogram[b];
+      }
+      Largest = FMath::Max(Largest, BucketCounts[b]);
+    }
+    if (Largest <= GroupPoints)
+    {
+      break;
+    }
+    if (BucketDepth >= MaxBucketDepth)
+    {
+      // points this dense are mostly duplicates, which no deeper split separates
+      Error = FString::Printf(TEXT("%s has %lld points in one cell, more than the %lld points read per pass"), *FileName, Largest, GroupPoints);
+      return nullptr;
+    }
+    ++BucketDepth;
+  }
+
+  // nodes above and at the bucket depth, every other node hangs below a bucket
+  TArray<FPointCloudNode> Nodes;
+  const FVector CubeMin(Reader.CubeMin);
+  TArray<TArray<int64>> LevelCounts;
+  TArray<TArray<int32>> LevelNodes;
+  LevelCounts.SetNum(BucketDepth + 1);
+  LevelNodes.SetNum(BucketDepth + 1);
+  for (int32 Level = 0; Level <= BucketDepth; ++Level)
+  {
+    LevelCounts[Level].SetNumZeroed(1 << (3 * Level));
+    LevelNodes[Level].Init(INDEX_NONE, 1 << (3 * Level));
+    for (int32 b = 0; b < NumBuckets; ++b)
+    {
+      LevelCounts[Level][b >> (3 * (BucketDepth - Level))] += BucketCounts[b];
+    }
+    for (int32 Cell = 0; Cell < LevelCounts[Level].Num(); ++Cell)
+    {
+      if (LevelCounts[Level][Cell] == 0 && Level > 0)
+      {
+        continue;
+      }
+      FPointCloudNode& Node = Nodes.AddDefaulted_GetRef();
+      Node.Level = Level;
+      Node.Bounds = GetCellBounds(CubeMin, CubeSize, Level, Cell);
+      LevelNodes[Level][Cell] = Nodes.Num() - 1;
+      if (Level > 0)
+      {
+        Node.Parent = LevelNodes[Level - 1][Cell >> 3];
+        Nodes[Node.Parent].Children[Cell & 7] = Nodes.Num() - 1;
+      }
+    }
+  }
+
+  const FString TempPointFile = PointFile + TEXT(".tmp");
+  TUniquePtr<IFileHandle> Writer(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*TempPointFile));
+  if (!Writer)
+  {
+    Error = FString::Printf(TEXT("could not write %s"), *TempPointFile);
+    return nullptr;
+  }
+  int64 Written = 0;
+  TArray<TArray<FCloudPoint>> UpperPoints;
+  UpperPoints.SetNum(Nodes.Num());
+
+  // buckets are read in groups that fit the memory budget, each pass over the input keeps only the points of its group
+  TArray<FKeyedPoint> Buffer;
+  for (int32 GroupStart = 0; GroupStart < NumBuckets;)
+  {
+    int32 GroupEnd = GroupStart;
+    int64 GroupSize = 0;
+    while (GroupEnd < NumBuckets && (GroupEnd == GroupStart || GroupSize + BucketCounts[GroupEnd] <= GroupPoints))
+    {
+      GroupSize += BucketCounts[GroupEnd++];
+    }
+    const int32 GroupBuckets = GroupEnd - GroupStart;
+    TArray<int64> BucketOffsets;
+    BucketOffsets.SetNumUninitialized(GroupBuckets + 1);
+    BucketOffsets[0] = 0;
+    for (int32 b = 0; b < GroupBuckets; ++b)
+    {
+      BucketOffsets[b + 1] = BucketOffsets[b] + BucketCounts[GroupStart + b];
+    }
+    // every block writes to its own slots, which keeps the order independent of the scheduling
+    TArray<TArray<int64>> BlockCursors;
+    BlockCursors.SetNum(NumBlocks);
+    TArray<int64> Running(BucketOffsets.GetData(), GroupBuckets);
+    for (int32 Block = 0; Block < NumBlocks; ++Block)
+    {
+      BlockCursors[Block] = Running;
+      for (int32 b = 0; b < GroupBuckets; ++b)
+      {
+        Running[b] += BlockHistograms[Block][GroupStart + b];
+      }
+    }
+    Buffer.SetNumUninitialized(static_cast<int32>(GroupSize), false);
+    ParallelFor(NumBlocks, [&](int32 Block)
+      {
+        TArray<int64>& Cursor = BlockCursors[Block];
+        const auto Range = BlockRange(Block);
+        for (int64 i = Range.Key; i < Range.Value; ++i)
+        {
+          const int32 Bucket = static_cast<int32>(Reader.Code(Reader.Position(i)) >> BucketShift) - GroupStart;
+          if (Bucket >= 0 && Bucket < GroupBuckets)
+          {
+            Buffer[Cursor[Bucket]++] = Reader.Read(i);
+          }
+        }
+      });
+
+    TArray<FBucketResult> Results;
+    Results.SetNum(GroupBuckets);
+    ParallelFor(GroupBuckets, [&](int32 b)
+      {
+        const int32 Bucket = GroupStart + b;
+        FKeyedPoint* Points = Buffer.GetData() + BucketOffsets[b];
+        int64 Remaining = BucketCounts[Bucket];
+        if (Remaining == 0)
+        {
+          return;
+        }
+        Algo::Sort(TArrayView<FKeyedPoint>(Points, Remaining), [](const FKeyedPoint& A, const FKeyedPoint& B) { return A.Code < B.Code; });
+        // every bucket contributes to the nodes above it in proportion to its share of their points
+        FBucketResult& Result = Results[b];
+        Result.Upper.SetNum(BucketDepth);
+        for (int32 Level = 0; Level < BucketDepth; ++Level)
+        {
+          const int64 Above = LevelCounts[Level][Bucket >> (3 * (BucketDepth - Level))];
+          const int64 Share = FMath::DivideAndRoundUp(static_cast<int64>(NodeCapacity) * BucketCounts[Bucket], Above);
+          Remaining = TakeSample(Points, Remaining, Share, Result.Upper[Level]);
+        }
+        BuildLocal(Points, Remaining, BucketDepth, Bucket, Result);
+      });
+
+    for (int32 b = 0; b < GroupBuckets; ++b)
+    {
+      const int32 Bucket = GroupStart + b;
+      FBucketResult& Result = Results[b];
+      if (Result.Nodes.Num() == 0)
+      {
+        continue;
+      }
+      for (int32 Level = 0; Level < BucketDepth; ++Level)
+      {
+        UpperPoints[LevelNodes[Level][Bucket >> (3 * (BucketDepth - Level))]].Append(Result.Upper[Level]);
+      }
+      // the root of the subtree is the bucket node, its descendants are appended in the order they were built
+      TArray<int32> GlobalIndex;
+      GlobalIndex.SetNumUninitialized(Result.Nodes.Num());
+      GlobalIndex[0] = LevelNodes[BucketDepth][Bucket];
+      for (int32 n = 1; n < Result.Nodes.Num(); ++n)
+      {
+        GlobalIndex[n] = Nodes.AddDefaulted();
+      }
+      for (int32 n = 0; n < Result.Nodes.Num(); ++n)
+      {
+        const FLocalNode& Local = Result.Nodes[n];
+        FPointCloudNode& Node = Nodes[GlobalIndex[n]];
+        Node.Level = Local.Level;
+        Node.Bounds = GetCellBounds(CubeMin, CubeSize, Local.Level, Local.Key);
+        Node.First = Written + Local.First;
+        Node.Count = Local.Count;
+        for (int32 c = 0; c < 8; ++c)
+        {
+          if (Local.Children[c] != INDEX_NONE)
+          {
+            Node.Children[c] = GlobalIndex[Local.Children[c]];
+            Nodes[Node.Children[c]].Parent = GlobalIndex[n];
+          }
+        }
+      }
+      if (!WritePoints(Writer.Get(), Result.Ordered))
+      {
+        Error = FString::Printf(TEXT("could not write %s"), *TempPointFile);
+        return nullptr;
+      }
+      Written += Result.Ordered.Num();
+    }
+    GroupStart = GroupEnd;
+  }
+  Buffer.Empty();
+
+  for (int32 n = 0; n < UpperPoints.Num(); ++n)
+  {
+    if (Nodes[n].Level >= BucketDepth)
+    {
+      continue;
+    }
+    Nodes[n].First = Written;
+    Nodes[n].Count = UpperPoints[n].Num();
+    if (!WritePoints(Writer.Get(), UpperPoints[n]))
+    {
+      Error = FString::Printf(TEXT("could not write %s"), *TempPointFile);
+      return nullptr;
+    }
+    Written += UpperPoints[n].Num();
+  }
+  Writer.Reset();
+
+  TArray<uint8> Index;
+  FPointCloudIndexHeader Header{ IndexMagic, IndexVersion, Written, Nodes.Num(), static_cast<int32>(sizeof(FPointCloudNode)) };
+  Index.Append(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+  Index.Append(reinterpret_cast<const uint8*>(Nodes.GetData()), Nodes.Num() * sizeof(FPointCloudNode));
+  // the index is written last, an interrupted build never leaves a usable looking pair behind
+  if (!FileManager.Move(*PointFile, *TempPointFile, true) || !FFileHelper::SaveArrayToFile(Index, *IndexFile))
+  {
+    Error = FString::Printf(TEXT("could not write %s"), *IndexFile);
+    return nullptr;
+  }
+  UE_LOG(LogTemp, Log, TEXT("Built point cloud %s with %lld points in %d nodes"), *FileName, Written, Nodes.Num());
+  return Open(IndexFile, PointFile, Error);
+}
+
+TSharedPtr<FPointCloud, ESPMode::ThreadSafe> FPointCloud::Open(const FString& IndexFile, const FString& PointFile, FString& Error)
+{
+  TArray<uint8> Index;
+  if (!FFileHelper::LoadFileToArray(Index, *IndexFile) || Index.Num() < static_cast<int32>(sizeof(FPointCloudIndexHeader)))
+  {
+    Error = FString::Printf(TEXT("could not read %s"), *IndexFile);
+    return nullptr;
+  }
+  FPointCloudIndexHeader Header;
+  FMemory::Memcpy(&Header, Index.GetData(), sizeof(Header));
+  if (Header.Magic != IndexMagic || Header.Version != IndexVersion || Header.NodeSize != sizeof(FPointCloudNode) || Header.NumNodes <= 0
+    || Index.Num() != sizeof(Header) + static_cast<int64>(Header.NumNodes) * sizeof(FPointCloudNode))
+  {
+    Error = FString::Printf(TEXT("%s is not a point cloud index of this version"), *IndexFile);
+    return nullptr;
+  }
+  TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Cloud = MakeShared<FPointCloud, ESPMode::ThreadSafe>();
+  Cloud->NumPoints = Header.NumPoints;
+  Cloud->Nodes.SetNumUninitialized(Header.NumNodes);
+  FMemory::Memcpy(Cloud->Nodes.GetData(), Index.GetData() + sizeof(Header), Header.NumNodes * sizeof(FPointCloudNode));
+  // a node refers to its own range of points and to children that name it as their parent, so every node is reached once
+  const TArray<FPointCloudNode>& Nodes = Cloud->Nodes;
+  for (int32 n = 0; n < Nodes.Num(); ++n)
+  {
+    const FPointCloudNode& Node = Nodes[n];
+    bool bValid = Header.NumPoints >= 0 && Node.First >= 0 && Node.Count >= 0 && Node.First <= Header.NumPoints - Node.Count;
+    bValid = bValid && (n == 0 ? Node.Parent == INDEX_NONE : Nodes.IsValidIndex(Node.Parent));
+    for (const int32 Child : Node.Children)
+    {
+      bValid = bValid && (Child == INDEX_NONE || (Child != n && Nodes.IsValidIndex(Child) && Nodes[Child].Parent == n));
+    }
+    if (!bValid)
+    {
+      Error = FString::Printf(TEXT("node %d of %s is corrupt"), n, *IndexFile);
+      return nullptr;
+    }
+  }
+  if (!Cloud->PointFile.Open(PointFile) || Cloud->PointFile.Num() != Header.NumPoints * static_cast<int64>(sizeof(FCloudPoint)))
+  {
+    Error = FString::Printf(TEXT("%s does not match its index"), *PointFile);
+    return nullptr;
+  }
+  return Cloud;
+}
+
+const FCloudPoint* FPointCloud::GetPoints(int32 Node) const
+{
+  return reinterpret_cast<const FCloudPoint*>(PointFile.GetData()) + Nodes[Node].First;
+}
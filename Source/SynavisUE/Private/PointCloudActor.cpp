@@ -0,0 +1,247 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "PointCloudActor.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
+#include "UObject/ConstructorHelpers.h"
+
+APointCloudActor::APointCloudActor()
+{
+  PrimaryActorTick.bCanEverTick = true;
+  RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+  static ConstructorHelpers::FObjectFinder<UStaticMesh> PointMeshAsset(TEXT("/Script/Engine.StaticMesh'/Engine/BasicShapes/Cube.Cube'"));
+  if (PointMeshAsset.Succeeded())
+  {
+    PointMesh = PointMeshAsset.Object;
+  }
+}
+
+void APointCloudActor::SetCloud(TSharedPtr<FPointCloud, ESPMode::ThreadSafe> InCloud)
+{
+  ++Generation;
+  for (auto& Entry : NodeStates)
+  {
+    if (Entry.Value.Component)
+    {
+      Entry.Value.Component->DestroyComponent();
+    }
+  }
+  NodeStates.Reset();
+  Selected.Reset();
+  VisiblePoints = 0;
+  VisibleNodes = 0;
+  Cloud = InCloud;
+  if (!Material)
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Point cloud %s has no material that reads the point colours, points are drawn in the colour of the mesh"), *GetName());
+  }
+}
+
+void APointCloudActor::Tick(float DeltaTime)
+{
+  Super::Tick(DeltaTime);
+  if (!Cloud.IsValid())
+  {
+    return;
+  }
+  FVector Location, Direction;
+  float FOV = 90.f;
+  float Width = 1920.f;
+  if (ViewSource)
+  {
+    Location = ViewSource->GetComponentLocation();
+    Direction = ViewSource->GetForwardVector();
+    FOV = ViewSource->FOVAngle;
+    if (ViewSource->TextureTarget)
+    {
+      Width = ViewSource->TextureTarget->SizeX;
+    }
+  }
+  else if (APlayerCameraManager* Camera = UGameplayStatics::GetPlayerCameraManager(GetWorld(), 0))
+  {
+    Location = Camera->GetCameraLocation();
+    Direction = Camera->GetCameraRotation().Vector();
+    FOV = Camera->GetFOVAngle();
+  }
+  else
+  {
+    return;
+  }
+  // the octree is in the space of the actor
+  const FTransform& Transform = GetActorTransform();
+  UpdateSelection(Transform.InverseTransformPosition(Location), Transform.InverseTransformVectorNoScale(Direction).GetSafeNormal(),
+    FOV, Width);
+  EvictHiddenNodes();
+}
+
+void APointCloudActor::UpdateSelection(const FVector& ViewLocation, const FVector& ViewDirection, float FOVDegrees, float ViewWidth)
+{
+  ++Frame;
+  const TArray<FPointCloudNode>& Nodes = Cloud->GetNodes();
+  const double HalfFOV = FMath::DegreesToRadians(FMath::Clamp(FOVDegrees, 1.f, 170.f) * 0.5);
+  const double PixelScale = ViewWidth * 0.5 / FMath::Tan(HalfFOV);
+  // projected size of the bounding sphere, zero if the node is outside of the view cone
+  auto GetPixels = [&](int32 Node) -> double
+  {
+    const FBox& Bounds = Nodes[Node].Bounds;
+    const double Radius = Bounds.GetExtent().Size();
+    const FVector ToCenter = Bounds.GetCenter() - ViewLocation;
+    const double Distance = ToCenter.Size();
+    if (Distance > Radius)
+    {
+      const double Angle = FMath::Acos(FMath::Clamp(ToCenter.Dot(ViewDirection) / Distance, -1.0, 1.0));
+      if (Angle - FMath::Asin(Radius / Distance) > HalfFOV)
+      {
+        return 0.0;
+      }
+    }
+    return Radius / FMath::Max(Distance - Radius, Radius * 0.1) * PixelScale;
+  };
+
+  TSet<int32> NewSelected;
+  int64 Points = 0;
+  TArray<TPair<double, int32>> Queue;
+  auto Larger = [](const TPair<double, int32>& A, const TPair<double, int32>& B) { return A.Key > B.Key; };
+  Queue.HeapPush(TPair<double, int32>(GetPixels(0), 0), Larger);
+  while (Queue.Num() > 0)
+  {
+    TPair<double, int32> Top;
+    Queue.HeapPop(Top, Larger, false);
+    const FPointCloudNode& Node = Nodes[Top.Value];
+    // a node that does not fit does not end the selection, smaller ones further down the queue still might
+    if (Points + Node.Count > PointBudget)
+    {
+      continue;
+    }
+    NewSelected.Add(Top.Value);
+    Points += Node.Count;
+    for (const int32 Child : Node.Children)
+    {
+      if (Child == INDEX_NONE)
+      {
+        continue;
+      }
+      const double Pixels = GetPixels(Child);
+      if (Pixels >= MinNodePixels)
+      {
+        Queue.HeapPush(TPair<double, int32>(Pixels, Child), Larger);
+      }
+    }
+  }
+
+  for (const int32 Node : Selected)
+  {
+    FNodeState* State = NodeStates.Find(Node);
+    if (!NewSelected.Contains(Node) && State && State->Component)
+    {
+      State->Component->SetVisibility(false);
+    }
+  }
+  VisiblePoints = 0;
+  VisibleNodes = 0;
+  for (const int32 Node : NewSelected)
+  {
+    FNodeState& State = NodeStates.FindOrAdd(Node);
+    State.LastUsed = Frame;
+    if (State.Component)
+    {
+      State.Component->SetVisibility(true);
+      VisiblePoints += Nodes[Node].Count;
+      ++VisibleNodes;
+    }
+    else if (!State.bLoading)
+    {
+      RequestNode(Node);
+    }
+  }
+  Selected = MoveTemp(NewSelected);
+}
+
+void APointCloudActor::RequestNode(int32 Node)
+{
+  NodeStates.FindOrAdd(Node).bLoading = true;
+  TWeakObjectPtr<APointCloudActor> WeakThis(this);
+  FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Cloud = Cloud, Node, LoadGeneration = Generation, Scale = PointSize / 100.f]()
+    {
+      // reading the points pages the node in from the mapped point file
+      const int32 Count = Cloud->GetNodes()[Node].Count;
+      const FCloudPoint* Points = Cloud->GetPoints(Node);
+      TArray<FTransform> Transforms;
+      TArray<float> CustomData;
+      Transforms.SetNumUninitialized(Count);
+      CustomData.SetNumUninitialized(Count * 3);
+      for (int32 i = 0; i < Count; ++i)
+      {
+        Transforms[i] = FTransform(FQuat::Identity, FVector(Points[i].Position), FVector(Scale));
+        const FLinearColor Color(Points[i].Color);
+        CustomData[3 * i] = Color.R;
+        CustomData[3 * i + 1] = Color.G;
+        CustomData[3 * i + 2] = Color.B;
+      }
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Node, LoadGeneration, Transforms = MoveTemp(Transforms), CustomData = MoveTemp(CustomData)]() mutable
+        {
+          if (WeakThis.IsValid())
+          {
+            WeakThis->OnNodeLoaded(Node, LoadGeneration, MoveTemp(Transforms), MoveTemp(CustomData));
+          }
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void APointCloudActor::OnNodeLoaded(int32 Node, int32 LoadGeneration, TArray<FTransform> Transforms, TArray<float> CustomData)
+{
+  FNodeState* State = NodeStates.Find(Node);
+  if (LoadGeneration != Generation || !State)
+  {
+    return;
+  }
+  State->bLoading = false;
+  UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(this);
+  Component->SetStaticMesh(PointMesh);
+  if (Material)
+  {
+    Component->SetMaterial(0, Material);
+  }
+  Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+  Component->SetCastShadow(false);
+  Component->SetupAttachment(RootComponent);
+  Component->RegisterComponent();
+  Component->SetNumCustomDataFloats(3);
+  Component->AddInstances(Transforms, false);
+  Component->PerInstanceSMCustomData = MoveTemp(CustomData);
+  Component->MarkRenderStateDirty();
+  const bool bVisible = Selected.Contains(Node);
+  Component->SetVisibility(bVisible);
+  State->Component = Component;
+  if (bVisible)
+  {
+    VisiblePoints += Transforms.Num();
+    ++VisibleNodes;
+  }
+}
+
+void APointCloudActor::EvictHiddenNodes()
+{
+  TArray<TPair<uint64, int32>> Hidden;
+  for (const auto& Entry : NodeStates)
+  {
+    if (Entry.Value.Component && !Selected.Contains(Entry.Key))
+    {
+      Hidden.Emplace(Entry.Value.LastUsed, Entry.Key);
+    }
+  }
+  if (Hidden.Num() <= CachedNodes)
+  {
+    return;
+  }
+  Hidden.Sort([](const TPair<uint64, int32>& A, const TPair<uint64, int32>& B) { return A.Key < B.Key; });
+  for (int32 i = 0; i < Hidden.Num() - CachedNodes; ++i)
+  {
+    NodeStates[Hidden[i].Value].Component->DestroyComponent();
+    NodeStates.Remove(Hidden[i].Value);
+  }
+}
@@ -0,0 +1,109 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "RenderTargetPool.h"
+
+#include "PixelFormat.h"
+
+FRenderTargetPool::FRenderTargetPool(int64 InBudget)
+  : Budget(InBudget)
+{
+}
+
+int64 FRenderTargetPool::GetTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format)
+{
+  const EPixelFormat PixelFormat = GetPixelFormatFromRenderTargetFormat(Format);
+  return static_cast<int64>(Width) * Height * FMath::Max(GPixelFormats[PixelFormat].BlockBytes, 1);
+}
+
+UTextureRenderTarget2D* FRenderTargetPool::Acquire(int32 Width, int32 Height, ETextureRenderTargetFormat Format, UObject* Outer)
+{
+  for (FEntry& Entry : Entries)
+  {
+    if (!Entry.bInUse && Entry.Format == Format && IsValid(Entry.Target)
+      && Entry.Target->SizeX == Width && Entry.Target->SizeY == Height)
+    {
+      Entry.bInUse = true;
+      return Entry.Target;
+    }
+  }
+  const int64 TargetBytes = GetTargetBytes(Width, Height, Format);
+  Evict(TargetBytes);
+  if (Bytes + TargetBytes > Budget)
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Render targets need %lld MiB, more than the budget of %lld MiB"),
+      (Bytes + TargetBytes) >> 20, Budget >> 20);
+  }
+
+  UTextureRenderTarget2D* Target = NewObject<UTextureRenderTarget2D>(Outer, NAME_None, RF_Transient);
+  Target->RenderTargetFormat = Format;
+  Target->ClearColor = FLinearColor::Black;
+  Target->bAutoGenerateMips = false;
+  Target->InitAutoFormat(Width, Height);
+  Target->UpdateResourceImmediate(true);
+
+  FEntry& Entry = Entries.AddDefaulted_GetRef();
+  Entry.Target = Target;
+  Entry.Format = Format;
+  Entry.Bytes = TargetBytes;
+  Entry.LastUse = UseCounter;
+  Entry.bInUse = true;
+  Bytes += TargetBytes;
+  return Target;
+}
+
+void FRenderTargetPool::Release(UTextureRenderTarget2D* Target)
+{
+  if (!Target)
+  {
+    return;
+  }
+  for (FEntry& Entry : Entries)
+  {
+    if (Entry.Target == Target)
+    {
+      Entry.bInUse = false;
+      Entry.LastUse = ++UseCounter;
+      break;
+    }
+  }
+  Evict(0);
+}
+
+void FRenderTargetPool::SetBudget(int64 InBudget)
+{
+  Budget = InBudget;
+  Evict(0);
+}
+
+void FRenderTargetPool::Evict(int64 Needed)
+{
+  while (Bytes + Needed > Budget)
+  {
+    int32 Oldest = INDEX_NONE;
+    for (int32 i = 0; i < Entries.Num(); ++i)
+    {
+      if (!Entries[i].bInUse && (Oldest == INDEX_NONE || Entries[i].LastUse < Entries[Oldest].LastUse))
+      {
+        Oldest = i;
+      }
+    }
+    if (Oldest == INDEX_NONE)
+    {
+      return;
+    }
+    if (IsValid(Entries[Oldest].Target))
+    {
+      Entries[Oldest].Target->ReleaseResource();
+    }
+    Bytes -= Entries[Oldest].Bytes;
+    Entries.RemoveAtSwap(Oldest);
+  }
+}
+
+void FRenderTargetPool::AddReferencedObjects(FReferenceCollector& Collector)
+{
+  for (FEntry& Entry : Entries)
+  {
+    Collector.AddReferencedObject(Entry.Target);
+  }
+}
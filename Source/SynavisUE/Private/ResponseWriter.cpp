@@ -0,0 +1,320 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "ResponseWriter.h"
+
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+  // shortest round trip formatting needs the floating point overloads of to_chars
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  template <typename FloatType>
+  int32 FormatShortest(char* Buffer, int32 Size, FloatType Value)
+  {
+    const std::to_chars_result Result = std::to_chars(Buffer, Buffer + Size, Value);
+    return Result.ec == std::errc() ? static_cast<int32>(Result.ptr - Buffer) : 0;
+  }
+#else
+  // 17 (9 for float) significant digits always read back to the same value, they are just not the shortest
+  int32 FormatShortest(char* Buffer, int32 Size, double Value)
+  {
+    return FMath::Max(std::snprintf(Buffer, Size, "%.17g", Value), 0);
+  }
+  int32 FormatShortest(char* Buffer, int32 Size, float Value)
+  {
+    return FMath::Max(std::snprintf(Buffer, Size, "%.9g", static_cast<double>(Value)), 0);
+  }
+#endif
+
+  const ANSICHAR HexDigits[] = "0123456789abcdef";
+  const ANSICHAR Base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+}
+
+FUtf8Builder& FUtf8Builder::Append(FStringView Text)
+{
+  const TCHAR* Chars = Text.GetData();
+  const int32 Length = Text.Len();
+  Bytes.Reserve(Bytes.Num() + Length);
+  for (int32 i = 0; i < Length; ++i)
+  {
+    uint32 Code = static_cast<uint32>(Chars[i]);
+    if (Code < 0x80)
+    {
+      Bytes.Add(static_cast<ANSICHAR>(Code));
+      continue;
+    }
+    if (Code >= 0xD800 && Code <= 0xDBFF && i + 1 < Length)
+    {
+      const uint32 Low = static_cast<uint32>(Chars[i + 1]);
+      if (Low >= 0xDC00 && Low <= 0xDFFF)
+      {
+        Code = 0x10000 + ((Code - 0xD800) << 10) + (Low - 0xDC00);
+        ++i;
+      }
+    }
+    if (Code >= 0xD800 && Code <= 0xDFFF)
+    {
+      // a lone surrogate has no UTF-8 form
+      Code = 0xFFFD;
+    }
+    if (Code < 0x800)
+    {
+      Bytes.Add(static_cast<ANSICHAR>(0xC0 | (Code >> 6)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | (Code & 0x3F)));
+    }
+    else if (Code < 0x10000)
+    {
+      Bytes.Add(static_cast<ANSICHAR>(0xE0 | (Code >> 12)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | ((Code >> 6) & 0x3F)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | (Code & 0x3F)));
+    }
+    else
+    {
+      Bytes.Add(static_cast<ANSICHAR>(0xF0 | (Code >> 18)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | ((Code >> 12) & 0x3F)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | ((Code >> 6) & 0x3F)));
+      Bytes.Add(static_cast<ANSICHAR>(0x80 | (Code & 0x3F)));
+    }
+  }
+  return *this;
+}
+
+FUtf8Builder& FUtf8Builder::AppendInt(int64 Value)
+{
+  char Buffer[24];
+  const std::to_chars_result Result = std::to_chars(Buffer, Buffer + sizeof(Buffer), Value);
+  return Append(Buffer, static_cast<int32>(Result.ptr - Buffer));
+}
+
+FUtf8Builder& FUtf8Builder::AppendDouble(double Value)
+{
+  if (!FMath::IsFinite(Value))
+  {
+    return Append("null", 4);
+  }
+  char Buffer[32];
+  return Append(Buffer, FormatShortest(Buffer, sizeof(Buffer), Value));
+}
+
+FUtf8Builder& FUtf8Builder::AppendFloat(float Value)
+{
+  if (!FMath::IsFinite(Value))
+  {
+    return Append("null", 4);
+  }
+  char Buffer[32];
+  return Append(Buffer, FormatShortest(Buffer, sizeof(Buffer), Value));
+}
+
+FUtf8Builder& FUtf8Builder::AppendJsonString(FStringView Text)
+{
+  Bytes.Add('"');
+  const TCHAR* Chars = Text.GetData();
+  const int32 Length = Text.Len();
+  int32 Start = 0;
+  for (int32 i = 0; i < Length; ++i)
+  {
+    const TCHAR Character = Chars[i];
+    if (Character >= 0x20 && Character != TEXT('"') && Character != TEXT('\\'))
+    {
+      continue;
+    }
+    // everything up to the escaped character in one go
+    Append(FStringView(Chars + Start, i - Start));
+    Start = i + 1;
+    switch (Character)
+    {
+    case TEXT('"'): Append("\\\"", 2); break;
+    case TEXT('\\'): Append("\\\\", 2); break;
+    case TEXT('\n'): Append("\\n", 2); break;
+    case TEXT('\r'): Append("\\r", 2); break;
+    case TEXT('\t'): Append("\\t", 2); break;
+    default:
+      Append("\\u00", 4);
+      Bytes.Add(HexDigits[(Character >> 4) & 0xF]);
+      Bytes.Add(HexDigits[Character & 0xF]);
+      break;
+    }
+  }
+  Append(FStringView(Chars + Start, Length - Start));
+  Bytes.Add('"');
+  return *this;
+}
+
+FUtf8Builder& FUtf8Builder::AppendBase64(const uint8* Data, int64 Length)
+{
+  const int64 Offset = Bytes.Num();
+  const int64 Encoded = ((Length + 2) / 3) * 4;
+  check(Offset + Encoded <= MAX_int32);
+  Bytes.SetNumUninitialized(static_cast<int32>(Offset + Encoded), false);
+  ANSICHAR* Dest = Bytes.GetData() + Offset;
+  int64 i = 0;
+  for (; i + 3 <= Length; i += 3)
+  {
+    const uint32 Group = (static_cast<uint32>(Data[i]) << 16) | (static_cast<uint32>(Data[i + 1]) << 8) | Data[i + 2];
+    *Dest++ = Base64Digits[(Group >> 18) & 0x3F];
+    *Dest++ = Base64Digits[(Group >> 12) & 0x3F];
+    *Dest++ = Base64Digits[(Group >> 6) & 0x3F];
+    *Dest++ = Base64Digits[Group & 0x3F];
+  }
+  if (i < Length)
+  {
+    const bool bTwo = i + 1 < Length;
+    const uint32 Group = (static_cast<uint32>(Data[i]) << 16) | (bTwo ? static_cast<uint32>(Data[i + 1]) << 8 : 0);
+    *Dest++ = Base64Digits[(Group >> 18) & 0x3F];
+    *Dest++ = Base64Digits[(Group >> 12) & 0x3F];
+    *Dest++ = bTwo ? Base64Digits[(Group >> 6) & 0x3F] : '=';
+    *Dest++ = '=';
+  }
+  return *this;
+}
+
+FString FUtf8Builder::ToTransport() const
+{
+  const int32 Units = (Bytes.Num() + sizeof(TCHAR) - 1) / sizeof(TCHAR);
+  FString Result;
+  TArray<TCHAR>& Chars = Result.GetCharArray();
+  Chars.SetNumUninitialized(Units + 1);
+  uint8* Dest = reinterpret_cast<uint8*>(Chars.GetData());
+  FMemory::Memcpy(Dest, Bytes.GetData(), Bytes.Num());
+  // no zero bytes inside the buffer, they would end the string early
+  FMemory::Memset(Dest + Bytes.Num(), ' ', Units * sizeof(TCHAR) - Bytes.Num());
+  Chars[Units] = TEXT('\0');
+  return Result;
+}
+
+FString FUtf8Builder::ToString(int32 MaxBytes) const
+{
+  const int32 Length = FMath::Min(Bytes.Num(), MaxBytes);
+  const FUTF8ToTCHAR Converted(Bytes.GetData(), Length);
+  return FString(Converted.Length(), Converted.Get());
+}
+
+void FJsonResponseWriter::Separate()
+{
+  if (bAfterKey)
+  {
+    bAfterKey = false;
+    return;
+  }
+  if (First.Num() > 0)
+  {
+    if (!First.Last())
+    {
+      Out.Append(',');
+    }
+    First.Last() = false;
+  }
+}
+
+FJsonResponseWriter& FJsonResponseWriter::BeginObject()
+{
+  Separate();
+  Out.Append('{');
+  First.Push(true);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::EndObject()
+{
+  First.Pop(false);
+  Out.Append('}');
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::BeginArray()
+{
+  Separate();
+  Out.Append('[');
+  First.Push(true);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::EndArray()
+{
+  First.Pop(false);
+  Out.Append(']');
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Key(const ANSICHAR* Name)
+{
+  Separate();
+  Out.Append('"').Append(Name).Append("\":", 2);
+  bAfterKey = true;
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Key(FStringView Name)
+{
+  Separate();
+  Out.AppendJsonString(Name).Append(':');
+  bAfterKey = true;
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(bool Value)
+{
+  Separate();
+  Out.Append(Value ? "true" : "false");
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(int32 Value)
+{
+  Separate();
+  Out.AppendInt(Value);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(int64 Value)
+{
+  Separate();
+  Out.AppendInt(Value);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(float Value)
+{
+  Separate();
+  Out.AppendFloat(Value);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(double Value)
+{
+  Separate();
+  Out.AppendDouble(Value);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(FStringView Value)
+{
+  Separate();
+  Out.AppendJsonString(Value);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Value(const FVector& Value)
+{
+  BeginObject();
+  Key("x").Value(Value.X);
+  Key("y").Value(Value.Y);
+  Key("z").Value(Value.Z);
+  return EndObject();
+}
+
+FJsonResponseWriter& FJsonResponseWriter::Null()
+{
+  Separate();
+  Out.Append("null", 4);
+  return *this;
+}
+
+FJsonResponseWriter& FJsonResponseWriter::RawValue(FStringView Json)
+{
+  Separate();
+  Out.Append(Json);
+  return *this;
+}
@@ -0,0 +1,197 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#include "SendPacer.h"
+
+FSendPacer::FSendPacer(double InInitialRate, double InMinRate, double InMaxRate)
+  : MinRate(FMath::Max(InMinRate, 1024.0))
+  , MaxRate(FMath::Max(InMaxRate, InMinRate))
+{
+  Rate = FMath::Clamp(InInitialRate, MinRate, MaxRate);
+  LastRefill = FPlatformTime::Seconds();
+}
+
+void FSendPacer::Refill(double Now)
+{
+  // the bucket holds a few milliseconds worth of data, enough to send a chunk right away after a pause
+  const double Burst = FMath::Max(Rate * 0.02, 65536.0);
+  Tokens = FMath::Min(Burst, Tokens + (Now - LastRefill) * Rate);
+  LastRefill = Now;
+}
+
+void FSendPacer::Track(int64 Bytes, uint64 Key, double Now)
+{
+  if (Key == 0)
+  {
+    return;
+  }
+  // a resent chunk replaces its first transmission
+  if (const FOutstanding* Previous = Outstanding.Find(Key))
+  {
+    InFlight -= Previous->Bytes;
+  }
+  Outstanding.Add(Key, { Bytes, Now });
+  InFlight += Bytes;
+}
+
+bool FSendPacer::IsWindowFull(double Now)
+{
+  if (Now - LastSweep > 0.25)
+  {
+    LastSweep = Now;
+    bool bLost = false;
+    for (auto It = Outstanding.CreateIterator(); It; ++It)
+    {
+      if (Now - It.Value().SendTime > AckTimeout)
+      {
+        InFlight -= It.Value().Bytes;
+        It.RemoveCurrent();
+        bLost = true;
+      }
+    }
+    if (bLost && bHasAcks)
+    {
+      Decrease(Now);
+    }
+    // a client that stopped acknowledging is paced by the rate alone
+    if (bHasAcks && Now - LastAck > 2.0 * AckTimeout)
+    {
+      bHasAcks = false;
+    }
+  }
+  if (!bHasAcks)
+  {
+    return false;
+  }
+  // twice the data that fits into the minimal round trip plus the queueing we allow
+  const double Window = FMath::Max(2.0 * Rate * (FMath::Max(MinRoundTrip, 0.0) + TargetDelay), 262144.0);
+  return InFlight > Window;
+}
+
+void FSendPacer::Increase(double Factor)
+{
+  Rate = FMath::Min(MaxRate, Rate * Factor);
+}
+
+void FSendPacer::Decrease(double Now)
+{
+  // at most once per round trip, the feedback of the previous decrease needs that long to arrive
+  if (Now - LastDecrease < FMath::Max(RoundTrip, TargetDelay))
+  {
+    return;
+  }
+  Rate = FMath::Max(MinRate, Rate * 0.8);
+  LastDecrease = Now;
+}
+
+bool FSendPacer::Acquire(int64 Bytes, uint64 Key, const std::atomic<bool>* Abort)
+{
+  while (!Abort || !Abort->load())
+  {
+    double Wait = 0.0;
+    {
+      FScopeLock ScopeLock(&Lock);
+      const double Now = FPlatformTime::Seconds();
+      Refill(Now);
+      const bool bWindowFull = IsWindowFull(Now);
+      if (!bWindowFull && Tokens >= 0.0)
+      {
+        // the bucket goes into debt for large messages, the next sender waits for it to be paid off
+        Tokens -= Bytes;
+        Track(Bytes, Key, Now);
+        return true;
+      }
+      Wait = bWindowFull ? 0.005 : -Tokens / Rate;
+    }
+    // short slices so that an abort is noticed quickly
+    FPlatformProcess::Sleep(static_cast<float>(FMath::Clamp(Wait, 0.001, 0.01)));
+  }
+  return false;
+}
+
+bool FSendPacer::TryAcquire(int64 Bytes, uint64 Key)
+{
+  FScopeLock ScopeLock(&Lock);
+  const double Now = FPlatformTime::Seconds();
+  Refill(Now);
+  if (IsWindowFull(Now) || Tokens < 0.0)
+  {
+    return false;
+  }
+  Tokens -= Bytes;
+  Track(Bytes, Key, Now);
+  return true;
+}
+
+void FSendPacer::Consume(int64 Bytes, uint64 Key)
+{
+  FScopeLock ScopeLock(&Lock);
+  const double Now = FPlatformTime::Seconds();
+  Refill(Now);
+  Tokens -= Bytes;
+  Track(Bytes, Key, Now);
+}
+
+void FSendPacer::Acknowledge(uint64 Key)
+{
+  FScopeLock ScopeLock(&Lock);
+  FOutstanding Message;
+  if (!Outstanding.RemoveAndCopyValue(Key, Message))
+  {
+    return;
+  }
+  const double Now = FPlatformTime::Seconds();
+  const double Sample = Now - Message.SendTime;
+  InFlight -= Message.Bytes;
+  bHasAcks = true;
+  LastAck = Now;
+  // the minimum is renewed every few seconds so that a changed route is picked up
+  if (MinRoundTrip < 0.0 || Sample < MinRoundTrip || Now - MinRoundTripTime > 10.0)
+  {
+    MinRoundTrip = Sample;
+    MinRoundTripTime = Now;
+  }
+  RoundTrip = RoundTrip > 0.0 ? 0.875 * RoundTrip + 0.125 * Sample : Sample;
+  if (Sample - MinRoundTrip > TargetDelay)
+  {
+    Decrease(Now);
+  }
+  else if (Tokens <= 0.0)
+  {
+    // only a rate that held the sender back has been tested, an idle sender leaves it where it is
+    Increase(1.02);
+  }
+}
+
+void FSendPacer::ReportBufferedAmount(int64 Bytes)
+{
+  FScopeLock ScopeLock(&Lock);
+  const double Now = FPlatformTime::Seconds();
+  const double Allowed = Rate * TargetDelay;
+  if (Bytes > Allowed)
+  {
+    Decrease(Now);
+  }
+  else if (Bytes < Allowed / 4 && Tokens <= 0.0)
+  {
+    // the channel drains faster than we fill it and we are the ones holding back
+    Increase(1.05);
+  }
+}
+
+double FSendPacer::GetRate() const
+{
+  FScopeLock ScopeLock(&Lock);
+  return Rate;
+}
+
+int64 FSendPacer::GetInFlight() const
+{
+  FScopeLock ScopeLock(&Lock);
+  return InFlight;
+}
+
+double FSendPacer::GetRoundTrip() const
+{
+  FScopeLock ScopeLock(&Lock);
+  return RoundTrip;
+}
@@ -14,6 +14,7 @@
 #include "Materials/MaterialInstanceDynamic.h"
 #include "Engine/Texture.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "RHI.h"
 #include "Blueprint/UserWidget.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "Components/InstancedStaticMeshComponent.h"
@@ -21,12 +22,26 @@
 #include "InstancedFoliageActor.h"
 #include "Landscape.h"
 #include "Misc/FileHelper.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 #include "Dom/JsonObject.h"
 #include "Engine/LevelStreaming.h"
 #include "Serialization/JsonReader.h"
 #include "NiagaraActor.h"
 #include "NiagaraComponent.h"
 #include "WorldSpawner.h"
+#include "MeshOptimizer.h"
+#include "DataCamera.h"
+#include "UObject/UObjectIterator.h"
+#include "GeometryCache.h"
+#include "Colormap.h"
+#include "MeshSequencePlayer.h"
+#include "GeometryImporter.h"
+#include "PointCloudActor.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "HAL/FileManager.h"
 #include "Components/SkyAtmosphereComponent.h"
 #include "Components/VolumetricCloudComponent.h"
 #include "Engine/DirectionalLight.h"
@@ -112,6 +127,57 @@ inline bool GetBoolFieldOr(TSharedPtr<FJsonObject> Json, const FString& Field, b
   return Default;
 }
 
+// optional [min, max] pair for scalar fields, Min >= Max leaves the range to the colormap
+inline FVector2D GetRangeFieldOr(TSharedPtr<FJsonObject> Json, const FString& Field, const FVector2D& Default)
+{
+  const TArray<TSharedPtr<FJsonValue>>* Range;
+  if (Json.IsValid() && Json->TryGetArrayField(Field, Range) && Range->Num() == 2)
+  {
+    return FVector2D((*Range)[0]->AsNumber(), (*Range)[1]->AsNumber());
+  }
+  return Default;
+}
+
+// "roi":[x,y,w,h] in pixels of the render target and "scale" in (0,1] of frame and receive requests
+inline bool ParseRegion(TSharedPtr<FJsonObject> Json, FFrameCodec& Codec)
+{
+  const TArray<TSharedPtr<FJsonValue>>* Roi;
+  if (Json.IsValid() && Json->TryGetArrayField(TEXT("roi"), Roi))
+  {
+    if (Roi->Num() != 4)
+    {
+      return false;
+    }
+    double Values[4];
+    for (int32 i = 0; i < 4; ++i)
+    {
+      Values[i] = (*Roi)[i]->AsNumber();
+      if (!FMath::IsFinite(Values[i]))
+      {
+        return false;
+      }
+    }
+    // checked as doubles, the corners have to fit into int32 before the cast
+    if (Values[0] < 0.0 || Values[1] < 0.0 || Values[2] < 1.0 || Values[3] < 1.0
+      || Values[0] + Values[2] > MAX_int32 || Values[1] + Values[3] > MAX_int32)
+    {
+      return false;
+    }
+    const int32 X = static_cast<int32>(Values[0]);
+    const int32 Y = static_cast<int32>(Values[1]);
+    const int32 W = static_cast<int32>(Values[2]);
+    const int32 H = static_cast<int32>(Values[3]);
+    Codec.Roi = FIntRect(X, Y, X + W, Y + H);
+  }
+  const double Scale = GetDoubleFieldOr(Json, TEXT("scale"), 1.0);
+  if (Scale <= 0.0 || Scale > 1.0)
+  {
+    return false;
+  }
+  Codec.Scale = static_cast<float>(Scale);
+  return true;
+}
+
 void ASynavisDrone::AppendToMesh(TSharedPtr<FJsonObject> Jason)
 {
   auto* Object = this->GetObjectFromJSON(Jason);
@@ -127,6 +193,11 @@ void ASynavisDrone::AppendToMesh(TSharedPtr<FJsonObject> Jason)
     procmesh->RegisterComponent();
     procmesh->AttachToComponent(Actor->GetRootComponent(), FAttachmentTransformRules::KeepRelativeTransform);
   }
+  if (!FMeshOptimizer::HasValidIndices(Triangles, Points.Num()))
+  {
+    SendError("mesh has triangle indices outside of its points");
+    return;
+  }
   int section = GetIntFieldOr(Jason, TEXT("section"), procmesh->GetNumSections());
   procmesh->CreateMeshSection(section, Points, Triangles, Normals, UVs, {}, Tangents, false);
 }
@@ -175,7 +246,10 @@ void ASynavisDrone::ParseInput(FString Descriptor)
 
       FMemory::Memcpy(ReceptionBuffer + ReceptionBufferOffset, data, size);
       ReceptionBufferOffset += size;
-      SendResponse(FString::Printf(TEXT("{\"type\":\"buffer\",\"name\":\"%s\", \"state\":\"transit\"}"), *ReceptionName), unixtime_start);
+      FUtf8Builder Response(64 + ReceptionName.Len());
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("buffer")).Field("name", ReceptionName).Field("state", TEXT("transit")).EndObject();
+      SendUtf8(Response, unixtime_start);
     }
   }
 }
@@ -187,6 +261,7 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
   {
     auto type = Jason->GetStringField(TEXT("type"));
     int pid = GetIntFieldOr(Jason, TEXT("pid"), -1);
+    bPeerHeard = true;
     if (LogResponses)
       UE_LOG(LogTemp, Warning, TEXT("Received Message of Type %s"), *type);
     if (type == "geometry")
@@ -217,10 +292,89 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
       }
       else
       {
-        auto* act = WorldSpawner->SpawnProcMesh(Points, Normals, Triangles, Scalars, 0.0, 1.0, UVs, Tangents);
+        const FVector2D range = GetRangeFieldOr(Jason, TEXT("range"), ScalarRange);
+        auto* act = WorldSpawner->SpawnProcMesh(Points, Normals, Triangles, Scalars, range.X, range.Y, UVs, Tangents,
+          GetBoolFieldOr(Jason, TEXT("bake"), false), GetStringFieldOr(Jason, TEXT("colormap"), TEXT("")));
+        if (!act)
+        {
+          // the spawner already told the client why
+          return;
+        }
         id = act->GetName();
       }
-      SendResponse("{\"type\":\"geometry\",\"name\":\"" + id + "\"}", unixtime_start, pid);
+      // an append only holds part of a mesh, only complete payloads are cached under their hash
+      const FString hash = (type == TEXT("directbase64")) ? CacheCurrentGeometry() : FString();
+      FUtf8Builder Response(64 + id.Len() + hash.Len());
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("geometry")).Field("name", id);
+      if (!hash.IsEmpty())
+      {
+        Writer.Field("hash", hash);
+      }
+      Writer.EndObject();
+      SendUtf8(Response, unixtime_start, pid);
+    }
+    else if (type == TEXT("have"))
+    {
+      // the client announces the hashes of the meshes it is about to send
+      // we reply with the ones that can be spawned through spawncached instead
+      const TArray<TSharedPtr<FJsonValue>>* hashes;
+      if (!Jason->TryGetArrayField(TEXT("hashes"), hashes))
+      {
+        SendError("have request needs a hashes array");
+        return;
+      }
+      TArray<FString> present, missing;
+      for (const auto& value : *hashes)
+      {
+        const FString hash = value->AsString().ToLower();
+        ((GeometryCache.IsValid() && GeometryCache->Contains(hash)) ? present : missing).Add(hash);
+      }
+      FUtf8Builder Response(64 + 44 * hashes->Num());
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("have")).Key("present").BeginArray();
+      for (const FString& hash : present)
+      {
+        Writer.Value(hash);
+      }
+      Writer.EndArray().Key("missing").BeginArray();
+      for (const FString& hash : missing)
+      {
+        Writer.Value(hash);
+      }
+      Writer.EndArray().EndObject();
+      SendUtf8(Response, unixtime_start, pid);
+    }
+    else if (type == TEXT("spawncached"))
+    {
+      const FString hash = GetStringFieldOr(Jason, TEXT("hash"), TEXT("")).ToLower();
+      FGeometryPayload Payload;
+      if (!GeometryCache.IsValid() || !GeometryCache->Load(hash, Payload))
+      {
+        SendError(FString::Printf(TEXT("geometry %s is not cached"), *hash));
+        return;
+      }
+      Points = MoveTemp(Payload.Points);
+      Normals = MoveTemp(Payload.Normals);
+      Triangles = MoveTemp(Payload.Triangles);
+      UVs = MoveTemp(Payload.UVs);
+      Scalars = MoveTemp(Payload.Scalars);
+      Tangents = MoveTemp(Payload.Tangents);
+      const FVector2D range = GetRangeFieldOr(Jason, TEXT("range"), FVector2D::ZeroVector);
+      auto* act = WorldSpawner->SpawnProcMesh(Points, Normals, Triangles, Scalars, range.X, range.Y, UVs, Tangents,
+        GetBoolFieldOr(Jason, TEXT("bake"), false), GetStringFieldOr(Jason, TEXT("colormap"), TEXT("")));
+      if (!act)
+      {
+        return;
+      }
+      if (Jason->HasField(TEXT("property")))
+      {
+        ApplyJSONToObject(act, Jason.Get());
+      }
+      FUtf8Builder Response(128);
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("geometry")).Field("name", act->GetName()).Field("hash", hash).EndObject();
+      SendUtf8(Response, unixtime_start, pid);
     }
     else if (type == TEXT("filegeometry"))
     {
@@ -268,22 +422,88 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         // create mesh
         if (!Jason->HasField(TEXT("append")) && !Jason->HasField(TEXT("hold")))
         {
-          auto mesh = WorldSpawner->SpawnProcMesh(Points, Normals, Triangles, {}, 0.0, 1.0, UVs, {});
-          ApplyJSONToObject(mesh, Jason.Get());
+          auto mesh = WorldSpawner->SpawnProcMesh(Points, Normals, Triangles, {}, 0.0, 1.0, UVs, {},
+            GetBoolFieldOr(Jason, TEXT("bake"), false));
+          if (mesh)
+          {
+            ApplyJSONToObject(mesh, Jason.Get());
+          }
         }
       }
       // we consumed the input, delete the file
       file.DeleteFile(*fname);
       if (unixtime_start > 0)
       {
-        SendResponse(FString::Printf(TEXT("{\"type\":\"filegeometry\",\"starttime\":%f}"), unixtime_start), unixtime_start, pid);
+        FUtf8Builder Response(64);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("filegeometry")).Field("starttime", unixtime_start).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
+      }
+    }
+    else if (type == TEXT("bake"))
+    {
+      // converts an already spawned procedural mesh into a static mesh, the reply arrives once the build is done
+      AActor* Target = Cast<AActor>(GetObjectFromJSON(Jason));
+      if (!Target || !WorldSpawner)
+      {
+        SendError("bake request object not found");
+        return;
+      }
+      WorldSpawner->BakeProcMesh(Target,
+        GetBoolFieldOr(Jason, TEXT("nanite"), WorldSpawner->BakeWithNanite),
+        GetBoolFieldOr(Jason, TEXT("instanced"), WorldSpawner->InstanceBakedMeshes));
+    }
+    else if (type == TEXT("sequence"))
+    {
+      // frames are geometry cache hashes from earlier uploads or raw geometry files
+      const TArray<TSharedPtr<FJsonValue>>* frames;
+      if (!WorldSpawner || !Jason->TryGetArrayField(TEXT("frames"), frames) || frames->Num() == 0)
+      {
+        SendError("sequence request needs a frames array");
+        return;
+      }
+      TArray<FString> sources;
+      for (const auto& value : *frames)
+      {
+        sources.Add(value->AsString());
+      }
+      AMeshSequencePlayer* Player = WorldSpawner->SpawnSequence();
+      Player->FrameRate = static_cast<float>(GetDoubleFieldOr(Jason, TEXT("rate"), Player->FrameRate));
+      Player->Loop = GetBoolFieldOr(Jason, TEXT("loop"), Player->Loop);
+      Player->RingSize = GetIntFieldOr(Jason, TEXT("ring"), Player->RingSize);
+      Player->Colormap = GetStringFieldOr(Jason, TEXT("colormap"), Player->Colormap);
+      Player->ScalarRange = GetRangeFieldOr(Jason, TEXT("range"), Player->ScalarRange);
+      Player->SetFrames(sources, GeometryCache);
+      FUtf8Builder Response(96);
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("sequence")).Field("name", Player->GetName()).Field("frames", sources.Num()).EndObject();
+      SendUtf8(Response, unixtime_start, pid);
+    }
+    else if (type == TEXT("step"))
+    {
+      // advances a sequence by one frame, or jumps to the given frame
+      AMeshSequencePlayer* Player = Cast<AMeshSequencePlayer>(GetObjectFromJSON(Jason));
+      if (!Player)
+      {
+        SendError("step request object is not a sequence");
+        return;
       }
+      const int32 frame = GetIntFieldOr(Jason, TEXT("frame"), -1);
+      const bool ready = (frame >= 0) ? Player->Seek(frame) : Player->Step();
+      FUtf8Builder Response(128);
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("step")).Field("name", Player->GetName()).Field("frame", Player->GetDisplayedFrame())
+        .Field("ready", ready).Field("stalls", Player->Stalls).EndObject();
+      SendUtf8(Response, unixtime_start, pid);
     }
     else if (type == "parameter")
     {
       auto* Target = this->GetObjectFromJSON(Jason);
       ApplyJSONToObject(Target, Jason.Get());
-      SendResponse("{\"type\":\"parameter\",\"name\":\"" + Target->GetName() + "\"}", unixtime_start, pid);
+      FUtf8Builder Response(96);
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("parameter")).Field("name", Target->GetName()).EndObject();
+      SendUtf8(Response, unixtime_start, pid);
     }
     else if (type == "query")
     {
@@ -299,16 +519,16 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
             if (spawn == "any")
             {
               // return names of all available assets
-              FString message = "{\"type\":\"query\",\"name\":\"spawn\",\"data\":[";
               TArray<FString> Names = WorldSpawner->GetNamesOfSpawnableTypes();
-              for (int i = 0; i < Names.Num(); ++i)
+              FUtf8Builder Response(64 + 32 * Names.Num());
+              FJsonResponseWriter Writer(Response);
+              Writer.BeginObject().Field("type", TEXT("query")).Field("name", TEXT("spawn")).Key("data").BeginArray();
+              for (const FString& AssetName : Names)
               {
-                message += FString::Printf(TEXT("\"%s\""), (*Names[i]));
-                if (i < Names.Num() - 1)
-                  message += TEXT(",");
+                Writer.Value(AssetName);
               }
-              message += "]}";
-              this->SendResponse(message, unixtime_start, pid);
+              Writer.EndArray().EndObject();
+              this->SendUtf8(Response, unixtime_start, pid);
             }
             else
             {
@@ -319,10 +539,12 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
                 // the asset json already contains all info
                 // serialize
                 FString message;
-                TSharedRef<TJsonWriter<TCHAR>> Writer = TJsonWriterFactory<TCHAR>::Create(&message);
-                FJsonSerializer::Serialize(asset_json.ToSharedRef(), Writer);
-                message = FString::Printf(TEXT("{\"type\":\"query\",\"name\":\"spawn\",\"data\":%s}"), *message);
-                this->SendResponse(message, unixtime_start, pid);
+                TSharedRef<TJsonWriter<TCHAR>> JsonWriter = TJsonWriterFactory<TCHAR>::Create(&message);
+                FJsonSerializer::Serialize(asset_json.ToSharedRef(), JsonWriter);
+                FUtf8Builder Response(64 + message.Len());
+                FJsonResponseWriter Writer(Response);
+                Writer.BeginObject().Field("type", TEXT("query")).Field("name", TEXT("spawn")).Key("data").RawValue(message).EndObject();
+                this->SendUtf8(Response, unixtime_start, pid);
               }
             }
           }
@@ -330,18 +552,17 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         else
         {
           // respond with names of all actors
-          FString message = "{\"type\":\"query\",\"name\":\"all\",\"data\":[";
           TArray<AActor*> Actors;
           UGameplayStatics::GetAllActorsOfClass(GetWorld(), AActor::StaticClass(), Actors);
-          const auto NumActors = Actors.Num();
-          for (auto i = 0; i < NumActors; ++i)
+          FUtf8Builder Response(64 + 32 * Actors.Num());
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("query")).Field("name", TEXT("all")).Key("data").BeginArray();
+          for (const AActor* Actor : Actors)
           {
-            message += FString::Printf(TEXT("\"%s\""), *Actors[i]->GetName());
-            if (i < NumActors - 1)
-              message += TEXT(",");
+            Writer.Value(Actor->GetName());
           }
-          message += "]}";
-          this->SendResponse(message, unixtime_start, pid);
+          Writer.EndArray().EndObject();
+          this->SendUtf8(Response, unixtime_start, pid);
         }
       }
       else if (Jason->HasField(TEXT("property")))
@@ -354,8 +575,10 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
           // join Name and Property
           Name = FString::Printf(TEXT("%s.%s"), *Name, *Property);
           FString JsonData = GetJSONFromObjectProperty(Target, Property);
-          FString message = FString::Printf(TEXT("{\"type\":\"query\",\"name\":\"%s\",\"data\":%s}"), *Name, *JsonData);
-          this->SendResponse(message, unixtime_start, pid);
+          FUtf8Builder Response(64 + Name.Len() + JsonData.Len());
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("query")).Field("name", Name).Key("data").RawValue(JsonData).EndObject();
+          this->SendUtf8(Response, unixtime_start, pid);
         }
         else
         {
@@ -370,8 +593,10 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         {
           FString Name = Target->GetName();
           FString JsonData = ListObjectPropertiesAsJSON(Target);
-          FString message = FString::Printf(TEXT("{\"type\":\"query\",\"name\":\"%s\",\"data\":%s}"), *Name, *JsonData);
-          this->SendResponse(message, unixtime_start, pid);
+          FUtf8Builder Response(64 + Name.Len() + JsonData.Len());
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("query")).Field("name", Name).Key("data").RawValue(JsonData).EndObject();
+          this->SendUtf8(Response, unixtime_start, pid);
         }
         else
         {
@@ -482,7 +707,80 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
       else if (Name == "frametime")
       {
         float frametime = GetWorld()->GetDeltaSeconds();
-        FString message = FString::Printf(TEXT("{\"type\":\"frametime\",\"value\":%f}"), frametime);
+        FUtf8Builder Response(64);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("frametime")).Field("value", frametime).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
+      }
+      else if (Name == "resolution")
+      {
+        const int Width = GetIntFieldOr(Jason, TEXT("width"), 0);
+        if (!SetCameraSize(Width, GetIntFieldOr(Jason, TEXT("height"), Width)))
+        {
+          SendError("resolution needs a width and height the GPU supports");
+        }
+      }
+      else if (Name == "capture")
+      {
+        // automatic frames of one camera, a rate of 0 stops them; "frame" holds the fields of the frame requests
+        const FString Camera = GetStringFieldOr(Jason, TEXT("camera"), TEXT("scene"));
+        USceneCaptureComponent2D* Capture = FindCaptureCamera(Camera);
+        if (!Capture)
+        {
+          SendError(FString::Printf(TEXT("unknown camera %s"), *Camera));
+          return;
+        }
+        const int Width = GetIntFieldOr(Jason, TEXT("width"), 0);
+        if (Width > 0)
+        {
+          if (!ResizeCaptureTarget(Capture, Width, GetIntFieldOr(Jason, TEXT("height"), Width)))
+          {
+            SendError("resolution needs a width and height the GPU supports");
+            return;
+          }
+          UpdateCamera();
+        }
+        RegisterCaptureSource(Capture, Camera, GetDoubleFieldOr(Jason, TEXT("rate"), 1.0), GetIntFieldOr(Jason, TEXT("priority"), 0));
+        const TSharedPtr<FJsonObject>* Frame;
+        FCaptureScheduler::FSource* Source = CaptureScheduler.Find(Camera);
+        if (Source && Jason->TryGetObjectField(TEXT("frame"), Frame) && Frame->IsValid())
+        {
+          Source->Request = MakeShared<FJsonObject>(**Frame);
+          Source->Request->SetStringField(TEXT("camera"), Camera);
+        }
+      }
+      else if (Name == "infoformat")
+      {
+        if (!SetInfoTargetFormat(GetStringFieldOr(Jason, TEXT("format"), TEXT("color"))))
+        {
+          SendError("info format must be color, half or float");
+        }
+      }
+      else if (Name == "framestats")
+      {
+        FUtf8Builder Response(256);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("framestats"))
+          .Field("sent", FrameEncoder.IsValid() ? FrameEncoder->GetSent() : 0)
+          .Field("queued", FrameEncoder.IsValid() ? FrameEncoder->GetQueued() : 0)
+          .Field("dropped", EncodeDrops).Field("readbackdrops", ReadbackDrops).Field("latency", FrameLatency)
+          .Field("lastlatency", FrameEncoder.IsValid() ? FrameEncoder->GetLastLatency() : 0.0)
+          .Field("rate", SendPacer.IsValid() ? SendPacer->GetRate() : 0.0)
+          .Field("inflight", SendPacer.IsValid() ? SendPacer->GetInFlight() : int64(0))
+          .Field("rtt", SendPacer.IsValid() ? SendPacer->GetRoundTrip() : 0.0)
+          .Field("datasetsamples", DatasetWriter.IsValid() ? DatasetWriter->GetSamples() : int64(0))
+          .Field("datasetbytes", DatasetWriter.IsValid() ? DatasetWriter->GetBytes() : int64(0))
+          .Field("captures", CaptureCount)
+          .Field("targetbytes", TargetPool.IsValid() ? TargetPool->GetBytes() : int64(0))
+          .Field("capturemisses", CaptureMisses).Field("captureallowance", CaptureScheduler.GetAllowance())
+          .Key("sources").BeginArray();
+        for (const FCaptureScheduler::FSource& Source : CaptureScheduler.GetSources())
+        {
+          Writer.BeginObject().Field("camera", Source.Name).Field("rate", 1.0 / Source.Interval).Field("priority", Source.Priority)
+            .Field("captures", Source.Captures).Field("misses", Source.Misses).EndObject();
+        }
+        Writer.EndArray().EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else if (Name == "cam")
       {
@@ -555,7 +853,7 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
       else if (Name == "RawData")
       {
         this->FrameCaptureTime = GetDoubleFieldOr(Jason, TEXT("framecapturetime"), 10.0);
-        this->FrameCaptureCounter = this->FrameCaptureTime;
+        RegisterCaptureSource(SceneCam, TEXT("scene"), FrameCaptureTime > 0.f ? 1.f / FrameCaptureTime : 0.f);
       }
       else if (Name == "navigate")
       {
@@ -599,35 +897,50 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         // trace all in range
         GetWorld()->LineTraceMultiByChannel(Hits, startpos, endpos, ECC_Visibility, TraceParams);
         // create a response by collapsing all hits with distance and name
-        FString message = TEXT("{\"type\":\"trace\",\"data\":[");
-        for (int i = 0; i < Hits.Num(); ++i)
+        FUtf8Builder Response(128 + 64 * Hits.Num());
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("trace")).Key("data").BeginArray();
+        for (const FHitResult& Hit : Hits)
         {
-          message += FString::Printf(TEXT("{\"distance\":%f,\"name\":\"%s\"}"), Hits[i].Distance, *Hits[i].GetActor()->GetName());
-          if (i < Hits.Num() - 1)
-            message += ",";
+          Writer.BeginObject().Field("distance", Hit.Distance);
+          if (const AActor* HitActor = Hit.GetActor())
+          {
+            Writer.Field("name", HitActor->GetName());
+          }
+          else
+          {
+            Writer.Key("name").Null();
+          }
+          Writer.EndObject();
         }
-        message += TEXT("],");
+        Writer.EndArray();
         // add start and end positions
-        message += FString::Printf(TEXT("\"start\":{\"x\":%f,\"y\":%f,\"z\":%f},\"end\":{\"x\":%f,\"y\":%f,\"z\":%f}}"), startpos.X, startpos.Y, startpos.Z, endpos.X, endpos.Y, endpos.Z);
-        SendResponse(message, unixtime_start, pid);
+        Writer.Field("start", startpos).Field("end", endpos).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
     }
     else if (type == "info")
     {
       if (Jason->HasField(TEXT("frametime")))
       {
-        const FString Response = FString::Printf(TEXT("{\"type\":\"info\",\"frametime\":%f}"), GetWorld()->GetDeltaSeconds());
-        SendResponse(Response, unixtime_start, pid);
+        FUtf8Builder Response(64);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("info")).Field("frametime", GetWorld()->GetDeltaSeconds()).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else if (Jason->HasField(TEXT("memory")))
       {
-        const FString Response = FString::Printf(TEXT("{\"type\":\"info\",\"memory\":%d}"), FPlatformMemory::GetStats().TotalPhysical);
-        SendResponse(Response, unixtime_start, pid);
+        FUtf8Builder Response(64);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("info")).Field("memory", static_cast<int64>(FPlatformMemory::GetStats().TotalPhysical)).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else if (Jason->HasField(TEXT("fps")))
       {
-        const FString Response = FString::Printf(TEXT("{\"type\":\"info\",\"fps\":%d}"), static_cast<uint32_t>(FPlatformTime::ToMilliseconds(FPlatformTime::Cycles64())));
-        SendResponse(Response, unixtime_start, pid);
+        FUtf8Builder Response(64);
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("info")).Field("fps", static_cast<int64>(FPlatformTime::ToMilliseconds(FPlatformTime::Cycles64()))).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else if (Jason->HasField(TEXT("object")))
       {
@@ -656,12 +969,124 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
     else if (type == "settings")
     {
       // check for settings subobject and put it into member
+      const float PreviousCaptureTime = FrameCaptureTime;
       ApplyFromJSON(Jason);
+      if (FrameCaptureTime != PreviousCaptureTime)
+      {
+        RegisterCaptureSource(SceneCam, TEXT("scene"), FrameCaptureTime > 0.f ? 1.f / FrameCaptureTime : 0.f);
+      }
+      ApplyCaptureMode();
       if (this->DataChannelMaxSize < 1024)
       {
         this->DataChannelMaxSize = 1024;
       }
     }
+    else if (type == TEXT("meshfile") || type == TEXT("vtpfile"))
+    {
+      // mesh files are parsed on a worker thread, the mesh is spawned once the geometry is decoded
+      const FString fname = GetStringFieldOr(Jason, TEXT("filename"), TEXT(""));
+      if (fname.IsEmpty() || !WorldSpawner)
+      {
+        SendError(FString::Printf(TEXT("%s request needs a filename"), *type));
+        return;
+      }
+      ImportFileAsync(fname, Jason, unixtime_start, pid);
+    }
+    else if (type == TEXT("dropfolder"))
+    {
+      // an empty directory stops watching, relative directories are taken from Saved
+      FString directory = GetStringFieldOr(Jason, TEXT("directory"), TEXT(""));
+      if (!directory.IsEmpty())
+      {
+        if (FPaths::IsRelative(directory))
+        {
+          directory = FPaths::ProjectSavedDir() / directory;
+        }
+        directory = FPaths::ConvertRelativePathToFull(directory);
+        // files in the folder may be deleted, so remote requests can only watch folders of the project
+        if (!FPaths::IsUnderDirectory(directory, FPaths::ConvertRelativePathToFull(FPaths::ProjectDir())))
+        {
+          SendError(FString::Printf(TEXT("drop folder %s is not inside the project"), *directory));
+          return;
+        }
+      }
+      DropFolderConsume = GetBoolFieldOr(Jason, TEXT("consume"), DropFolderConsume);
+      DropFolderExisting = GetBoolFieldOr(Jason, TEXT("existing"), false);
+      SetDropFolder(directory);
+      FUtf8Builder Response(128);
+      FJsonResponseWriter Writer(Response);
+      Writer.BeginObject().Field("type", TEXT("dropfolder"))
+        .Field("directory", DropFolderWatcher ? DropFolderWatcher->GetDirectory() : FString()).EndObject();
+      SendUtf8(Response, unixtime_start, pid);
+    }
+    else if (type == TEXT("pointcloud"))
+    {
+      // binary point records are sorted into an octree on worker threads, which is cached next to the geometry cache
+      const FString fname = GetStringFieldOr(Jason, TEXT("filename"), TEXT(""));
+      FPointCloudLayout layout;
+      if (fname.IsEmpty() || !WorldSpawner)
+      {
+        SendError("pointcloud request needs a filename");
+        return;
+      }
+      if (!FPointCloudLayout::FromFormat(GetStringFieldOr(Jason, TEXT("format"), TEXT("xyz")), GetBoolFieldOr(Jason, TEXT("double"), false), layout))
+      {
+        SendError("pointcloud format must be one of xyz, xyzrgb, xyzi, xyzirgb");
+        return;
+      }
+      layout.HeaderBytes = GetIntFieldOr(Jason, TEXT("header"), 0);
+      const FString colormap = GetStringFieldOr(Jason, TEXT("colormap"), WorldSpawner->Colormap);
+      const FVector2D range = GetRangeFieldOr(Jason, TEXT("range"), FVector2D::ZeroVector);
+      const int32 budget = GetIntFieldOr(Jason, TEXT("budget"), 0);
+      const float pointsize = static_cast<float>(GetDoubleFieldOr(Jason, TEXT("pointsize"), 0.0));
+      // a material that reads the point colour from per instance custom data, the spawner's point cloud material otherwise
+      UMaterialInterface* material = nullptr;
+      const FString materialpath = GetStringFieldOr(Jason, TEXT("material"), TEXT(""));
+      if (!materialpath.IsEmpty())
+      {
+        material = LoadObject<UMaterialInterface>(nullptr, *materialpath);
+        if (!material)
+        {
+          SendError(FString::Printf(TEXT("could not find point cloud material %s"), *materialpath));
+          return;
+        }
+      }
+      TWeakObjectPtr<UMaterialInterface> weakmaterial(material);
+      const FString directory = FPaths::ProjectSavedDir() / TEXT("SynavisPointClouds");
+      TWeakObjectPtr<ASynavisDrone> WeakThis(this);
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, fname, layout, directory, colormap, range, budget, pointsize, weakmaterial, unixtime_start, pid]()
+        {
+          FString Error;
+          auto Cloud = FPointCloud::Build(fname, layout, directory, colormap, range, Error);
+          FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Cloud, Error, fname, budget, pointsize, weakmaterial, unixtime_start, pid]()
+            {
+              ASynavisDrone* Drone = WeakThis.Get();
+              if (!Drone || !Drone->WorldSpawner)
+              {
+                return;
+              }
+              if (!Cloud.IsValid())
+              {
+                Drone->SendError(FString::Printf(TEXT("could not load point cloud %s: %s"), *fname, *Error));
+                return;
+              }
+              APointCloudActor* Actor = Drone->WorldSpawner->SpawnPointCloud(Cloud, Drone->SceneCam, weakmaterial.Get());
+              if (budget > 0)
+              {
+                Actor->PointBudget = budget;
+              }
+              if (pointsize > 0.f)
+              {
+                Actor->PointSize = pointsize;
+              }
+              FUtf8Builder Response(128);
+              FJsonResponseWriter Writer(Response);
+              Writer.BeginObject().Field("type", TEXT("pointcloud")).Field("name", Actor->GetName())
+                .Field("points", Cloud->GetNumPoints()).Field("nodes", Cloud->GetNodes().Num()).EndObject();
+              Drone->SendUtf8(Response, unixtime_start, pid);
+            }, TStatId(), nullptr, ENamedThreads::GameThread);
+        }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+    }
     else if (type == "append")
     {
       if (Jason->HasField(TEXT("object")))
@@ -686,35 +1111,25 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         if (Scalars.Num() == Points.Num())
         {
           // we have scalars, so we need to convert them to colors
-          // just as an example, we use a bluered
-          // we can use the same color map for all scalars
-          // but we need to know the range of the scalars
-          float min = Scalars[0];
-          float max = Scalars[0];
-          for (auto scalar : Scalars)
-          {
-            if (scalar < min)
-            {
-              min = scalar;
-            }
-            if (scalar > max)
-            {
-              max = scalar;
-            }
-          }
-          for (auto scalar : Scalars)
+          const FString colormap = GetStringFieldOr(Jason, TEXT("colormap"), WorldSpawner->Colormap);
+          const FColormap* Map = FColormap::Find(colormap);
+          if (!Map)
           {
-            float t = (scalar - min) / (max - min);
-            FLinearColor color = FLinearColor::LerpUsingHSV(FLinearColor(1, 0, 0), FLinearColor(0, 0, 1), t);
-            Colors.Add(color.ToFColor(false));
+            SendError(FString::Printf(TEXT("Unknown colormap %s"), *colormap));
+            return;
           }
+          const FVector2D range = GetRangeFieldOr(Jason, TEXT("range"), FVector2D::ZeroVector);
+          Map->Map(Scalars, range.X, range.Y, Colors);
         }
         Mesh->CreateMeshSection(section_index, Points, Triangles, Normals, UVs, Colors, Tangents, false);
       }
       else if (this->WorldSpawner)
       {
         auto name = this->WorldSpawner->SpawnObject(Jason);
-        SendResponse(FString::Printf(TEXT("{\"type\":\"spawn\",\"name\":\"%s\"}"), *name), unixtime_start, pid);
+        FUtf8Builder Response(64 + name.Len());
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("spawn")).Field("name", name).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else
       {
@@ -821,7 +1236,10 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
           SendError("Unknown buffer name");
           return;
         }
-        SendResponse(FString::Printf(TEXT("{\"type\":\"buffer\",\"name\":\"%s\", \"state\":\"start\"}"), *name), unixtime_start, pid);
+        FUtf8Builder Response(64 + name.Len());
+        FJsonResponseWriter Writer(Response);
+        Writer.BeginObject().Field("type", TEXT("buffer")).Field("name", name).Field("state", TEXT("start")).EndObject();
+        SendUtf8(Response, unixtime_start, pid);
       }
       else if (Jason->HasField(TEXT("stop")))
       {
@@ -910,7 +1328,11 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
           delete[] ReceptionBuffer;
           ReceptionBuffer = OutputBuffer;
           name = Jason->GetStringField(TEXT("stop"));
-          SendResponse(FString::Printf(TEXT("{\"type\":\"buffer\",\"name\":\"%s\", \"state\":\"stop\", \"amount\":%llu}"), *name, ReceptionBufferSize), unixtime_start, pid);
+          FUtf8Builder Response(96 + name.Len());
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("buffer")).Field("name", name).Field("state", TEXT("stop"))
+            .Field("amount", static_cast<int64>(ReceptionBufferSize)).EndObject();
+          SendUtf8(Response, unixtime_start, pid);
           ReceptionBufferSize = OutputSize;
           //SendResponse(FString::Printf(TEXT("{\"type\":\"buffer\",\"name\":\"%s\", \"state\":\"stop\"}"), *name),unixtime_start, pid);
         }
@@ -927,46 +1349,27 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
       int progress = Jason->GetIntegerField(TEXT("progress"));
       if (progress == -1)
       {
-        FTextureRenderTargetResource* Source = nullptr;
         ReceptionName = GetStringFieldOr(Jason, TEXT("camera"), TEXT("scene"));
-        if (ReceptionName == TEXT("scene"))
+        // the transfer starts once the copy of the render target arrives from the GPU and is encoded
+        ReceptionBufferSize = 0;
+        ReceptionBufferOffset = 0;
+        ++ReceptionSerial;
+        FFrameCodec Codec;
+        if (!ParseRegion(Jason, Codec))
         {
-          Source = SceneCam->TextureTarget->GameThread_GetRenderTargetResource();
+          SendError("roi needs [x,y,w,h] with a positive size and scale must be in (0,1]");
+          return;
         }
-        else
+        if (!RegionHitsTarget(FindCaptureCamera(ReceptionName), Codec))
         {
-          Source = InfoCam->TextureTarget->GameThread_GetRenderTargetResource();
+          SendError("roi lies outside of the camera target");
+          return;
         }
-        TArray<FColor> CamData;
-        FReadSurfaceDataFlags ReadPixelFlags(ERangeCompressionMode::RCM_MinMax);
-        ReadPixelFlags.SetLinearToGamma(true);
-        if (!Source->ReadPixels(CamData, ReadPixelFlags))
+        if (!RequestFrame(ReceptionName, EFramePurpose::Receive, true, Codec))
         {
           SendError("Could not read pixels from camera");
           return;
         }
-        ReceptionFormat = FBase64::Encode(reinterpret_cast<uint8*>(CamData.GetData()), CamData.Num() * sizeof(FColor));
-        if (this->IsInEditor())
-        {
-          auto OutputString = ReceptionFormat;
-          // split every 100th character into a new line
-          for (int i = 100; i < OutputString.Len(); i += 100)
-          {
-            OutputString.InsertAt(i, '\n');
-          }
-          auto unixtime = FDateTime::Now().ToUnixTimestamp();
-          auto FileName = FPaths::ProjectDir() + "/Synavisue" + FString::FromInt(unixtime) + ".json";
-          FFileHelper::SaveStringToFile(OutputString, *FileName);
-        }
-        UE_LOG(LogTemp, Warning, TEXT("Read %d pixels from camera amounting to sizes of %d->%d"), CamData.Num(), CamData.Num() * sizeof(FColor), ReceptionFormat.Len());
-        ReceptionBufferSize = 1;
-        ReceptionBufferOffset = 0;
-        auto BaseLength = ReceptionFormat.Len();
-        while (30 * ReceptionBufferSize + (BaseLength / ReceptionBufferSize) > DataChannelMaxSize)
-        {
-          ReceptionBufferSize++;
-        }
-        LastProgress = 0;
       }
       else if (progress == -2)
       {
@@ -979,39 +1382,56 @@ void ASynavisDrone::JsonCommand(TSharedPtr<FJsonObject> Jason, double unixtime_s
         }
         else
         {
-          FString Response = TEXT("{\"type\":\"receive\",\"data\":\"");
-          auto ChunkSize = ReceptionFormat.Len() / ReceptionBufferSize;
-          const auto Lower = ChunkSize * missing_chunk;
-          auto Upper = FGenericPlatformMath::Min(ChunkSize * (missing_chunk + 1), (uint64_t)ReceptionFormat.Len());
-          if ((ReceptionFormat.Len() - Upper) < ReceptionBufferSize)
+          FUtf8Builder Response;
+          BuildReceptionChunk(missing_chunk, Response);
+          if (SendPacer.IsValid())
           {
-            Upper = ReceptionFormat.Len();
+            // a requested chunk goes out right away, it still counts against the rate
+            SendPacer->Consume(Response.Len(), FSendPacer::ReceiveKey(missing_chunk));
           }
-          Response += ReceptionFormat.Mid(Lower, Upper - Lower + 1);
-          Response += TEXT("\", \"chunk\":\"");
-          Response += FString::FromInt(missing_chunk);
-          Response += TEXT("/");
-          Response += FString::FromInt(ReceptionBufferSize);
-          Response += TEXT("\"}");
-          SendResponse(Response, unixtime_start, pid);
+          SendUtf8(Response, unixtime_start, pid);
         }
       }
       else
       {
         LastProgress = progress;
+        if (SendPacer.IsValid())
+        {
+          SendPacer->Acknowledge(FSendPacer::ReceiveKey(progress));
+        }
+      }
+    }
+    else if (type == "ack")
+    {
+      // the client acknowledges frame chunks, either one chunk or an inclusive range
+      if (SendPacer.IsValid())
+      {
+        const int id = GetIntFieldOr(Jason, TEXT("id"), 0);
+        // chunks of the info half of a pair are counted on from the scene half
+        // older clients only send the camera of the half
+        const int half = GetIntFieldOr(Jason, TEXT("half"), GetStringFieldOr(Jason, TEXT("cam"), TEXT("")) == TEXT("info") ? 1 : 0);
+        const int offset = half << 16;
+        FVector2D Range = GetRangeFieldOr(Jason, TEXT("chunks"), FVector2D(GetIntFieldOr(Jason, TEXT("chunk"), 0)));
+        const int last = FMath::Min(static_cast<int>(Range.Y), static_cast<int>(Range.X) + 65535);
+        for (int chunk = static_cast<int>(Range.X); chunk <= last; ++chunk)
+        {
+          SendPacer->Acknowledge(FSendPacer::FrameKey(id, offset + chunk));
+        }
       }
     }
     else if (type == "frame")
     {
-      if (this->DataChannelMaxSize < 0)
+      FString res = GetStringFieldOr(Jason, TEXT("resolution"), TEXT("base"));
+      FString ImageTarget = GetStringFieldOr(Jason, TEXT("camera"), TEXT("scene"));
+      // frames for the dataset do not need the data channel
+      FFrameCodec Sink;
+      FFrameCodec::ParseSink(GetStringFieldOr(Jason, TEXT("sink"), ImageTarget.EndsWith(TEXT("scene")) ? SceneSink : InfoSink), Sink);
+      if (this->DataChannelMaxSize < 0 && !Sink.bDataset)
       {
         SendError("frame was requested but data channel size is not set");
         return;
       }
 
-      FString res = GetStringFieldOr(Jason, TEXT("resolution"), TEXT("base"));
-      FString ImageTarget = GetStringFieldOr(Jason, TEXT("camera"), TEXT("scene"));
-
       if (res == TEXT("base"))
       {
         SendRawFrame(Jason);
@@ -1073,6 +1493,7 @@ void ASynavisDrone::ParseGeometryFromJson(TSharedPtr<FJsonObject> Jason)
   Points.Empty();
   Normals.Empty();
   Triangles.Empty();
+  ScalarRange = FVector2D::ZeroVector;
   // fetch the geometry from the world
   if (!WorldSpawner)
   {
@@ -1137,18 +1558,11 @@ void ASynavisDrone::ParseGeometryFromJson(TSharedPtr<FJsonObject> Jason)
       Dest.Reset();
       Base64.Decode(scalars, Dest);
       Scalars.SetNumUninitialized(Dest.Num() / sizeof(float), true);
-      // for range calculation, we must move through the data manually
-      auto ScalarData = reinterpret_cast<float*>(Dest.GetData());
-      auto Min = std::numeric_limits<float>::max();
-      auto Max = std::numeric_limits<float>::min();
-      for (size_t i = 0; i < Dest.Num() / sizeof(float); i++)
+      FMemory::Memcpy(Scalars.GetData(), Dest.GetData(), Scalars.Num() * sizeof(float));
+      float Min, Max;
+      if (FColormap::ComputeRange(Scalars.GetData(), Scalars.Num(), Min, Max))
       {
-        auto Value = ScalarData[i];
-        if (Value < Min)
-          Min = Value;
-        if (Value > Max)
-          Max = Value;
-        Scalars[i] = Value;
+        ScalarRange = FVector2D(Min, Max);
       }
     }
   }
@@ -1175,35 +1589,333 @@ void ASynavisDrone::ParseGeometryFromJson(TSharedPtr<FJsonObject> Jason)
 
 }
 
+FString ASynavisDrone::CacheCurrentGeometry()
+{
+  if (!UseGeometryCache || !GeometryCache.IsValid() || Points.Num() == 0)
+  {
+    return FString();
+  }
+  FGeometryPayload Payload;
+  Payload.Points = Points;
+  Payload.Normals = Normals;
+  Payload.Triangles = Triangles;
+  Payload.UVs = UVs;
+  Payload.Scalars = Scalars;
+  Payload.Tangents = Tangents;
+  const FString Hash = FGeometryCache::ComputeHash(Payload);
+  GeometryCache->StoreAsync(Payload, Hash);
+  return Hash;
+}
+
+// removes a consumed file together with its sidecar, a file that failed to import stays for inspection
+static void DeleteImportedFile(const FString& FileName)
+{
+  const FString SidecarFile = FDropFolderWatcher::FindSidecar(FileName);
+  if (!SidecarFile.IsEmpty())
+  {
+    IFileManager::Get().Delete(*SidecarFile);
+  }
+  IFileManager::Get().Delete(*FileName);
+}
+
+void ASynavisDrone::ImportFileAsync(const FString& FileName, TSharedPtr<FJsonObject> Jason, double unixtime_start, int pid, bool bDeleteAfterImport)
+{
+  FGeometryImportOptions Options;
+  Options.ScalarArray = GetStringFieldOr(Jason, TEXT("scalars"), TEXT(""));
+  TWeakObjectPtr<ASynavisDrone> WeakThis(this);
+  FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Options, FileName, Jason, unixtime_start, pid, bDeleteAfterImport]() mutable
+    {
+      auto Payload = MakeShared<FGeometryPayload, ESPMode::ThreadSafe>();
+      FString Error;
+      const bool bLoaded = FGeometryImporterRegistry::Get().ImportFile(FileName, Options, *Payload, Error);
+      if (bDeleteAfterImport && bLoaded && !Payload->IsEmpty())
+      {
+        DeleteImportedFile(FileName);
+      }
+      // the request is only moved through the worker, its reference count is never touched off the game thread
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Payload, bLoaded, Error, FileName, Jason = MoveTemp(Jason), unixtime_start, pid]()
+        {
+          ASynavisDrone* Drone = WeakThis.Get();
+          if (!Drone || !Drone->WorldSpawner)
+          {
+            return;
+          }
+          if (!bLoaded || Payload->IsEmpty())
+          {
+            Drone->SendError(FString::Printf(TEXT("could not load %s: %s"), *FileName, bLoaded ? TEXT("no triangles") : *Error));
+            return;
+          }
+          Drone->Points = MoveTemp(Payload->Points);
+          Drone->Normals = MoveTemp(Payload->Normals);
+          Drone->Triangles = MoveTemp(Payload->Triangles);
+          Drone->UVs = MoveTemp(Payload->UVs);
+          Drone->Scalars = MoveTemp(Payload->Scalars);
+          Drone->Tangents.Reset();
+          const FVector2D range = GetRangeFieldOr(Jason, TEXT("range"), FVector2D::ZeroVector);
+          auto* act = Drone->WorldSpawner->SpawnProcMesh(Drone->Points, Drone->Normals, Drone->Triangles, Drone->Scalars, range.X, range.Y,
+            Drone->UVs, Drone->Tangents, GetBoolFieldOr(Jason, TEXT("bake"), false), GetStringFieldOr(Jason, TEXT("colormap"), TEXT("")));
+          if (!act)
+          {
+            return;
+          }
+          if (Jason->HasField(TEXT("property")))
+          {
+            Drone->ApplyJSONToObject(act, Jason.Get());
+          }
+          const FString hash = Drone->CacheCurrentGeometry();
+          FUtf8Builder Response(160);
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("geometry")).Field("name", act->GetName()).Field("hash", hash)
+            .Field("points", Drone->Points.Num()).Field("triangles", Drone->Triangles.Num() / 3).EndObject();
+          Drone->SendUtf8(Response, unixtime_start, pid);
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void ASynavisDrone::ImportTextureAsync(const FString& FileName, TSharedPtr<FJsonObject> Jason, bool bDeleteAfterImport)
+{
+  // the module is loaded on the game thread, the wrappers it creates can be used on any thread
+  IImageWrapperModule* ImageWrapperModule = &FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+  TWeakObjectPtr<ASynavisDrone> WeakThis(this);
+  FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, ImageWrapperModule, FileName, Jason, bDeleteAfterImport]() mutable
+    {
+      TArray<uint8> Compressed;
+      TArray<uint8> Raw;
+      int32 Width = 0, Height = 0;
+      if (FFileHelper::LoadFileToArray(Compressed, *FileName))
+      {
+        const EImageFormat Format = ImageWrapperModule->DetectImageFormat(Compressed.GetData(), Compressed.Num());
+        TSharedPtr<IImageWrapper> Wrapper = (Format != EImageFormat::Invalid) ? ImageWrapperModule->CreateImageWrapper(Format) : nullptr;
+        if (Wrapper.IsValid() && Wrapper->SetCompressed(Compressed.GetData(), Compressed.Num()) && Wrapper->GetRaw(ERGBFormat::BGRA, 8, Raw))
+        {
+          Width = static_cast<int32>(Wrapper->GetWidth());
+          Height = static_cast<int32>(Wrapper->GetHeight());
+        }
+      }
+      if (bDeleteAfterImport && Width > 0 && Height > 0)
+      {
+        DeleteImportedFile(FileName);
+      }
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, FileName, Jason = MoveTemp(Jason), Raw = MoveTemp(Raw), Width, Height]() mutable
+        {
+          ASynavisDrone* Drone = WeakThis.Get();
+          if (!Drone || !Drone->WorldSpawner)
+          {
+            return;
+          }
+          if (Width == 0 || Height == 0)
+          {
+            Drone->SendError(FString::Printf(TEXT("could not decode image %s"), *FileName));
+            return;
+          }
+          UTexture2D* Texture = Drone->WorldSpawner->CreateTexture2DFromData(Raw.GetData(), Raw.Num(), Width, Height);
+          Drone->ApplyTexture(Texture, Jason);
+          FUtf8Builder Response(96);
+          FJsonResponseWriter Writer(Response);
+          Writer.BeginObject().Field("type", TEXT("texture")).Field("name", GetStringFieldOr(Jason, TEXT("name"), TEXT("Instance")))
+            .Field("x", Width).Field("y", Height).EndObject();
+          Drone->SendUtf8(Response);
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void ASynavisDrone::SetDropFolder(const FString& Directory)
+{
+  DropFolderWatcher.Reset();
+  DropFolder = Directory;
+  if (Directory.IsEmpty())
+  {
+    return;
+  }
+  TWeakObjectPtr<ASynavisDrone> WeakThis(this);
+  DropFolderWatcher = MakeUnique<FDropFolderWatcher>(Directory, [WeakThis](const FString& FileName)
+    {
+      // the sidecar is read right away, it is consumed together with the file once that is imported
+      const FString SidecarFile = FDropFolderWatcher::FindSidecar(FileName);
+      FString Sidecar;
+      if (!SidecarFile.IsEmpty())
+      {
+        FFileHelper::LoadFileToString(Sidecar, *SidecarFile);
+      }
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, FileName, SidecarFile, Sidecar]()
+        {
+          if (WeakThis.IsValid())
+          {
+            WeakThis->OnDroppedFile(FileName, SidecarFile, Sidecar);
+          }
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, DropFolderExisting);
+  UE_LOG(LogTemp, Log, TEXT("Watching drop folder %s"), *DropFolderWatcher->GetDirectory());
+}
+
+void ASynavisDrone::OnDroppedFile(const FString& FileName, const FString& SidecarFile, const FString& Sidecar)
+{
+  TSharedPtr<FJsonObject> Jason = MakeShareable(new FJsonObject());
+  if (!Sidecar.IsEmpty())
+  {
+    TSharedRef<TJsonReader<TCHAR>> Reader = TJsonReaderFactory<TCHAR>::Create(Sidecar);
+    if (!FJsonSerializer::Deserialize(Reader, Jason) || !Jason.IsValid())
+    {
+      SendError(FString::Printf(TEXT("sidecar %s is not a json object"), *SidecarFile));
+      return;
+    }
+  }
+  const FString Extension = FPaths::GetExtension(FileName).ToLower();
+  if (Extension == TEXT("png") || Extension == TEXT("jpg") || Extension == TEXT("jpeg") || Extension == TEXT("bmp"))
+  {
+    ImportTextureAsync(FileName, Jason, DropFolderConsume);
+  }
+  else if (!WorldSpawner)
+  {
+    SendError(FString::Printf(TEXT("no world spawner for dropped file %s"), *FileName));
+  }
+  else
+  {
+    ImportFileAsync(FileName, Jason, -1, -1, DropFolderConsume);
+  }
+}
+
 void ASynavisDrone::SendResponse(FString Descriptor, double StartTime, int PlayerID)
 {
-  if (StartTime > 0)
+  FUtf8Builder Response(Descriptor.Len() + 48);
+  Response.Append(Descriptor);
+  SendUtf8(Response, StartTime, PlayerID);
+}
+
+void ASynavisDrone::SendUtf8(FUtf8Builder& Response, double StartTime, int PlayerID)
+{
+  while (FCharAnsi::IsWhitespace(Response.Last()))
   {
-    // get the current unix time
-    const double CurrentTime = FPlatformTime::Seconds();
-    // calculate the time difference
-    const int32 TimeDifference = static_cast<int32> ((CurrentTime - StartTime) * 1000);
-    // add the time difference to the descriptor by removing the rbrace at the end and adding the time difference
-    Descriptor.RemoveAt(Descriptor.Len() - 1);
-    Descriptor.Append(FString::Printf(TEXT(", \"processed_time\":%d}"), TimeDifference));
+    Response.RemoveLast();
   }
-  if (PlayerID >= 0)
+  if ((StartTime > 0 || PlayerID >= 0) && Response.Last() == '}')
   {
-    // add the player id to the descriptor by removing the rbrace at the and and adding the player id
-    Descriptor.RemoveAt(Descriptor.Len() - 1);
-    Descriptor.Append(FString::Printf(TEXT(", \"player_id\":%d}"), PlayerID));
+    // the fields are added by removing the rbrace at the end
+    Response.RemoveLast();
+    if (StartTime > 0)
+    {
+      const int32 TimeDifference = static_cast<int32> ((FPlatformTime::Seconds() - StartTime) * 1000);
+      Response.Append(",\"processed_time\":").AppendInt(TimeDifference);
+    }
+    if (PlayerID >= 0)
+    {
+      Response.Append(",\"player_id\":").AppendInt(PlayerID);
+    }
+    Response.Append('}');
   }
-  FString Response(reinterpret_cast<TCHAR*>(TCHAR_TO_UTF8(*Descriptor)));
   // logging the first 20 characters of the response
   if (LogResponses)
-    UE_LOG(LogTemp, Warning, TEXT("Sending response: %s"), *Descriptor.Left(20));
-  OnPixelStreamingResponse.Broadcast(Response);
+    UE_LOG(LogTemp, Warning, TEXT("Sending response: %s"), *Response.ToString(20));
+  OnPixelStreamingResponse.Broadcast(Response.ToTransport());
 }
 
 void ASynavisDrone::SendError(FString Message)
 {
-  FString Response = FString::Printf(TEXT("{\"type\":\"error\",\"message\":\"%s\"}"), *Message);
-  SendResponse(Response);
+  FUtf8Builder Response(Message.Len() + 48);
+  FJsonResponseWriter Writer(Response);
+  Writer.BeginObject().Field("type", TEXT("error")).Field("message", Message).EndObject();
+  SendUtf8(Response);
+}
+
+void ASynavisDrone::WriteTrackedProperties(FJsonResponseWriter& Writer) const
+{
+  for (const auto& Target : TransmissionTargets)
+  {
+    if (IsValid(Target.Object))
+    {
+      Writer.Key(Target.Name);
+      // read the property
+      switch (Target.DataType)
+      {
+      case EDataTypeIndicator::Float:
+        Writer.Value(*Target.Property->ContainerPtrToValuePtr<float>(Target.Object));
+        break;
+      case EDataTypeIndicator::Int:
+        Writer.Value(*Target.Property->ContainerPtrToValuePtr<int32>(Target.Object));
+        break;
+      case EDataTypeIndicator::Bool:
+        Writer.Value(*Target.Property->ContainerPtrToValuePtr<bool>(Target.Object));
+        break;
+      case EDataTypeIndicator::String:
+        Writer.Value(*Target.Property->ContainerPtrToValuePtr<FString>(Target.Object));
+        break;
+      case EDataTypeIndicator::Transform:
+        Writer.Value(PrintFormattedTransform(Target.Object));
+        break;
+      case EDataTypeIndicator::Vector:
+      {
+        const FVector* Vector = Target.Property->ContainerPtrToValuePtr<FVector>(Target.Object);
+        Writer.BeginArray().Value(Vector->X).Value(Vector->Y).Value(Vector->Z).EndArray();
+        break;
+      }
+      case EDataTypeIndicator::Rotator:
+      {
+        const FRotator* Rotator = Target.Property->ContainerPtrToValuePtr<FRotator>(Target.Object);
+        Writer.BeginArray().Value(Rotator->Pitch).Value(Rotator->Yaw).Value(Rotator->Roll).EndArray();
+        break;
+      }
+      default:
+        Writer.Null();
+        break;
+      }
+    }
+  }
+}
+
+FString ASynavisDrone::GetTrackingMeta() const
+{
+  if (TransmissionTargets.Num() == 0)
+  {
+    return FString();
+  }
+  FUtf8Builder Meta(48 * TransmissionTargets.Num());
+  FJsonResponseWriter Writer(Meta);
+  Writer.BeginObject();
+  WriteTrackedProperties(Writer);
+  Writer.EndObject();
+  return Meta.ToString();
+}
+
+void ASynavisDrone::FarmTick()
+{
+  if (bFarmDone)
+  {
+    return;
+  }
+  if (DatasetWriter.IsValid() && DatasetWriter->HasFailed())
+  {
+    // nothing captured from here on would reach the disk
+    bFarmDone = true;
+    UE_LOG(LogTemp, Error, TEXT("Farm mode stops after %lld samples, the dataset could not be written"), DatasetSamples);
+    SendError("farm mode stopped, the dataset could not be written");
+    if (FarmQuit)
+    {
+      FPlatformMisc::RequestExitWithStatus(false, 1);
+    }
+    return;
+  }
+  if (FarmSamples > 0 && DatasetSamples >= FarmSamples)
+  {
+    bFarmDone = true;
+    UE_LOG(LogTemp, Log, TEXT("Farm mode wrote %lld samples in %lld steps"), DatasetSamples, FarmSteps);
+    if (FarmQuit)
+    {
+      FPlatformMisc::RequestExit(false);
+    }
+    return;
+  }
+  ++FarmSteps;
+  ++FarmStepsSinceCapture;
+  // the target counts written samples, frames lost on the way are captured again
+  const bool bWanted = FarmSamples <= 0 || FarmRequested - FarmLost < FarmSamples;
+  // a capture that finds no room is taken in the next step with room, the simulation does not wait for it
+  const bool bRoom = FrameEncoder.IsValid() && ReadbackRing.IsValid()
+    && FrameEncoder->GetQueued() + ReadbackRing->GetInFlight() < EncodeQueueDepth + ReadbackDepth;
+  if (bWanted && bRoom && FarmStepsSinceCapture >= FarmCaptureInterval && SendRawFrame(FarmRequest, false))
+  {
+    ++FarmRequested;
+    FarmStepsSinceCapture = 0;
+  }
 }
 
 void ASynavisDrone::ResetSynavisState()
@@ -1211,6 +1923,19 @@ void ASynavisDrone::ResetSynavisState()
   TransmissionTargets.Empty();
 }
 
+void ASynavisDrone::ReportBufferedAmount(int64 Bytes)
+{
+  if (SendPacer.IsValid())
+  {
+    SendPacer->ReportBufferedAmount(Bytes);
+  }
+}
+
+void ASynavisDrone::ReportPeers(int Peers)
+{
+  ConnectedPeers = FMath::Max(Peers, 0);
+}
+
 // Sets default values
 ASynavisDrone::ASynavisDrone()
 {
@@ -1289,24 +2014,7 @@ ASynavisDrone::ASynavisDrone()
   ParamsObject.AddObjectTypesToQuery(ECollisionChannel::ECC_WorldStatic);
   ParamsTrace.AddIgnoredActor(this);
 
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_128_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_128.scene_128'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_128_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_128.target_128'"));
-  if (SC_128_.Succeeded() && TA_128_.Succeeded()) RenderTargets.Add(128, { SC_128_.Object, TA_128_.Object });
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_256_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_256.scene_256'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_256_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_256.target_256'"));
-  if (SC_256_.Succeeded() && TA_256_.Succeeded()) RenderTargets.Add(256, { SC_256_.Object, TA_256_.Object });
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_512_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_512.scene_512'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_512_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_512.target_512'"));
-  if (SC_512_.Succeeded() && TA_512_.Succeeded()) RenderTargets.Add(512, { SC_512_.Object, TA_512_.Object });
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_1024_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_1024.scene_1024'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_1024_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_1024.target_1024'"));
-  if (SC_1024_.Succeeded() && TA_1024_.Succeeded()) RenderTargets.Add(1024, { SC_1024_.Object, TA_1024_.Object });
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_2048_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_2048.scene_2048'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_2048_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_2048.target_2048'"));
-  if (SC_2048_.Succeeded() && TA_2048_.Succeeded()) RenderTargets.Add(2048, { SC_2048_.Object, TA_2048_.Object });
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> SC_4096_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/scene_4096.scene_4096'"));
-  static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D> TA_4096_(TEXT("/Script/Engine.TextureRenderTarget2D'/SynavisUE/TextureBases/target_4096.target_4096'"));
-  if (SC_4096_.Succeeded() && TA_4096_.Succeeded()) RenderTargets.Add(4096, { SC_4096_.Object, TA_4096_.Object });
+  // other resolutions come from TargetPool once they are asked for
 
   LoadConfig();
   this->SetActorTickEnabled(false);
@@ -1448,7 +2156,7 @@ void ASynavisDrone::StoreCameraBuffer(int BufferNumber, FString NameBase)
 {
   // local blueprint-only function call to save the texture target to a file
   // this is useful for debugging purposes
-  if (BufferNumber < 0 || BufferNumber >= RenderTargets.Num())
+  if (BufferNumber < 0 || BufferNumber > 1)
   {
     UE_LOG(LogTemp, Warning, TEXT("Buffer number %d out of range"), BufferNumber);
     return;
@@ -1459,6 +2167,7 @@ void ASynavisDrone::StoreCameraBuffer(int BufferNumber, FString NameBase)
     UE_LOG(LogTemp, Warning, TEXT("No target found for buffer number %d"), BufferNumber);
     return;
   }
+  CaptureNow(BufferNumber == 0 ? SceneCam : InfoCam);
   FTextureRenderTargetResource* Source = Target->GameThread_GetRenderTargetResource();
   TArray<FColor> CamData;
   FReadSurfaceDataFlags ReadPixelFlags(ERangeCompressionMode::RCM_MinMax);
@@ -1580,7 +2289,11 @@ void ASynavisDrone::ApplyJSONToObject(UObject* Object, FJsonObject* JSON)
   else
   {
     UE_LOG(LogTemp, Warning, TEXT("Property %s not found"), *Name);
-    SendResponse(FString::Printf(TEXT("{\"type\":\"error\",\"message\":\"Property not found\", \"properties\":%s}"), *ListObjectPropertiesAsJSON(Object)));
+    const FString Properties = ListObjectPropertiesAsJSON(Object);
+    FUtf8Builder Response(64 + Properties.Len());
+    FJsonResponseWriter Writer(Response);
+    Writer.BeginObject().Field("type", TEXT("error")).Field("message", TEXT("Property not found")).Key("properties").RawValue(Properties).EndObject();
+    SendUtf8(Response);
   }
 }
 
@@ -1710,18 +2423,21 @@ FString ASynavisDrone::GetJSONFromObjectProperty(UObject* Object, FString Proper
       auto* StringValue = StringProperty->ContainerPtrToValuePtr<FString>(Object);
       if (StringValue)
       {
-        return FString::Printf(TEXT("{\"value\":\"%s\"}"), **StringValue);
+        FUtf8Builder Value(16 + StringValue->Len());
+        FJsonResponseWriter Writer(Value);
+        Writer.BeginObject().Field("value", *StringValue).EndObject();
+        return Value.ToString();
       }
     }
     else
     {
       UE_LOG(LogTemp, Warning, TEXT("Property %s not vector, float, bool, or string"), *PropertyName);
-      SendResponse(TEXT("{\"type\":\"error\",\"message\":\"Property not vector, float, bool, or string\"}"));
+      SendError("Property not vector, float, bool, or string");
       return TEXT("{}");
     }
   }
   UE_LOG(LogTemp, Warning, TEXT("Property %s not found"), *PropertyName);
-  SendResponse(TEXT("{\"type\":\"error\",\"message\":\"Property not found\"}"));
+  SendError("Property not found");
   return TEXT("{}");
 }
 
@@ -1736,93 +2452,365 @@ void ASynavisDrone::UpdateCamera()
   }
   SceneCam->TextureTarget = SceneCamTarget;
   InfoCam->TextureTarget = InfoCamTarget;
+  const bool bHalf = (InfoTargetFormat == TEXT("half"));
+  if ((bHalf || InfoTargetFormat == TEXT("float")) && InfoCamTarget)
+  {
+    // the depth capture bypasses the info material and writes centimetres into the first channel
+    const ETextureRenderTargetFormat Format = bHalf ? RTF_R16f : RTF_R32f;
+    if (!PreciseInfoTarget || PreciseInfoTarget->RenderTargetFormat != Format
+      || PreciseInfoTarget->SizeX != InfoCamTarget->SizeX || PreciseInfoTarget->SizeY != InfoCamTarget->SizeY)
+    {
+      FRenderTargetPool& Pool = GetTargetPool();
+      UTextureRenderTarget2D* Precise = Pool.Acquire(InfoCamTarget->SizeX, InfoCamTarget->SizeY, Format, this);
+      Pool.Release(PreciseInfoTarget);
+      PreciseInfoTarget = Precise;
+    }
+    InfoCam->TextureTarget = PreciseInfoTarget;
+    InfoCam->CaptureSource = ESceneCaptureSource::SCS_SceneDepth;
+  }
+  else
+  {
+    InfoCam->CaptureSource = InfoColorSource;
+    if (PreciseInfoTarget)
+    {
+      // kept by the pool in case depth is switched on again
+      GetTargetPool().Release(PreciseInfoTarget);
+      PreciseInfoTarget = nullptr;
+    }
+  }
 }
 
-void ASynavisDrone::SendRawFrame(TSharedPtr<FJsonObject> Jason, bool bFreezeID)
+bool ASynavisDrone::SetInfoTargetFormat(const FString& Format)
 {
-
-  if (this->DataChannelMaxSize < 0)
+  if (Format != TEXT("color") && Format != TEXT("half") && Format != TEXT("float"))
   {
-    return;
+    return false;
   }
+  InfoTargetFormat = Format;
+  UpdateCamera();
+  return true;
+}
 
+bool ASynavisDrone::SendRawFrame(TSharedPtr<FJsonObject> Jason, bool bFreezeID)
+{
   FString ImageTarget = GetStringFieldOr(Jason, TEXT("camera"), TEXT("scene"));
+  FFrameCodec Codec;
+  const FString Sink = GetStringFieldOr(Jason, TEXT("sink"), ImageTarget.EndsWith(TEXT("scene")) ? SceneSink : InfoSink);
+  if (!FFrameCodec::ParseSink(Sink, Codec))
+  {
+    SendError(FString::Printf(TEXT("unknown frame sink %s"), *Sink));
+    return false;
+  }
+  // frames only go to the client once it told us the size of the data channel
+  Codec.bNetwork = Codec.bNetwork && this->DataChannelMaxSize >= 0;
+  if (!Codec.bNetwork && !Codec.bDataset)
+  {
+    return false;
+  }
+  const FString Encoding = GetStringFieldOr(Jason, TEXT("encoding"), FrameEncoding);
+  if (!FFrameCodec::Parse(Encoding, GetIntFieldOr(Jason, TEXT("quality"), FrameQuality), Codec))
+  {
+    SendError(FString::Printf(TEXT("unknown frame encoding %s"), *Encoding));
+    return false;
+  }
+  const FString Channel = GetStringFieldOr(Jason, TEXT("channel"), TEXT("color"));
+  if (!FFrameCodec::ParseChannel(Channel, Codec.Channel))
+  {
+    SendError(FString::Printf(TEXT("unknown frame channel %s"), *Channel));
+    return false;
+  }
+  const bool bPair = (ImageTarget == TEXT("dual"));
+  // only the info camera of the drone captures depth
+  if (FFrameCodec::IsDepth(Codec.Channel) && ((!bPair && ImageTarget != TEXT("info")) || InfoTargetFormat == TEXT("color")))
+  {
+    SendError("depth frames need the info camera in half or float format");
+    return false;
+  }
+  Codec.DepthUnit = GetDoubleFieldOr(Jason, TEXT("depthunit"), Codec.DepthUnit);
+  Codec.bDelta = GetBoolFieldOr(Jason, TEXT("delta"), FrameDelta);
+  Codec.TileSize = GetIntFieldOr(Jason, TEXT("tile"), Codec.TileSize);
+  Codec.KeyframeInterval = DeltaKeyframeInterval;
+  Codec.bKeyframe = GetBoolFieldOr(Jason, TEXT("keyframe"), false);
+  if (!ParseRegion(Jason, Codec))
+  {
+    SendError("roi needs [x,y,w,h] with a positive size and scale must be in (0,1]");
+    return false;
+  }
+  if (bPair ? !RegionHitsTarget(SceneCam, Codec) || !RegionHitsTarget(InfoCam, Codec) : !RegionHitsTarget(FindCaptureCamera(ImageTarget), Codec))
+  {
+    SendError("roi lies outside of the camera target");
+    return false;
+  }
+  if (bPair)
+  {
+    // the channel only applies to the info camera, the scene camera always sends colour
+    Codec.bPaired = true;
+    FFrameCodec SceneCodec = Codec;
+    SceneCodec.Channel = EFrameChannel::Color;
+    if (!Jason.IsValid() || !Jason->HasField(TEXT("sink")))
+    {
+      // without a sink in the request each camera follows its own
+      FFrameCodec::ParseSink(SceneSink, SceneCodec);
+      SceneCodec.bNetwork = SceneCodec.bNetwork && this->DataChannelMaxSize >= 0;
+    }
+    return RequestFramePair(bFreezeID, SceneCodec, Codec);
+  }
+  else
+  {
+    return RequestFrame(ImageTarget, EFramePurpose::Frame, bFreezeID, Codec);
+  }
+}
 
-  auto* rtarget = (ImageTarget == TEXT("scene"))
-    ? SceneCam->TextureTarget->GameThread_GetRenderTargetResource() : InfoCam->TextureTarget->GameThread_GetRenderTargetResource();
-  auto* CameraTarget = (ImageTarget == TEXT("scene")) ? SceneCam : InfoCam;
-
-  union
-  {
-    struct
-    {
-      float fov{ 3.f };
-      int width{};
-      int height{};
-      int id{};
-      float pos[3]{ 0.f, 0.f, 0.f };
-      float rot[3]{ 0.f, 0.f, 0.f };
-    } data{};
-    uint8_t rawdata[sizeof(data)];
-  } package;
-  package.data.fov = CameraTarget->FOVAngle;
-  package.data.width = CameraTarget->TextureTarget->GetSurfaceWidth();
-  package.data.height = CameraTarget->TextureTarget->GetSurfaceHeight();
-  package.data.pos[0] = CameraTarget->GetComponentLocation().X;
-  package.data.pos[1] = CameraTarget->GetComponentLocation().Y;
-  package.data.pos[2] = CameraTarget->GetComponentLocation().Z;
-  package.data.rot[0] = CameraTarget->GetComponentRotation().Pitch;
-  package.data.rot[1] = CameraTarget->GetComponentRotation().Yaw;
-  package.data.rot[2] = CameraTarget->GetComponentRotation().Roll;
-  package.data.id = (bFreezeID) ? LastTransmissionID : this->GetTransmissionID();
-  FString packageString = FBase64::Encode(package.rawdata, sizeof(package.rawdata));
-
-  TArray<FColor> CData;
-
-  FReadSurfaceDataFlags ReadPixelFlags(RCM_UNorm);
-  ReadPixelFlags.SetLinearToGamma(true);
-  rtarget->ReadPixels(CData, ReadPixelFlags);
+bool ASynavisDrone::RegionHitsTarget(USceneCaptureComponent2D* Camera, const FFrameCodec& Codec) const
+{
+  if (Codec.Roi.Width() <= 0 || Codec.Roi.Height() <= 0 || !Camera || !Camera->TextureTarget)
+  {
+    // no crop, or no target to check against, the request fails later on its own
+    return true;
+  }
+  FIntRect Clipped = Codec.Roi;
+  Clipped.Clip(FIntRect(0, 0, Camera->TextureTarget->SizeX, Camera->TextureTarget->SizeY));
+  return Clipped.Width() > 0 && Clipped.Height() > 0;
+}
 
-  // print transmission ID as hex 
-  FString TransmissionID = FString::Printf(TEXT("%x"), this->GetTransmissionID());
+void ASynavisDrone::AppendReceptionShape(FUtf8Builder& Response) const
+{
+  Response.Append(",\"w\":").AppendInt(ReceptionWidth).Append(",\"h\":").AppendInt(ReceptionHeight);
+  if (ReceptionRoi.Width() > 0 && ReceptionRoi.Height() > 0)
+  {
+    Response.Append(",\"roi\":[").AppendInt(ReceptionRoi.Min.X).Append(',').AppendInt(ReceptionRoi.Min.Y).Append(',');
+    Response.AppendInt(ReceptionRoi.Width()).Append(',').AppendInt(ReceptionRoi.Height()).Append(']');
+  }
+}
 
-  FString RenderTargetString = FBase64::Encode(reinterpret_cast<uint8*>(CData.GetData()), CData.Num() * sizeof(FColor));
+FFramePose ASynavisDrone::MakePose(USceneCaptureComponent2D* Camera, int32 ID) const
+{
+  FFramePose Pose;
+  Pose.FOV = Camera->FOVAngle;
+  Pose.Width = Camera->TextureTarget->GetSurfaceWidth();
+  Pose.Height = Camera->TextureTarget->GetSurfaceHeight();
+  Pose.Position[0] = Camera->GetComponentLocation().X;
+  Pose.Position[1] = Camera->GetComponentLocation().Y;
+  Pose.Position[2] = Camera->GetComponentLocation().Z;
+  Pose.Rotation[0] = Camera->GetComponentRotation().Pitch;
+  Pose.Rotation[1] = Camera->GetComponentRotation().Yaw;
+  Pose.Rotation[2] = Camera->GetComponentRotation().Roll;
+  Pose.ID = ID;
+  return Pose;
+}
 
-  FString Base = TEXT("{\"t\":\"f\",\"m\":\"") + packageString + TEXT("\",\"c\":\"");
-  FString End = TEXT("\"}");
-  int numChunks = 1;
-  // lambda for the length of an int in digits
-  const auto intlen = [](int i) -> int
+void ASynavisDrone::ApplyCaptureMode()
+{
+  TArray<USceneCaptureComponent2D*, TInlineAllocator<8>> Cameras = { SceneCam, InfoCam };
+  for (const FCaptureScheduler::FSource& Source : CaptureScheduler.GetSources())
+  {
+    if (Source.Camera.IsValid())
     {
-      int len = 0;
-      while (i > 0)
+      Cameras.AddUnique(Source.Camera.Get());
+    }
+  }
+  for (USceneCaptureComponent2D* Camera : Cameras)
+  {
+    Camera->bCaptureEveryFrame = CapturePreview;
+    Camera->bCaptureOnMovement = false;
+    // eye adaptation and temporal effects carry over between renders that are frames apart
+    Camera->bAlwaysPersistRenderingState = true;
+  }
+}
+
+void ASynavisDrone::CaptureNow(USceneCaptureComponent2D* Camera)
+{
+  if (Camera->bCaptureEveryFrame)
+  {
+    return;
+  }
+  uint64& LastFrame = LastCaptureFrame.FindOrAdd(Camera, MAX_uint64);
+  if (LastFrame == GFrameCounter)
+  {
+    return;
+  }
+  // the render commands go out before the copy of the readback, so the frame shows this very pose
+  Camera->CaptureScene();
+  LastFrame = GFrameCounter;
+  ++CaptureCount;
+}
+
+bool ASynavisDrone::RequestFramePair(bool bFreezeID, const FFrameCodec& SceneCodec, const FFrameCodec& InfoCodec)
+{
+  if (!ReadbackRing.IsValid() || !SceneCam->TextureTarget || !InfoCam->TextureTarget)
+  {
+    return false;
+  }
+  // half a pair is of no use, so both copies have to fit
+  if (!ReadbackRing->CanRequest(2))
+  {
+    ReadbackDrops = ReadbackRing->GetDropped();
+    return false;
+  }
+  CaptureNow(SceneCam);
+  CaptureNow(InfoCam);
+  // both copies are enqueued in this tick and therefore read the same render of both cameras
+  const int32 ID = bFreezeID ? LastTransmissionID : GetTransmissionID();
+  const FFramePose ScenePose = MakePose(SceneCam, ID);
+  // one pose package for both, only the size follows the info target
+  FFramePose InfoPose = ScenePose;
+  InfoPose.Width = InfoCam->TextureTarget->GetSurfaceWidth();
+  InfoPose.Height = InfoCam->TextureTarget->GetSurfaceHeight();
+  const FString Meta = (SceneCodec.bDataset || InfoCodec.bDataset) ? GetTrackingMeta() : FString();
+  if (PendingPair.IsSet() && ReadbackRing->GetInFlight() == 0)
+  {
+    // nothing is left in the ring that could complete the half that waits
+    PendingPair.Reset();
+  }
+  // frozen ids repeat, the serial tells the halves of different requests apart
+  ++PairSerial;
+  FFrameCodec SceneHalf = SceneCodec;
+  FFrameCodec InfoHalf = InfoCodec;
+  SceneHalf.PairSerial = PairSerial;
+  InfoHalf.PairSerial = PairSerial;
+  ReadbackRing->Request(SceneCam->TextureTarget, ScenePose, EFramePurpose::Frame, TEXT("scene"), SceneHalf, Meta);
+  ReadbackRing->Request(InfoCam->TextureTarget, InfoPose, EFramePurpose::Frame, TEXT("info"), InfoHalf, Meta);
+  return true;
+}
+
+bool ASynavisDrone::RequestFrame(const FString& Camera, EFramePurpose Purpose, bool bFreezeID, const FFrameCodec& Codec)
+{
+  auto* CameraTarget = FindCaptureCamera(Camera);
+  if (!ReadbackRing.IsValid() || !CameraTarget || !CameraTarget->TextureTarget)
+  {
+    return false;
+  }
+  if (!ReadbackRing->CanRequest(1))
+  {
+    // no render for a frame that would be dropped anyway
+    ReadbackDrops = ReadbackRing->GetDropped();
+    return false;
+  }
+  CaptureNow(CameraTarget);
+  // the pose is taken now, the pixels arrive a few frames later
+  const FFramePose Pose = MakePose(CameraTarget, (bFreezeID) ? LastTransmissionID : this->GetTransmissionID());
+  if (!ReadbackRing->Request(CameraTarget->TextureTarget, Pose, Purpose, Camera, Codec, Codec.bDataset ? GetTrackingMeta() : FString()))
+  {
+    ReadbackDrops = ReadbackRing->GetDropped();
+    UE_LOG(LogTemp, Verbose, TEXT("Dropped frame %d, all readbacks are in flight"), Pose.ID);
+    return false;
+  }
+  return true;
+}
+
+void ASynavisDrone::OnFrameReadback(FReadbackFrame&& Frame)
+{
+  if (Frame.Pixels.Num() == 0 && Frame.Depth.Num() == 0)
+  {
+    if (FarmMode && Frame.Codec.bDataset)
+    {
+      ++FarmLost;
+    }
+    if (Frame.Codec.bPaired && PendingPair.IsSet() && PendingPair->Codec.PairSerial == Frame.Codec.PairSerial)
+    {
+      // the other half has no partner anymore
+      PendingPair.Reset();
+    }
+    SendError("Could not read pixels from camera");
+    return;
+  }
+  if (Frame.Purpose == EFramePurpose::Frame && Frame.Codec.bPaired)
+  {
+    // the ring hands out frames in request order, so the partner of a pair follows right after it
+    if (PendingPair.IsSet() && PendingPair->Codec.PairSerial == Frame.Codec.PairSerial && PendingPair->Pose.ID == Frame.Pose.ID
+      && PendingPair->Camera != Frame.Camera)
+    {
+      if (FrameEncoder.IsValid())
       {
-        i /= 10;
-        len++;
+        FrameEncoder->SubmitPair(MoveTemp(PendingPair.GetValue()), MoveTemp(Frame), DataChannelMaxSize);
       }
-      return len;
-    };
-  while (3 + (2 * intlen(numChunks)) + Base.Len() * numChunks + End.Len() * numChunks + RenderTargetString.Len() / numChunks > DataChannelMaxSize)
+      PendingPair.Reset();
+    }
+    else
+    {
+      // a half of another request that still waits lost its partner
+      PendingPair = MoveTemp(Frame);
+    }
+    return;
+  }
+  if (Frame.Purpose == EFramePurpose::Frame)
   {
-    numChunks++;
+    if (FrameEncoder.IsValid())
+    {
+      FrameEncoder->Submit(MoveTemp(Frame), DataChannelMaxSize);
+    }
+    return;
   }
-  // make a task in the game thread to send the chunks
-  FGraphEventRef Task = FFunctionGraphTask::CreateAndDispatchWhenReady(
-    [RenderTargetString = std::move(RenderTargetString), Base = std::move(Base), End = std::move(End),
-    SendResponse = std::bind(&ASynavisDrone::SendResponse, this, std::placeholders::_1, -1.0, -1),
-    Delay = this->DataChannelBufferDelay, numChunks
-    ]()
+  // the encoder thread scales the other frames, receive frames are scaled and encoded on a worker
+  TWeakObjectPtr<ASynavisDrone> WeakThis(this);
+  const bool bDump = IsInEditor();
+  FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Frame = MoveTemp(Frame), Serial = ReceptionSerial, bDump]() mutable
     {
-      for (int i = 0; i < numChunks; i++)
+      FFrameEncoder::Rescale(Frame);
+      FString Encoded = FBase64::Encode(reinterpret_cast<uint8*>(Frame.Pixels.GetData()), Frame.Pixels.Num() * sizeof(FColor));
+      if (bDump)
       {
-        int start = i * RenderTargetString.Len() / numChunks;
-        int end = (i + 1) * RenderTargetString.Len() / numChunks;
-        FString Chunk = Base + FString::FromInt(i) + TEXT("/") + FString::FromInt(numChunks) + TEXT("\",\"d\":\"") + RenderTargetString.Mid(start, end - start) + End;
-        SendResponse(Chunk);
-        // we need to wait a bit, otherwise the chunks might jam
-        FPlatformProcess::Sleep(Delay);
+        // split every 100th character into a new line
+        FString OutputString;
+        OutputString.Reserve(Encoded.Len() + Encoded.Len() / 100 + 1);
+        for (int32 i = 0; i < Encoded.Len(); i += 100)
+        {
+          OutputString.Append(Encoded.Mid(i, 100)).AppendChar('\n');
+        }
+        auto unixtime = FDateTime::Now().ToUnixTimestamp();
+        auto FileName = FPaths::ProjectDir() + "/Synavisue" + FString::FromInt(unixtime) + ".json";
+        FFileHelper::SaveStringToFile(OutputString, *FileName);
       }
-    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundHiPriTask);
+      UE_LOG(LogTemp, Log, TEXT("Read %d pixels from camera amounting to sizes of %d->%d"), Frame.Pixels.Num(), Frame.Pixels.Num() * sizeof(FColor), Encoded.Len());
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, Serial, Encoded = MoveTemp(Encoded), Width = Frame.Pose.Width, Height = Frame.Pose.Height,
+        Roi = Frame.Codec.Roi]() mutable
+        {
+          ASynavisDrone* Drone = WeakThis.Get();
+          if (Drone && Drone->ReceptionSerial == Serial)
+          {
+            Drone->StartReception(MoveTemp(Encoded), Width, Height, Roi);
+          }
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void ASynavisDrone::StartReception(FString&& Encoded, int32 Width, int32 Height, const FIntRect& Roi)
+{
+  ReceptionFormat = MoveTemp(Encoded);
+  ReceptionWidth = Width;
+  ReceptionHeight = Height;
+  ReceptionRoi = Roi;
+  // the chunk header, its numbers aside, is the same for every chunk
+  FUtf8Builder Header(128);
+  Header.Append("{\"type\":\"receive\",\"data\":\"\", \"chunk\":\"/\"");
+  AppendReceptionShape(Header);
+  Header.Append('}');
+  const int32 Chunks = FFrameEncoder::GetChunkCount(ReceptionFormat.Len(), 1, Header.Len(), DataChannelMaxSize);
+  if (Chunks == 0)
+  {
+    ReceptionFormat.Empty();
+    ReceptionBufferSize = 0;
+    SendError(FString::Printf(TEXT("receive chunks do not fit into messages of %d bytes"), DataChannelMaxSize));
+    return;
+  }
+  ReceptionBufferSize = Chunks;
+  ReceptionBufferOffset = 0;
+  LastProgress = 0;
+}
+
+void ASynavisDrone::BuildReceptionChunk(uint64 Chunk, FUtf8Builder& Response) const
+{
+  // chunk i covers [Len*i/n, Len*(i+1)/n), none is more than one character longer than another
+  const int64 Length = ReceptionFormat.Len();
+  const int64 First = Length * Chunk / ReceptionBufferSize;
+  const int64 Last = Length * (Chunk + 1) / ReceptionBufferSize;
+  // the reception format is base64, it goes into the message as it is
+  const FStringView Data = FStringView(ReceptionFormat).Mid(static_cast<int32>(First), static_cast<int32>(Last - First));
+  Response.Reserve(Data.Len() + 128);
+  Response.Append("{\"type\":\"receive\",\"data\":\"").Append(Data).Append("\", \"chunk\":\"");
+  Response.AppendInt(Chunk).Append('/').AppendInt(ReceptionBufferSize).Append('"');
+  AppendReceptionShape(Response);
+  Response.Append('}');
 }
 
 const bool ASynavisDrone::IsInEditor() const
@@ -1836,16 +2824,167 @@ const bool ASynavisDrone::IsInEditor() const
 
 void ASynavisDrone::SetCameraResolution(int Resolution)
 {
-  if (RenderTargets.Contains(Resolution))
+  SetCameraSize(Resolution, Resolution);
+}
+
+FRenderTargetPool& ASynavisDrone::GetTargetPool()
+{
+  if (!TargetPool.IsValid())
   {
-    InfoCamTarget = RenderTargets[Resolution].Key;
-    SceneCamTarget = RenderTargets[Resolution].Value;
-    UpdateCamera();
+    TargetPool = MakeUnique<FRenderTargetPool>(static_cast<int64>(RenderTargetBudget) << 20);
+  }
+  return *TargetPool;
+}
+
+bool ASynavisDrone::SetCameraSize(int Width, int Height)
+{
+  if (!ResizeCaptureTarget(SceneCam, Width, Height) || !ResizeCaptureTarget(InfoCam, Width, Height))
+  {
+    return false;
+  }
+  UpdateCamera();
+  return true;
+}
+
+bool ASynavisDrone::ResizeCaptureTarget(USceneCaptureComponent2D* Camera, int Width, int Height)
+{
+  const int32 MaxSize = static_cast<int32>(GetMax2DTextureDimension());
+  if (!Camera || Width <= 0 || Height <= 0 || Width > MaxSize || Height > MaxSize)
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Resolution %dx%d not possible, at most %d per side"), Width, Height, MaxSize);
+    return false;
+  }
+  // scene and info camera keep their targets in members, UpdateCamera hands them over
+  UTextureRenderTarget2D* Current = (Camera == SceneCam) ? SceneCamTarget : (Camera == InfoCam) ? InfoCamTarget : Camera->TextureTarget.Get();
+  if (Current && Current->SizeX == Width && Current->SizeY == Height)
+  {
+    return true;
+  }
+  // the new target takes the format of the current one, which starts out as the asset
+  const ETextureRenderTargetFormat Format = Current ? Current->RenderTargetFormat.GetValue() : RTF_RGBA8;
+  FRenderTargetPool& Pool = GetTargetPool();
+  Pool.SetBudget(static_cast<int64>(RenderTargetBudget) << 20);
+  UTextureRenderTarget2D* Target = Pool.Acquire(Width, Height, Format, this);
+  Pool.Release(Current);
+  if (Camera == SceneCam)
+  {
+    SceneCamTarget = Target;
+  }
+  else if (Camera == InfoCam)
+  {
+    InfoCamTarget = Target;
   }
   else
   {
-    UE_LOG(LogTemp, Warning, TEXT("Resolution %d not found"), Resolution);
+    Camera->TextureTarget = Target;
+  }
+  return true;
+}
+
+bool ASynavisDrone::RegisterCaptureSource(USceneCaptureComponent2D* Camera, const FString& Name, float Rate, int Priority)
+{
+  if (Rate <= 0.f)
+  {
+    const FCaptureScheduler::FSource* Source = CaptureScheduler.Find(Name);
+    USceneCaptureComponent2D* Previous = Source ? Source->Camera.Get() : nullptr;
+    if (!CaptureScheduler.Unregister(Name))
+    {
+      return false;
+    }
+    const bool bStillUsed = CaptureScheduler.GetSources().ContainsByPredicate(
+      [Previous](const FCaptureScheduler::FSource& Other) { return Other.Camera.Get() == Previous; });
+    TPair<bool, bool> Mode;
+    if (Previous && !bStillUsed && ForeignCaptureModes.RemoveAndCopyValue(Previous, Mode))
+    {
+      Previous->bCaptureEveryFrame = Mode.Key;
+      Previous->bCaptureOnMovement = Mode.Value;
+    }
+    return true;
+  }
+  if (!Camera)
+  {
+    return false;
+  }
+  const FCaptureScheduler::FSource* Existing = CaptureScheduler.Find(Name);
+  if (Existing && Existing->Camera.Get() != Camera)
+  {
+    // the name moves to another camera, the one it leaves gets its own mode back
+    RegisterCaptureSource(nullptr, Name, 0.f);
+  }
+  if (!Camera->TextureTarget && !ResizeCaptureTarget(Camera, SceneCamTarget ? SceneCamTarget->SizeX : RawDataResolution,
+    SceneCamTarget ? SceneCamTarget->SizeY : RawDataResolution))
+  {
+    return false;
+  }
+  if (Camera != SceneCam && Camera != InfoCam && !ForeignCaptureModes.Contains(Camera))
+  {
+    // data cameras render on their own terms again once nothing schedules them
+    ForeignCaptureModes.Add(Camera, TPair<bool, bool>(Camera->bCaptureEveryFrame, Camera->bCaptureOnMovement));
+  }
+  TSharedPtr<FJsonObject> Request = MakeShared<FJsonObject>();
+  Request->SetStringField(TEXT("camera"), Name);
+  CaptureScheduler.Register(Name, Camera, Rate, Priority, Request, GetWorld() ? GetWorld()->GetTimeSeconds() : 0.0);
+  ApplyCaptureMode();
+  return true;
+}
+
+USceneCaptureComponent2D* ASynavisDrone::FindCaptureCamera(const FString& Name)
+{
+  if (Name == TEXT("scene"))
+  {
+    return SceneCam;
+  }
+  if (Name == TEXT("info"))
+  {
+    return InfoCam;
+  }
+  if (FCaptureScheduler::FSource* Source = CaptureScheduler.Find(Name))
+  {
+    return Source->Camera.Get();
+  }
+  FString Owner, View;
+  if (!Name.Split(TEXT("/"), &Owner, &View))
+  {
+    return nullptr;
+  }
+  for (TObjectIterator<UDataCamera> It; It; ++It)
+  {
+    if (It->GetWorld() == GetWorld() && It->GetName() == Owner)
+    {
+      return (View == TEXT("scene")) ? It->SceneCam : (View == TEXT("info")) ? It->InfoCam : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+void ASynavisDrone::RunCaptureSchedule()
+{
+  CaptureScheduler.MaxCaptures = CaptureBudget;
+  CaptureScheduler.GpuBudget = CaptureGpuBudget;
+  const double GpuMilliseconds = CaptureGpuBudget > 0.f ? FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()) : 0.0;
+  const bool bPeer = HasPeer() && DataChannelMaxSize >= 0;
+  for (FCaptureScheduler::FSource& Source : CaptureScheduler.GetSources())
+  {
+    // a source that only streams has nowhere to go without a client, it waits instead of missing every deadline
+    FFrameCodec Codec;
+    const FString Sink = GetStringFieldOr(Source.Request, TEXT("sink"), Source.Name.EndsWith(TEXT("scene")) ? SceneSink : InfoSink);
+    Source.bParked = !bPeer && FFrameCodec::ParseSink(Sink, Codec) && !Codec.bDataset;
+  }
+  TArray<FCaptureScheduler::FSource*> Due;
+  CaptureScheduler.Select(GetWorld()->GetTimeSeconds(), GpuMilliseconds, Due);
+  for (FCaptureScheduler::FSource* Source : Due)
+  {
+    // a due frame that was dropped is not retried, its deadline is lost
+    if (SendRawFrame(Source->Request, false))
+    {
+      CaptureScheduler.Complete(*Source);
+    }
+    else
+    {
+      CaptureScheduler.Miss(*Source);
+    }
   }
+  CaptureMisses = static_cast<int>(CaptureScheduler.GetMisses());
 }
 
 int32_t ASynavisDrone::GetDecodedSize(char* Source, int32_t Length)
@@ -1879,6 +3018,12 @@ void ASynavisDrone::BeginPlay()
   Flyspace->DetachFromComponent(FDetachmentTransformRules::KeepWorldTransform);
   LoadFromJSON();
   auto* world = GetWorld();
+  InfoColorSource = InfoCam->CaptureSource;
+  ApplyCaptureMode();
+  if (InfoTargetFormat != TEXT("color"))
+  {
+    UpdateCamera();
+  }
   CallibratedPostprocess = UMaterialInstanceDynamic::Create(PostProcessMat, this);
   InfoCam->AddOrUpdateBlendable(CallibratedPostprocess, 1.f);
   CallibratedPostprocess->SetScalarParameterValue(TEXT("DistanceScale"), DistanceScale);
@@ -1887,7 +3032,7 @@ void ASynavisDrone::BeginPlay()
   CallibratedPostprocess->SetVectorParameterValue(TEXT("BinScale"), (FLinearColor)BinScale);
   UE_LOG(LogTemp, Warning, TEXT("L:(%f,%f,%f) - E:(%f,%f,%f)"), SpaceOrigin.X, SpaceOrigin.Y, SpaceOrigin.Z, SpaceExtend.X, SpaceExtend.Y, SpaceExtend.Z);
   NextLocation = UKismetMathLibrary::RandomPointInBoundingBox(Flyspace->GetComponentLocation(), Flyspace->GetScaledBoxExtent());
-  FrameCaptureCounter = FrameCaptureTime;
+  RegisterCaptureSource(SceneCam, TEXT("scene"), FrameCaptureTime > 0.f ? 1.f / FrameCaptureTime : 0.f);
 
   SceneCam->PostProcessSettings.AutoExposureBias = this->AutoExposureBias;
   if (Rain)
@@ -1982,6 +3127,67 @@ void ASynavisDrone::BeginPlay()
     InfoCam->PostProcessSettings.DepthOfFieldMinFstop = 2.0f;
   }
 
+  if (UseGeometryCache)
+  {
+    const FString CacheDirectory = GeometryCacheDirectory.IsEmpty()
+      ? FPaths::ProjectSavedDir() / TEXT("SynavisGeometryCache") : GeometryCacheDirectory;
+    GeometryCache = MakeShared<FGeometryCache, ESPMode::ThreadSafe>(CacheDirectory);
+  }
+
+  ReadbackRing = MakeUnique<FFrameReadbackRing>(ReadbackDepth);
+  SendPacer = MakeShared<FSendPacer, ESPMode::ThreadSafe>(SendRateInitial, SendRateMin, SendRateMax);
+  // the encoder lives shorter than the drone, see EndPlay
+  // cluster nodes start straight into farm mode from the command line
+  const TCHAR* CommandLine = FCommandLine::Get();
+  FarmMode = FarmMode || FParse::Param(CommandLine, TEXT("SynavisFarm"));
+  FParse::Value(CommandLine, TEXT("SynavisFarmTimestep="), FarmTimestep);
+  FParse::Value(CommandLine, TEXT("SynavisFarmInterval="), FarmCaptureInterval);
+  FParse::Value(CommandLine, TEXT("SynavisFarmSamples="), FarmSamples);
+  FParse::Value(CommandLine, TEXT("SynavisFarmCamera="), FarmCamera);
+  FParse::Value(CommandLine, TEXT("SynavisDataset="), DatasetDirectory);
+  if (FarmMode)
+  {
+    // simulated time no longer follows the wall clock, so the engine neither waits nor smooths
+    FApp::SetUseFixedTimeStep(true);
+    FApp::SetFixedDeltaTime(FarmTimestep > 0.f ? FarmTimestep : 1.f / 30.f);
+    GEngine->bSmoothFrameRate = false;
+    GEngine->SetMaxFPS(0.f);
+    FrameCaptureTime = 0.f;
+    FarmRequest = MakeShared<FJsonObject>();
+    FarmRequest->SetStringField(TEXT("camera"), FarmCamera);
+    FarmRequest->SetStringField(TEXT("sink"), TEXT("dataset"));
+    UE_LOG(LogTemp, Log, TEXT("Farm mode, capturing %s every %d steps of %f s"), *FarmCamera, FarmCaptureInterval, FApp::GetFixedDeltaTime());
+  }
+
+  EDatasetSync Sync = EDatasetSync::Shard;
+  if (!FDatasetWriter::ParseSync(DatasetSync, Sync))
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Unknown dataset sync %s, syncing per shard"), *DatasetSync);
+  }
+  // every session, and every rank of a cluster job, writes its own shards
+  FString DatasetPrefix = FString::Printf(TEXT("synavis-%lld"), FDateTime::UtcNow().ToUnixTimestamp());
+  const FString Rank = FPlatformMisc::GetEnvironmentVariable(TEXT("OMPI_COMM_WORLD_RANK"));
+  if (!Rank.IsEmpty())
+  {
+    DatasetPrefix += TEXT("-r") + Rank;
+  }
+  // the writer only creates files once the first sample arrives
+  DatasetWriter = MakeShared<FDatasetWriter, ESPMode::ThreadSafe>(
+    DatasetDirectory.IsEmpty() ? FPaths::ProjectSavedDir() / TEXT("SynavisDatasets") : DatasetDirectory,
+    DatasetPrefix, static_cast<int64>(DatasetShardSize) << 20, Sync);
+  // in farm mode whatever the readback ring holds fits into the queue, FarmTick waits for room instead of losing frames
+  FrameEncoder = MakeUnique<FFrameEncoder>([this](FUtf8Builder& Message) { SendUtf8(Message); }, SendPacer,
+    FarmMode ? EncodeQueueDepth + ReadbackDepth : EncodeQueueDepth, DatasetWriter);
+  if (FFrameReadbackRing::IsSynthetic())
+  {
+    UE_LOG(LogTemp, Log, TEXT("No rendering RHI, frames are generated test patterns"));
+  }
+
+  if (!DropFolder.IsEmpty())
+  {
+    SetDropFolder(DropFolder);
+  }
+
   this->WorldSpawner = Cast<AWorldSpawner>(UGameplayStatics::GetActorOfClass(world, AWorldSpawner::StaticClass()));
   if (WorldSpawner)
   {
@@ -2051,9 +3257,14 @@ void ASynavisDrone::ApplyOrStoreTexture(TSharedPtr<FJsonObject> Json)
   TSharedPtr<FJsonObject> dimension = Json->GetObjectField(TEXT("dimension"));
   x = dimension->GetIntegerField(TEXT("x"));
   y = dimension->GetIntegerField(TEXT("y"));
+  UTexture2D* Texture = WorldSpawner->CreateTexture2DFromData(ReceptionBuffer, this->ReceptionBufferSize, x, y);
+  ApplyTexture(Texture, Json);
+}
+
+void ASynavisDrone::ApplyTexture(UTexture2D* Texture, TSharedPtr<FJsonObject> Json)
+{
   FString target = GetStringFieldOr(Json, TEXT("target"), "Diffuse");
   FString name = GetStringFieldOr(Json, TEXT("name"), "Instance");
-  UTexture2D* Texture = WorldSpawner->CreateTexture2DFromData(ReceptionBuffer, this->ReceptionBufferSize, x, y);
   UMaterialInstanceDynamic* MatInst = WorldSpawner->GenerateInstanceFromName(name, false);
   MatInst->SetTextureParameterValue(*target, Texture);
 
@@ -2097,11 +3308,20 @@ void ASynavisDrone::EnsureDistancePreservation()
 void ASynavisDrone::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
   Super::EndPlay(EndPlayReason);
+  DropFolderWatcher.Reset();
+  ReadbackRing.Reset();
+  FrameEncoder.Reset();
+  // finishes the open shard
+  DatasetWriter.Reset();
+  SendPacer.Reset();
   if (WorldSpawner)
   {
     WorldSpawner->ReceiveStreamingCommunicatorRef(nullptr);
   }
-  SendResponse(FString("{\"type\":\"closed\""));
+  FUtf8Builder Response(24);
+  FJsonResponseWriter Writer(Response);
+  Writer.BeginObject().Field("type", TEXT("closed")).EndObject();
+  SendUtf8(Response);
 
 }
 
@@ -2114,7 +3334,6 @@ void ASynavisDrone::Tick(float DeltaTime)
   if (BindPawnToCamera)
     UGameplayStatics::GetPlayerPawn(GetWorld(), 0)->SetActorLocation(GetActorLocation());
 
-  FrameCaptureCounter -= DeltaTime;
   FVector Distance = NextLocation - GetActorLocation();
   if (DistanceToLandscape > 0.f)
   {
@@ -2180,80 +3399,58 @@ void ASynavisDrone::Tick(float DeltaTime)
 
 
 
-    FString Data = FString::Printf(TEXT("{\"type\":\"track\",\"time\":%n,\"data\":{"), Now);
-
-    for (auto i = 0; i < TransmissionTargets.Num(); ++i)
-    {
-      auto& Target = TransmissionTargets[i];
-      if (IsValid(Target.Object))
-      {
-        Data.Append(FString::Printf(TEXT("\"%s\":"), *Target.Name));
-        // read the property
-        switch (Target.DataType)
-        {
-        case EDataTypeIndicator::Float:
-          Data.Append(FString::Printf(TEXT("%f"), Target.Property->ContainerPtrToValuePtr<float>(Target.Object)));
-          break;
-        case EDataTypeIndicator::Int:
-          Data.Append(FString::Printf(TEXT("%d"), Target.Property->ContainerPtrToValuePtr<int>(Target.Object)));
-          break;
-        case EDataTypeIndicator::Bool:
-          Data.Append(FString::Printf(TEXT("%s"), Target.Property->ContainerPtrToValuePtr<bool>(Target.Object) ? TEXT("true") : TEXT("false")));
-          break;
-        case EDataTypeIndicator::String:
-          Data.Append(FString::Printf(TEXT("\"%s\""), **Target.Property->ContainerPtrToValuePtr<FString>(Target.Object)));
-          break;
-        case EDataTypeIndicator::Transform:
-          Data.Append(PrintFormattedTransform(Target.Object));
-          break;
-        case EDataTypeIndicator::Vector:
-          Data.Append(FString::Printf(TEXT("[%f,%f,%f]"), Target.Property->ContainerPtrToValuePtr<FVector>(Target.Object)->X, Target.Property->ContainerPtrToValuePtr<FVector>(Target.Object)->Y, Target.Property->ContainerPtrToValuePtr<FVector>(Target.Object)->Z));
-          break;
-        case EDataTypeIndicator::Rotator:
-          Data.Append(FString::Printf(TEXT("[%f,%f,%f]"), Target.Property->ContainerPtrToValuePtr<FRotator>(Target.Object)->Pitch, Target.Property->ContainerPtrToValuePtr<FRotator>(Target.Object)->Yaw, Target.Property->ContainerPtrToValuePtr<FRotator>(Target.Object)->Roll));
-          break;
-        }
-        if (i < TransmissionTargets.Num() - 1)
-          Data.Append(TEXT(","));
-      }
-    }
-    Data.Append(TEXT("}}"));
-    SendResponse(Data);
+    FUtf8Builder Response(64 + 48 * TransmissionTargets.Num());
+    FJsonResponseWriter Writer(Response);
+    Writer.BeginObject().Field("type", TEXT("track")).Field("time", Now).Key("data").BeginObject();
+    WriteTrackedProperties(Writer);
+    Writer.EndObject().EndObject();
+    SendUtf8(Response);
+  }
+
+  if (ReadbackRing.IsValid())
+  {
+    ReadbackRing->Poll([this](FReadbackFrame&& Frame) { OnFrameReadback(MoveTemp(Frame)); });
+  }
+  if (FrameEncoder.IsValid())
+  {
+    EncodeDrops = FrameEncoder->GetDropped();
+    FrameLatency = FrameEncoder->GetMeanLatency();
+  }
+  if (SendPacer.IsValid())
+  {
+    SendRate = SendPacer->GetRate();
+  }
+  if (DatasetWriter.IsValid())
+  {
+    DatasetSamples = DatasetWriter->GetSamples();
   }
 
   // prepare texture for storage
-  if (FrameCaptureTime > 0.f && FrameCaptureCounter <= 0.f)
+  if (FarmMode)
+  {
+    FarmTick();
+  }
+  else
   {
-    SendRawFrame(nullptr, false);
-    FrameCaptureCounter = FrameCaptureTime;
+    RunCaptureSchedule();
   }
 
-  if (LastProgress >= 0 && ReceptionBufferOffset < ReceptionBufferSize)
+  if (LastProgress >= 0 && ReceptionBufferOffset < ReceptionBufferSize
+    && (!SendPacer.IsValid() || SendPacer->TryAcquire(ReceptionFormat.Len() / ReceptionBufferSize + 64, FSendPacer::ReceiveKey(ReceptionBufferOffset))))
   {
     // ReceptionBufferOffset is our chunk, LastProgress is last received chucnk
-    FString Response = TEXT("{\"type\":\"receive\",\"data\":\"");
-    auto ChunkSize = ReceptionFormat.Len() / ReceptionBufferSize;
-    const auto Lower = ChunkSize * ReceptionBufferOffset;
-    auto Upper = FGenericPlatformMath::Min(ChunkSize * (ReceptionBufferOffset + 1), (uint64_t)ReceptionFormat.Len());
-    if ((ReceptionFormat.Len() - Upper) < ReceptionBufferSize)
+    if (ReceptionBufferOffset + 1 == ReceptionBufferSize)
     {
-      Upper = ReceptionFormat.Len();
       LastProgress = -1;
     }
-    const auto chunk = ReceptionFormat.Mid(Lower, Upper - Lower);
-    Response += chunk;
-    Response += TEXT("\", \"chunk\":\"");
-    Response += FString::FromInt(ReceptionBufferOffset);
-    Response += TEXT("/");
-    Response += FString::FromInt(ReceptionBufferSize);
-    Response += TEXT("\"}");
+    FUtf8Builder Response;
+    BuildReceptionChunk(ReceptionBufferOffset, Response);
     ReceptionBufferOffset++;
     if (LogResponses)
     {
       UE_LOG(LogActor, Warning, TEXT("Sending chunk %d of %d"), ReceptionBufferOffset, ReceptionBufferSize);
-      UE_LOG(LogActor, Warning, TEXT("First and last 20 charactes of chunk %d: %s"), ReceptionBufferOffset, *(chunk.Mid(0, 20) + TEXT("...") + chunk.Mid(chunk.Len() - 20, 20)))
     }
-    SendResponse(Response);
+    SendUtf8(Response);
   }
 
   for (auto& Task : ScheduledTasks)
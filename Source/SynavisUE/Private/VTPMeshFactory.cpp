@@ -1,142 +1,1043 @@
-// Fill out your copyright notice in the Description page of Project Settings.
-
+// Copyright Dirk Norbert Helmrich, 2023
 
 #include "VTPMeshFactory.h"
 
 #include "ProceduralMeshComponent.h"
-#include "Components/OctreeDynamicMeshComponent.h"
-#include "DynamicMesh/DynamicMesh3.h"
-#include "Misc/Base64.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Compression.h"
+#include "GeometryImporter.h"
+#include "Algo/Sort.h"
 
-THIRD_PARTY_INCLUDES_START
+#include <atomic>
+#include <cstdlib>
 
+// number of base64 quads or values that one worker handles at a time
+static constexpr int64 VTPParallelBlock = 1 << 16;
 
-THIRD_PARTY_INCLUDES_END
+enum class EVTPType : uint8
+{
+  Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64, Float32, Float64, Unknown
+};
 
-#include "Components/OctreeDynamicMeshComponent.h"
+static EVTPType ParseVTPType(const FString& Name)
+{
+  static const TMap<FString, EVTPType> Types
+  {
+    {TEXT("Int8"), EVTPType::Int8}, {TEXT("UInt8"), EVTPType::UInt8}, {TEXT("Char"), EVTPType::Int8},
+    {TEXT("Int16"), EVTPType::Int16}, {TEXT("UInt16"), EVTPType::UInt16},
+    {TEXT("Int32"), EVTPType::Int32}, {TEXT("UInt32"), EVTPType::UInt32},
+    {TEXT("Int64"), EVTPType::Int64}, {TEXT("UInt64"), EVTPType::UInt64},
+    {TEXT("Float32"), EVTPType::Float32}, {TEXT("Float64"), EVTPType::Float64}
+  };
+  const EVTPType* Type = Types.Find(Name);
+  return Type ? *Type : EVTPType::Unknown;
+}
 
-#define AVAIL_POINTS 0b00000001
-#define AVAIL_NORMALS 0b00000010
-#define AVAIL_TANGENTS 0b00000100
-#define AVAIL_TRIANGLES 0b00001000
-#define AVAIL_UV 0b00001000
+static int64 GetVTPTypeSize(EVTPType Type)
+{
+  switch (Type)
+  {
+  case EVTPType::Int8: case EVTPType::UInt8: return 1;
+  case EVTPType::Int16: case EVTPType::UInt16: return 2;
+  case EVTPType::Int32: case EVTPType::UInt32: case EVTPType::Float32: return 4;
+  case EVTPType::Int64: case EVTPType::UInt64: case EVTPType::Float64: return 8;
+  default: return 0;
+  }
+}
 
-#define VALID_GEOM AVAIL_POINTS | AVAIL_NORMALS | AVAIL_TRIANGLES;
+enum class EVTPFormat : uint8
+{
+  Ascii, Binary, Appended
+};
 
-VTPMeshFactory::VTPMeshFactory()
+// everything the reader needs to know about one DataArray element, the contents stay in the file buffer
+struct FVTPDataArray
+{
+  int32 Piece = 0;
+  FString Parent;
+  FString Name;
+  EVTPType Type = EVTPType::Unknown;
+  int32 NumberOfComponents = 1;
+  EVTPFormat Format = EVTPFormat::Ascii;
+  int64 Offset = 0;
+  const char* Text = nullptr;
+  int64 TextLength = 0;
+};
+
+struct FVTPPiece
+{
+  int64 NumberOfPoints = 0;
+  int64 NumberOfPolys = 0;
+  int64 NumberOfStrips = 0;
+  int64 NumberOfCells = 0;
+  FString ActiveScalars, ActiveNormals, ActiveTCoords;
+};
+
+struct FVTPFile
+{
+  bool bUnstructured = false;
+  bool bLegacyOffsets = false;
+  int64 HeaderSize = 4;
+  bool bCompressed = false;
+  bool bAppendedBase64 = false;
+  const char* Appended = nullptr;
+  const char* End = nullptr;
+  TArray<FVTPPiece> Pieces;
+  TArray<FVTPDataArray> Arrays;
+};
+
+// decoded contents of a DataArray, ascii arrays end up as Float64
+struct FVTPDecoded
+{
+  EVTPType Type = EVTPType::Unknown;
+  int32 NumberOfComponents = 1;
+  TArray<uint8> Bytes;
+
+  int64 NumValues() const { return Type == EVTPType::Unknown ? 0 : Bytes.Num() / GetVTPTypeSize(Type); }
+};
+
+/**
+ * Minimal pull tokenizer for the subset of XML that VTK writes.
+ * Start tags come with their attributes, text is reported as a range into the buffer.
+ */
+class FVTPTokenizer
+{
+public:
+  enum class EToken : uint8 { StartTag, EndTag, Text, End, Error };
+
+  FVTPTokenizer(const char* InBegin, const char* InEnd) : Cursor(InBegin), End(InEnd) {}
+
+  EToken Next()
+  {
+    while (Cursor < End)
+    {
+      if (*Cursor != '<')
+      {
+        TextBegin = Cursor;
+        while (Cursor < End && *Cursor != '<')
+          ++Cursor;
+        TextEnd = Cursor;
+        return EToken::Text;
+      }
+      ++Cursor;
+      if (Cursor < End && (*Cursor == '?' || *Cursor == '!'))
+      {
+        // declarations and comments carry nothing for the reader
+        const bool bComment = (End - Cursor > 3) && Cursor[1] == '-' && Cursor[2] == '-';
+        while (Cursor < End && !(*Cursor == '>' && (!bComment || (Cursor[-1] == '-' && Cursor[-2] == '-'))))
+          ++Cursor;
+        ++Cursor;
+        continue;
+      }
+      const bool bEndTag = Cursor < End && *Cursor == '/';
+      if (bEndTag)
+        ++Cursor;
+      if (!ReadName(TagName))
+        return EToken::Error;
+      Attributes.Reset();
+      bSelfClosing = false;
+      while (true)
+      {
+        SkipWhitespace();
+        if (Cursor >= End)
+          return EToken::Error;
+        if (*Cursor == '>')
+        {
+          ++Cursor;
+          break;
+        }
+        if (*Cursor == '/' && Cursor + 1 < End && Cursor[1] == '>')
+        {
+          bSelfClosing = true;
+          Cursor += 2;
+          break;
+        }
+        FString Key;
+        if (!ReadName(Key))
+          return EToken::Error;
+        SkipWhitespace();
+        if (Cursor >= End || *Cursor != '=')
+          return EToken::Error;
+        ++Cursor;
+        SkipWhitespace();
+        if (Cursor >= End || (*Cursor != '"' && *Cursor != '\''))
+          return EToken::Error;
+        const char Quote = *Cursor++;
+        const char* ValueBegin = Cursor;
+        while (Cursor < End && *Cursor != Quote)
+          ++Cursor;
+        if (Cursor >= End)
+          return EToken::Error;
+        Attributes.Add(Key, FString(static_cast<int32>(Cursor - ValueBegin), ValueBegin));
+        ++Cursor;
+      }
+      return bEndTag ? EToken::EndTag : EToken::StartTag;
+    }
+    return EToken::End;
+  }
+
+  FString GetAttribute(const TCHAR* Key, const FString& Default = FString()) const
+  {
+    const FString* Value = Attributes.Find(Key);
+    return Value ? *Value : Default;
+  }
+
+  FString TagName;
+  TMap<FString, FString> Attributes;
+  bool bSelfClosing = false;
+  const char* TextBegin = nullptr;
+  const char* TextEnd = nullptr;
+  const char* Cursor;
+  const char* End;
+
+private:
+  void SkipWhitespace()
+  {
+    while (Cursor < End && FCharAnsi::IsWhitespace(*Cursor))
+      ++Cursor;
+  }
+
+  bool ReadName(FString& Out)
+  {
+    const char* Begin = Cursor;
+    while (Cursor < End && !FCharAnsi::IsWhitespace(*Cursor) && *Cursor != '>' && *Cursor != '/' && *Cursor != '=')
+      ++Cursor;
+    Out = FString(static_cast<int32>(Cursor - Begin), Begin);
+    return Cursor > Begin;
+  }
+};
+
+static bool ParseStructure(const char* Begin, const char* End, FVTPFile& File, FString& Error)
 {
+  FVTPTokenizer Tokenizer(Begin, End);
+  TArray<FString> Stack;
+  int32 OpenArray = INDEX_NONE;
+  bool bSawFile = false;
+  File.End = End;
+  while (true)
+  {
+    const FVTPTokenizer::EToken Token = Tokenizer.Next();
+    if (Token == FVTPTokenizer::EToken::End)
+    {
+      break;
+    }
+    if (Token == FVTPTokenizer::EToken::Error)
+    {
+      Error = FString::Printf(TEXT("malformed XML at byte %lld"), static_cast<int64>(Tokenizer.Cursor - Begin));
+      return false;
+    }
+    if (Token == FVTPTokenizer::EToken::Text)
+    {
+      if (OpenArray != INDEX_NONE)
+      {
+        File.Arrays[OpenArray].Text = Tokenizer.TextBegin;
+        File.Arrays[OpenArray].TextLength = Tokenizer.TextEnd - Tokenizer.TextBegin;
+      }
+      continue;
+    }
+    if (Token == FVTPTokenizer::EToken::EndTag)
+    {
+      if (Stack.Num() == 0 || Stack.Top() != Tokenizer.TagName)
+      {
+        Error = FString::Printf(TEXT("unexpected closing tag %s"), *Tokenizer.TagName);
+        return false;
+      }
+      Stack.Pop(false);
+      OpenArray = INDEX_NONE;
+      continue;
+    }
+
+    const FString& Tag = Tokenizer.TagName;
+    if (Tag == TEXT("VTKFile"))
+    {
+      bSawFile = true;
+      const FString Type = Tokenizer.GetAttribute(TEXT("type"));
+      if (Type != TEXT("PolyData") && Type != TEXT("UnstructuredGrid"))
+      {
+        Error = FString::Printf(TEXT("expected PolyData or UnstructuredGrid, found %s"), *Type);
+        return false;
+      }
+      File.bUnstructured = Type == TEXT("UnstructuredGrid");
+      if (Tokenizer.GetAttribute(TEXT("byte_order"), TEXT("LittleEndian")) != TEXT("LittleEndian"))
+      {
+        Error = TEXT("big endian files are not supported");
+        return false;
+      }
+      const FString Version = Tokenizer.GetAttribute(TEXT("version"), TEXT("0.1"));
+      File.bLegacyOffsets = Version == TEXT("0.1");
+      const FString HeaderType = Tokenizer.GetAttribute(TEXT("header_type"), TEXT("UInt32"));
+      if (HeaderType != TEXT("UInt32") && HeaderType != TEXT("UInt64"))
+      {
+        Error = FString::Printf(TEXT("unsupported header type %s"), *HeaderType);
+        return false;
+      }
+      File.HeaderSize = HeaderType == TEXT("UInt64") ? 8 : 4;
+      const FString Compressor = Tokenizer.GetAttribute(TEXT("compressor"));
+      if (!Compressor.IsEmpty() && Compressor != TEXT("vtkZLibDataCompressor"))
+      {
+        Error = FString::Printf(TEXT("unsupported compressor %s"), *Compressor);
+        return false;
+      }
+      File.bCompressed = !Compressor.IsEmpty();
+    }
+    else if (Tag == TEXT("Piece"))
+    {
+      FVTPPiece& Piece = File.Pieces.AddDefaulted_GetRef();
+      Piece.NumberOfPoints = FCString::Atoi64(*Tokenizer.GetAttribute(TEXT("NumberOfPoints"), TEXT("0")));
+      Piece.NumberOfPolys = FCString::Atoi64(*Tokenizer.GetAttribute(TEXT("NumberOfPolys"), TEXT("0")));
+      Piece.NumberOfStrips = FCString::Atoi64(*Tokenizer.GetAttribute(TEXT("NumberOfStrips"), TEXT("0")));
+      Piece.NumberOfCells = FCString::Atoi64(*Tokenizer.GetAttribute(TEXT("NumberOfCells"), TEXT("0")));
+      for (const int64 Count : { Piece.NumberOfPoints, Piece.NumberOfPolys, Piece.NumberOfStrips, Piece.NumberOfCells })
+      {
+        // cell lists hold one entry more than there are cells
+        if (Count < 0 || Count >= MAX_int32)
+        {
+          Error = FString::Printf(TEXT("piece %d has a count of %lld"), File.Pieces.Num() - 1, Count);
+          return false;
+        }
+      }
+    }
+    else if (Tag == TEXT("PointData") && File.Pieces.Num() > 0)
+    {
+      FVTPPiece& Piece = File.Pieces.Last();
+      Piece.ActiveScalars = Tokenizer.GetAttribute(TEXT("Scalars"));
+      Piece.ActiveNormals = Tokenizer.GetAttribute(TEXT("Normals"));
+      Piece.ActiveTCoords = Tokenizer.GetAttribute(TEXT("TCoords"));
+    }
+    else if (Tag == TEXT("DataArray") && File.Pieces.Num() > 0 && Stack.Num() > 0)
+    {
+      FVTPDataArray& Array = File.Arrays.AddDefaulted_GetRef();
+      Array.Piece = File.Pieces.Num() - 1;
+      Array.Parent = Stack.Top();
+      Array.Name = Tokenizer.GetAttribute(TEXT("Name"));
+      Array.Type = ParseVTPType(Tokenizer.GetAttribute(TEXT("type")));
+      Array.NumberOfComponents = FMath::Max(1, FCString::Atoi(*Tokenizer.GetAttribute(TEXT("NumberOfComponents"), TEXT("1"))));
+      const FString Format = Tokenizer.GetAttribute(TEXT("format"), TEXT("ascii"));
+      Array.Format = Format == TEXT("appended") ? EVTPFormat::Appended : (Format == TEXT("binary") ? EVTPFormat::Binary : EVTPFormat::Ascii);
+      Array.Offset = FCString::Atoi64(*Tokenizer.GetAttribute(TEXT("offset"), TEXT("0")));
+      OpenArray = Tokenizer.bSelfClosing ? INDEX_NONE : File.Arrays.Num() - 1;
+    }
+    else if (Tag == TEXT("AppendedData"))
+    {
+      // everything after the underscore is binary, so the tokenizer must not look at it
+      File.bAppendedBase64 = Tokenizer.GetAttribute(TEXT("encoding"), TEXT("raw")) == TEXT("base64");
+      const char* Marker = Tokenizer.Cursor;
+      while (Marker < End && *Marker != '_')
+        ++Marker;
+      if (Marker >= End)
+      {
+        Error = TEXT("appended data has no start marker");
+        return false;
+      }
+      File.Appended = Marker + 1;
+      break;
+    }
+    if (!Tokenizer.bSelfClosing)
+    {
+      Stack.Push(Tag);
+    }
+  }
+  if (!bSawFile || File.Pieces.Num() == 0)
+  {
+    Error = TEXT("no VTKFile element with a piece");
+    return false;
+  }
+  return true;
 }
 
-VTPMeshFactory::~VTPMeshFactory()
+static uint8 Base64Value(char c)
 {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return 0xFF;
 }
 
-UProceduralMeshComponent* VTPMeshFactory::LoadFile(FString inFileName)
+static int64 Base64Length(int64 NumBytes)
+{
+  return (NumBytes + 2) / 3 * 4;
+}
+
+// decodes whole quads, the input is split across workers on quad boundaries
+static bool DecodeBase64(const char* Source, int64 Length, TArray<uint8>& Out)
+{
+  if (Length % 4 != 0)
+  {
+    return false;
+  }
+  int64 Padding = 0;
+  if (Length > 0 && Source[Length - 1] == '=')
+    ++Padding;
+  if (Length > 1 && Source[Length - 2] == '=')
+    ++Padding;
+  const int64 NumQuads = Length / 4;
+  if (NumQuads * 3 > MAX_int32)
+  {
+    return false;
+  }
+  Out.SetNumUninitialized(static_cast<int32>(NumQuads * 3));
+  std::atomic<bool> bValid{ true };
+  ParallelFor(static_cast<int32>(FMath::DivideAndRoundUp(NumQuads, VTPParallelBlock)), [&](int32 Block)
+    {
+      const int64 First = Block * VTPParallelBlock;
+      const int64 Last = FMath::Min(NumQuads, First + VTPParallelBlock);
+      for (int64 q = First; q < Last; ++q)
+      {
+        const char* In = Source + q * 4;
+        const uint8 a = Base64Value(In[0]), b = Base64Value(In[1]);
+        const uint8 c = In[2] == '=' ? 0 : Base64Value(In[2]);
+        const uint8 d = In[3] == '=' ? 0 : Base64Value(In[3]);
+        if ((a | b | c | d) & 0xC0)
+        {
+          bValid = false;
+          return;
+        }
+        uint8* Dest = Out.GetData() + q * 3;
+        Dest[0] = (a << 2) | (b >> 4);
+        Dest[1] = (b << 4) | (c >> 2);
+        Dest[2] = (c << 6) | d;
+      }
+    }, NumQuads < VTPParallelBlock);
+  Out.SetNum(static_cast<int32>(NumQuads * 3 - Padding), false);
+  return bValid;
+}
+
+static uint64 ReadHeaderValue(const uint8* Data, int64 HeaderSize)
+{
+  return HeaderSize == 8 ? *reinterpret_cast<const uint64*>(Data) : *reinterpret_cast<const uint32*>(Data);
+}
+
+// arrays are indexed with int32, every size from a header has to fit before it is used
+static bool IsArraySize(uint64 Value)
+{
+  return Value <= static_cast<uint64>(MAX_int32);
+}
+
+// reads one header-prefixed binary stream that starts at Source and may extend up to End
+static bool DecodeBinaryStream(const FVTPFile& File, const char* Source, const char* End, bool bBase64, TArray<uint8>& Out, FString& Error)
+{
+  const int64 HeaderSize = File.HeaderSize;
+  const int64 Available = End - Source;
+  TArray<uint8> Scratch;
+  if (!File.bCompressed)
+  {
+    if (!bBase64)
+    {
+      if (Available < HeaderSize)
+        return false;
+      const uint64 Size = ReadHeaderValue(reinterpret_cast<const uint8*>(Source), HeaderSize);
+      if (!IsArraySize(Size) || Size > static_cast<uint64>(Available - HeaderSize))
+        return false;
+      Out.SetNumUninitialized(static_cast<int32>(Size));
+      FMemory::Memcpy(Out.GetData(), Source + HeaderSize, Size);
+      return true;
+    }
+    // header and data form one base64 stream
+    const int64 HeaderChars = Base64Length(HeaderSize);
+    if (Available < HeaderChars || !DecodeBase64(Source, HeaderChars, Scratch))
+      return false;
+    const uint64 Size = ReadHeaderValue(Scratch.GetData(), HeaderSize);
+    // base64 takes more characters than it holds bytes
+    if (!IsArraySize(Size) || Size > static_cast<uint64>(Available))
+      return false;
+    const int64 TotalChars = Base64Length(HeaderSize + Size);
+    if (TotalChars > Available || !DecodeBase64(Source, TotalChars, Out))
+      return false;
+    Out.RemoveAt(0, static_cast<int32>(HeaderSize), false);
+    Out.SetNum(static_cast<int32>(Size), false);
+    return true;
+  }
+
+  // compressed streams start with the block count, block size, size of the last block and all compressed sizes
+  // in base64 the header is encoded on its own, followed by the encoded blocks
+  TArray<uint8> Header;
+  int64 HeaderBytes = 0;
+  int64 DataStart = 0;
+  if (bBase64)
+  {
+    if (Available < Base64Length(HeaderSize) || !DecodeBase64(Source, Base64Length(HeaderSize), Scratch))
+      return false;
+    const uint64 NumBlocks = ReadHeaderValue(Scratch.GetData(), HeaderSize);
+    if (NumBlocks > static_cast<uint64>(Available / HeaderSize))
+      return false;
+    HeaderBytes = (3 + NumBlocks) * HeaderSize;
+    DataStart = Base64Length(HeaderBytes);
+    if (DataStart > Available || !DecodeBase64(Source, DataStart, Header))
+      return false;
+  }
+  else
+  {
+    if (Available < HeaderSize)
+      return false;
+    const uint64 NumBlocks = ReadHeaderValue(reinterpret_cast<const uint8*>(Source), HeaderSize);
+    if (NumBlocks > static_cast<uint64>(Available / HeaderSize))
+      return false;
+    HeaderBytes = (3 + NumBlocks) * HeaderSize;
+    DataStart = HeaderBytes;
+    if (HeaderBytes > Available)
+      return false;
+    Header.Append(reinterpret_cast<const uint8*>(Source), static_cast<int32>(HeaderBytes));
+  }
+  const uint64 BlockSizeValue = ReadHeaderValue(Header.GetData() + HeaderSize, HeaderSize);
+  const uint64 LastBlockSizeValue = ReadHeaderValue(Header.GetData() + 2 * HeaderSize, HeaderSize);
+  if (!IsArraySize(BlockSizeValue) || LastBlockSizeValue > BlockSizeValue)
+    return false;
+  // the block count was checked against the buffer above
+  const int64 NumBlocks = ReadHeaderValue(Header.GetData(), HeaderSize);
+  const int64 BlockSize = BlockSizeValue;
+  const int64 LastBlockSize = LastBlockSizeValue;
+  if (NumBlocks > 0 && (BlockSize == 0 || NumBlocks - 1 > MAX_int32 / BlockSize))
+    return false;
+  TArray<int64> CompressedOffsets;
+  CompressedOffsets.SetNumUninitialized(static_cast<int32>(NumBlocks + 1));
+  CompressedOffsets[0] = 0;
+  for (int64 b = 0; b < NumBlocks; ++b)
+  {
+    // no block can be larger than the buffer, so the sum stays far from overflowing
+    const uint64 CompressedSize = ReadHeaderValue(Header.GetData() + (3 + b) * HeaderSize, HeaderSize);
+    if (CompressedSize > static_cast<uint64>(Available))
+      return false;
+    CompressedOffsets[b + 1] = CompressedOffsets[b] + CompressedSize;
+    if (CompressedOffsets[b + 1] > Available)
+      return false;
+  }
+  const uint8* Compressed;
+  if (bBase64)
+  {
+    const int64 DataChars = Base64Length(CompressedOffsets.Last());
+    if (DataStart + DataChars > Available || !DecodeBase64(Source + DataStart, DataChars, Scratch))
+      return false;
+    Compressed = Scratch.GetData();
+  }
+  else
+  {
+    if (DataStart + CompressedOffsets.Last() > Available)
+      return false;
+    Compressed = reinterpret_cast<const uint8*>(Source + DataStart);
+  }
+  const int64 UncompressedSize = NumBlocks == 0 ? 0 : (NumBlocks - 1) * BlockSize + (LastBlockSize ? LastBlockSize : BlockSize);
+  if (!IsArraySize(UncompressedSize))
+    return false;
+  Out.SetNumUninitialized(static_cast<int32>(UncompressedSize));
+  std::atomic<bool> bValid{ true };
+  ParallelFor(static_cast<int32>(NumBlocks), [&](int32 b)
+    {
+      const int64 Size = (b == NumBlocks - 1 && LastBlockSize) ? LastBlockSize : BlockSize;
+      if (!FCompression::UncompressMemory(NAME_Zlib, Out.GetData() + b * BlockSize, Size,
+        Compressed + CompressedOffsets[b], CompressedOffsets[b + 1] - CompressedOffsets[b]))
+      {
+        bValid = false;
+      }
+    });
+  if (!bValid)
+  {
+    Error = TEXT("could not inflate a compressed block");
+  }
+  return bValid;
+}
+
+static bool DecodeArray(const FVTPFile& File, const FVTPDataArray& Array, FVTPDecoded& Out, FString& Error)
+{
+  Out.Type = Array.Type;
+  Out.NumberOfComponents = Array.NumberOfComponents;
+  if (Array.Type == EVTPType::Unknown)
+  {
+    Error = FString::Printf(TEXT("array %s has an unknown type"), *Array.Name);
+    return false;
+  }
+  bool bDecoded = false;
+  if (Array.Format == EVTPFormat::Ascii)
+  {
+    // ascii numbers are parsed as doubles, which holds every integer index a mesh can have
+    TArray<double> Values;
+    const char* Cursor = Array.Text;
+    const char* End = Array.Text + Array.TextLength;
+    while (Cursor && Cursor < End)
+    {
+      while (Cursor < End && FCharAnsi::IsWhitespace(*Cursor))
+        ++Cursor;
+      if (Cursor >= End)
+        break;
+      char* Next = nullptr;
+      Values.Add(std::strtod(Cursor, &Next));
+      if (Next == Cursor)
+        break;
+      Cursor = Next;
+    }
+    Out.Type = EVTPType::Float64;
+    Out.Bytes.SetNumUninitialized(Values.Num() * sizeof(double));
+    FMemory::Memcpy(Out.Bytes.GetData(), Values.GetData(), Out.Bytes.Num());
+    bDecoded = true;
+  }
+  else if (Array.Format == EVTPFormat::Binary)
+  {
+    const char* Begin = Array.Text;
+    const char* End = Array.Text + Array.TextLength;
+    while (Begin < End && FCharAnsi::IsWhitespace(*Begin))
+      ++Begin;
+    while (End > Begin && FCharAnsi::IsWhitespace(End[-1]))
+      --End;
+    bDecoded = Begin && DecodeBinaryStream(File, Begin, End, true, Out.Bytes, Error);
+  }
+  else
+  {
+    if (!File.Appended || Array.Offset < 0 || Array.Offset >= File.End - File.Appended)
+    {
+      Error = FString::Printf(TEXT("array %s points outside of the appended data"), *Array.Name);
+      return false;
+    }
+    bDecoded = DecodeBinaryStream(File, File.Appended + Array.Offset, File.End, File.bAppendedBase64, Out.Bytes, Error);
+  }
+  if (!bDecoded && Error.IsEmpty())
+  {
+    Error = FString::Printf(TEXT("array %s is truncated or malformed"), *Array.Name);
+  }
+  return bDecoded;
+}
+
+template<typename TIn, typename TOut>
+static void ConvertTyped(const uint8* In, TOut* Out, int64 Num)
 {
-  return NewObject<UProceduralMeshComponent>();
-#if 0
-  uint8 ArrayAvailable = 0;
-  UProceduralMeshComponent* output = NewObject<UProceduralMeshComponent>();
-  tinyxml2::XMLDocument doc; 
-  doc.LoadFile(TCHAR_TO_ANSI(*inFileName));
+  const TIn* Source = reinterpret_cast<const TIn*>(In);
+  ParallelFor(static_cast<int32>(FMath::DivideAndRoundUp(Num, VTPParallelBlock)), [&](int32 Block)
+    {
+      const int64 Last = FMath::Min(Num, (Block + 1) * VTPParallelBlock);
+      for (int64 i = Block * VTPParallelBlock; i < Last; ++i)
+      {
+        Out[i] = static_cast<TOut>(Source[i]);
+      }
+    }, Num < VTPParallelBlock);
+}
 
-  auto* VTKFile = doc.FirstChild();
-  auto* PolyData = VTKFile->FirstChild();
-  auto * AppendedData = PolyData->NextSibling();
-  auto* Piece = AppendedData->FirstChild();
-  int64 NumberOfPoints = Piece->ToElement()->Int64Attribute("NumberOfPoints");
-  int64 NumberOfPolys = Piece->ToElement()->Int64Attribute("NumberOfPolys");
-  auto* Points = PolyData->FirstChildElement("Points")->FirstChildElement("DataArray");
-  auto* PointData = PolyData->FirstChildElement("PointData");
-  FString ReadingMode = ANSI_TO_TCHAR(Points->Attribute("Encoding"));
-  auto* CellData = PolyData->FirstChildElement("CellData");
-  int64 PointOffset = Points->Int64Attribute("offset");
-  auto* Polys = PolyData->FirstChildElement("Polys")->FirstChildElement("DataArray");
-  auto* PolyOffsets = Polys->NextSiblingElement();
-  if (strcmp(Polys->Attribute("Name"),"connectivity") == 0)
+// converts any element type into the one the payload needs, the type switch happens once per array
+template<typename TOut>
+static void ConvertArray(const FVTPDecoded& In, TArray<TOut>& Out)
+{
+  const int64 Num = In.NumValues();
+  Out.SetNumUninitialized(static_cast<int32>(Num));
+  const uint8* Data = In.Bytes.GetData();
+  switch (In.Type)
+  {
+  case EVTPType::Int8: ConvertTyped<int8>(Data, Out.GetData(), Num); break;
+  case EVTPType::UInt8: ConvertTyped<uint8>(Data, Out.GetData(), Num); break;
+  case EVTPType::Int16: ConvertTyped<int16>(Data, Out.GetData(), Num); break;
+  case EVTPType::UInt16: ConvertTyped<uint16>(Data, Out.GetData(), Num); break;
+  case EVTPType::Int32: ConvertTyped<int32>(Data, Out.GetData(), Num); break;
+  case EVTPType::UInt32: ConvertTyped<uint32>(Data, Out.GetData(), Num); break;
+  case EVTPType::Int64: ConvertTyped<int64>(Data, Out.GetData(), Num); break;
+  case EVTPType::UInt64: ConvertTyped<uint64>(Data, Out.GetData(), Num); break;
+  case EVTPType::Float32: ConvertTyped<float>(Data, Out.GetData(), Num); break;
+  case EVTPType::Float64: ConvertTyped<double>(Data, Out.GetData(), Num); break;
+  default: Out.Reset(); break;
+  }
+}
+
+// offsets list the end of every cell, an array with one entry more than there are cells lists the start of every cell
+// plus the total instead; version 0.1 files are always read as ends
+static void GetCellRanges(const TArray<int64>& Offsets, int64 NumCells, bool bLegacy, TArray<int64>& Starts)
+{
+  Starts.Reset(static_cast<int32>(NumCells + 1));
+  if (!bLegacy && Offsets.Num() == NumCells + 1)
+  {
+    Starts = Offsets;
+    return;
+  }
+  Starts.Add(0);
+  Starts.Append(Offsets.GetData(), static_cast<int32>(FMath::Min<int64>(Offsets.Num(), NumCells)));
+}
+
+// polygons are fanned, strips alternate their winding, both are written in parallel after a prefix sum
+static bool Triangulate(const TArray<int64>& Connectivity, const TArray<int64>& Starts, bool bStrips, int32 VertexOffset, int64 NumVertices, TArray<int32>& Triangles)
+{
+  const int64 NumCells = Starts.Num() - 1;
+  if (NumCells <= 0)
   {
-    Swap(Polys, PolyOffsets);
+    return true;
   }
-  TArray<FVector> MeshPoints, Normals;
-  TArray<int> Triangles;
-  TArray<FVector2D> UV;
-  TArray<FColor> Colors;
-  TArray<FProcMeshTangent> Tangents;
-  //int64 PolyStart, PolyOffset;
-  int64 UVOffset, NormalOffset, TangentOffset;
-  if (ReadingMode == "AppendedData")
+  TArray<int64> TriangleStarts;
+  TriangleStarts.SetNumUninitialized(static_cast<int32>(NumCells + 1));
+  TriangleStarts[0] = 0;
+  for (int64 c = 0; c < NumCells; ++c)
   {
-    for (auto* DataArray = PointData->FirstChild(); DataArray->NextSibling(); DataArray = DataArray->NextSibling())
+    if (Starts[c + 1] < Starts[c] || Starts[c + 1] > Connectivity.Num())
     {
-      if (strcmp(DataArray->ToElement()->Attribute("Name"), "Texture Coordinates"))
+      return false;
+    }
+    TriangleStarts[c + 1] = TriangleStarts[c] + FMath::Max<int64>(0, Starts[c + 1] - Starts[c] - 2);
+  }
+  const int64 Base = Triangles.Num();
+  if (Base + TriangleStarts.Last() * 3 > MAX_int32)
+  {
+    return false;
+  }
+  Triangles.AddUninitialized(static_cast<int32>(TriangleStarts.Last() * 3));
+  std::atomic<bool> bValid{ true };
+  ParallelFor(static_cast<int32>(NumCells), [&](int32 c)
+    {
+      const int64* Cell = Connectivity.GetData() + Starts[c];
+      int32* Out = Triangles.GetData() + Base + TriangleStarts[c] * 3;
+      const int64 Count = Starts[c + 1] - Starts[c];
+      for (int64 i = 0; i < Count; ++i)
       {
-        UVOffset = DataArray->ToElement()->Int64Attribute("offset");
-        ArrayAvailable |= AVAIL_UV;
+        if (Cell[i] < 0 || Cell[i] >= NumVertices)
+        {
+          bValid = false;
+          return;
+        }
       }
-      else if (strcmp(DataArray->ToElement()->Attribute("Name"), "Normals"))
+      for (int64 t = 0; t + 2 < Count; ++t)
       {
-        NormalOffset = DataArray->ToElement()->Int64Attribute("offset");
-        ArrayAvailable |= AVAIL_NORMALS;
+        int64 a, b, c2;
+        if (bStrips)
+        {
+          a = Cell[t];
+          b = (t % 2) ? Cell[t + 2] : Cell[t + 1];
+          c2 = (t % 2) ? Cell[t + 1] : Cell[t + 2];
+        }
+        else
+        {
+          a = Cell[0];
+          b = Cell[t + 1];
+          c2 = Cell[t + 2];
+        }
+        *Out++ = VertexOffset + static_cast<int32>(a);
+        *Out++ = VertexOffset + static_cast<int32>(b);
+        *Out++ = VertexOffset + static_cast<int32>(c2);
       }
-      else if (strcmp(DataArray->ToElement()->Attribute("Name") , "Tangents"))
+    }, NumCells < 1024);
+  return bValid;
+}
+
+// faces of the linear volume cells in VTK vertex order, oriented outwards
+struct FVTKCellFaces
+{
+  uint8 CellType;
+  TArray<TArray<int32>> Faces;
+};
+
+static const FVTKCellFaces* FindCellFaces(uint8 CellType)
+{
+  static const TArray<FVTKCellFaces> Cells
+  {
+    { 10, { {0, 1, 3}, {1, 2, 3}, {2, 0, 3}, {0, 2, 1} } },
+    { 12, { {0, 4, 7, 3}, {1, 2, 6, 5}, {0, 1, 5, 4}, {3, 7, 6, 2}, {0, 3, 2, 1}, {4, 5, 6, 7} } },
+    { 13, { {0, 1, 2}, {3, 5, 4}, {0, 3, 4, 1}, {1, 4, 5, 2}, {2, 5, 3, 0} } },
+    { 14, { {0, 3, 2, 1}, {0, 1, 4}, {1, 2, 4}, {2, 3, 4}, {3, 0, 4} } }
+  };
+  return Cells.FindByPredicate([CellType](const FVTKCellFaces& Cell) { return Cell.CellType == CellType; });
+}
+
+// Turns the cells of an unstructured grid into polygons and strips that can be rendered.
+// Surface cells are kept as they are, of the volume cells only faces that no other cell shares are kept.
+static void ExtractSurface(const TArray<int64>& Connectivity, const TArray<int64>& Starts, const TArray<uint8>& Types,
+  TArray<int64>& PolyConnectivity, TArray<int64>& PolyStarts, TArray<int64>& StripConnectivity, TArray<int64>& StripStarts)
+{
+  using FFaceKey = TTuple<int64, int64, int64, int64>;
+  TMap<FFaceKey, int32> FaceCount;
+  struct FFace
+  {
+    int64 Vertices[4];
+    int32 Num;
+    FFaceKey Key;
+  };
+  TArray<FFace> VolumeFaces;
+  PolyStarts.Reset();
+  PolyStarts.Add(0);
+  StripStarts.Reset();
+  StripStarts.Add(0);
+  const int32 NumCells = FMath::Min(Types.Num(), Starts.Num() - 1);
+  for (int32 c = 0; c < NumCells; ++c)
+  {
+    const int64* Cell = Connectivity.GetData() + Starts[c];
+    const int32 Count = static_cast<int32>(Starts[c + 1] - Starts[c]);
+    switch (Types[c])
+    {
+    case 5: case 7: case 9:
+      PolyConnectivity.Append(Cell, Count);
+      PolyStarts.Add(PolyConnectivity.Num());
+      break;
+    case 6:
+      StripConnectivity.Append(Cell, Count);
+      StripStarts.Add(StripConnectivity.Num());
+      break;
+    default:
+      if (const FVTKCellFaces* Faces = FindCellFaces(Types[c]))
       {
-        TangentOffset = DataArray->ToElement()->Int64Attribute("offset");
-        ArrayAvailable |= AVAIL_TANGENTS;
+        for (const auto& Face : Faces->Faces)
+        {
+          FFace& Out = VolumeFaces.AddDefaulted_GetRef();
+          Out.Num = Face.Num();
+          int64 Sorted[4] = { -1, -1, -1, -1 };
+          for (int32 i = 0; i < Out.Num; ++i)
+          {
+            Out.Vertices[i] = Face[i] < Count ? Cell[Face[i]] : -1;
+            Sorted[i] = Out.Vertices[i];
+          }
+          Algo::Sort(MakeArrayView(Sorted, Out.Num));
+          Out.Key = FFaceKey(Sorted[0], Sorted[1], Sorted[2], Sorted[3]);
+          ++FaceCount.FindOrAdd(Out.Key);
+        }
       }
+      // lines, vertices and quadratic cells have no surface that could be drawn
+      break;
     }
-    const char* raw = AppendedData->ToElement()->GetText();
+  }
+  for (const FFace& Face : VolumeFaces)
+  {
+    if (FaceCount[Face.Key] == 1)
+    {
+      PolyConnectivity.Append(Face.Vertices, Face.Num);
+      PolyStarts.Add(PolyConnectivity.Num());
+    }
+  }
+}
 
-    // Assemble points
+VTPMeshFactory::VTPMeshFactory()
+{
+}
 
-    const float* pointpointer = reinterpret_cast<const float*>(raw[PointOffset * sizeof(float)]);
-    for (int64 i = 0; i < NumberOfPoints; i += 3)
+VTPMeshFactory::~VTPMeshFactory()
+{
+}
+
+bool VTPMeshFactory::LoadFile(const FString& FileName, FGeometryPayload& Out, FString& Error) const
+{
+  FMappedFile File;
+  if (!File.Open(FileName))
+  {
+    Error = FString::Printf(TEXT("could not read %s"), *FileName);
+    return false;
+  }
+  return LoadFromMemory(File.GetData(), File.Num(), Out, Error);
+}
+
+bool VTPMeshFactory::LoadFromMemory(const uint8* Data, int64 Size, FGeometryPayload& Out, FString& Error) const
+{
+  Out.Reset();
+  FVTPFile File;
+  const char* Begin = reinterpret_cast<const char*>(Data);
+  if (!ParseStructure(Begin, Begin + Size, File, Error))
+  {
+    return false;
+  }
+
+  // only the arrays that end up in the payload are decoded
+  auto FindArray = [&File](int32 Piece, const TCHAR* Parent, const FString& Name) -> int32
+  {
+    return File.Arrays.IndexOfByPredicate([&](const FVTPDataArray& Array)
+      {
+        return Array.Piece == Piece && Array.Parent == Parent && (Name.IsEmpty() || Array.Name == Name);
+      });
+  };
+  struct FPieceArrays
+  {
+    int32 Points, Connectivity, Offsets, CellTypes, StripConnectivity, StripOffsets, Normals, TCoords, Scalars;
+  };
+  TArray<FPieceArrays> PieceArrays;
+  TArray<int32> Needed;
+  for (int32 p = 0; p < File.Pieces.Num(); ++p)
+  {
+    const FVTPPiece& Piece = File.Pieces[p];
+    FPieceArrays Arrays;
+    Arrays.Points = FindArray(p, TEXT("Points"), FString());
+    // unstructured grids keep all cells in one list with a type per cell
+    const TCHAR* CellParent = File.bUnstructured ? TEXT("Cells") : TEXT("Polys");
+    Arrays.Connectivity = FindArray(p, CellParent, TEXT("connectivity"));
+    Arrays.Offsets = FindArray(p, CellParent, TEXT("offsets"));
+    Arrays.CellTypes = File.bUnstructured ? FindArray(p, CellParent, TEXT("types")) : INDEX_NONE;
+    Arrays.StripConnectivity = FindArray(p, TEXT("Strips"), TEXT("connectivity"));
+    Arrays.StripOffsets = FindArray(p, TEXT("Strips"), TEXT("offsets"));
+    Arrays.Normals = FindArray(p, TEXT("PointData"), Piece.ActiveNormals.IsEmpty() ? TEXT("Normals") : Piece.ActiveNormals);
+    Arrays.TCoords = FindArray(p, TEXT("PointData"), Piece.ActiveTCoords.IsEmpty() ? TEXT("TCoords") : Piece.ActiveTCoords);
+    if (Arrays.TCoords == INDEX_NONE)
     {
-      MeshPoints.Add(FVector(pointpointer[i], pointpointer[i + 1], pointpointer[i + 2]));
+      Arrays.TCoords = FindArray(p, TEXT("PointData"), TEXT("Texture Coordinates"));
     }
+    const FString ScalarName = ScalarArray.IsEmpty() ? Piece.ActiveScalars : ScalarArray;
+    Arrays.Scalars = ScalarName.IsEmpty() ? INDEX_NONE : FindArray(p, TEXT("PointData"), ScalarName);
+    if (Arrays.Points == INDEX_NONE && Piece.NumberOfPoints > 0)
+    {
+      Error = FString::Printf(TEXT("piece %d has no points array"), p);
+      return false;
+    }
+    if ((Piece.NumberOfPolys > 0 || Piece.NumberOfCells > 0) && (Arrays.Connectivity == INDEX_NONE || Arrays.Offsets == INDEX_NONE))
+    {
+      Error = FString::Printf(TEXT("piece %d has cells without connectivity or offsets"), p);
+      return false;
+    }
+    if (File.bUnstructured && Piece.NumberOfCells > 0 && Arrays.CellTypes == INDEX_NONE)
+    {
+      Error = FString::Printf(TEXT("piece %d has cells without types"), p);
+      return false;
+    }
+    for (const int32 Index : { Arrays.Points, Arrays.Connectivity, Arrays.Offsets, Arrays.CellTypes, Arrays.StripConnectivity, Arrays.StripOffsets, Arrays.Normals, Arrays.TCoords, Arrays.Scalars })
+    {
+      if (Index != INDEX_NONE)
+        Needed.AddUnique(Index);
+    }
+    PieceArrays.Add(Arrays);
   }
-  else if (ReadingMode == "Binary")
+
+  TArray<FVTPDecoded> Decoded;
+  Decoded.SetNum(File.Arrays.Num());
+  TArray<FString> Errors;
+  Errors.SetNum(Needed.Num());
+  ParallelFor(Needed.Num(), [&](int32 i)
+    {
+      DecodeArray(File, File.Arrays[Needed[i]], Decoded[Needed[i]], Errors[i]);
+    });
+  for (const FString& ArrayError : Errors)
   {
-    FString Base64Points = ANSI_TO_TCHAR(Points->GetText());
-    TArray<uint8> BinaryData;
-    FBase64::Decode(Base64Points,BinaryData);
-    TArray<float> PointArray(reinterpret_cast<float*>(BinaryData.GetData()),BinaryData.Num() / sizeof(float));
-    FString Base64Polys = ANSI_TO_TCHAR(Polys->GetText());
-    for(int i = 0; i < PointArray.Num() / 3; ++i)
+    if (!ArrayError.IsEmpty())
     {
-      MeshPoints.Add(FVector(PointArray[3*i + 0], PointArray[3*i + 1], PointArray[3*i + 2]));
+      Error = ArrayError;
+      return false;
     }
-    BinaryData.Empty();
-    FBase64::Decode(Base64Polys,BinaryData);
-    TArray<int32> PolyArray(reinterpret_cast<int32*>(BinaryData.GetData()), BinaryData.Num() / sizeof(int32));
+  }
 
-    BinaryData.Empty();
+  for (int32 p = 0; p < File.Pieces.Num(); ++p)
+  {
+    const FVTPPiece& Piece = File.Pieces[p];
+    const FPieceArrays& Arrays = PieceArrays[p];
+    if (Piece.NumberOfPoints == 0)
+    {
+      continue;
+    }
+    const int32 VertexOffset = Out.Points.Num();
+    const int64 NumPoints = Piece.NumberOfPoints;
+    if (VertexOffset + NumPoints > MAX_int32)
+    {
+      Error = FString::Printf(TEXT("piece %d has more points than a mesh can hold"), p);
+      return false;
+    }
 
-    auto ArrayFinder = [PointData](const char* Name)-> tinyxml2::XMLElement*
+    TArray<double> Values;
+    ConvertArray(Decoded[Arrays.Points], Values);
+    const int32 PointComponents = Decoded[Arrays.Points].NumberOfComponents;
+    if (PointComponents != 3 || Values.Num() < NumPoints * 3)
     {
-      for (auto* child = PointData->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+      Error = FString::Printf(TEXT("piece %d declares %lld points but has %d values"), p, NumPoints, Values.Num());
+      return false;
+    }
+    Out.Points.AddUninitialized(static_cast<int32>(NumPoints));
+    FVector* Points = Out.Points.GetData() + VertexOffset;
+    ParallelFor(static_cast<int32>(NumPoints), [&](int32 i)
       {
-        if (strcmp(child->Attribute("Name"), Name) == 0)
+        Points[i] = FVector(Values[3 * i], Values[3 * i + 1], Values[3 * i + 2]);
+      }, NumPoints < VTPParallelBlock);
+
+    // optional attributes only survive if every piece has them, otherwise they are dropped below
+    if (Arrays.Normals != INDEX_NONE && Decoded[Arrays.Normals].NumberOfComponents == 3)
+    {
+      ConvertArray(Decoded[Arrays.Normals], Values);
+      if (Values.Num() >= NumPoints * 3 && Out.Normals.Num() == VertexOffset)
+      {
+        Out.Normals.AddUninitialized(static_cast<int32>(NumPoints));
+        for (int64 i = 0; i < NumPoints; ++i)
+          Out.Normals[VertexOffset + i] = FVector(Values[3 * i], Values[3 * i + 1], Values[3 * i + 2]);
+      }
+    }
+    if (Arrays.TCoords != INDEX_NONE && Decoded[Arrays.TCoords].NumberOfComponents >= 2)
+    {
+      ConvertArray(Decoded[Arrays.TCoords], Values);
+      const int32 Stride = Decoded[Arrays.TCoords].NumberOfComponents;
+      if (Values.Num() >= NumPoints * Stride && Out.UVs.Num() == VertexOffset)
+      {
+        Out.UVs.AddUninitialized(static_cast<int32>(NumPoints));
+        for (int64 i = 0; i < NumPoints; ++i)
+          Out.UVs[VertexOffset + i] = FVector2D(Values[Stride * i], Values[Stride * i + 1]);
+      }
+    }
+    if (Arrays.Scalars != INDEX_NONE)
+    {
+      // vector fields are shown by their magnitude
+      ConvertArray(Decoded[Arrays.Scalars], Values);
+      const int32 Stride = Decoded[Arrays.Scalars].NumberOfComponents;
+      if (Values.Num() >= NumPoints * Stride && Out.Scalars.Num() == VertexOffset)
+      {
+        Out.Scalars.AddUninitialized(static_cast<int32>(NumPoints));
+        for (int64 i = 0; i < NumPoints; ++i)
         {
-          return child;
+          double Sum = 0.0;
+          for (int32 c = 0; c < Stride; ++c)
+            Sum += Values[Stride * i + c] * Values[Stride * i + c];
+          Out.Scalars[VertexOffset + i] = static_cast<float>(Stride == 1 ? Values[i] : FMath::Sqrt(Sum));
         }
       }
-      return nullptr;
-    };
+    }
 
-    tinyxml2::XMLElement* FoundElement = ArrayFinder("Normals");
-    if(!FoundElement)
+    TArray<int64> Connectivity, Offsets, Starts;
+    if (File.bUnstructured)
     {
-      UE_LOG(LogTemp, Warning, TEXT("Did not find mesh vertex normals"));
+      if (Piece.NumberOfCells == 0)
+      {
+        continue;
+      }
+      TArray<uint8> Types;
+      TArray<int64> PolyConnectivity, PolyStarts, StripConnectivity, StripStarts;
+      ConvertArray(Decoded[Arrays.Connectivity], Connectivity);
+      ConvertArray(Decoded[Arrays.Offsets], Offsets);
+      ConvertArray(Decoded[Arrays.CellTypes], Types);
+      GetCellRanges(Offsets, Piece.NumberOfCells, File.bLegacyOffsets, Starts);
+      for (int32 c = 0; c + 1 < Starts.Num(); ++c)
+      {
+        if (Starts[c + 1] < Starts[c] || Starts[c + 1] > Connectivity.Num())
+        {
+          Error = FString::Printf(TEXT("piece %d has invalid cell offsets"), p);
+          return false;
+        }
+      }
+      ExtractSurface(Connectivity, Starts, Types, PolyConnectivity, PolyStarts, StripConnectivity, StripStarts);
+      if (!Triangulate(PolyConnectivity, PolyStarts, false, VertexOffset, NumPoints, Out.Triangles)
+        || !Triangulate(StripConnectivity, StripStarts, true, VertexOffset, NumPoints, Out.Triangles))
+      {
+        Error = FString::Printf(TEXT("piece %d has cells that reference missing points"), p);
+        return false;
+      }
+      continue;
     }
-    FBase64::Decode(Base64Polys, BinaryData);
-    TArray<float> NormalArray(reinterpret_cast<float*>(BinaryData.GetData()), BinaryData.Num() / sizeof(float));
-    for(int i = 0; i < NumberOfPoints; ++i)
+    const struct { int32 Connectivity, Offsets; int64 NumCells; bool bStrips; } Cells[] =
     {
-      Normals.Add({ NormalArray[i * 3 + 0],NormalArray[i * 3 + 1] ,NormalArray[i * 3 + 2] });
+      { Arrays.Connectivity, Arrays.Offsets, Piece.NumberOfPolys, false },
+      { Arrays.StripConnectivity, Arrays.StripOffsets, Piece.NumberOfStrips, true }
+    };
+    for (const auto& CellArrays : Cells)
+    {
+      if (CellArrays.NumCells == 0 || CellArrays.Connectivity == INDEX_NONE || CellArrays.Offsets == INDEX_NONE)
+      {
+        continue;
+      }
+      ConvertArray(Decoded[CellArrays.Connectivity], Connectivity);
+      ConvertArray(Decoded[CellArrays.Offsets], Offsets);
+      GetCellRanges(Offsets, CellArrays.NumCells, File.bLegacyOffsets, Starts);
+      if (!Triangulate(Connectivity, Starts, CellArrays.bStrips, VertexOffset, NumPoints, Out.Triangles))
+      {
+        Error = FString::Printf(TEXT("piece %d has cells that reference missing points"), p);
+        return false;
+      }
     }
-    
-    output->CreateMeshSection(0,MeshPoints,PolyArray,Normals,UV,Colors,Tangents,false);
   }
-  return output;
-#endif
+  if (Out.Normals.Num() != Out.Points.Num())
+    Out.Normals.Reset();
+  if (Out.UVs.Num() != Out.Points.Num())
+    Out.UVs.Reset();
+  if (Out.Scalars.Num() != Out.Points.Num())
+    Out.Scalars.Reset();
+  return true;
+}
+
+UProceduralMeshComponent* VTPMeshFactory::LoadFile(FString inFileName)
+{
+  UProceduralMeshComponent* Output = NewObject<UProceduralMeshComponent>();
+  FGeometryPayload Geometry;
+  FString Error;
+  if (!LoadFile(inFileName, Geometry, Error))
+  {
+    UE_LOG(LogTemp, Warning, TEXT("Could not load %s: %s"), *inFileName, *Error);
+    return Output;
+  }
+  Output->CreateMeshSection(0, Geometry.Points, Geometry.Triangles, Geometry.Normals, Geometry.UVs, TArray<FColor>(), TArray<FProcMeshTangent>(), false);
+  return Output;
 }
@@ -3,6 +3,14 @@
 
 #include "WorldSpawner.h"
 #include "SynavisDrone.h"
+#include "MeshBaker.h"
+#include "MeshLODGenerator.h"
+#include "Colormap.h"
+#include "MeshSplitter.h"
+#include "MeshOptimizer.h"
+#include "MeshSequencePlayer.h"
+#include "PointCloudActor.h"
+#include "MeshDescription.h"
 
 // Asset Registry
 #include "AssetRegistry/AssetRegistryModule.h"
@@ -18,6 +26,7 @@
 // Meshes
 #include "ProceduralMeshComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "Engine/StaticMesh.h"
 #include "Components/BoxComponent.h"
 // Materials and Runtime Textures
@@ -43,6 +52,7 @@
 #include "Engine/StreamableManager.h"
 // blueprint math library
 #include "Kismet/KismetMathLibrary.h"
+#include "TimerManager.h"
 // Audio
 
 
@@ -197,20 +207,338 @@ AWorldSpawner::AWorldSpawner()
 }
 
 AActor* AWorldSpawner::SpawnProcMesh(TArray<FVector> Points, TArray<FVector> Normals, TArray<int> Triangles,
-  TArray<float> Scalars, float Min, float Max, TArray<FVector2D> TexCoords, TArray<FProcMeshTangent> Tangents)
+  TArray<float> Scalars, float Min, float Max, TArray<FVector2D> TexCoords, TArray<FProcMeshTangent> Tangents, bool Bake, FString ColormapName)
 {
+  // the buffers come from the client, an index outside of the points would be read by every stage below
+  if (!FMeshOptimizer::HasValidIndices(Triangles, Points.Num()))
+  {
+    MessageToClient(TEXT("{\"type\":\"error\",\"message\":\"mesh has triangle indices outside of its points\"}"));
+    return nullptr;
+  }
   ASpawnTarget* Actor = GetWorld()->SpawnActor<ASpawnTarget>();
   const auto trans = this->GetTransformInCropField();
   Actor->SetActorTransform(trans);
 
-  Actor->ProcMesh->CreateMeshSection_LinearColor(0, Points, Triangles, Normals,
-    (TexCoords.Num() == Points.Num()) ? TexCoords : TArray<FVector2D>(),
-    TArray<FLinearColor>(),
-    (Tangents.Num() == Normals.Num()) ? Tangents : TArray<FProcMeshTangent>(), true);
-  this->OnSpawnProcMesh.Broadcast(Actor->ProcMesh);
+  if (OptimizeMeshes && Triangles.Num() > 0)
+  {
+    FGeometryPayload Geometry;
+    Geometry.Points = MoveTemp(Points);
+    Geometry.Normals = MoveTemp(Normals);
+    Geometry.Triangles = MoveTemp(Triangles);
+    Geometry.UVs = MoveTemp(TexCoords);
+    Geometry.Scalars = MoveTemp(Scalars);
+    Geometry.Tangents = MoveTemp(Tangents);
+    const FMeshOptimizationStats Stats = FMeshOptimizer::Optimize(Geometry, WeldEpsilon, VertexCacheSize);
+    Points = MoveTemp(Geometry.Points);
+    Normals = MoveTemp(Geometry.Normals);
+    Triangles = MoveTemp(Geometry.Triangles);
+    TexCoords = MoveTemp(Geometry.UVs);
+    Scalars = MoveTemp(Geometry.Scalars);
+    Tangents = MoveTemp(Geometry.Tangents);
+    FUtf8Builder Message(128);
+    FJsonResponseWriter Writer(Message);
+    Writer.BeginObject().Field("type", TEXT("optimize")).Field("name", Actor->GetName())
+      .Key("vertices").BeginArray().Value(Stats.VerticesBefore).Value(Stats.VerticesAfter).EndArray()
+      .Key("acmr").BeginArray().Value(Stats.ACMRBefore).Value(Stats.ACMRAfter).EndArray().EndObject();
+    MessageToClient(Message);
+  }
+
+  // scalar fields are shown as vertex colours, Min >= Max lets the colormap find the range itself
+  TArray<FColor> Colors;
+  if (Scalars.Num() == Points.Num())
+  {
+    const FColormap* Map = FColormap::Find(ColormapName.IsEmpty() ? Colormap : ColormapName);
+    if (!Map)
+    {
+      UE_LOG(LogTemp, Warning, TEXT("Unknown colormap %s, falling back to bluered"), *ColormapName);
+      Map = FColormap::Find(TEXT("bluered"));
+    }
+    Map->Map(Scalars, Min, Max, Colors);
+  }
+
+  // a baked mesh has a single set of bounds anyway, so only procedural meshes are split
+  const bool bBake = Bake || BakeSpawnedMeshes;
+  TArray<UProceduralMeshComponent*> Chunks{ Actor->ProcMesh };
+  if (SplitLargeMeshes && !bBake && Points.Num() > SplitVertexThreshold)
+  {
+    TArray<FProcMeshSection> Sections = FMeshSplitter::Split(Points, Triangles,
+      (Normals.Num() == Points.Num()) ? Normals : TArray<FVector>(),
+      (TexCoords.Num() == Points.Num()) ? TexCoords : TArray<FVector2D>(),
+      Colors,
+      (Tangents.Num() == Normals.Num()) ? Tangents : TArray<FProcMeshTangent>(), SplitVertexThreshold);
+    Actor->ProcMesh->SetProcMeshSection(0, Sections[0]);
+    // every further chunk is its own component so that it is culled with its own bounds
+    for (int32 i = 1; i < Sections.Num(); ++i)
+    {
+      UProceduralMeshComponent* Chunk = NewObject<UProceduralMeshComponent>(Actor);
+      Chunk->SetupAttachment(Actor->ProcMesh);
+      Chunk->RegisterComponent();
+      Actor->AddInstanceComponent(Chunk);
+      Chunk->SetProcMeshSection(0, Sections[i]);
+      Chunk->SetMaterial(0, Actor->ProcMesh->GetMaterial(0));
+      Chunks.Add(Chunk);
+    }
+    UE_LOG(LogTemp, Log, TEXT("Split mesh of %d vertices into %d chunks"), Points.Num(), Sections.Num());
+  }
+  else
+  {
+    Actor->ProcMesh->CreateMeshSection(0, Points, Triangles, Normals,
+      (TexCoords.Num() == Points.Num()) ? TexCoords : TArray<FVector2D>(),
+      Colors,
+      (Tangents.Num() == Normals.Num()) ? Tangents : TArray<FProcMeshTangent>(), true);
+  }
+  for (UProceduralMeshComponent* Chunk : Chunks)
+  {
+    this->OnSpawnProcMesh.Broadcast(Chunk);
+  }
+  if (bBake)
+  {
+    BakeProcMesh(Actor, BakeWithNanite, InstanceBakedMeshes);
+  }
+  else if (GenerateLODs)
+  {
+    for (UProceduralMeshComponent* Chunk : Chunks)
+    {
+      GenerateProcMeshLODs(Chunk);
+    }
+  }
+  return Actor;
+}
+
+AMeshSequencePlayer* AWorldSpawner::SpawnSequence()
+{
+  AMeshSequencePlayer* Player = GetWorld()->SpawnActor<AMeshSequencePlayer>();
+  Player->SetActorTransform(this->GetTransformInCropField());
+  Player->Material = DefaultMaterial;
+  Player->Colormap = Colormap;
+  return Player;
+}
+
+APointCloudActor* AWorldSpawner::SpawnPointCloud(TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Cloud, USceneCaptureComponent2D* ViewSource, UMaterialInterface* Material)
+{
+  APointCloudActor* Actor = GetWorld()->SpawnActor<APointCloudActor>();
+  Actor->SetActorTransform(this->GetTransformInCropField());
+  Actor->ViewSource = ViewSource;
+  Actor->Material = Material ? Material : PointCloudMaterial;
+  Actor->SetCloud(Cloud);
   return Actor;
 }
 
+void AWorldSpawner::BakeProcMesh(AActor* Actor, bool bNanite, bool bInstanced)
+{
+  // split meshes consist of several procedural components, which are baked back into one mesh
+  TArray<UProceduralMeshComponent*> ProcMeshes;
+  if (Actor)
+  {
+    Actor->GetComponents<UProceduralMeshComponent>(ProcMeshes);
+  }
+  TArray<FProcMeshSection> Sections;
+  TArray<UMaterialInterface*> Materials;
+  for (UProceduralMeshComponent* ProcMesh : ProcMeshes)
+  {
+    // sections of a procedural LOD set are not separate geometry, only the full detail one is baked
+    const int32 LODSet = ProcMeshLODs.IndexOfByPredicate([ProcMesh](const FProcMeshLODSet& Set) { return Set.Mesh.Get() == ProcMesh; });
+    const int32 NumSections = (LODSet != INDEX_NONE) ? 1 : ProcMesh->GetNumSections();
+    if (LODSet != INDEX_NONE)
+    {
+      ProcMeshLODs.RemoveAtSwap(LODSet);
+    }
+    for (int32 i = 0; i < NumSections; ++i)
+    {
+      Sections.Add(*ProcMesh->GetProcMeshSection(i));
+      UMaterialInterface* Material = ProcMesh->GetMaterial(i);
+      Materials.Add(Material ? Material : DefaultMaterial);
+    }
+  }
+  if (Sections.Num() == 0)
+  {
+    MessageToClient(TEXT("{\"type\":\"error\",\"message\":\"bake target has no procedural mesh\"}"));
+    return;
+  }
+  // hashing reads every vertex, the game thread only takes the copy of the sections
+  TWeakObjectPtr<AWorldSpawner> WeakThis(this);
+  TWeakObjectPtr<AActor> WeakActor(Actor);
+  auto Shared = MakeShared<const TArray<FProcMeshSection>, ESPMode::ThreadSafe>(MoveTemp(Sections));
+  FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, WeakActor, Shared, Materials, bNanite, bInstanced]()
+    {
+      FString Key = FMeshBaker::ComputeSectionKey(*Shared);
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, WeakActor, Shared, Materials, Key = MoveTemp(Key), bNanite, bInstanced]()
+        {
+          AWorldSpawner* Spawner = WeakThis.Get();
+          if (!Spawner || !WeakActor.IsValid())
+          {
+            return;
+          }
+          if (Spawner->BakedMeshes.Contains(Key))
+          {
+            Spawner->ApplyBakedMesh(WeakActor.Get(), Key, bInstanced);
+            return;
+          }
+          Spawner->BakeSections(WeakActor.Get(), Shared, Materials, Key, bNanite, bInstanced);
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void AWorldSpawner::BakeSections(AActor* Actor, TSharedRef<const TArray<FProcMeshSection>, ESPMode::ThreadSafe> Sections,
+  const TArray<UMaterialInterface*>& Materials, const FString& Key, bool bNanite, bool bInstanced)
+{
+  TWeakObjectPtr<AWorldSpawner> WeakThis(this);
+  TWeakObjectPtr<AActor> WeakActor(Actor);
+  // LODs of a baked mesh are static mesh LODs, which only works for single-section geometry
+  const int32 LODCount = (GenerateLODs && Sections->Num() == 1) ? FMath::Clamp(NumLODs, 2, 4) : 1;
+  TArray<float> ScreenSizes;
+  for (int32 LOD = 0; LOD < LODCount; ++LOD)
+  {
+    ScreenSizes.Add(FMeshLODGenerator::GetScreenSize(LOD, LODScreenSizeBase));
+  }
+  FFunctionGraphTask::CreateAndDispatchWhenReady(
+    [WeakThis, WeakActor, Sections, Materials, Key, bNanite, bInstanced, LODCount, ScreenSizes, Reduction = LODReduction]()
+    {
+      TArray<TSharedPtr<FMeshDescription, ESPMode::ThreadSafe>> Descriptions;
+      if (LODCount > 1)
+      {
+        for (const auto& LOD : FMeshLODGenerator::BuildLODChain((*Sections)[0], LODCount, Reduction))
+        {
+          Descriptions.Add(FMeshBaker::BuildMeshDescription({ LOD }));
+        }
+      }
+      else
+      {
+        Descriptions.Add(FMeshBaker::BuildMeshDescription(*Sections));
+      }
+      FFunctionGraphTask::CreateAndDispatchWhenReady(
+        [WeakThis, WeakActor, Descriptions, Materials, Key, bNanite, bInstanced, ScreenSizes]()
+        {
+          if (!WeakThis.IsValid() || !WeakActor.IsValid())
+          {
+            return;
+          }
+          AWorldSpawner* Spawner = WeakThis.Get();
+          if (!Spawner->BakedMeshes.Contains(Key))
+          {
+            TArray<const FMeshDescription*> LODs;
+            for (const auto& Description : Descriptions)
+            {
+              LODs.Add(Description.Get());
+            }
+            UStaticMesh* StaticMesh = FMeshBaker::CreateStaticMesh(Spawner, LODs, Materials, bNanite, ScreenSizes);
+            if (!StaticMesh)
+            {
+              Spawner->MessageToClient(TEXT("{\"type\":\"error\",\"message\":\"could not bake mesh\"}"));
+              return;
+            }
+            Spawner->BakedMeshes.Add(Key, StaticMesh);
+          }
+          Spawner->ApplyBakedMesh(WeakActor.Get(), Key, bInstanced);
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void AWorldSpawner::GenerateProcMeshLODs(UProceduralMeshComponent* ProcMesh)
+{
+  if (!ProcMesh || ProcMesh->GetNumSections() != 1)
+  {
+    return;
+  }
+  const int32 LODCount = FMath::Clamp(NumLODs, 2, 4);
+  TWeakObjectPtr<AWorldSpawner> WeakThis(this);
+  TWeakObjectPtr<UProceduralMeshComponent> WeakMesh(ProcMesh);
+  FFunctionGraphTask::CreateAndDispatchWhenReady(
+    [WeakThis, WeakMesh, Source = *ProcMesh->GetProcMeshSection(0), LODCount, Reduction = LODReduction]()
+    {
+      auto LODs = MakeShared<TArray<FProcMeshSection>, ESPMode::ThreadSafe>(FMeshLODGenerator::BuildLODChain(Source, LODCount, Reduction));
+      FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, WeakMesh, LODs]()
+        {
+          UProceduralMeshComponent* Mesh = WeakMesh.Get();
+          // the mesh might have been rebuilt or baked in the meantime
+          if (!WeakThis.IsValid() || !Mesh || Mesh->GetNumSections() != 1 || LODs->Num() < 2)
+          {
+            return;
+          }
+          UMaterialInterface* Material = Mesh->GetMaterial(0);
+          for (int32 LOD = 1; LOD < LODs->Num(); ++LOD)
+          {
+            Mesh->SetProcMeshSection(LOD, (*LODs)[LOD]);
+            Mesh->SetMeshSectionVisible(LOD, false);
+            Mesh->SetMaterial(LOD, Material);
+          }
+          FProcMeshLODSet Set;
+          Set.Mesh = Mesh;
+          Set.NumLODs = LODs->Num();
+          WeakThis->ProcMeshLODs.Add(Set);
+        }, TStatId(), nullptr, ENamedThreads::GameThread);
+    }, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void AWorldSpawner::ApplyBakedMesh(AActor* Actor, const FString& Key, bool bInstanced)
+{
+  UStaticMesh* StaticMesh = BakedMeshes.FindRef(Key);
+  // chunks of a split mesh are attached to the root, which carries the transform
+  UProceduralMeshComponent* ProcMesh = Cast<UProceduralMeshComponent>(Actor->GetRootComponent());
+  if (!ProcMesh)
+  {
+    ProcMesh = Actor->FindComponentByClass<UProceduralMeshComponent>();
+  }
+  if (!StaticMesh || !ProcMesh)
+  {
+    return;
+  }
+  const FString ActorName = Actor->GetName();
+  if (bInstanced)
+  {
+    UInstancedStaticMeshComponent* Instances = BakedInstances.FindRef(Key);
+    if (!Instances)
+    {
+      Instances = NewObject<UInstancedStaticMeshComponent>(this);
+      Instances->SetStaticMesh(StaticMesh);
+      Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+      Instances->SetupAttachment(GetRootComponent());
+      Instances->RegisterComponent();
+      AddInstanceComponent(Instances);
+      BakedInstances.Add(Key, Instances);
+    }
+    const int32 Index = Instances->AddInstance(ProcMesh->GetComponentTransform(), true);
+    // a bake of an already known mesh ends here right inside SpawnProcMesh, whose caller still uses the actor,
+    // so it is only hidden now and destroyed in the next tick
+    Actor->SetActorHiddenInGame(true);
+    Actor->SetActorEnableCollision(false);
+    GetWorldTimerManager().SetTimerForNextTick([WeakActor = TWeakObjectPtr<AActor>(Actor)]()
+      {
+        if (AActor* Replaced = WeakActor.Get())
+        {
+          Replaced->Destroy();
+        }
+      });
+    FUtf8Builder Message(160);
+    FJsonResponseWriter Writer(Message);
+    Writer.BeginObject().Field("type", TEXT("bake")).Field("name", ActorName).Field("state", TEXT("done"))
+      .Field("component", GetName() + TEXT(".") + Instances->GetName()).Field("instance", Index).EndObject();
+    MessageToClient(Message);
+  }
+  else
+  {
+    UStaticMeshComponent* Baked = NewObject<UStaticMeshComponent>(Actor);
+    Baked->SetStaticMesh(StaticMesh);
+    Baked->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    Baked->SetupAttachment(ProcMesh);
+    Baked->SetRelativeTransform(FTransform::Identity);
+    Baked->RegisterComponent();
+    Actor->AddInstanceComponent(Baked);
+    // the procedural component stays as the transform carrier, it just does not render anything anymore
+    TArray<UProceduralMeshComponent*> ProcMeshes;
+    Actor->GetComponents<UProceduralMeshComponent>(ProcMeshes);
+    for (UProceduralMeshComponent* Chunk : ProcMeshes)
+    {
+      Chunk->ClearAllMeshSections();
+    }
+    FUtf8Builder Message(128);
+    FJsonResponseWriter Writer(Message);
+    Writer.BeginObject().Field("type", TEXT("bake")).Field("name", ActorName).Field("state", TEXT("done"))
+      .Field("component", Baked->GetName()).EndObject();
+    MessageToClient(Message);
+  }
+}
+
 
 TArray<FString> AWorldSpawner::GetNamesOfSpawnableTypes()
 {
@@ -242,7 +570,10 @@ void AWorldSpawner::ReceiveStreamingCommunicatorRef()
       // spawn the object
       auto asset = StreamingHandle->GetLoadedAsset();
       GetWorld()->SpawnActor<AActor>(asset->GetClass());
-      MessageToClient(FString::Printf(TEXT("{\"type\":\"spawned\",\"name\":\"%s\"}"), *asset->GetName()));
+      FUtf8Builder Message(64);
+      FJsonResponseWriter Writer(Message);
+      Writer.BeginObject().Field("type", TEXT("spawned")).Field("name", asset->GetName()).EndObject();
+      MessageToClient(Message);
       HandlesToRelease.Add(StreamingHandle);
     }
   }
@@ -456,6 +787,14 @@ void AWorldSpawner::MessageToClient(FString Message)
   }
 }
 
+void AWorldSpawner::MessageToClient(FUtf8Builder& Message)
+{
+  if (IsValid(DroneRef))
+  {
+    DroneRef->SendUtf8(Message);
+  }
+}
+
 AActor *AWorldSpawner::SampleBoxMesh()
 {
   auto Points = TArray<FVector>{
@@ -529,5 +868,28 @@ void AWorldSpawner::Tick(float DeltaTime)
 
 
   }
+  // swap procedural LODs by their size in the scene camera
+  if (IsValid(DroneRef) && DroneRef->SceneCam && ProcMeshLODs.Num() > 0)
+  {
+    const FVector ViewOrigin = DroneRef->SceneCam->GetComponentLocation();
+    const float FOV = DroneRef->SceneCam->FOVAngle;
+    ProcMeshLODs.RemoveAllSwap([](const FProcMeshLODSet& Set) { return !Set.Mesh.IsValid(); });
+    for (auto& Set : ProcMeshLODs)
+    {
+      UProceduralMeshComponent* Mesh = Set.Mesh.Get();
+      const float ScreenSize = FMeshLODGenerator::ComputeScreenSize(Mesh->Bounds, ViewOrigin, FOV);
+      int32 LOD = 0;
+      while (LOD + 1 < Set.NumLODs && ScreenSize < FMeshLODGenerator::GetScreenSize(LOD + 1, LODScreenSizeBase))
+      {
+        ++LOD;
+      }
+      if (LOD != Set.CurrentLOD)
+      {
+        Mesh->SetMeshSectionVisible(Set.CurrentLOD, false);
+        Mesh->SetMeshSectionVisible(LOD, true);
+        Set.CurrentLOD = LOD;
+      }
+    }
+  }
 }
 
@@ -0,0 +1,63 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class USceneCaptureComponent2D;
+class FJsonObject;
+
+/**
+ * Decides which cameras capture in a frame. Every source has its own rate and priority,
+ * all of them share a budget of captures per frame. When a GPU budget is set, the number of captures
+ * per frame halves whenever the measured GPU frame time is above it and grows back slowly below it.
+ * Due sources compete by priority, then by how late they are. A source that is a whole interval late
+ * loses that deadline, which is counted as a miss. A parked source is never due and misses nothing,
+ * its next capture is due as soon as it is no longer parked. Game thread only.
+ */
+class SYNAVISUE_API FCaptureScheduler
+{
+public:
+  struct FSource
+  {
+    // camera name of the frame requests, scene, info or <data camera>/scene and so on
+    FString Name;
+    TWeakObjectPtr<USceneCaptureComponent2D> Camera;
+    // the frame request that is sent when the source is due
+    TSharedPtr<FJsonObject> Request;
+    double Interval = 1.0;
+    int32 Priority = 0;
+    double NextDue = 0.0;
+    int64 Captures = 0;
+    int64 Misses = 0;
+    // set by the owner while the frames of the source could not go anywhere
+    bool bParked = false;
+  };
+
+  // replaces a source of the same name, the first capture is due one interval from Now
+  FSource& Register(const FString& Name, USceneCaptureComponent2D* Camera, double Rate, int32 Priority, TSharedPtr<FJsonObject> Request, double Now);
+  bool Unregister(const FString& Name);
+  FSource* Find(const FString& Name);
+
+  // the sources to capture in this frame, most important first; GpuMilliseconds of the last frame, 0 if unknown
+  void Select(double Now, double GpuMilliseconds, TArray<FSource*>& Out);
+  // a selected source was captured, its next deadline follows one interval after the last
+  void Complete(FSource& Source);
+  // a selected source could not be captured, the deadline is lost like one that passed
+  void Miss(FSource& Source);
+
+  const TArray<FSource>& GetSources() const { return Sources; }
+  TArray<FSource>& GetSources() { return Sources; }
+  int64 GetMisses() const;
+  int32 GetAllowance() const { return FMath::Max(1, FMath::FloorToInt(Allowance)); }
+
+  // captures per frame, 0 for no limit
+  int32 MaxCaptures = 2;
+  // milliseconds of GPU time per frame, 0 to only count captures
+  double GpuBudget = 0.0;
+
+private:
+  TArray<FSource> Sources;
+  // captures per frame that the GPU budget currently allows
+  double Allowance = 1.0;
+};
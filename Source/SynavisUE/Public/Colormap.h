@@ -0,0 +1,31 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Named 256-entry colour lookup tables for mapping scalar fields onto vertex colours.
+ * Range computation and mapping are vectorised and split across worker threads for large arrays.
+ */
+class SYNAVISUE_API FColormap
+{
+public:
+  // returns nullptr for unknown names, names are case insensitive
+  static const FColormap* Find(const FString& Name);
+  static TArray<FString> GetNames();
+
+  // minimum and maximum of all values in one vectorised pass, returns false for empty input
+  static bool ComputeRange(const float* Values, int32 Num, float& OutMin, float& OutMax);
+
+  // Min >= Max means that the range is computed from the values
+  void Map(const float* Values, int32 Num, float Min, float Max, FColor* OutColors) const;
+  void Map(const TArray<float>& Values, float Min, float Max, TArray<FColor>& OutColors) const;
+
+  const FColor& Sample(float t) const { return LUT[FMath::Clamp(static_cast<int32>(t * 255.f + 0.5f), 0, 255)]; }
+
+  // evenly spaced control points, interpolated in sRGB like matplotlib's segmented maps
+  static FColormap FromControlPoints(const TArray<FColor>& Points);
+
+  FColor LUT[256];
+};
@@ -0,0 +1,98 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+
+class IFileHandle;
+
+// when written data is forced to the disk
+enum class EDatasetSync : uint8
+{
+  // left to the operating system
+  None,
+  // when a shard is complete
+  Shard,
+  // after every sample, slow but nothing is lost beyond the current sample
+  Sample,
+};
+
+/**
+ * Writes samples into sharded tar archives in the WebDataset layout on its own thread.
+ * A sample is a group of files that share a key, for instance 000000042.scene.jpeg and 000000042.json.
+ * Shards are named Prefix-000000.tar and so on, they are written as .tar.part and renamed once complete,
+ * so a reader never sees half a shard. Everything goes through a large buffer to keep the I/O sequential.
+ */
+class SYNAVISUE_API FDatasetWriter : public FRunnable
+{
+public:
+  struct FFile
+  {
+    // name within the sample, the part of the file name after the key
+    FString Name;
+    TArray<uint8> Data;
+  };
+
+  // ShardSize in bytes is a soft limit, a sample is never split across shards
+  FDatasetWriter(const FString& InDirectory, const FString& InPrefix, int64 InShardSize, EDatasetSync InSync);
+  virtual ~FDatasetWriter();
+
+  // the key is generated from a running count, blocks while too much data waits for the disk
+  void Write(TArray<FFile>&& Files);
+
+  virtual uint32 Run() override;
+  virtual void Stop() override;
+
+  static bool ParseSync(const FString& Name, EDatasetSync& Out);
+
+  // samples whose every entry reached the shard file
+  int64 GetSamples() const { return Samples; }
+  int64 GetBytes() const { return Bytes; }
+  int32 GetShards() const { return Shards; }
+  bool HasFailed() const { return bFailed; }
+
+private:
+  struct FSample
+  {
+    FString Key;
+    TArray<FFile> Files;
+  };
+
+  // all below on the writer thread
+  void WriteSample(FSample& Sample);
+  void WriteEntry(const FString& Name, const TArray<uint8>& Data);
+  void Append(const uint8* Data, int64 Length);
+  void FlushBuffer(bool bSync);
+  bool OpenShard();
+  void CloseShard();
+
+  FString Directory;
+  FString Prefix;
+  int64 ShardSize;
+  EDatasetSync Sync;
+
+  TUniquePtr<IFileHandle> File;
+  FString ShardFile;
+  int64 ShardBytes = 0;
+  int32 ShardIndex = 0;
+  TArray<uint8> Buffer;
+  // complete samples with data still in Buffer, counted once it is written
+  int64 BufferedSamples = 0;
+
+  FCriticalSection QueueLock;
+  TArray<FSample> Queue;
+  int64 QueuedBytes = 0;
+  int64 NextKey = 0;
+  FEvent* WakeUp = nullptr;
+  // raised by the writer whenever the queue shrinks
+  FEvent* Drained = nullptr;
+  FRunnableThread* Thread = nullptr;
+  std::atomic<bool> bStopping{ false };
+  std::atomic<bool> bFailed{ false };
+  std::atomic<int64> Samples{ 0 };
+  std::atomic<int64> Bytes{ 0 };
+  std::atomic<int32> Shards{ 0 };
+};
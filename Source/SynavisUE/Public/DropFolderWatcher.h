@@ -0,0 +1,45 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+
+/**
+ * Watches a folder for files that are renamed into it once they are complete.
+ * On Linux the watcher blocks on inotify, elsewhere it lists the folder in a fixed interval.
+ * Files that already exist when the watcher starts are only reported first if ReportExisting is set. Hidden files, temporary files
+ * (.tmp, .part) and sidecar .json files are not reported, writers should create files under such a name
+ * and rename them into place, writing the sidecar before the file it describes.
+ */
+class SYNAVISUE_API FDropFolderWatcher : public FRunnable
+{
+public:
+  // OnFile is called on the watcher thread with the full path of every new file
+  FDropFolderWatcher(const FString& InDirectory, TFunction<void(const FString&)> InOnFile, bool bInReportExisting = false, float InPollInterval = 0.25f);
+  virtual ~FDropFolderWatcher();
+
+  virtual uint32 Run() override;
+  virtual void Stop() override;
+
+  const FString& GetDirectory() const { return Directory; }
+
+  static bool IsIgnored(const FString& FileName);
+  // file.ext.json or file.json next to the file, empty if there is none
+  static FString FindSidecar(const FString& FileName);
+
+private:
+  // adds the files in the folder to Known, and reports the ones that were not known yet if bReport is set
+  void ScanExisting(TSet<FString>& Known, bool bReport);
+  bool RunNotify(TSet<FString>& Known);
+  void RunPolling(TSet<FString>& Known);
+
+  FString Directory;
+  TFunction<void(const FString&)> OnFile;
+  bool bReportExisting;
+  float PollInterval;
+  std::atomic<bool> bStopping{ false };
+  FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,99 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IImageWrapperModule;
+
+// how the pixels of a frame are packed before they are base64 encoded for the data channel
+enum class EFrameEncoding : uint8
+{
+  // FColor BGRA as it comes from the render target
+  Raw,
+  // raw pixels as an LZ4 block, the client knows the size from the frame header
+  LZ4,
+  // raw pixels as a zlib stream
+  Zlib,
+  QOI,
+  PNG,
+  JPEG,
+};
+
+// what a frame carries, colour frames are BGRA, the others are planes with one value per pixel
+enum class EFrameChannel : uint8
+{
+  Color,
+  // depth quantised to DepthUnit, needs a float target
+  Depth16,
+  // depth in centimetres as rendered, needs a float target
+  Depth32,
+  // segmentation ids from the red channel, run-length encoded, float targets hold them as id / 255 like an 8 bit target
+  Seg8,
+  // segmentation ids from the red (low byte) and green (high byte) channel, run-length encoded
+  Seg16,
+};
+
+struct SYNAVISUE_API FFrameCodec
+{
+  EFrameEncoding Encoding = EFrameEncoding::Raw;
+  // JPEG quality from 1 to 100, PNG compression level as IImageWrapper takes it (0 is the default), ignored otherwise
+  int32 Quality = 0;
+  EFrameChannel Channel = EFrameChannel::Color;
+  // centimetres per step of 16 bit depth, the default of a millimetre reaches 65 metres
+  float DepthUnit = 0.1f;
+  // colour frames only carry the tiles that changed since the last frame sent from this camera, frames go to every peer,
+  // so a peer that joins later asks for bKeyframe
+  bool bDelta = false;
+  int32 TileSize = 32;
+  // every this many frames, or when bKeyframe is set, the full frame is sent
+  int32 KeyframeInterval = 30;
+  bool bKeyframe = false;
+  // one half of a scene and info capture under the same id, the chunks name their camera in "cam"
+  bool bPaired = false;
+  // counts the pair requests, both halves of one pair carry the same number
+  int32 PairSerial = 0;
+  // crop in pixels of the render target, applied while reading back, empty for the whole frame
+  FIntRect Roi;
+  // output size relative to the crop, applied on the encoder thread before anything else
+  float Scale = 1.f;
+  // where the frame goes, to the client over the data channel, into the dataset on disk or both
+  bool bNetwork = true;
+  bool bDataset = false;
+
+  // false for unknown names
+  static bool Parse(const FString& Name, int32 Quality, FFrameCodec& Out);
+  static bool ParseChannel(const FString& Name, EFrameChannel& Out);
+  // network, dataset or both
+  static bool ParseSink(const FString& Name, FFrameCodec& Out);
+  static const TCHAR* GetName(EFrameEncoding Encoding);
+  static const TCHAR* GetChannelName(EFrameChannel Channel);
+  static bool IsDepth(EFrameChannel Channel) { return Channel == EFrameChannel::Depth16 || Channel == EFrameChannel::Depth32; }
+
+  // LZ4 or zlib of arbitrary data, false for the image codecs
+  static bool Compress(EFrameEncoding Encoding, const uint8* Data, int32 Bytes, TArray<uint8>& Out);
+
+  // encodes BGRA pixels, ImageWrappers is needed for PNG and JPEG and has to be loaded on the game thread beforehand
+  static bool Encode(const FFrameCodec& Codec, const TArray<FColor>& Pixels, int32 Width, int32 Height, IImageWrapperModule* ImageWrappers, TArray<uint8>& Out);
+
+  // the "Quite OK Image" format, lossless and much faster than PNG
+  static void EncodeQOI(const FColor* Pixels, int32 Width, int32 Height, TArray<uint8>& Out);
+
+  // little endian plane of the depth channel, Scale receives the metres per stored unit
+  static void PackDepth(const TArray<float>& Depth, EFrameChannel Channel, float DepthUnit, TArray<uint8>& Out, double& Scale);
+  // runs of (id, count) in little endian, ids in the width of the channel and counts as uint16
+  static void PackSegmentation(const TArray<FColor>& Pixels, EFrameChannel Channel, TArray<uint8>& Out);
+
+  // the size a frame of Width x Height has after Scale, at least one pixel
+  static FIntPoint GetScaledSize(int32 Width, int32 Height, float Scale);
+  // colours are box filtered where the size shrinks by a whole factor and bilinear otherwise,
+  // with bFilter unset (segmentation ids) the nearest pixel is taken
+  static void Resize(const TArray<FColor>& In, int32 Width, int32 Height, int32 OutWidth, int32 OutHeight, bool bFilter, TArray<FColor>& Out);
+  // depth takes the nearest value, averaging across an edge would invent surfaces
+  static void Resize(const TArray<float>& In, int32 Width, int32 Height, int32 OutWidth, int32 OutHeight, TArray<float>& Out);
+
+  // the tiles of Current that differ from Reference as uint16 tile size, uint32 tile count
+  // and per tile uint16 column, uint16 row and its BGRA rows clipped at the frame border, all little endian
+  // false if so much changed that the full frame is cheaper
+  static bool EncodeTiles(const TArray<FColor>& Current, const TArray<FColor>& Reference, int32 Width, int32 Height, int32 TileSize, TArray<uint8>& Out);
+};
@@ -0,0 +1,115 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "FrameReadback.h"
+#include "SendPacer.h"
+#include "FrameCodec.h"
+#include "ResponseWriter.h"
+#include "DatasetWriter.h"
+
+#include <atomic>
+
+/**
+ * Streams frames to the client from its own thread, one frame after the other so that chunks never interleave.
+ * Frames are compressed with the codec they were requested with on this thread,
+ * the chunks of a frame are base64 encoded in parallel on the task graph workers.
+ * Frames wait in a bounded queue, when the transport falls behind the oldest waiting frame is dropped,
+ * the client always gets the most recent frame instead of an ever growing backlog.
+ * Frames that go to the dataset are handed to its writer as full frames, regardless of delta settings.
+ * They are never dropped, the queue grows past its depth instead, and the ones still waiting are written when the encoder stops.
+ */
+class IImageWrapperModule;
+
+class SYNAVISUE_API FFrameEncoder : public FRunnable
+{
+public:
+  // Send is called on the encoder thread with every chunk message once the pacer lets it go, construct on the game thread
+  FFrameEncoder(TFunction<void(FUtf8Builder&)> InSend, TSharedPtr<FSendPacer, ESPMode::ThreadSafe> InPacer, int32 InQueueDepth = 2,
+    TSharedPtr<FDatasetWriter, ESPMode::ThreadSafe> InDataset = nullptr);
+  virtual ~FFrameEncoder();
+
+  void Submit(FReadbackFrame&& Frame, int32 MaxMessageSize);
+  // both frames are sent back to back and dropped together
+  void SubmitPair(FReadbackFrame&& First, FReadbackFrame&& Second, int32 MaxMessageSize);
+
+  virtual uint32 Run() override;
+  virtual void Stop() override;
+
+  // chunk messages of a frame, each within MaxMessageSize, whose data fields concatenate to the base64 of Data
+  // Fields are further members of the header, each followed by a comma
+  // empty if not even one group of the data fits next to the header
+  static TArray<FUtf8Builder> EncodeChunks(const FFramePose& Pose, const uint8* Data, int64 Bytes, const FUtf8Builder& Fields, int32 MaxMessageSize);
+  // chunks for Units of UnitLength characters when every chunk carries Overhead characters and its "i/n" besides them,
+  // 1 without a limit and 0 if a single unit does not fit
+  static int32 GetChunkCount(int64 Units, int32 UnitLength, int32 Overhead, int32 MaxMessageSize);
+
+  // applies the scale of the codec, the pose has the output size afterwards
+  static void Rescale(FReadbackFrame& Frame);
+
+  // frames, a pair counts once
+  int32 GetSent() const { return Sent; }
+  int32 GetDropped() const { return Dropped; }
+  int32 GetQueued() const;
+  // seconds from the request of a frame until its last chunk was sent
+  double GetLastLatency() const { return LastLatency; }
+  double GetMeanLatency() const { return MeanLatency; }
+
+private:
+  struct FPackedFrame
+  {
+    TArray<uint8> Storage;
+    // points into the frame or into Storage
+    const uint8* Data = nullptr;
+    int64 Bytes = 0;
+    // what was applied in the end, codecs fall back to raw where they fail
+    EFrameEncoding Encoding = EFrameEncoding::Raw;
+    // metres per stored unit of depth channels
+    double Scale = 0.0;
+    // the encoding ("e"), channel ("ch") and metric scale ("s") where they differ from a raw colour frame, each followed by a comma
+    FUtf8Builder Fields;
+  };
+  // applies channel and Codec to a frame
+  void Pack(const FReadbackFrame& Frame, const FFrameCodec& Codec, FPackedFrame& Out);
+  // replaces a colour frame by its changed tiles if the reference of its camera allows it, "df" tells which one it was
+  bool PackDelta(const FReadbackFrame& Frame, const FFrameCodec& Codec, FPackedFrame& Out);
+
+  // what the peers have last been sent from one camera and crop, only used on the encoder thread
+  struct FDeltaReference
+  {
+    TArray<FColor> Pixels;
+    int32 Width = 0;
+    int32 Height = 0;
+    int32 SinceKeyframe = 0;
+  };
+  TMap<FString, FDeltaReference> References;
+
+  struct FJob
+  {
+    TArray<FReadbackFrame, TInlineAllocator<2>> Frames;
+    int32 MaxMessageSize;
+  };
+  void Enqueue(FJob&& Job);
+  static bool HasDatasetFrames(const FJob& Job);
+  // false if the encoder is stopping; Half is the place of the frame in its job, the halves of a pair share their id
+  bool SendFrame(const FReadbackFrame& Frame, int32 MaxMessageSize, int32 Half);
+  // the frames of a job become one sample of the dataset
+  void StoreJob(const FJob& Job);
+
+  TFunction<void(FUtf8Builder&)> Send;
+  TSharedPtr<FSendPacer, ESPMode::ThreadSafe> Pacer;
+  TSharedPtr<FDatasetWriter, ESPMode::ThreadSafe> Dataset;
+  IImageWrapperModule* ImageWrappers = nullptr;
+  int32 QueueDepth;
+  mutable FCriticalSection QueueLock;
+  TArray<FJob> Queue;
+  FEvent* WakeUp = nullptr;
+  FRunnableThread* Thread = nullptr;
+  std::atomic<bool> bStopping{ false };
+  std::atomic<int32> Sent{ 0 };
+  std::atomic<int32> Dropped{ 0 };
+  std::atomic<double> LastLatency{ 0.0 };
+  std::atomic<double> MeanLatency{ 0.0 };
+};
@@ -0,0 +1,104 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "PixelFormat.h"
+#include "FrameCodec.h"
+
+#include <atomic>
+
+class FRHIGPUTextureReadback;
+class UTextureRenderTarget2D;
+
+// camera state of a frame at the time it was requested, sent to the client base64 encoded as the frame header
+struct FFramePose
+{
+  float FOV = 3.f;
+  int32 Width = 0;
+  int32 Height = 0;
+  int32 ID = 0;
+  float Position[3] = { 0.f, 0.f, 0.f };
+  float Rotation[3] = { 0.f, 0.f, 0.f };
+};
+
+enum class EFramePurpose : uint8
+{
+  // streamed to the client in chunks right away
+  Frame,
+  // kept for the receive protocol, which the client paces
+  Receive,
+};
+
+struct FReadbackFrame
+{
+  FFramePose Pose;
+  EFramePurpose Purpose = EFramePurpose::Frame;
+  FString Camera;
+  // how the frame leaves, applied on the encoder thread
+  FFrameCodec Codec;
+  // seconds of FPlatformTime when the frame was requested
+  double RequestTime = 0.0;
+  // JSON object with the tracked properties at the time of the request, stored next to dataset frames
+  FString Meta;
+  // gamma corrected 8 bit colours, row by row without padding, linear for the segmentation channels
+  TArray<FColor> Pixels;
+  // depth in centimetres from the first channel of a float target instead of Pixels, for the depth channels
+  TArray<float> Depth;
+};
+
+/**
+ * Ring of asynchronous copies from render targets into CPU memory.
+ * A request enqueues a GPU copy, Poll hands every finished copy to the caller in request order.
+ * Neither blocks on the GPU, the game thread no longer flushes rendering for each frame as ReadPixels did.
+ * Without a rendering RHI (-nullrhi) requests complete on the next poll with a generated test pattern,
+ * so that everything that consumes frames can run headless.
+ */
+class SYNAVISUE_API FFrameReadbackRing
+{
+public:
+  explicit FFrameReadbackRing(int32 Depth = 3);
+  ~FFrameReadbackRing();
+
+  // false if every slot is still in flight, the request is counted as dropped
+  bool Request(UTextureRenderTarget2D* Target, const FFramePose& Pose, EFramePurpose Purpose, const FString& Camera, const FFrameCodec& Codec = FFrameCodec(),
+    const FString& Meta = FString());
+
+  // hands every finished frame to OnFrame on the game thread
+  void Poll(TFunctionRef<void(FReadbackFrame&&)> OnFrame);
+
+  // false if fewer than Count slots are free, which counts as one dropped request
+  bool CanRequest(int32 Count);
+
+  int32 GetInFlight() const;
+  int32 GetDropped() const { return Dropped; }
+  static bool IsSynthetic();
+
+private:
+  enum class ESlotState : int32
+  {
+    Free,
+    // the copy is enqueued on the render thread
+    Requested,
+    // the copy is on the GPU
+    Copying,
+    // the render thread reads the finished copy
+    Reading,
+  };
+
+  struct FSlot
+  {
+    TUniquePtr<FRHIGPUTextureReadback> Readback;
+    std::atomic<ESlotState> State{ ESlotState::Free };
+    FReadbackFrame Frame;
+    EPixelFormat Format = PF_Unknown;
+    uint64 Sequence = 0;
+  };
+
+  TArray<TUniquePtr<FSlot>> Slots;
+  // frames that finished on the render thread, or synthetic frames
+  TQueue<FReadbackFrame, EQueueMode::Mpsc> Completed;
+  uint64 NextSequence = 0;
+  int32 Dropped = 0;
+};
@@ -0,0 +1,42 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GeometryPayload.h"
+
+/**
+ * Content-addressed on-disk store for received geometry.
+ * Entries are keyed by the lowercase hex SHA-1 of the raw buffers as they are transmitted
+ * (points, normals, triangles, texcoords, scalars in this order, tangents excluded),
+ * so that a client can compute the key before uploading anything.
+ */
+class SYNAVISUE_API FGeometryCache : public TSharedFromThis<FGeometryCache, ESPMode::ThreadSafe>
+{
+public:
+  explicit FGeometryCache(const FString& InDirectory);
+
+  static FString ComputeHash(const FGeometryPayload& Payload);
+  static bool IsValidHash(const FString& Hash);
+
+  bool Contains(const FString& Hash) const;
+
+  // writes the payload on a background thread, the hash is known to the index immediately
+  void StoreAsync(const FGeometryPayload& Payload, const FString& Hash);
+
+  bool Load(const FString& Hash, FGeometryPayload& OutPayload) const;
+
+  const FString& GetDirectory() const { return Directory; }
+  int32 Num() const;
+
+protected:
+  FString GetFileName(const FString& Hash) const;
+  static bool WriteFile(const FGeometryPayload& Payload, const FString& FileName);
+  static bool ReadFile(const FString& FileName, FGeometryPayload& OutPayload);
+
+  FString Directory;
+  mutable FCriticalSection IndexMutex;
+  TSet<FString> Index;
+  // entries that are announced but not yet on disk
+  TMap<FString, TSharedPtr<const FGeometryPayload, ESPMode::ThreadSafe>> Pending;
+};
@@ -0,0 +1,77 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GeometryPayload.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+struct FGeometryImportOptions
+{
+  // name of the per-vertex field that becomes the scalar field, empty uses the importer's default
+  FString ScalarArray;
+};
+
+// Read-only view of a whole file, memory mapped where the platform supports it and read into memory otherwise
+class SYNAVISUE_API FMappedFile
+{
+public:
+  FMappedFile();
+  ~FMappedFile();
+
+  bool Open(const FString& FileName);
+  const uint8* GetData() const { return Data; }
+  int64 Num() const { return Size; }
+
+private:
+  TUniquePtr<IMappedFileHandle> Handle;
+  TUniquePtr<IMappedFileRegion> Region;
+  TArray<uint8> Fallback;
+  const uint8* Data = nullptr;
+  int64 Size = 0;
+};
+
+/**
+ * Parser for one mesh file format. Importers work on the complete file contents and must be thread safe,
+ * as files are imported on worker threads. Every importer produces the payload that the spawner consumes.
+ */
+class SYNAVISUE_API IGeometryImporter
+{
+public:
+  virtual ~IGeometryImporter() = default;
+
+  virtual FString GetName() const = 0;
+  // lower case extensions without the dot
+  virtual TArray<FString> GetExtensions() const = 0;
+  // true if the contents carry an unambiguous signature of the format
+  virtual bool MatchesContent(const uint8* Data, int64 Size) const { return false; }
+  virtual bool Import(const uint8* Data, int64 Size, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const = 0;
+};
+
+/**
+ * Importers by format, chosen by file signature first and by extension second.
+ * Files that match neither are read in the raw layout of the filegeometry command.
+ */
+class SYNAVISUE_API FGeometryImporterRegistry
+{
+public:
+  static FGeometryImporterRegistry& Get();
+
+  void Register(TSharedRef<IGeometryImporter, ESPMode::ThreadSafe> Importer);
+
+  TSharedPtr<IGeometryImporter, ESPMode::ThreadSafe> FindImporter(const FString& FileName, const uint8* Data, int64 Size) const;
+
+  // maps the file and runs the matching importer on the calling thread
+  bool ImportFile(const FString& FileName, const FGeometryImportOptions& Options, FGeometryPayload& Out, FString& Error) const;
+
+  TArray<FString> GetSupportedExtensions() const;
+
+private:
+  FGeometryImporterRegistry();
+
+  mutable FCriticalSection Lock;
+  TArray<TSharedRef<IGeometryImporter, ESPMode::ThreadSafe>> Importers;
+  TSharedRef<IGeometryImporter, ESPMode::ThreadSafe> RawImporter;
+};
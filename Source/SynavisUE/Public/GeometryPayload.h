@@ -0,0 +1,30 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+
+// Decoded geometry as it is consumed by AWorldSpawner::SpawnProcMesh
+// This is what the data channel, the geometry cache and the file importers all produce
+struct FGeometryPayload
+{
+  TArray<FVector> Points;
+  TArray<FVector> Normals;
+  TArray<int32> Triangles;
+  TArray<FVector2D> UVs;
+  TArray<float> Scalars;
+  TArray<FProcMeshTangent> Tangents;
+
+  bool IsEmpty() const { return Points.Num() == 0 || Triangles.Num() == 0; }
+
+  void Reset()
+  {
+    Points.Reset();
+    Normals.Reset();
+    Triangles.Reset();
+    UVs.Reset();
+    Scalars.Reset();
+    Tangents.Reset();
+  }
+};
@@ -0,0 +1,31 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+
+struct FMeshDescription;
+class UStaticMesh;
+class UMaterialInterface;
+
+/**
+ * Converts procedural mesh sections into transient static meshes.
+ * The mesh description is plain data and can be assembled on any thread,
+ * the static mesh itself has to be created on the game thread.
+ */
+class SYNAVISUE_API FMeshBaker
+{
+public:
+  // every section becomes its own polygon group and material slot
+  static TSharedPtr<FMeshDescription, ESPMode::ThreadSafe> BuildMeshDescription(const TArray<FProcMeshSection>& Sections);
+
+  // identifies identical geometry so that it is only baked once, covers every stream the description is built from
+  // reads all vertices, call it on a worker for large meshes
+  static FString ComputeSectionKey(const TArray<FProcMeshSection>& Sections);
+
+  // LODs are expected in descending detail, the first entry becomes LOD0
+  // ScreenSizes optionally gives the screen size at which each LOD becomes active
+  static UStaticMesh* CreateStaticMesh(UObject* Outer, const TArray<const FMeshDescription*>& LODs,
+    const TArray<UMaterialInterface*>& Materials, bool bNanite, const TArray<float>& ScreenSizes = TArray<float>());
+};
@@ -0,0 +1,23 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+
+/**
+ * Builds a chain of simplified versions of a mesh section with the quadric error metric simplifier
+ * of the geometry processing module. Pure data in and out, meant to run on worker threads.
+ */
+class SYNAVISUE_API FMeshLODGenerator
+{
+public:
+  // The first entry is the unmodified source, every further LOD keeps Reduction times the triangles of its predecessor
+  static TArray<FProcMeshSection> BuildLODChain(const FProcMeshSection& Source, int32 NumLODs, float Reduction);
+
+  // screen size below which LOD index is used, LOD0 always has 1
+  static float GetScreenSize(int32 LODIndex, float Base) { return FMath::Pow(Base, static_cast<float>(LODIndex)); }
+
+  // approximates the fraction of the screen covered by a bounding sphere
+  static float ComputeScreenSize(const FBoxSphereBounds& Bounds, const FVector& ViewOrigin, float FOVDegrees);
+};
@@ -0,0 +1,42 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GeometryPayload.h"
+
+struct FMeshOptimizationStats
+{
+  int32 VerticesBefore = 0;
+  int32 VerticesAfter = 0;
+  // average cache miss ratio, transformed vertices per triangle for a FIFO cache
+  float ACMRBefore = 0.f;
+  float ACMRAfter = 0.f;
+};
+
+/**
+ * Ingest pass for triangle lists in whatever order the client mesher produced them.
+ * Welds duplicate vertices, reorders triangles for the post-transform cache (Tipsify, Sander et al. 2007)
+ * and renumbers vertices in first-use order for fetch locality. Pure data in and out.
+ */
+class SYNAVISUE_API FMeshOptimizer
+{
+public:
+  // runs all passes, attributes that do not match the number of points are dropped
+  static FMeshOptimizationStats Optimize(FGeometryPayload& Geometry, float WeldEpsilon = 0.f, int32 CacheSize = 16);
+
+  // merges vertices with identical attributes, positions only have to lie within Epsilon along every axis if it is positive
+  // triangles that collapse in the process are removed, returns the new number of vertices
+  static int32 WeldVertices(FGeometryPayload& Geometry, float Epsilon);
+
+  // large index buffers are processed in independent batches on worker threads
+  static void OptimizeVertexCache(TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize);
+
+  // renumbers vertices in the order in which the index buffer references them, unreferenced ones are removed
+  static void OptimizeVertexFetch(FGeometryPayload& Geometry);
+
+  // true if every index refers to one of NumVertices vertices, client buffers are checked with this before any pass
+  static bool HasValidIndices(const TArray<int32>& Triangles, int32 NumVertices);
+
+  static float ComputeACMR(const TArray<int32>& Triangles, int32 NumVertices, int32 CacheSize);
+};
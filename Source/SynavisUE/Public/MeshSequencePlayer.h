@@ -0,0 +1,100 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SpawnTarget.h"
+#include "GeometryPayload.h"
+#include "MeshSequencePlayer.generated.h"
+
+class FGeometryCache;
+
+/**
+ * Replays a time series of meshes, for example the timesteps of a growth simulation.
+ * Frames are given as geometry cache hashes or raw geometry files and are decoded on worker threads
+ * into a ring of hidden sections of the procedural mesh. Advancing a frame only swaps section visibility,
+ * so replay runs at render speed as long as the decode keeps up with the frame rate.
+ */
+UCLASS()
+class SYNAVISUE_API AMeshSequencePlayer : public ASpawnTarget
+{
+  GENERATED_BODY()
+
+public:
+  AMeshSequencePlayer();
+
+  // replaces the frames of the sequence and starts decoding from the first one
+  void SetFrames(const TArray<FString>& InFrames, TSharedPtr<FGeometryCache, ESPMode::ThreadSafe> InCache);
+
+  // advances by one frame, returns false if the next frame is not decoded yet or the sequence has ended
+  UFUNCTION(BlueprintCallable, Category = "Sequence")
+  bool Step();
+
+  // jumps to a frame, which becomes visible as soon as it is decoded
+  UFUNCTION(BlueprintCallable, Category = "Sequence")
+  bool Seek(int32 Frame);
+
+  UFUNCTION(BlueprintPure, Category = "Sequence")
+  int32 GetDisplayedFrame() const { return DisplayedFrame; }
+
+  UFUNCTION(BlueprintPure, Category = "Sequence")
+  int32 GetNumFrames() const { return Frames.Num(); }
+
+  // frames per second for timed playback, zero only advances on request
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  float FrameRate = 0.f;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  bool Loop = true;
+
+  // number of frames that are kept decoded ahead, including the visible one
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  int RingSize = 4;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  FString Colormap = TEXT("bluered");
+
+  // a fixed range keeps colours comparable between frames, Min >= Max maps every frame on its own range
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  FVector2D ScalarRange = FVector2D::ZeroVector;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Sequence")
+  UMaterialInterface* Material = nullptr;
+
+  // times a frame was due but not decoded yet, a frame that is waited on over several ticks counts once
+  UPROPERTY(BlueprintReadOnly, Category = "Sequence")
+  int32 Stalls = 0;
+
+  virtual void Tick(float DeltaTime) override;
+
+protected:
+  // dispatches decodes for all frames of the window ahead of the requested frame that are not in the ring
+  void FillRing();
+  // called on the game thread once a frame is decoded into the section of its slot
+  void OnFrameDecoded(int32 Frame, int32 Slot, int32 FrameGeneration, const FProcMeshSection& Section);
+  // shows the requested frame if its section is ready
+  void TryShowRequested();
+  // counts a stall once for every frame that is waited on
+  void NoteStall();
+
+  bool IsInWindow(int32 Frame) const;
+  // slot that holds or decodes the frame, INDEX_NONE if there is none
+  int32 GetSlot(int32 Frame) const { return SlotFrames.IndexOfByKey(Frame); }
+  // a slot that is empty or holds a frame that is neither visible nor in the window, INDEX_NONE if all are taken
+  int32 FindFreeSlot() const;
+
+  TArray<FString> Frames;
+  TSharedPtr<FGeometryCache, ESPMode::ThreadSafe> Cache;
+
+  // frame held by each section of the procedural mesh, slots are handed out by window position
+  TArray<int32> SlotFrames;
+  // whether the section of a slot is decoded, otherwise its frame is still in flight
+  TArray<bool> SlotReady;
+  int32 ActiveRingSize = 1;
+  int32 DisplayedFrame = INDEX_NONE;
+  int32 RequestedFrame = INDEX_NONE;
+  bool bStalled = false;
+  // results of decodes that were started for an older set of frames are dropped
+  int32 Generation = 0;
+  float Accumulator = 0.f;
+};
@@ -0,0 +1,23 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralMeshComponent.h"
+
+/**
+ * Splits large triangle meshes into spatially coherent chunks by recursive median splits of the
+ * triangle centroids (a BVH over triangles). Every chunk gets its own tight bounds, so that chunks
+ * of terrain-scale meshes can be culled independently once they live in separate components.
+ */
+class SYNAVISUE_API FMeshSplitter
+{
+public:
+  // Missing attributes are filled with the same defaults that CreateMeshSection uses.
+  // Vertices on chunk borders are copied into every chunk that uses them with identical attributes,
+  // so the chunks stay welded without visible seams. Returns a single section if no split is needed
+  // and none at all if an index lies outside of Points.
+  static TArray<FProcMeshSection> Split(const TArray<FVector>& Points, const TArray<int32>& Triangles,
+    const TArray<FVector>& Normals, const TArray<FVector2D>& UVs, const TArray<FColor>& Colors,
+    const TArray<FProcMeshTangent>& Tangents, int32 MaxVertices, bool bEnableCollision = true);
+};
@@ -0,0 +1,71 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GeometryImporter.h"
+
+// record layout of a binary point file, offsets are in bytes from the start of a record, INDEX_NONE if absent
+struct FPointCloudLayout
+{
+  int32 Stride = 12;
+  int32 HeaderBytes = 0;
+  bool bDoublePositions = false;
+  int32 ColorOffset = INDEX_NONE;
+  int32 IntensityOffset = INDEX_NONE;
+
+  // packed records described by a format name: xyz, xyzrgb, xyzi or xyzirgb, with float or double positions
+  // intensities are float32, colours are three uint8
+  static bool FromFormat(const FString& Format, bool bDouble, FPointCloudLayout& Out);
+};
+
+struct FCloudPoint
+{
+  FVector3f Position;
+  FColor Color;
+};
+
+struct FPointCloudNode
+{
+  FBox Bounds;
+  // range of the node's own points in the point file
+  int64 First = 0;
+  int32 Count = 0;
+  int32 Level = 0;
+  int32 Parent = INDEX_NONE;
+  int32 Children[8] = { INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE };
+};
+
+/**
+ * Octree over a point cloud that is too large to be held in memory.
+ * Every point is stored in exactly one node, inner nodes hold an even subsample of the points below them,
+ * so drawing a node and any of its ancestors adds detail without duplicates.
+ * The points are written in node order to a file next to the octree index and memory mapped,
+ * only the nodes that are drawn are ever paged in.
+ */
+class SYNAVISUE_API FPointCloud
+{
+public:
+  // builds the octree on the calling thread and its workers, or opens the result of an earlier build of the same file
+  // intensities are baked into the colours with the colormap, Min >= Max maps the range of the file
+  // the input is read in passes that hold at most GroupPoints points in memory, a cell that is too dense to fit fails the build
+  static TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Build(const FString& FileName, const FPointCloudLayout& Layout, const FString& CacheDirectory,
+    const FString& Colormap, FVector2D IntensityRange, FString& Error, int64 GroupPoints = 4 << 20);
+
+  // opens a built octree from its index and point file
+  static TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Open(const FString& IndexFile, const FString& PointFile, FString& Error);
+
+  const TArray<FPointCloudNode>& GetNodes() const { return Nodes; }
+  const FCloudPoint* GetPoints(int32 Node) const;
+  int64 GetNumPoints() const { return NumPoints; }
+  const FBox& GetBounds() const { return Nodes[0].Bounds; }
+
+  // points per inner node and most points in a leaf
+  static constexpr int32 NodeCapacity = 16384;
+  static constexpr int32 LeafCapacity = 32768;
+
+private:
+  TArray<FPointCloudNode> Nodes;
+  int64 NumPoints = 0;
+  FMappedFile PointFile;
+};
@@ -0,0 +1,86 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PointCloud.h"
+#include "PointCloudActor.generated.h"
+
+class UInstancedStaticMeshComponent;
+class USceneCaptureComponent2D;
+
+/**
+ * Draws a point cloud octree with one instanced mesh component per octree node.
+ * Every tick the nodes are chosen by their projected size in the view of the capture component,
+ * largest first, until the point budget is spent. Instances of newly chosen nodes are prepared on worker threads,
+ * hidden nodes are kept for a while so that small camera motions do not rebuild them.
+ * The point colour is passed as per instance custom data 0 to 2, the material has to read it from there
+ * for the points to show their colour.
+ */
+UCLASS()
+class SYNAVISUE_API APointCloudActor : public AActor
+{
+  GENERATED_BODY()
+
+public:
+  APointCloudActor();
+
+  void SetCloud(TSharedPtr<FPointCloud, ESPMode::ThreadSafe> InCloud);
+
+  // most points drawn for one capture
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  int32 PointBudget = 2000000;
+
+  // nodes that cover fewer pixels than this are not refined further
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  float MinNodePixels = 64.f;
+
+  // edge length of a point in world units
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  float PointSize = 1.f;
+
+  // nodes that are not drawn anymore but kept ready
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  int32 CachedNodes = 256;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  UStaticMesh* PointMesh = nullptr;
+
+  // reads the point colour from per instance custom data 0 to 2
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  UMaterialInterface* Material = nullptr;
+
+  // capture whose view selects the nodes, without one the first player camera is used
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "PointCloud")
+  USceneCaptureComponent2D* ViewSource = nullptr;
+
+  UPROPERTY(BlueprintReadOnly, Category = "PointCloud")
+  int32 VisiblePoints = 0;
+
+  UPROPERTY(BlueprintReadOnly, Category = "PointCloud")
+  int32 VisibleNodes = 0;
+
+  virtual void Tick(float DeltaTime) override;
+
+protected:
+  struct FNodeState
+  {
+    UInstancedStaticMeshComponent* Component = nullptr;
+    bool bLoading = false;
+    uint64 LastUsed = 0;
+  };
+
+  // chooses the nodes for the current view and requests the ones that are not ready
+  void UpdateSelection(const FVector& ViewLocation, const FVector& ViewDirection, float FOVDegrees, float ViewWidth);
+  void RequestNode(int32 Node);
+  void OnNodeLoaded(int32 Node, int32 LoadGeneration, TArray<FTransform> Transforms, TArray<float> CustomData);
+  void EvictHiddenNodes();
+
+  TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Cloud;
+  TMap<int32, FNodeState> NodeStates;
+  TSet<int32> Selected;
+  uint64 Frame = 0;
+  // nodes prepared for a cloud that was replaced in the meantime are dropped
+  int32 Generation = 0;
+};
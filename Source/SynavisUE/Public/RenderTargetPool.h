@@ -0,0 +1,56 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "UObject/GCObject.h"
+
+/**
+ * Creates render targets at any size and format when they are first needed and keeps them for later use.
+ * Released targets stay allocated, so switching back and forth between resolutions does not reallocate.
+ * Once the targets together exceed the budget, the released ones that were used longest ago are freed.
+ * Targets in use are never freed, a request beyond the budget is served anyway and only logged.
+ * The targets belong to the outer given on creation and are collected with it once the pool is gone.
+ * Game thread only.
+ */
+class SYNAVISUE_API FRenderTargetPool : public FGCObject
+{
+public:
+  // Budget in bytes of GPU memory for all targets, in use or not
+  explicit FRenderTargetPool(int64 InBudget);
+
+  // a released target of this kind if there is one, otherwise a new one with Outer as its outer
+  UTextureRenderTarget2D* Acquire(int32 Width, int32 Height, ETextureRenderTargetFormat Format, UObject* Outer);
+  // targets that did not come from the pool are ignored
+  void Release(UTextureRenderTarget2D* Target);
+  // frees released targets until the pool fits into the budget
+  void SetBudget(int64 InBudget);
+
+  static int64 GetTargetBytes(int32 Width, int32 Height, ETextureRenderTargetFormat Format);
+
+  int64 GetBytes() const { return Bytes; }
+  int32 Num() const { return Entries.Num(); }
+
+  virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+  virtual FString GetReferencerName() const override { return TEXT("FRenderTargetPool"); }
+
+private:
+  struct FEntry
+  {
+    TObjectPtr<UTextureRenderTarget2D> Target;
+    ETextureRenderTargetFormat Format;
+    int64 Bytes;
+    // value of UseCounter when it was last released, for the eviction order
+    uint64 LastUse;
+    bool bInUse;
+  };
+
+  // frees released targets, least recently used first, until Needed more bytes fit
+  void Evict(int64 Needed);
+
+  TArray<FEntry> Entries;
+  int64 Budget;
+  int64 Bytes = 0;
+  uint64 UseCounter = 0;
+};
@@ -0,0 +1,93 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Growing UTF-8 buffer that responses are written into.
+ * Text is converted from TCHAR while it is appended, numbers are formatted straight into the buffer,
+ * so a response is built in one allocation instead of a chain of FStrings.
+ */
+class SYNAVISUE_API FUtf8Builder
+{
+public:
+  FUtf8Builder() = default;
+  explicit FUtf8Builder(int32 Capacity) { Bytes.Reserve(Capacity); }
+
+  void Reset() { Bytes.Reset(); }
+  void Reserve(int32 Capacity) { Bytes.Reserve(Capacity); }
+  int32 Len() const { return Bytes.Num(); }
+  bool IsEmpty() const { return Bytes.Num() == 0; }
+  const ANSICHAR* GetData() const { return Bytes.GetData(); }
+  ANSICHAR Last() const { return Bytes.Num() > 0 ? Bytes.Last() : '\0'; }
+  void RemoveLast(int32 Count = 1) { Bytes.SetNum(FMath::Max(Bytes.Num() - Count, 0), false); }
+
+  FUtf8Builder& Append(ANSICHAR Character) { Bytes.Add(Character); return *this; }
+  FUtf8Builder& Append(const ANSICHAR* Text, int32 Length) { Bytes.Append(Text, Length); return *this; }
+  FUtf8Builder& Append(const ANSICHAR* Text) { return Append(Text, FCStringAnsi::Strlen(Text)); }
+  FUtf8Builder& Append(const FUtf8Builder& Other) { Bytes.Append(Other.Bytes); return *this; }
+  // converts from UTF-16 including surrogate pairs
+  FUtf8Builder& Append(FStringView Text);
+  FUtf8Builder& AppendInt(int64 Value);
+  // the shortest text that reads back to the same value, null for values JSON can not hold
+  FUtf8Builder& AppendDouble(double Value);
+  FUtf8Builder& AppendFloat(float Value);
+  // quoted and escaped for JSON
+  FUtf8Builder& AppendJsonString(FStringView Text);
+  FUtf8Builder& AppendBase64(const uint8* Data, int64 Length);
+
+  // the transport sends the character buffer of an FString as it is, so the UTF-8 bytes are packed into the TCHARs
+  // an odd byte count is padded with a space, which JSON ignores
+  FString ToTransport() const;
+  // the text as an FString, for logs and for callers that hand JSON on as a string
+  FString ToString(int32 MaxBytes = MAX_int32) const;
+
+private:
+  TArray<ANSICHAR> Bytes;
+};
+
+/**
+ * Minimal streaming JSON writer on top of FUtf8Builder, it takes care of the commas.
+ * Protocol keys are plain ASCII, names from the scene are passed as strings and escaped.
+ */
+class SYNAVISUE_API FJsonResponseWriter
+{
+public:
+  explicit FJsonResponseWriter(FUtf8Builder& InOut) : Out(InOut) {}
+
+  FJsonResponseWriter& BeginObject();
+  FJsonResponseWriter& EndObject();
+  FJsonResponseWriter& BeginArray();
+  FJsonResponseWriter& EndArray();
+  FJsonResponseWriter& Key(const ANSICHAR* Name);
+  FJsonResponseWriter& Key(FStringView Name);
+
+  FJsonResponseWriter& Value(bool Value);
+  FJsonResponseWriter& Value(int32 Value);
+  FJsonResponseWriter& Value(int64 Value);
+  FJsonResponseWriter& Value(float Value);
+  FJsonResponseWriter& Value(double Value);
+  FJsonResponseWriter& Value(FStringView Value);
+  FJsonResponseWriter& Value(const FString& Value) { return this->Value(FStringView(Value)); }
+  FJsonResponseWriter& Value(const TCHAR* Value) { return this->Value(FStringView(Value)); }
+  // as {"x":..,"y":..,"z":..}
+  FJsonResponseWriter& Value(const FVector& Value);
+  FJsonResponseWriter& Null();
+  // JSON that is already serialized, for instance by FJsonSerializer
+  FJsonResponseWriter& RawValue(FStringView Json);
+
+  template <typename ValueType>
+  FJsonResponseWriter& Field(const ANSICHAR* Name, const ValueType& FieldValue)
+  {
+    return Key(Name).Value(FieldValue);
+  }
+
+private:
+  // writes the comma in front of every element but the first of its container
+  void Separate();
+
+  FUtf8Builder& Out;
+  TArray<bool, TInlineAllocator<16>> First;
+  bool bAfterKey = false;
+};
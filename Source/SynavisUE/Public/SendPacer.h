@@ -0,0 +1,75 @@
+// Copyright Dirk Norbert Helmrich, 2023
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+/**
+ * Token bucket shared by all outbound bulk traffic (frame chunks, receive chunks).
+ * The rate adapts to feedback instead of a fixed sleep per chunk:
+ * acknowledged messages give round trip samples, the rate grows while the round trip stays close to its minimum
+ * and backs off once data queues up. Where the streamer reports the buffered amount of the data channel,
+ * a growing buffer backs off the same way. Without any feedback the rate stays at its initial value.
+ * Thread safe, workers block in Acquire while the game thread only uses the non-blocking calls.
+ */
+class SYNAVISUE_API FSendPacer
+{
+public:
+  FSendPacer(double InInitialRate, double InMinRate, double InMaxRate);
+
+  // keys of tracked messages, the client acknowledges them by frame id and chunk
+  static uint64 FrameKey(int32 ID, int32 Chunk) { return (static_cast<uint64>(static_cast<uint32>(ID)) << 32) | static_cast<uint32>(Chunk); }
+  static uint64 ReceiveKey(int32 Chunk) { return (1ull << 63) | static_cast<uint32>(Chunk); }
+
+  // blocks until Bytes may be sent, false if Abort was raised in the meantime; Key 0 is not tracked
+  bool Acquire(int64 Bytes, uint64 Key = 0, const std::atomic<bool>* Abort = nullptr);
+  // takes the tokens only if they are available right away
+  bool TryAcquire(int64 Bytes, uint64 Key = 0);
+  // accounts for a message that is sent regardless of the pacing
+  void Consume(int64 Bytes, uint64 Key = 0);
+
+  void Acknowledge(uint64 Key);
+  void ReportBufferedAmount(int64 Bytes);
+
+  double GetRate() const;
+  int64 GetInFlight() const;
+  // smoothed round trip of acknowledged messages in seconds, 0 before the first acknowledgement
+  double GetRoundTrip() const;
+
+  // seconds that data may queue up before the rate backs off
+  double TargetDelay = 0.05;
+  // messages without acknowledgement after this are considered lost
+  double AckTimeout = 2.0;
+
+private:
+  struct FOutstanding
+  {
+    int64 Bytes;
+    double SendTime;
+  };
+
+  // all below with Lock held
+  void Refill(double Now);
+  void Track(int64 Bytes, uint64 Key, double Now);
+  bool IsWindowFull(double Now);
+  void Increase(double Factor);
+  void Decrease(double Now);
+
+  mutable FCriticalSection Lock;
+  double Rate;
+  double MinRate;
+  double MaxRate;
+  double Tokens = 0.0;
+  double LastRefill;
+  TMap<uint64, FOutstanding> Outstanding;
+  int64 InFlight = 0;
+  bool bHasAcks = false;
+  double LastAck = 0.0;
+  double MinRoundTrip = -1.0;
+  double MinRoundTripTime = 0.0;
+  double RoundTrip = 0.0;
+  double LastDecrease = 0.0;
+  double LastSweep = 0.0;
+};
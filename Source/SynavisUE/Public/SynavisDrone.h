@@ -8,6 +8,12 @@
 
 #include "HAL/RunnableThread.h"
 #include "HAL/Runnable.h"
+#include "DropFolderWatcher.h"
+#include "FrameReadback.h"
+#include "FrameEncoder.h"
+#include "ResponseWriter.h"
+#include "RenderTargetPool.h"
+#include "CaptureScheduler.h"
 #include "Containers/Map.h"
 #include "PixelStreamingInputComponent.h"
 #include "ProceduralMeshComponent.h"
@@ -27,6 +33,7 @@ class USceneCaptureComponent2D;
 class UBoxComponent;
 class UTextureRenderTarget2D;
 class AWorldSpawner;
+class FGeometryCache;
 
 UENUM(BlueprintType)
 enum class EBlueprintSignalling : uint8
@@ -109,12 +116,23 @@ public:
   UFUNCTION(BlueprintCallable, Category = "Network")
     void SendResponse(FString Message, double StartTime = -1.0, int PlayerID = -1);
 
+  // every response ends up here, Response has to be a JSON object and receives the timing and player fields
+  void SendUtf8(FUtf8Builder& Response, double StartTime = -1.0, int PlayerID = -1);
+
   UFUNCTION(BlueprintCallable, Category = "Network")
     void SendError(FString Message);
 
   UFUNCTION(BlueprintCallable, Category = "Network")
     void ResetSynavisState();
 
+  // the streamer glue reports the buffered amount of the data channel here, it slows down bulk traffic when the channel fills up
+  UFUNCTION(BlueprintCallable, Category = "Network")
+    void ReportBufferedAmount(int64 Bytes);
+
+  // the streamer glue reports the number of connected peers here, automatic frames for the network wait while there are none
+  UFUNCTION(BlueprintCallable, Category = "Network")
+    void ReportPeers(int Peers);
+
   UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "View")
     USceneCaptureComponent2D* InfoCam;
   UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "View")
@@ -173,8 +191,19 @@ public:
   UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
     int DataChannelMaxSize = 32767;
 
-  UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Network")
-    float DataChannelBufferDelay = 0.1f;
+  // bulk traffic starts at this many bytes per second and adapts to the feedback of the client
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    float SendRateInitial = 1048576.f;
+
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    float SendRateMin = 65536.f;
+
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    float SendRateMax = 268435456.f;
+
+  // current rate of bulk traffic in bytes per second
+  UPROPERTY(BlueprintReadOnly, Category = "Network")
+    float SendRate = 0.f;
 
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
     float TurnWeight = 0.8f;
@@ -183,9 +212,22 @@ public:
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
     float CircleSpeed = 0.3f;
 
+  // seconds between automatic frames of the scene camera, 0 for none; other cameras are added with RegisterCaptureSource
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Time")
     float FrameCaptureTime = 10.f;
 
+  // automatic captures that may run in one frame, 0 for no limit
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Time")
+    int CaptureBudget = 2;
+
+  // milliseconds of GPU frame time above which fewer automatic captures run per frame, 0 to only count captures
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Time")
+    float CaptureGpuBudget = 0.f;
+
+  // deadlines of automatic captures that passed without a capture
+  UPROPERTY(BlueprintReadOnly, Category = "Time")
+    int CaptureMisses = 0;
+
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
     int RenderMode = 3;
 
@@ -195,6 +237,22 @@ public:
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
     float BlackDistance = 0.f;
 
+  // color renders the info material into 8 bit targets, half and float capture metric depth into R16f or R32f targets
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
+    FString InfoTargetFormat = TEXT("color");
+
+  // cameras render every frame so their targets can be watched live, otherwise they only render when a frame is taken
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
+    bool CapturePreview = false;
+
+  // scene renders of the cameras outside of the preview
+  UPROPERTY(BlueprintReadOnly, Category = "View")
+    int CaptureCount = 0;
+
+  // megabytes of render targets that are kept around after a resolution change before the oldest are freed
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
+    int RenderTargetBudget = 512;
+
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "View")
     float DirectionalIntensity = 10.0f;
 
@@ -260,15 +318,124 @@ public:
   UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
     int RawDataResolution = 256;
 
+  // frames that can be copied back from the GPU at the same time, further requests are dropped
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    int ReadbackDepth = 3;
+
+  // frame requests that found every readback slot busy
+  UPROPERTY(BlueprintReadOnly, Category = "Network")
+    int ReadbackDrops = 0;
+
+  // encoding of frames that do not name one: raw, lz4, zlib, qoi, png or jpeg
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    FString FrameEncoding = TEXT("raw");
+
+  // JPEG quality or PNG compression level of frames that do not name one
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    int FrameQuality = 0;
+
+  // send only the tiles that changed since the previous frame, for frames that do not say otherwise
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    bool FrameDelta = false;
+
+  // delta frames send the full frame every this many frames
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    int DeltaKeyframeInterval = 30;
+
+  // frames that can wait for the encoder, when the transport falls behind the oldest waiting frame is dropped
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    int EncodeQueueDepth = 2;
+
+  // frames the encoder dropped in favour of newer ones
+  UPROPERTY(BlueprintReadOnly, Category = "Network")
+    int EncodeDrops = 0;
+
+  // mean seconds from the request of a frame until its last chunk was sent
+  UPROPERTY(BlueprintReadOnly, Category = "Network")
+    float FrameLatency = 0.f;
+
+  // where frames of the scene camera go that do not name it: network, dataset or both
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Dataset")
+    FString SceneSink = TEXT("network");
+
+  // where frames of the info camera go that do not name it: network, dataset or both
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Dataset")
+    FString InfoSink = TEXT("network");
+
+  // defaults to Saved/SynavisDatasets when left empty, every session writes its own shards
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Dataset")
+    FString DatasetDirectory;
+
+  // megabytes after which the next dataset shard is started
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Dataset")
+    int DatasetShardSize = 1024;
+
+  // when the dataset is forced to the disk: none, shard or sample
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Dataset")
+    FString DatasetSync = TEXT("shard");
+
+  // samples written to the dataset so far
+  UPROPERTY(BlueprintReadOnly, Category = "Dataset")
+    int64 DatasetSamples = 0;
+
+  // runs the simulation in fixed steps as fast as rendering allows and captures into the dataset, also set by -SynavisFarm
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    bool FarmMode = false;
+
+  // simulated seconds per step in farm mode, -SynavisFarmTimestep=
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    float FarmTimestep = 1.f / 30.f;
+
+  // steps between captures in farm mode, -SynavisFarmInterval=
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    int FarmCaptureInterval = 1;
+
+  // samples after which farm mode ends, 0 runs until stopped, -SynavisFarmSamples=
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    int FarmSamples = 0;
+
+  // scene, info or dual, -SynavisFarmCamera=
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    FString FarmCamera = TEXT("scene");
+
+  // quit the application once FarmSamples are written
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Farm")
+    bool FarmQuit = true;
+
+  // store received meshes in a content-addressed cache so that clients can skip re-uploads
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    bool UseGeometryCache = true;
+
+  // defaults to Saved/SynavisGeometryCache when left empty
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    FString GeometryCacheDirectory;
+
+  // geometry and image files renamed into this folder are spawned without a request, their sidecar json holds the request fields
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    FString DropFolder;
+
+  // removes dropped files and their sidecars once they are imported, files that fail to import are kept
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    bool DropFolderConsume = false;
+
+  // also imports the files that are in the drop folder when it is set, otherwise only files dropped later
+  UPROPERTY(EditAnywhere, Config, BlueprintReadWrite, Category = "Network")
+    bool DropFolderExisting = false;
+
   UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Network")
     UPixelStreamingInput* RemoteInput;
 
   UFUNCTION(BlueprintCallable, Category = "View")
     void UpdateCamera();
 
+  // switches the cameras between rendering every frame and rendering on demand, see CapturePreview
+  UFUNCTION(BlueprintCallable, Category = "View")
+    void ApplyCaptureMode();
+
   UFUNCTION(BlueprintCallable, Category = "View")
     void SendFrame(){ SendRawFrame(nullptr,false); }
-    void SendRawFrame(TSharedPtr<FJsonObject> Data = nullptr, bool bFreezeID = false);
+    // false if the frame could not be requested
+    bool SendRawFrame(TSharedPtr<FJsonObject> Data = nullptr, bool bFreezeID = false);
 
   UFUNCTION(BlueprintCallable, Category = "Network")
     const bool IsInEditor() const;
@@ -283,12 +450,27 @@ public:
     TArray<FVector2D> UVs;
   UPROPERTY(BlueprintReadWrite, Category = "Network")
     TArray<float> Scalars;
+  // value range of the last decoded scalar field
+  UPROPERTY(BlueprintReadOnly, Category = "Network")
+    FVector2D ScalarRange = FVector2D::ZeroVector;
   UPROPERTY(BlueprintReadWrite, Category = "Network")
     TArray<FProcMeshTangent> Tangents;
 
   UFUNCTION(BlueprintCallable, Category = "Camera")
     void SetCameraResolution(int Resolution);
 
+  // gives both cameras targets of this size, the formats stay as they are
+  UFUNCTION(BlueprintCallable, Category = "Camera")
+    bool SetCameraSize(int Width, int Height);
+
+  // captures Camera automatically at Rate per second under Name, a rate of 0 removes the source
+  UFUNCTION(BlueprintCallable, Category = "Camera")
+    bool RegisterCaptureSource(USceneCaptureComponent2D* Camera, const FString& Name, float Rate, int Priority = 0);
+
+  // switches the info camera between its material and metric depth, see InfoTargetFormat
+  UFUNCTION(BlueprintCallable, Category = "Camera")
+    bool SetInfoTargetFormat(const FString& Format);
+
   TOptional<TFunction<void(TSharedPtr<FJsonObject>)>> ApplicationProcessInput;
 
   FCriticalSection Mutex;
@@ -318,10 +500,86 @@ protected:
   TArray<TTuple<double, double, TSharedPtr<FJsonObject>>> ScheduledTasks;
 
   void ApplyOrStoreTexture(TSharedPtr<FJsonObject> Json);
+  // assigns the texture to the material instance and object named in the request
+  void ApplyTexture(class UTexture2D* Texture, TSharedPtr<FJsonObject> Json);
+
+  // hashes the current geometry buffers and hands them to the cache, returns the hash or an empty string
+  FString CacheCurrentGeometry();
+
+  // imports a mesh file of any registered format on a worker and spawns it with the fields of the request
+  void ImportFileAsync(const FString& FileName, TSharedPtr<FJsonObject> Jason, double unixtime_start, int pid, bool bDeleteAfterImport = false);
+  // decodes an image file on a worker and applies it like a texture request
+  void ImportTextureAsync(const FString& FileName, TSharedPtr<FJsonObject> Jason, bool bDeleteAfterImport = false);
+
+  // starts watching the folder, an empty name stops the current watcher
+  void SetDropFolder(const FString& Directory);
+  // called on the game thread for every file that arrived in the drop folder
+  void OnDroppedFile(const FString& FileName, const FString& SidecarFile, const FString& Sidecar);
+
+  TUniquePtr<FDropFolderWatcher> DropFolderWatcher;
+
+  // captures the camera state and requests an asynchronous copy of its render target
+  bool RequestFrame(const FString& Camera, EFramePurpose Purpose, bool bFreezeID, const FFrameCodec& Codec = FFrameCodec());
+  // requests scene and info camera of the same render under one id and pose, both or none
+  bool RequestFramePair(bool bFreezeID, const FFrameCodec& SceneCodec, const FFrameCodec& InfoCodec);
+  FFramePose MakePose(USceneCaptureComponent2D* Camera, int32 ID) const;
+  // renders the camera now unless it renders every frame anyway or already did in this frame
+  void CaptureNow(USceneCaptureComponent2D* Camera);
+  // engine frame of the last render on demand per camera
+  TMap<const USceneCaptureComponent2D*, uint64> LastCaptureFrame;
+  // capture flags of cameras outside the drone from before they became a source, restored when the last source of one goes
+  TMap<TWeakObjectPtr<USceneCaptureComponent2D>, TPair<bool, bool>> ForeignCaptureModes;
+  // called from Tick for every frame that arrived from the GPU
+  void OnFrameReadback(FReadbackFrame&& Frame);
+  TUniquePtr<FFrameReadbackRing> ReadbackRing;
+  // first half of a pair that waits for its partner from the readback ring
+  TOptional<FReadbackFrame> PendingPair;
+  // serial of the last pair request, see FFrameCodec::PairSerial
+  int32 PairSerial = 0;
+  // paces frame and receive chunks, shared with the encoder thread
+  TSharedPtr<FSendPacer, ESPMode::ThreadSafe> SendPacer;
+  // streams frames to the client in chunks of the data channel size
+  TUniquePtr<FFrameEncoder> FrameEncoder;
+  // shards for frames that go to the dataset, written from its own thread
+  TSharedPtr<FDatasetWriter, ESPMode::ThreadSafe> DatasetWriter;
+  // the tracked properties as members of an open object
+  void WriteTrackedProperties(FJsonResponseWriter& Writer) const;
+  // the tracked properties as a JSON object for the dataset, empty if nothing is tracked
+  FString GetTrackingMeta() const;
+
+  // the automatic captures, see CaptureBudget
+  FCaptureScheduler CaptureScheduler;
+  // called from Tick outside of farm mode
+  void RunCaptureSchedule();
+  // peers as reported by the streamer glue, INDEX_NONE until it does
+  int32 ConnectedPeers = INDEX_NONE;
+  // without reports from the glue a client counts as connected once it sent a message
+  bool bPeerHeard = false;
+  bool HasPeer() const { return ConnectedPeers != INDEX_NONE ? ConnectedPeers > 0 : bPeerHeard; }
+  // scene, info, a registered source or <data camera>/scene and <data camera>/info
+  USceneCaptureComponent2D* FindCaptureCamera(const FString& Name);
+  // false if the crop of the codec lies entirely outside the target of the camera
+  bool RegionHitsTarget(USceneCaptureComponent2D* Camera, const FFrameCodec& Codec) const;
+  // a target of this size from the pool for one camera, UpdateCamera applies it to scene and info camera
+  bool ResizeCaptureTarget(USceneCaptureComponent2D* Camera, int Width, int Height);
+
+  // called from Tick in farm mode instead of the timed capture
+  void FarmTick();
+  TSharedPtr<FJsonObject> FarmRequest;
+  int64 FarmSteps = 0;
+  int32 FarmStepsSinceCapture = 0;
+  int64 FarmRequested = 0;
+  // requested frames that never made it, they are captured again
+  int64 FarmLost = 0;
+  bool bFarmDone = false;
+
+  TSharedPtr<FGeometryCache, ESPMode::ThreadSafe> GeometryCache;
 
   AWorldSpawner* WorldSpawner;
 
-  TMap<int, TPair<UTextureRenderTarget2D*, UTextureRenderTarget2D*>> RenderTargets;
+  // camera targets beyond the two assets, created on the first resolution change
+  TUniquePtr<FRenderTargetPool> TargetPool;
+  FRenderTargetPool& GetTargetPool();
   int LastTransmissionID = 100;
   FVector Velocity;
   FVector SpaceOrigin;
@@ -332,18 +590,35 @@ protected:
   float LowestLandscapeBound;
   class UMaterialInstanceDynamic* CallibratedPostprocess{ nullptr };
 
+  // float target of the info camera in the depth formats, sized like InfoCamTarget and taken from the pool
+  UPROPERTY(Transient)
+    UTextureRenderTarget2D* PreciseInfoTarget = nullptr;
+  // what the info camera captured before it was switched to depth
+  TEnumAsByte<ESceneCaptureSource> InfoColorSource = ESceneCaptureSource::SCS_FinalColorLDR;
+
   float FocalLength;
   float TargetFocalLength;
   FCollisionObjectQueryParams ParamsObject;
   FCollisionQueryParams ParamsTrace;
 
   float xprogress = 0.f;
-  float FrameCaptureCounter;
 
   FJsonObject JsonConfig;
   int LastProgress = -1;
   FString ReceptionName;
   FString ReceptionFormat;
+  // size and crop of the frame in ReceptionFormat, an empty crop is the whole target
+  int32 ReceptionWidth = 0;
+  int32 ReceptionHeight = 0;
+  FIntRect ReceptionRoi;
+  // ,"w":..,"h":.. and the crop for the receive chunks
+  void AppendReceptionShape(FUtf8Builder& Response) const;
+  // counts receive requests, a frame encoded for an older one is thrown away
+  int32 ReceptionSerial = 0;
+  // takes the base64 of a receive frame from the worker that encoded it and splits it into chunks
+  void StartReception(FString&& Encoded, int32 Width, int32 Height, const FIntRect& Roi);
+  // the whole message of one receive chunk
+  void BuildReceptionChunk(uint64 Chunk, FUtf8Builder& Response) const;
   uint8* ReceptionBuffer; // this is normally a reinterpret of the below
   uint64_t ReceptionBufferSize;
   uint64_t ReceptionBufferOffset;
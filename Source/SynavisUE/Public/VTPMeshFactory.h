@@ -1,17 +1,30 @@
-// Fill out your copyright notice in the Description page of Project Settings.
+// Copyright Dirk Norbert Helmrich, 2023
 
 #pragma once
 
 #include "CoreMinimal.h"
+#include "GeometryPayload.h"
 
 /**
- * 
+ * Reader for VTK XML PolyData (.vtp) and UnstructuredGrid (.vtu) files, of the latter only the surface is kept.
+ * The XML is scanned by a streaming tokenizer that only keeps the DataArray descriptions, no document tree is built.
+ * Arrays can be ascii, inline base64 or appended raw/base64 data, uncompressed or zlib compressed.
+ * Arrays and compressed blocks are decoded in parallel.
  */
 class SYNAVISUE_API VTPMeshFactory
 {
 public:
-	VTPMeshFactory();
-	~VTPMeshFactory();
+  VTPMeshFactory();
+  ~VTPMeshFactory();
 
-	class UProceduralMeshComponent* LoadFile(FString inFileName);
+  // point data array that becomes the scalar field, empty takes the active scalars of the file
+  FString ScalarArray;
+
+  // Polygons are triangulated as fans, triangle strips are unrolled, all pieces are merged
+  // returns false with a description in Error if the file is not readable VTK XML data
+  bool LoadFile(const FString& FileName, FGeometryPayload& Out, FString& Error) const;
+  bool LoadFromMemory(const uint8* Data, int64 Size, FGeometryPayload& Out, FString& Error) const;
+
+  // creates a transient procedural mesh component with the geometry of the file
+  class UProceduralMeshComponent* LoadFile(FString inFileName);
 };
@@ -9,6 +9,14 @@
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FSpawnProcMesh, UProceduralMeshComponent*, ProcMesh);
 
+// procedural mesh whose sections are LODs of one another, only one of them is visible at a time
+struct FProcMeshLODSet
+{
+  TWeakObjectPtr<UProceduralMeshComponent> Mesh;
+  int32 NumLODs = 1;
+  int32 CurrentLOD = 0;
+};
+
 
 USTRUCT(BlueprintType)
 struct FObjectSpawnInstance
@@ -23,9 +31,16 @@ struct FObjectSpawnInstance
 
 class UProceduralMeshComponent;
 class UMaterial;
+class UMaterialInterface;
 class UMaterialInstanceDynamic;
 struct FStreamableHandle;
 class ASynavisDrone;
+class AMeshSequencePlayer;
+class FGeometryCache;
+class APointCloudActor;
+class FPointCloud;
+class FUtf8Builder;
+class USceneCaptureComponent2D;
 
 UCLASS()
 class SYNAVISUE_API AWorldSpawner : public AActor
@@ -36,10 +51,74 @@ public:
   // Sets default values for this actor's properties
   AWorldSpawner();
 
+  // nullptr if a triangle index lies outside of the points, the client is told so
   UFUNCTION(BlueprintCallable, Category = "Field", meta = (AutoCreateRefTerm = "Tangents, TexCoords"))
   AActor* SpawnProcMesh(TArray<FVector> Points, TArray<FVector> Normals, TArray<int> Triangles,
     TArray<float> Scalars, float Min, float Max,
-    TArray<FVector2D> TexCoords, TArray<FProcMeshTangent> Tangents);
+    TArray<FVector2D> TexCoords, TArray<FProcMeshTangent> Tangents, bool Bake = false, FString ColormapName = TEXT(""));
+
+  // Spawns an empty player for a time series of meshes, its frames are set once the playback options are applied
+  AMeshSequencePlayer* SpawnSequence();
+
+  // Spawns an actor that draws a point cloud octree within the point budget of the given view, with PointCloudMaterial unless a material is given
+  APointCloudActor* SpawnPointCloud(TSharedPtr<FPointCloud, ESPMode::ThreadSafe> Cloud, USceneCaptureComponent2D* ViewSource, UMaterialInterface* Material = nullptr);
+
+  // colour table for scalar fields of spawned meshes, see FColormap for the available names
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  FString Colormap = TEXT("bluered");
+
+  // Converts the procedural mesh of an actor into a transient static mesh
+  // The mesh description is assembled on a worker thread, the component is swapped once the mesh is built
+  // Instanced bakes are merged into one instanced component per distinct geometry and the source actor is removed
+  void BakeProcMesh(AActor* Actor, bool bNanite, bool bInstanced);
+
+  // long-lived scenery is cheaper to render as a static mesh than through the dynamic draw path
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  bool BakeSpawnedMeshes = false;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  bool BakeWithNanite = false;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  bool InstanceBakedMeshes = false;
+
+  // welds duplicate vertices and reorders triangles and vertices for the GPU caches before a mesh is created
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  bool OptimizeMeshes = false;
+
+  // positions closer than this are welded, zero only welds exact duplicates
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  float WeldEpsilon = 0.f;
+
+  // post-transform cache size that the triangle order is optimised for
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  int VertexCacheSize = 16;
+
+  // meshes above the vertex threshold are split into spatial chunks, each in its own component with tight bounds
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  bool SplitLargeMeshes = false;
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Field")
+  int SplitVertexThreshold = 65536;
+
+  // Builds simplified LODs for a single-section procedural mesh on a worker thread
+  // LODs become hidden sections that are swapped by screen size relative to the scene camera
+  void GenerateProcMeshLODs(UProceduralMeshComponent* ProcMesh);
+
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+  bool GenerateLODs = false;
+
+  // number of LODs including the original mesh, between 2 and 4
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+  int NumLODs = 3;
+
+  // fraction of triangles that each LOD keeps from the previous one
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+  float LODReduction = 0.35f;
+
+  // LOD i is used below a screen size of LODScreenSizeBase^i
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+  float LODScreenSizeBase = 0.3f;
 
   UPROPERTY(EditAnywhere, Category = "Field")
   class UBoxComponent* CropField;
@@ -47,6 +126,10 @@ public:
   UPROPERTY(EditAnywhere, Category = "Coupling")
   UMaterial* DefaultMaterial;
 
+  // material of spawned point clouds, it has to read the point colour from per instance custom data 0 to 2
+  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Coupling")
+  UMaterialInterface* PointCloudMaterial = nullptr;
+
   UPROPERTY(BlueprintReadOnly, Category = "Management")
   TArray<FObjectSpawnInstance> SpawnedObjects;
 
@@ -114,11 +197,28 @@ protected:
   UPROPERTY()
   ASynavisDrone* DroneRef;
   void MessageToClient(FString Message);
+  void MessageToClient(FUtf8Builder& Message);
 
   TSharedPtr<FJsonObject> AssetCache;
 
   TArray<TSharedPtr<FStreamableHandle>> StreamableHandles;
 
+  // swaps the procedural mesh of the actor for the baked mesh, or adds an instance of it
+  void ApplyBakedMesh(AActor* Actor, const FString& Key, bool bInstanced);
+  // builds the static mesh of sections whose key is not baked yet on a worker and applies it on the game thread
+  void BakeSections(AActor* Actor, TSharedRef<const TArray<FProcMeshSection>, ESPMode::ThreadSafe> Sections, const TArray<UMaterialInterface*>& Materials,
+    const FString& Key, bool bNanite, bool bInstanced);
+
+  // procedural meshes with hidden LOD sections, switched in Tick
+  TArray<FProcMeshLODSet> ProcMeshLODs;
+
+  // baked geometry by content key, so that repeated spawns share render data
+  UPROPERTY()
+  TMap<FString, UStaticMesh*> BakedMeshes;
+
+  UPROPERTY()
+  TMap<FString, class UInstancedStaticMeshComponent*> BakedInstances;
+
   UPROPERTY()
   AActor* HeldActor;
   UPROPERTY()
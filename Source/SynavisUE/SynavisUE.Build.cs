@@ -26,11 +26,13 @@ public class SynavisUE : ModuleRules
 			new string[]
 			{
         "Core", "CoreUObject", "Engine",
-        "DynamicMesh", 
+        "DynamicMesh", "GeometryCore",
         "UMG", "Foliage","Json", 
         "Landscape", "Niagara",
         "ModelingComponents",
         "ProceduralMeshComponent", 
+        "MeshDescription",
+        "StaticMeshDescription",
         "PixelStreaming",
         "PixelStreamingBlueprint",
         // ... add other public dependencies that you statically link with here ...
@@ -44,7 +46,8 @@ public class SynavisUE : ModuleRules
 				"CoreUObject",
 				"Engine",
 				"Slate",
-				"SlateCore","DynamicMesh", "PixelStreaming"
+				"SlateCore","DynamicMesh", "PixelStreaming",
+				"ImageWrapper", "RHI", "RenderCore"
                 // ... add private dependencies that you statically link with here ...	
 			}
 			);